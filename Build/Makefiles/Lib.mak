@@ -135,6 +135,13 @@ CORE_SOURCES = 								\
     Ap4Eac3Parser.cpp                       \
     Ap4HevcParser.cpp                       \
     Ap4SegmentBuilder.cpp                   \
+    Ap4PlaylistWriter.cpp                   \
+    Ap4SegmentIndex.cpp                     \
+    Ap4FileSummary.cpp                      \
+    Ap4MoovUpdater.cpp                      \
+    Ap4FastStart.cpp                        \
+    Ap4SampleHashIndex.cpp                  \
+    Ap4Xxhash.cpp                           \
 
 
 CORE_OBJECTS=$(CORE_SOURCES:.cpp=.o)
@@ -145,7 +152,9 @@ CRYPTO_OBJECTS = $(CRYPTO_SOURCES:.cpp=.o)
 METADATA_SOURCES = Ap4MetaData.cpp
 METADATA_OBJECTS = $(METADATA_SOURCES:.cpp=.o)
 
-SYSTEM_SOURCES = $(FILE_BYTE_STREAM_IMPLEMENTATION).cpp $(RANDOM_IMPLEMENTATION).cpp
+THREADS_IMPLEMENTATION ?= Ap4PosixThreads
+TIME_IMPLEMENTATION ?= Ap4PosixTime
+SYSTEM_SOURCES = $(FILE_BYTE_STREAM_IMPLEMENTATION).cpp $(RANDOM_IMPLEMENTATION).cpp $(THREADS_IMPLEMENTATION).cpp $(TIME_IMPLEMENTATION).cpp
 SYSTEM_OBJECTS = $(SYSTEM_SOURCES:.cpp=.o)
 
 CODECS_SOURCES = Ap4AdtsParser.cpp Ap4BitStream.cpp Ap4Mp4AudioInfo.cpp
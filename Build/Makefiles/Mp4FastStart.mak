@@ -0,0 +1,36 @@
+##########################################################################
+#
+#    Mp4FastStart Program
+#
+#    (c) 2002-2017 Axiomatic Systems, LLC
+#
+##########################################################################
+all: mp4faststart
+
+##########################################################################
+# includes
+##########################################################################
+include $(BUILD_ROOT)/Makefiles/Lib.exp
+
+##########################################################################
+# targets
+##########################################################################
+TARGET_SOURCES = Mp4FastStart.cpp
+
+##########################################################################
+# make path
+##########################################################################
+VPATH += $(SOURCE_ROOT)/Apps/Mp4FastStart
+
+##########################################################################
+# includes
+##########################################################################
+include $(BUILD_ROOT)/Makefiles/Rules.mak
+
+##########################################################################
+# rules
+##########################################################################
+mp4faststart: $(TARGET_OBJECTS) $(TARGET_LIBRARY_FILES)
+	$(LINK) $(TARGET_OBJECTS) -o $@ $(LINK_LIBRARIES)
+
+
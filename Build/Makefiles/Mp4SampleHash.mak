@@ -0,0 +1,36 @@
+##########################################################################
+#
+#    Mp4SampleHash Program
+#
+#    (c) 2002-2017 Axiomatic Systems, LLC
+#
+##########################################################################
+all: mp4samplehash
+
+##########################################################################
+# includes
+##########################################################################
+include $(BUILD_ROOT)/Makefiles/Lib.exp
+
+##########################################################################
+# targets
+##########################################################################
+TARGET_SOURCES = Mp4SampleHash.cpp
+
+##########################################################################
+# make path
+##########################################################################
+VPATH += $(SOURCE_ROOT)/Apps/Mp4SampleHash
+
+##########################################################################
+# includes
+##########################################################################
+include $(BUILD_ROOT)/Makefiles/Rules.mak
+
+##########################################################################
+# rules
+##########################################################################
+mp4samplehash: $(TARGET_OBJECTS) $(TARGET_LIBRARY_FILES)
+	$(LINK) $(TARGET_OBJECTS) -o $@ $(LINK_LIBRARIES)
+
+
@@ -0,0 +1,36 @@
+##########################################################################
+#
+#    Mp4SegmentIndex Program
+#
+#    (c) 2002-2017 Axiomatic Systems, LLC
+#
+##########################################################################
+all: mp4segmentindex
+
+##########################################################################
+# includes
+##########################################################################
+include $(BUILD_ROOT)/Makefiles/Lib.exp
+
+##########################################################################
+# targets
+##########################################################################
+TARGET_SOURCES = Mp4SegmentIndex.cpp
+
+##########################################################################
+# make path
+##########################################################################
+VPATH += $(SOURCE_ROOT)/Apps/Mp4SegmentIndex
+
+##########################################################################
+# includes
+##########################################################################
+include $(BUILD_ROOT)/Makefiles/Rules.mak
+
+##########################################################################
+# rules
+##########################################################################
+mp4segmentindex: $(TARGET_OBJECTS) $(TARGET_LIBRARY_FILES)
+	$(LINK) $(TARGET_OBJECTS) -o $@ $(LINK_LIBRARIES)
+
+
@@ -19,6 +19,7 @@ export TARGET
 
 export FILE_BYTE_STREAM_IMPLEMENTATION
 export RANDOM_IMPLEMENTATION
+export THREADS_IMPLEMENTATION
 
 export CC
 export AUTODEP_CPP
@@ -49,7 +50,7 @@ Setup:
 	mkdir $(OUTPUT_DIR)
 
 # ------- Apps -----------
-ALL_APPS = mp4dump mp4info mp42aac mp42ts aac2mp4 mp4decrypt mp4encrypt mp4edit mp4extract mp4rtphintinfo mp4tag mp4dcfpackager mp4fragment mp4compact mp4split mp4mux avcinfo hevcinfo mp42hevc mp42hls mp4iframeindex
+ALL_APPS = mp4dump mp4info mp42aac mp42ts aac2mp4 mp4decrypt mp4encrypt mp4edit mp4extract mp4rtphintinfo mp4tag mp4dcfpackager mp4fragment mp4compact mp4split mp4mux avcinfo hevcinfo mp42hevc mp42hls mp4iframeindex mp4faststart mp4segmentindex mp4samplehash
 export ALL_APPS
 
 ##################################################################
@@ -157,6 +158,18 @@ mp4iframeindex: lib
 	$(TITLE)
 	@$(INVOKE_SUBMAKE) -f $(BUILD_ROOT)/Makefiles/Mp4IframeIndex.mak
 
+mp4faststart: lib
+	$(TITLE)
+	@$(INVOKE_SUBMAKE) -f $(BUILD_ROOT)/Makefiles/Mp4FastStart.mak
+
+mp4segmentindex: lib
+	$(TITLE)
+	@$(INVOKE_SUBMAKE) -f $(BUILD_ROOT)/Makefiles/Mp4SegmentIndex.mak
+
+mp4samplehash: lib
+	$(TITLE)
+	@$(INVOKE_SUBMAKE) -f $(BUILD_ROOT)/Makefiles/Mp4SampleHash.mak
+
 ##################################################################
 # includes
 ##################################################################
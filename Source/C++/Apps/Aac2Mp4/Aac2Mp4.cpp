@@ -41,6 +41,8 @@
 #define BANNER "AAC to MP4 Converter - Version 1.0\n"\
                "(Bento4 Version " AP4_VERSION_STRING ")\n"\
                "(c) 2002-2008 Axiomatic Systems, LLC"
+
+#define AAC2MP4_READ_BLOCK_SIZE (1024*1024)
  
 /*----------------------------------------------------------------------
 |   PrintUsageAndExit
@@ -96,19 +98,28 @@ main(int argc, char** argv)
     // create a sample table
     AP4_SyntheticSampleTable* sample_table = new AP4_SyntheticSampleTable();
 
-    // create an ADTS parser
-    AP4_AdtsParser parser;
+    // read the input in large blocks, and find the frames in place: the
+    // samples refer to the input stream, so the frame data is not copied
+    AP4_DataBuffer buffer;
+    AP4_Position   buffer_position = 0; // position of the buffer in the input
+    AP4_Size       buffer_offset = 0;
     bool           initialized = false;
     unsigned int   sample_description_index = 0;
 
-    // read from the input, feed, and get AAC frames
+    // read from the input and get AAC frames
     AP4_UI32     sample_rate = 0;
     AP4_Cardinal sample_count = 0;
     bool eos = false;
     for(;;) {
         // try to get a frame
-        AP4_AacFrame frame;
-        result = parser.FindFrame(frame);
+        AP4_AacFrameSpan frame;
+        AP4_Size bytes_consumed = 0;
+        result = AP4_AdtsParser::FindFrameSpan(buffer.GetData()+buffer_offset,
+                                               buffer.GetDataSize()-buffer_offset,
+                                               bytes_consumed,
+                                               frame,
+                                               eos);
+        buffer_offset += bytes_consumed;
         if (AP4_SUCCEEDED(result)) {
             AP4_Debug("AAC frame [%06d]: size = %d, %d kHz, %d ch\n",
                        sample_count,
@@ -138,32 +149,27 @@ main(int argc, char** argv)
                 sample_rate = frame.m_Info.m_SamplingFrequency;
             }
 
-            AP4_MemoryByteStream* sample_data = new AP4_MemoryByteStream(frame.m_Info.m_FrameLength);
-            frame.m_Source->ReadBytes(sample_data->UseData(), frame.m_Info.m_FrameLength);
-            sample_table->AddSample(*sample_data, 0, frame.m_Info.m_FrameLength, 1024, sample_description_index, 0, 0, true);
-            sample_data->Release();
+            AP4_Position frame_position = buffer_position+(frame.m_Data-buffer.GetData());
+            sample_table->AddSample(*input, frame_position, frame.m_Size, 1024, sample_description_index, 0, 0, true);
             sample_count++;
         } else if (!eos) {
-            // read some data and feed the parser
-            AP4_UI08 input_buffer[4096];
-            AP4_Size to_read = parser.GetBytesFree();
-            if (to_read) {
-                AP4_Size bytes_read = 0;
-                if (to_read > sizeof(input_buffer)) to_read = sizeof(input_buffer);
-                result = input->ReadPartial(input_buffer, to_read, bytes_read);
-                if (AP4_SUCCEEDED(result)) {
-                    AP4_Size to_feed = bytes_read;
-                    result = parser.Feed(input_buffer, &to_feed);
-                    if (AP4_FAILED(result)) {
-                        AP4_Debug("ERROR: parser.Feed() failed (%d)\n", result);
-                        return 1;
-                    }
-                } else {
-                    if (result == AP4_ERROR_EOS) {
-                        eos = true;
-                        parser.Feed(NULL, 0, true);
-                    }
+            // keep what has not been consumed, and read the next block
+            AP4_Size bytes_left = buffer.GetDataSize()-buffer_offset;
+            if (buffer_offset) {
+                AP4_MoveMemory(buffer.UseData(), buffer.GetData()+buffer_offset, bytes_left);
+                buffer_position += buffer_offset;
+                buffer_offset = 0;
+            }
+            buffer.SetDataSize(bytes_left+AAC2MP4_READ_BLOCK_SIZE);
+            AP4_Size bytes_read = 0;
+            result = input->ReadPartial(buffer.UseData()+bytes_left, AAC2MP4_READ_BLOCK_SIZE, bytes_read);
+            buffer.SetDataSize(bytes_left+(AP4_SUCCEEDED(result) ? bytes_read : 0));
+            if (AP4_FAILED(result)) {
+                if (result != AP4_ERROR_EOS) {
+                    AP4_Debug("ERROR: failed to read from the input (%d)\n", result);
+                    return 1;
                 }
+                eos = true;
             }
         } else {
             break;
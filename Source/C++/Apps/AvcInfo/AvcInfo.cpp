@@ -34,7 +34,6 @@
 
 #include "Ap4.h"
 #include "Ap4AvcParser.h"
-#include "Ap4BitStream.h"
 
 /*----------------------------------------------------------------------
 |   constants
@@ -57,34 +56,16 @@ PrintUsageAndExit()
     exit(1);
 }
 
-/*----------------------------------------------------------------------
-|   ReadGolomb
-+---------------------------------------------------------------------*/
-static unsigned int
-ReadGolomb(AP4_BitStream& bits)
-{
-    unsigned int leading_zeros = 0;
-    while (bits.ReadBit() == 0) {
-        leading_zeros++;
-    }
-    if (leading_zeros) {
-        return (1<<leading_zeros)-1+bits.ReadBits(leading_zeros);
-    } else {
-        return 0;
-    }
-}
-
 /*----------------------------------------------------------------------
 |   PrintSliceInfo
 +---------------------------------------------------------------------*/
 static void
 PrintSliceInfo(const unsigned char* data)
 {
-    AP4_BitStream bits;
-    bits.WriteBytes(data, 8);
-    ReadGolomb(bits);
+    AP4_BitReader bits(data, 8);
+    bits.ReadUE();
     
-    unsigned int slice_type = ReadGolomb(bits);
+    unsigned int slice_type = bits.ReadUE();
     const char* slice_type_name = AP4_AvcNalParser::SliceTypeName(slice_type);
     if (slice_type_name == NULL) slice_type_name = "?";
     printf(" slice=%d (%s)", slice_type, slice_type_name);
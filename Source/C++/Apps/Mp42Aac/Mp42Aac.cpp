@@ -80,16 +80,14 @@ GetSamplingFrequencyIndex(unsigned int sampling_frequency)
 }
 
 /*----------------------------------------------------------------------
-|   WriteAdtsHeader
+|   MakeAdtsHeader
 +---------------------------------------------------------------------*/
-static AP4_Result
-WriteAdtsHeader(AP4_ByteStream* output, 
-                unsigned int    frame_size,
-                unsigned int    sampling_frequency_index,
-                unsigned int    channel_configuration)
+static void
+MakeAdtsHeader(unsigned char* bits,
+               unsigned int   frame_size,
+               unsigned int   sampling_frequency_index,
+               unsigned int   channel_configuration)
 {
-	unsigned char bits[7];
-
 	bits[0] = 0xFF;
 	bits[1] = 0xF1; // 0xF9 (MPEG2)
     bits[2] = 0x40 | (sampling_frequency_index << 2) | (channel_configuration >> 2);
@@ -98,8 +96,6 @@ WriteAdtsHeader(AP4_ByteStream* output,
 	bits[5] = (((frame_size+7) << 5)&0xFF) | 0x1F;
 	bits[6] = 0xFC;
 
-	return output->Write(bits, 7);
-
 	/*
         0:  syncword 12 always: '111111111111' 
         12: ID 1 0: MPEG-4, 1: MPEG-2 
@@ -157,6 +153,7 @@ DecryptAndWriteSamples(AP4_Track*             track,
     AP4_Sample     sample;
     AP4_DataBuffer encrypted_data;
     AP4_DataBuffer decrypted_data;
+    AP4_DataBuffer frame;
     AP4_Ordinal    index = 0;
     while (AP4_SUCCEEDED(track->ReadSample(index, sample, encrypted_data))) {
         if (AP4_FAILED(decrypter->DecryptSampleData(encrypted_data, decrypted_data))) {
@@ -164,8 +161,11 @@ DecryptAndWriteSamples(AP4_Track*             track,
             return;
         }
 
-	    WriteAdtsHeader(output, decrypted_data.GetDataSize(), sampling_frequency_index, channel_configuration);
-        output->Write(decrypted_data.GetData(), decrypted_data.GetDataSize());
+        // write the header and the payload at once
+        frame.SetDataSize(7+decrypted_data.GetDataSize());
+        MakeAdtsHeader(frame.UseData(), decrypted_data.GetDataSize(), sampling_frequency_index, channel_configuration);
+        AP4_CopyMemory(frame.UseData()+7, decrypted_data.GetData(), decrypted_data.GetDataSize());
+        output->Write(frame.GetData(), frame.GetDataSize());
 	    index++;
     }
 }
@@ -186,12 +186,23 @@ WriteSamples(AP4_Track*             track,
     unsigned int sampling_frequency_index = GetSamplingFrequencyIndex(audio_desc->GetSampleRate());
     unsigned int channel_configuration    = audio_desc->GetChannelCount();
 
+    // read each sample right after room for its header, so that the
+    // header and the payload can be written at once
     AP4_Sample     sample;
-    AP4_DataBuffer data;
+    AP4_DataBuffer frame;
     AP4_Ordinal    index = 0;
-    while (AP4_SUCCEEDED(track->ReadSample(index, sample, data))) {
-	    WriteAdtsHeader(output, sample.GetSize(), sampling_frequency_index, channel_configuration);
-        output->Write(data.GetData(), data.GetDataSize());
+    while (AP4_SUCCEEDED(track->GetSample(index, sample))) {
+        AP4_ByteStream* sample_stream = sample.GetDataStream();
+        if (sample_stream == NULL) break;
+        frame.SetDataSize(7+sample.GetSize());
+        MakeAdtsHeader(frame.UseData(), sample.GetSize(), sampling_frequency_index, channel_configuration);
+        AP4_Result result = sample_stream->Seek(sample.GetOffset());
+        if (AP4_SUCCEEDED(result)) {
+            result = sample_stream->Read(frame.UseData()+7, sample.GetSize());
+        }
+        sample_stream->Release();
+        if (AP4_FAILED(result)) break;
+        output->Write(frame.GetData(), frame.GetDataSize());
 	    index++;
     }
 }
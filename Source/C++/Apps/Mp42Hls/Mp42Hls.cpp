@@ -83,6 +83,8 @@ static struct _Options {
     unsigned int          segment_duration;
     unsigned int          segment_duration_threshold;
     const char*           allow_cache;
+    AP4_HlsPlaylistWriter::PlaylistType playlist_type;
+    unsigned int          playlist_window;
     const char*           encryption_key_hex;
     AP4_UI08              encryption_key[16];
     AP4_UI08              encryption_iv[16];
@@ -151,6 +153,11 @@ PrintUsageAndExit()
             "    Filename to use for the playlist/index (default: stream.m3u8)\n"
             "  --allow-cache <YES|NO>\n"
             "    set #EXT-X-ALLOW-CACHE to YES or NO\n"
+            "  --playlist-type <vod|event|live>\n"
+            "    Type of playlist (default: vod). With 'event' and 'live', the playlist is\n"
+            "    updated each time a segment is complete, instead of only at the end\n"
+            "  --playlist-window <n>\n"
+            "    Maximum number of segments listed in a 'live' playlist (default: 0, no limit)\n"
             "  --segment-filename-template <pattern>\n"
             "    Filename pattern to use for the segments. Use a printf-style pattern with\n"
             "    one number field for the segment number, unless using single file mode\n"
@@ -267,37 +274,6 @@ OpenOutput(const char* filename_pattern, unsigned int segment_number)
     return output;
 }
 
-/*----------------------------------------------------------------------
-|   PreventStartCodeEmulation
-+---------------------------------------------------------------------*/
-static void
-PreventStartCodeEmulation(const AP4_UI08* payload, AP4_Size payload_size, AP4_DataBuffer& output)
-{
-    output.Reserve(payload_size*2); // more than enough
-    AP4_Size  output_size = 0;
-    AP4_UI08* buffer = output.UseData();
-    
-	unsigned int zero_counter = 0;
-	for (unsigned int i = 0; i < payload_size; i++) {
-		if (zero_counter == 2) {
-            if (payload[i] == 0 || payload[i] == 1 || payload[i] == 2 || payload[i] == 3) {
-                buffer[output_size++] = 3;
-                zero_counter = 0;
-            }
-		}
-
-        buffer[output_size++] = payload[i];
-
-		if (payload[i] == 0) {
-			++zero_counter;
-		} else {
-			zero_counter = 0;
-        }
-	}
-
-    output.SetDataSize(output_size);
-}
-
 /*----------------------------------------------------------------------
 |   EncryptingStream
 +---------------------------------------------------------------------*/
@@ -563,7 +539,7 @@ SampleEncrypter::EncryptVideoSample(AP4_DataBuffer& sample, AP4_UI08 nalu_length
 
             // perform startcode emulation prevention
             AP4_DataBuffer escaped_nalu;
-            PreventStartCodeEmulation(nalu+nalu_length_size, nalu_length, escaped_nalu);
+            AP4_NalParser::Escape(nalu+nalu_length_size, nalu_length, escaped_nalu);
             
             // the size may have changed
             // TODO: this could overflow if nalu_length_size is too small
@@ -1018,6 +994,145 @@ ReadSample(SampleReader&   reader,
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   ComputeMaxSegmentDuration
++---------------------------------------------------------------------*/
+static AP4_Result
+ComputeMaxSegmentDuration(AP4_Movie&      movie,
+                          AP4_ByteStream& input,
+                          AP4_Track&      track,
+                          bool            sync_samples_only,
+                          double&         max_duration)
+{
+    // replay the segmentation done by WriteSamples on the timestamps of the
+    // track that drives it, since segments are cut at sync samples and can
+    // be longer than the nominal segment duration
+    max_duration = 0.0;
+    
+    // fragmented files are scanned with a separate reader, which does
+    // not read the sample data
+    AP4_LinearReader* reader   = NULL;
+    AP4_Position      position = 0;
+    if (movie.HasFragments()) {
+        input.Tell(position);
+        reader = new AP4_LinearReader(movie, &input);
+        reader->EnableTrack(track.GetId());
+    }
+    
+    double     timescale = (double)track.GetMediaTimeScale();
+    double     threshold = (double)Options.segment_duration_threshold/1000.0;
+    double     last_ts   = 0.0;
+    double     end_ts    = 0.0;
+    AP4_Result result    = AP4_SUCCESS;
+    for (AP4_Ordinal i=0;; i++) {
+        AP4_Sample sample;
+        if (reader) {
+            AP4_UI32 track_id = 0;
+            result = reader->GetNextSample(sample, track_id);
+        } else if (i < track.GetSampleCount()) {
+            result = track.GetSample(i, sample);
+        } else {
+            result = AP4_ERROR_EOS;
+        }
+        if (AP4_FAILED(result)) break;
+        
+        double ts = (double)sample.GetDts()/timescale;
+        if (!sync_samples_only || sample.IsSync()) {
+            if (ts-last_ts >= (double)Options.segment_duration-threshold) {
+                if (ts-last_ts > max_duration) max_duration = ts-last_ts;
+                last_ts = ts;
+            }
+        }
+        end_ts = ts+(double)sample.GetDuration()/timescale;
+    }
+    if (end_ts-last_ts > max_duration) max_duration = end_ts-last_ts;
+    
+    if (reader) {
+        delete reader;
+        input.Seek(position);
+    }
+    
+    return result == AP4_ERROR_EOS ? AP4_SUCCESS : result;
+}
+
+/*----------------------------------------------------------------------
+|   AppendString
++---------------------------------------------------------------------*/
+static void
+AppendString(AP4_DataBuffer& buffer, const char* chars)
+{
+    buffer.AppendData((const AP4_UI08*)chars, (AP4_Size)strlen(chars));
+}
+
+/*----------------------------------------------------------------------
+|   AddKeyTags
++---------------------------------------------------------------------*/
+static void
+AddKeyTags(AP4_HlsPlaylistWriter& playlist, bool use_key_lines)
+{
+    if (Options.encryption_mode == ENCRYPTION_MODE_NONE) return;
+    
+    const char* method = "";
+    if (Options.encryption_mode == ENCRYPTION_MODE_AES_128) {
+        method = "AES-128";
+    } else if (Options.encryption_mode == ENCRYPTION_MODE_SAMPLE_AES) {
+        method = "SAMPLE-AES";
+    }
+    char iv_hex[33];
+    iv_hex[32] = 0;
+    AP4_FormatHex(Options.encryption_iv, 16, iv_hex);
+    
+    AP4_DataBuffer tag;
+    if (use_key_lines && Options.encryption_key_lines.ItemCount()) {
+        for (unsigned int i=0; i<Options.encryption_key_lines.ItemCount(); i++) {
+            AP4_String& key_line = Options.encryption_key_lines[i];
+            const char* key_line_cstr = key_line.GetChars();
+            bool omit_iv = false;
+            
+            // omit the IV if the key line starts with a "!" (and skip the "!")
+            if (key_line[0] == '!') {
+                ++key_line_cstr;
+                omit_iv = true;
+            }
+            
+            tag.SetDataSize(0);
+            AppendString(tag, "#EXT-X-KEY:METHOD=");
+            AppendString(tag, method);
+            AppendString(tag, ",");
+            AppendString(tag, key_line_cstr);
+            if ((Options.encryption_iv_mode == ENCRYPTION_IV_MODE_RANDOM ||
+                 Options.encryption_iv_mode == ENCRYPTION_IV_MODE_FPS) && !omit_iv) {
+                AppendString(tag, ",IV=0x");
+                AppendString(tag, iv_hex);
+            }
+            tag.AppendData((const AP4_UI08*)"", 1);
+            playlist.AddHeaderTag((const char*)tag.GetData());
+        }
+    } else {
+        AppendString(tag, "#EXT-X-KEY:METHOD=");
+        AppendString(tag, method);
+        AppendString(tag, ",URI=\"");
+        AppendString(tag, Options.encryption_key_uri);
+        AppendString(tag, "\"");
+        if (Options.encryption_iv_mode == ENCRYPTION_IV_MODE_RANDOM) {
+            AppendString(tag, ",IV=0x");
+            AppendString(tag, iv_hex);
+        }
+        if (Options.encryption_key_format) {
+            AppendString(tag, ",KEYFORMAT=\"");
+            AppendString(tag, Options.encryption_key_format);
+            AppendString(tag, "\"");
+        }
+        if (Options.encryption_key_format_versions) {
+            AppendString(tag, ",KEYFORMATVERSIONS=\"");
+            AppendString(tag, Options.encryption_key_format_versions);
+            AppendString(tag, "\"");
+        }
+        tag.AppendData((const AP4_UI08*)"", 1);
+        playlist.AddHeaderTag((const char*)tag.GetData());
+    }
+}
+
 /*----------------------------------------------------------------------
 |   WriteSamples
 +---------------------------------------------------------------------*/
@@ -1031,6 +1146,7 @@ WriteSamples(AP4_Mpeg2TsWriter*               ts_writer,
              SampleReader*                    video_reader, 
              AP4_Mpeg2TsWriter::SampleStream* video_stream,
              unsigned int                     segment_duration_threshold,
+             unsigned int                     target_duration,
              AP4_UI08                         nalu_length_size)
 {
     AP4_Sample              audio_sample;
@@ -1060,11 +1176,26 @@ WriteSamples(AP4_Mpeg2TsWriter*               ts_writer,
     AP4_Array<AP4_UI32>     iframe_segment_indexes;
     bool                    new_segment = true;
     AP4_ByteStream*         raw_output = NULL;
-    AP4_ByteStream*         playlist = NULL;
+    AP4_HlsPlaylistWriter   playlist(Options.playlist_type, Options.hls_version);
+    char                    playlist_filename[4096];
     char                    string_buffer[4096];
     SampleEncrypter*        sample_encrypter = NULL;
     AP4_Result              result = AP4_SUCCESS;
     
+    // setup the media playlist/index file
+    sprintf(playlist_filename, Options.index_filename, 0);
+    playlist.SetIndependentSegments(video_track != NULL);
+    playlist.SetAllowCache(Options.allow_cache);
+    if (Options.playlist_type != AP4_HlsPlaylistWriter::PLAYLIST_TYPE_VOD) {
+        // the target duration must not change when the playlist is updated,
+        // so it is set to the longest segment duration upfront
+        playlist.SetTargetDuration(target_duration);
+    }
+    if (Options.playlist_type == AP4_HlsPlaylistWriter::PLAYLIST_TYPE_LIVE) {
+        playlist.SetWindowSize(Options.playlist_window);
+    }
+    AddKeyTags(playlist, true);
+    
     // prime the samples
     if (audio_reader) {
         result = ReadSample(*audio_reader, *audio_track, audio_sample, audio_sample_data, audio_ts, audio_frame_duration, audio_eos);
@@ -1135,6 +1266,20 @@ WriteSamples(AP4_Mpeg2TsWriter*               ts_writer,
                     segment_sizes.Append(segment_size);
                     segment_positions.Append(segment_position);
                     segment_durations.Append(segment_duration);
+                    
+                    // update the playlist
+                    sprintf(string_buffer, Options.segment_url_template, segment_number);
+                    playlist.AddSegment(string_buffer,
+                                        segment_duration,
+                                        Options.output_single_file?segment_size:0,
+                                        Options.output_single_file?segment_position:0);
+                    if (Options.playlist_type != AP4_HlsPlaylistWriter::PLAYLIST_TYPE_VOD) {
+                        result = playlist.WriteFile(playlist_filename);
+                        if (AP4_FAILED(result)) {
+                            fprintf(stderr, "ERROR: failed to write playlist (%d)\n", result);
+                            return result;
+                        }
+                    }
             
                     if (segment_duration != 0.0) {
                         double segment_bitrate = 8.0*(double)segment_size/segment_duration;
@@ -1339,122 +1484,21 @@ WriteSamples(AP4_Mpeg2TsWriter*               ts_writer,
         }
     }
     
-    // create the media playlist/index file
-    playlist = OpenOutput(Options.index_filename, 0);
-    if (playlist == NULL) return AP4_ERROR_CANNOT_OPEN_FILE;
-
-    unsigned int target_duration = 0;
-    double       total_duration = 0.0;
+    // finalize the media playlist/index file
+    double total_duration = 0.0;
     for (unsigned int i=0; i<segment_durations.ItemCount(); i++) {
-        if ((unsigned int)(segment_durations[i]+0.5) > target_duration) {
-            target_duration = (unsigned int)segment_durations[i];
-        }
         total_duration += segment_durations[i];
     }
-
-    playlist->WriteString("#EXTM3U\r\n");
-    if (Options.hls_version > 1) {
-        sprintf(string_buffer, "#EXT-X-VERSION:%d\r\n", Options.hls_version);
-        playlist->WriteString(string_buffer);
-    }
-    playlist->WriteString("#EXT-X-PLAYLIST-TYPE:VOD\r\n");
-    if (video_track) {
-        playlist->WriteString("#EXT-X-INDEPENDENT-SEGMENTS\r\n");
-    }
-    if (Options.allow_cache) {
-        playlist->WriteString("#EXT-X-ALLOW-CACHE:");
-        playlist->WriteString(Options.allow_cache);
-        playlist->WriteString("\r\n");
+    playlist.SetEndList();
+    result = playlist.WriteFile(playlist_filename);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: failed to write playlist (%d)\n", result);
+        return result;
     }
-    playlist->WriteString("#EXT-X-TARGETDURATION:");
-    sprintf(string_buffer, "%d\r\n", target_duration);
-    playlist->WriteString(string_buffer);
-    playlist->WriteString("#EXT-X-MEDIA-SEQUENCE:0\r\n");
-
-    if (Options.encryption_mode != ENCRYPTION_MODE_NONE) {
-        if (Options.encryption_key_lines.ItemCount()) {
-            for (unsigned int i=0; i<Options.encryption_key_lines.ItemCount(); i++) {
-                AP4_String& key_line = Options.encryption_key_lines[i];
-                const char* key_line_cstr = key_line.GetChars();
-                bool omit_iv = false;
-                
-                // omit the IV if the key line starts with a "!" (and skip the "!")
-                if (key_line[0] == '!') {
-                    ++key_line_cstr;
-                    omit_iv = true;
-                }
-                
-                playlist->WriteString("#EXT-X-KEY:METHOD=");
-                if (Options.encryption_mode == ENCRYPTION_MODE_AES_128) {
-                    playlist->WriteString("AES-128");
-                } else if (Options.encryption_mode == ENCRYPTION_MODE_SAMPLE_AES) {
-                    playlist->WriteString("SAMPLE-AES");
-                }
-                playlist->WriteString(",");
-                playlist->WriteString(key_line_cstr);
-                if ((Options.encryption_iv_mode == ENCRYPTION_IV_MODE_RANDOM ||
-                     Options.encryption_iv_mode == ENCRYPTION_IV_MODE_FPS) && !omit_iv) {
-                    playlist->WriteString(",IV=0x");
-                    char iv_hex[33];
-                    iv_hex[32] = 0;
-                    AP4_FormatHex(Options.encryption_iv, 16, iv_hex);
-                    playlist->WriteString(iv_hex);
-                }
-                playlist->WriteString("\r\n");
-            }
-        } else {
-            playlist->WriteString("#EXT-X-KEY:METHOD=");
-            if (Options.encryption_mode == ENCRYPTION_MODE_AES_128) {
-                playlist->WriteString("AES-128");
-            } else if (Options.encryption_mode == ENCRYPTION_MODE_SAMPLE_AES) {
-                playlist->WriteString("SAMPLE-AES");
-            }
-            playlist->WriteString(",URI=\"");
-            playlist->WriteString(Options.encryption_key_uri);
-            playlist->WriteString("\"");
-            if (Options.encryption_iv_mode == ENCRYPTION_IV_MODE_RANDOM) {
-                playlist->WriteString(",IV=0x");
-                char iv_hex[33];
-                iv_hex[32] = 0;
-                AP4_FormatHex(Options.encryption_iv, 16, iv_hex);
-                playlist->WriteString(iv_hex);
-            }
-            if (Options.encryption_key_format) {
-                playlist->WriteString(",KEYFORMAT=\"");
-                playlist->WriteString(Options.encryption_key_format);
-                playlist->WriteString("\"");
-            }
-            if (Options.encryption_key_format_versions) {
-                playlist->WriteString(",KEYFORMATVERSIONS=\"");
-                playlist->WriteString(Options.encryption_key_format_versions);
-                playlist->WriteString("\"");
-            }
-            playlist->WriteString("\r\n");
-        }
-    }
-    
-    for (unsigned int i=0; i<segment_durations.ItemCount(); i++) {
-        if (Options.hls_version >= 3) {
-            sprintf(string_buffer, "#EXTINF:%f,\r\n", segment_durations[i]);
-        } else {
-            sprintf(string_buffer, "#EXTINF:%u,\r\n", (unsigned int)(segment_durations[i]+0.5));
-        }
-        playlist->WriteString(string_buffer);
-        if (Options.output_single_file) {
-            sprintf(string_buffer, "#EXT-X-BYTERANGE:%d@%lld\r\n", segment_sizes[i], segment_positions[i]);
-            playlist->WriteString(string_buffer);
-        }
-        sprintf(string_buffer, Options.segment_url_template, i);
-        playlist->WriteString(string_buffer);
-        playlist->WriteString("\r\n");
-    }
-                    
-    playlist->WriteString("#EXT-X-ENDLIST\r\n");
-    playlist->Release();
 
     // create the iframe playlist/index file
     if (video_track && Options.hls_version >= 4) {
-        // compute the iframe durations and target duration
+        // compute the iframe durations
         for (unsigned int i=0; i<iframe_positions.ItemCount(); i++) {
             double iframe_duration = 0.0;
             if (i+1 < iframe_positions.ItemCount()) {
@@ -1464,71 +1508,21 @@ WriteSamples(AP4_Mpeg2TsWriter*               ts_writer,
             }
             iframe_durations[i] = iframe_duration;
         }
-        unsigned int iframes_target_duration = 0;
-        for (unsigned int i=0; i<iframe_durations.ItemCount(); i++) {
-            if ((unsigned int)(iframe_durations[i]+0.5) > iframes_target_duration) {
-                iframes_target_duration = (unsigned int)iframe_durations[i];
-            }
-        }
-        
-        playlist = OpenOutput(Options.iframe_index_filename, 0);
-        if (playlist == NULL) return AP4_ERROR_CANNOT_OPEN_FILE;
-
-        playlist->WriteString("#EXTM3U\r\n");
-        if (Options.hls_version > 1) {
-            sprintf(string_buffer, "#EXT-X-VERSION:%d\r\n", Options.hls_version);
-            playlist->WriteString(string_buffer);
-        }
-        playlist->WriteString("#EXT-X-PLAYLIST-TYPE:VOD\r\n");
-        playlist->WriteString("#EXT-X-I-FRAMES-ONLY\r\n");
-        playlist->WriteString("#EXT-X-INDEPENDENT-SEGMENTS\r\n");
-        playlist->WriteString("#EXT-X-TARGETDURATION:");
-        sprintf(string_buffer, "%d\r\n", iframes_target_duration);
-        playlist->WriteString(string_buffer);
-        playlist->WriteString("#EXT-X-MEDIA-SEQUENCE:0\r\n");
-
-        if (Options.encryption_mode != ENCRYPTION_MODE_NONE) {
-            playlist->WriteString("#EXT-X-KEY:METHOD=");
-            if (Options.encryption_mode == ENCRYPTION_MODE_AES_128) {
-                playlist->WriteString("AES-128");
-            } else if (Options.encryption_mode == ENCRYPTION_MODE_SAMPLE_AES) {
-                playlist->WriteString("SAMPLE-AES");
-            }
-            playlist->WriteString(",URI=\"");
-            playlist->WriteString(Options.encryption_key_uri);
-            playlist->WriteString("\"");
-            if (Options.encryption_iv_mode == ENCRYPTION_IV_MODE_RANDOM) {
-                playlist->WriteString(",IV=0x");
-                char iv_hex[33];
-                iv_hex[32] = 0;
-                AP4_FormatHex(Options.encryption_iv, 16, iv_hex);
-                playlist->WriteString(iv_hex);
-            }
-            if (Options.encryption_key_format) {
-                playlist->WriteString(",KEYFORMAT=\"");
-                playlist->WriteString(Options.encryption_key_format);
-                playlist->WriteString("\"");
-            }
-            if (Options.encryption_key_format_versions) {
-                playlist->WriteString(",KEYFORMATVERSIONS=\"");
-                playlist->WriteString(Options.encryption_key_format_versions);
-                playlist->WriteString("\"");
-            }
-            playlist->WriteString("\r\n");
-        }
-        
+        AP4_HlsPlaylistWriter iframe_playlist(AP4_HlsPlaylistWriter::PLAYLIST_TYPE_VOD, Options.hls_version);
+        iframe_playlist.SetIFramesOnly(true);
+        iframe_playlist.SetIndependentSegments(true);
+        AddKeyTags(iframe_playlist, false);
         for (unsigned int i=0; i<iframe_positions.ItemCount(); i++) {
-            sprintf(string_buffer, "#EXTINF:%f,\r\n", iframe_durations[i]);
-            playlist->WriteString(string_buffer);
-            sprintf(string_buffer, "#EXT-X-BYTERANGE:%d@%lld\r\n", iframe_sizes[i], iframe_positions[i]);
-            playlist->WriteString(string_buffer);
             sprintf(string_buffer, Options.segment_url_template, iframe_segment_indexes[i]);
-            playlist->WriteString(string_buffer);
-            playlist->WriteString("\r\n");
+            iframe_playlist.AddSegment(string_buffer, iframe_durations[i], iframe_sizes[i], iframe_positions[i]);
+        }
+        iframe_playlist.SetEndList();
+        sprintf(playlist_filename, Options.iframe_index_filename, 0);
+        result = iframe_playlist.WriteFile(playlist_filename);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: failed to write playlist (%d)\n", result);
+            return result;
         }
-                        
-        playlist->WriteString("#EXT-X-ENDLIST\r\n");
-        playlist->Release();
     }
     
     // update stats
@@ -1589,6 +1583,8 @@ main(int argc, char** argv)
     Options.segment_duration               = 6;
     Options.segment_duration_threshold     = DefaultSegmentDurationThreshold;
     Options.allow_cache                    = NULL;
+    Options.playlist_type                  = AP4_HlsPlaylistWriter::PLAYLIST_TYPE_VOD;
+    Options.playlist_window                = 0;
     Options.encryption_key_hex             = NULL;
     Options.encryption_mode                = ENCRYPTION_MODE_NONE;
     Options.encryption_iv_mode             = ENCRYPTION_IV_MODE_NONE;
@@ -1646,6 +1642,28 @@ main(int argc, char** argv)
                 return 1;
             }
             Options.allow_cache = *args++;
+        } else if (!strcmp(arg, "--playlist-type")) {
+            if (*args == NULL) {
+                fprintf(stderr, "ERROR: --playlist-type requires an argument\n");
+                return 1;
+            }
+            const char* type = *args++;
+            if (!strcmp(type, "vod")) {
+                Options.playlist_type = AP4_HlsPlaylistWriter::PLAYLIST_TYPE_VOD;
+            } else if (!strcmp(type, "event")) {
+                Options.playlist_type = AP4_HlsPlaylistWriter::PLAYLIST_TYPE_EVENT;
+            } else if (!strcmp(type, "live")) {
+                Options.playlist_type = AP4_HlsPlaylistWriter::PLAYLIST_TYPE_LIVE;
+            } else {
+                fprintf(stderr, "ERROR: unknown playlist type\n");
+                return 1;
+            }
+        } else if (!strcmp(arg, "--playlist-window")) {
+            if (*args == NULL) {
+                fprintf(stderr, "ERROR: --playlist-window requires a number\n");
+                return 1;
+            }
+            Options.playlist_window = (unsigned int)strtoul(*args++, NULL, 10);
         } else if (!strcmp(arg, "--pmt-pid")) {
             if (*args == NULL) {
                 fprintf(stderr, "ERROR: --pmt-pid requires a number\n");
@@ -1948,6 +1966,21 @@ main(int argc, char** argv)
         Options.segment_duration_threshold = 0;
     }
     
+    // event and live playlists need the longest segment duration upfront
+    unsigned int target_duration = Options.segment_duration;
+    if (Options.playlist_type != AP4_HlsPlaylistWriter::PLAYLIST_TYPE_VOD && Options.segment_duration) {
+        AP4_Track* segmenting_track = video_track ? video_track : audio_track;
+        bool       sync_samples_only = video_track != NULL ||
+                                       audio_track->GetSampleDescription(0)->GetFormat() == AP4_SAMPLE_FORMAT_AC_4;
+        double     max_segment_duration = 0.0;
+        result = ComputeMaxSegmentDuration(*movie, *input, *segmenting_track, sync_samples_only, max_segment_duration);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: failed to scan the input samples (%d)\n", result);
+            return 1;
+        }
+        target_duration = (unsigned int)(max_segment_duration+0.5);
+    }
+    
     // create the appropriate readers
     AP4_LinearReader* linear_reader = NULL;
     SampleReader*     audio_reader  = NULL;
@@ -2189,6 +2222,7 @@ main(int argc, char** argv)
                           audio_track, audio_reader, audio_stream,
                           video_track, video_reader, video_stream,
                           Options.segment_duration_threshold,
+                          target_duration,
                           nalu_length_size);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: failed to write samples (%d)\n", result);
@@ -37,94 +37,124 @@
 /*----------------------------------------------------------------------
 |   constants
 +---------------------------------------------------------------------*/
-#define BANNER "MP4 Compacter - Version 1.0\n"\
+#define BANNER "MP4 Compacter - Version 1.1\n"\
                "(Bento4 Version " AP4_VERSION_STRING ")\n"\
                "(c) 2002-2011 Axiomatic Systems, LLC"
 
+
 /*----------------------------------------------------------------------
 |   PrintUsageAndExit
 +---------------------------------------------------------------------*/
 static void
 PrintUsageAndExit()
 {
-    fprintf(stderr, 
-        BANNER 
+    fprintf(stderr,
+        BANNER
         "\n\n"
         "usage: mp4compact [options] <input> <output>\n"
+        "   or: mp4compact --moov-only [options] <input> [<output>]\n"
         "Options:\n"
         "  --verbose\n"
+        "  --moov-only: only rewrite the moov atom, leaving the media data untouched\n"
+        "    (<input> is modified in place when <output> is not specified)\n"
+        "  --padding <n>: with --moov-only, reserve <n> bytes of free space after\n"
+        "    the moov atom if it is, or has to be moved, at the end of the file\n"
+        "    (without padding, a file that ends with the moov atom is cut after it)\n"
         );
     exit(1);
 }
 
 /*----------------------------------------------------------------------
-|   AP4_CompactingProcessor
+|   AP4_SampleTableCompacter
 +---------------------------------------------------------------------*/
-class AP4_CompactingProcessor : public AP4_Processor
+/**
+ * Replace the sample table atoms of a track with smaller equivalents:
+ * stsz with stz2, stts and ctts with tables where consecutive entries with
+ * the same value are merged, and, when the chunk offsets will not change,
+ * co64 with stco if all the offsets fit in 32 bits.
+ * The replaced atoms are kept until the compacter is destroyed, because
+ * sample tables created before the compaction may still refer to them.
+ */
+class AP4_SampleTableCompacter
 {
 public:
-    //  inner classes
-    class TrackHandler : public AP4_Processor::TrackHandler 
-    {
-    public:
-        TrackHandler(AP4_CompactingProcessor& outer, AP4_TrakAtom* trak_atom) :
-            m_Outer(outer),
-            m_TrakAtom(trak_atom),
-            m_StszAtom(NULL) {}
-        ~TrackHandler();
-        virtual AP4_Result ProcessTrack();
-        virtual AP4_Result ProcessSample(AP4_DataBuffer& data_in,
-                                         AP4_DataBuffer& data_out) {
-            return data_out.SetData(data_in.GetData(), data_in.GetDataSize());
-        }
-    private:
-        AP4_CompactingProcessor& m_Outer;
-        AP4_TrakAtom*            m_TrakAtom;
-        AP4_StszAtom*            m_StszAtom;
-    };
-    
+    AP4_SampleTableCompacter(bool verbose, bool demote_chunk_offsets) :
+        m_Verbose(verbose),
+        m_DemoteChunkOffsets(demote_chunk_offsets),
+        m_StszReduction(0),
+        m_SttsReduction(0),
+        m_CttsReduction(0),
+        m_ChunkOffsetsReduction(0) {}
+    ~AP4_SampleTableCompacter();
+    AP4_Result CompactTrack(AP4_TrakAtom* trak);
+
+private:
     // methods
-    AP4_CompactingProcessor(bool verbose) : m_Verbose(verbose), m_SizeReduction(0) {}
-    ~AP4_CompactingProcessor();
-    virtual TrackHandler* CreateTrackHandler(AP4_TrakAtom* trak_atom) { 
-        return new TrackHandler(*this, trak_atom); 
-    }
-    
+    AP4_Result ReplaceAtom(AP4_ContainerAtom* stbl, AP4_Atom* atom, AP4_Atom* replacement);
+    AP4_Result CompactStsz(AP4_ContainerAtom* stbl, AP4_UI32& reduction);
+    AP4_Result CompactStts(AP4_ContainerAtom* stbl, AP4_UI32& reduction);
+    AP4_Result CompactCtts(AP4_ContainerAtom* stbl, AP4_UI32& reduction);
+    AP4_Result CompactCo64(AP4_ContainerAtom* stbl, AP4_UI32& reduction);
+
     // members
-    bool     m_Verbose;
-    AP4_UI32 m_SizeReduction;
+    bool               m_Verbose;
+    bool               m_DemoteChunkOffsets;
+    AP4_UI32           m_StszReduction;
+    AP4_UI32           m_SttsReduction;
+    AP4_UI32           m_CttsReduction;
+    AP4_UI32           m_ChunkOffsetsReduction;
+    AP4_List<AP4_Atom> m_ReplacedAtoms;
 };
 
 /*----------------------------------------------------------------------
-|   AP4_CompactingProcessor::~AP4_CompactingProcessor
+|   AP4_SampleTableCompacter::~AP4_SampleTableCompacter
 +---------------------------------------------------------------------*/
-AP4_CompactingProcessor::~AP4_CompactingProcessor()
+AP4_SampleTableCompacter::~AP4_SampleTableCompacter()
 {
     if (m_Verbose) {
-        printf("Total stz2 reduction = %d bytes\n", m_SizeReduction);
+        printf("Total reduction = %d bytes (stz2: %d, stts: %d, ctts: %d, stco: %d)\n",
+               m_StszReduction+m_SttsReduction+m_CttsReduction+m_ChunkOffsetsReduction,
+               m_StszReduction,
+               m_SttsReduction,
+               m_CttsReduction,
+               m_ChunkOffsetsReduction);
     }
+    m_ReplacedAtoms.DeleteReferences();
 }
 
 /*----------------------------------------------------------------------
-|   AP4_CompactingProcessor::TrackHandler::~TrackHandler()
+|   AP4_SampleTableCompacter::ReplaceAtom
 +---------------------------------------------------------------------*/
-AP4_CompactingProcessor::TrackHandler::~TrackHandler()
+AP4_Result
+AP4_SampleTableCompacter::ReplaceAtom(AP4_ContainerAtom* stbl,
+                                      AP4_Atom*          atom,
+                                      AP4_Atom*          replacement)
 {
-    delete m_StszAtom;
+    // keep the position of the original atom
+    int position = 0;
+    for (AP4_List<AP4_Atom>::Item* item = stbl->GetChildren().FirstItem();
+         item && item->GetData() != atom;
+         item = item->GetNext()) {
+        ++position;
+    }
+
+    // detach the original atom so we can destroy it later
+    atom->Detach();
+    m_ReplacedAtoms.Add(atom);
+
+    return stbl->AddChild(replacement, position);
 }
 
 /*----------------------------------------------------------------------
-|   AP4_CompactingProcessor::TrackHandler::ProcessTrack
+|   AP4_SampleTableCompacter::CompactStsz
 +---------------------------------------------------------------------*/
 AP4_Result
-AP4_CompactingProcessor::TrackHandler::ProcessTrack()
+AP4_SampleTableCompacter::CompactStsz(AP4_ContainerAtom* stbl, AP4_UI32& reduction)
 {
-    // find the stsz atom
-    AP4_ContainerAtom* stbl = AP4_DYNAMIC_CAST(AP4_ContainerAtom, m_TrakAtom->FindChild("mdia/minf/stbl"));
-    if (stbl == NULL) return AP4_SUCCESS;
+    reduction = 0;
     AP4_StszAtom* stsz = AP4_DYNAMIC_CAST(AP4_StszAtom, stbl->GetChild(AP4_ATOM_TYPE_STSZ));
     if (stsz == NULL) return AP4_SUCCESS;
-    
+
     // check if we can reduce the size of stsz by changing it to stz2
     AP4_UI32 max_size = 0;
     for (unsigned int i=1; i<=stsz->GetSampleCount(); i++) {
@@ -135,41 +165,256 @@ AP4_CompactingProcessor::TrackHandler::ProcessTrack()
         }
     }
     AP4_UI08 field_size = 0;
-    if (max_size <= 0xFF) {
-        field_size = 1;
+    if (max_size <= 0xF) {
+        field_size = 4;
+    } else if (max_size <= 0xFF) {
+        field_size = 8;
     } else if (max_size <= 0xFFFF) {
-        field_size = 2;
-    }
-    if (m_Outer.m_Verbose) printf("Track %d: ", m_TrakAtom->GetId());
-    if (field_size == 0) {
-        if (m_Outer.m_Verbose) {
-            printf("no stz2 reduction possible\n");
-        }
-        return AP4_SUCCESS;
+        field_size = 16;
     } else {
-        if (m_Outer.m_Verbose) {
-            unsigned int reduction = (4-field_size)*stsz->GetSampleCount();
-            printf("stz2 reduction = %d bytes\n", reduction);
-            m_Outer.m_SizeReduction += reduction;
-        }
+        return AP4_SUCCESS;
     }
-    
-    // detach the original stsz atom so we can destroy it later
-    m_StszAtom = stsz;
-    stsz->Detach();
-    
+
     // create an stz2 atom and populate its entries
     AP4_Stz2Atom* stz2 = new AP4_Stz2Atom(field_size);
-    for (unsigned int i=1; i<=m_StszAtom->GetSampleCount(); i++) {
+    for (unsigned int i=1; i<=stsz->GetSampleCount(); i++) {
         AP4_Size sample_size;
-        m_StszAtom->GetSampleSize(i, sample_size);
+        stsz->GetSampleSize(i, sample_size);
         stz2->AddEntry(sample_size);
     }
-    stbl->AddChild(stz2);
-    
+
+    // tables with a single sample size are already smaller than stz2 tables
+    if (stz2->GetSize() >= stsz->GetSize()) {
+        delete stz2;
+        return AP4_SUCCESS;
+    }
+    reduction = (AP4_UI32)(stsz->GetSize()-stz2->GetSize());
+
+    return ReplaceAtom(stbl, stsz, stz2);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleTableCompacter::CompactStts
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleTableCompacter::CompactStts(AP4_ContainerAtom* stbl, AP4_UI32& reduction)
+{
+    reduction = 0;
+    AP4_SttsAtom* stts = AP4_DYNAMIC_CAST(AP4_SttsAtom, stbl->GetChild(AP4_ATOM_TYPE_STTS));
+    if (stts == NULL) return AP4_SUCCESS;
+
+    // merge the consecutive entries that have the same duration
+    const AP4_Array<AP4_SttsTableEntry>& entries = stts->GetEntries();
+    AP4_SttsAtom* merged = new AP4_SttsAtom();
+    AP4_UI32 run_count    = 0;
+    AP4_UI32 run_duration = 0;
+    for (unsigned int i=0; i<entries.ItemCount(); i++) {
+        if (entries[i].m_SampleCount == 0) continue;
+        if (run_count && entries[i].m_SampleDuration == run_duration &&
+            (AP4_UI64)run_count+entries[i].m_SampleCount <= 0xFFFFFFFF) {
+            run_count += entries[i].m_SampleCount;
+            continue;
+        }
+        if (run_count) merged->AddEntry(run_count, run_duration);
+        run_count    = entries[i].m_SampleCount;
+        run_duration = entries[i].m_SampleDuration;
+    }
+    if (run_count) merged->AddEntry(run_count, run_duration);
+
+    if (merged->GetSize() >= stts->GetSize()) {
+        delete merged;
+        return AP4_SUCCESS;
+    }
+    reduction = (AP4_UI32)(stts->GetSize()-merged->GetSize());
+
+    return ReplaceAtom(stbl, stts, merged);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleTableCompacter::CompactCtts
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleTableCompacter::CompactCtts(AP4_ContainerAtom* stbl, AP4_UI32& reduction)
+{
+    reduction = 0;
+    AP4_CttsAtom* ctts = AP4_DYNAMIC_CAST(AP4_CttsAtom, stbl->GetChild(AP4_ATOM_TYPE_CTTS));
+    if (ctts == NULL) return AP4_SUCCESS;
+
+    // merge the consecutive entries that have the same offset (the version
+    // is kept, because it says whether the offsets are signed)
+    const AP4_Array<AP4_CttsTableEntry>& entries = ctts->GetEntries();
+    AP4_CttsAtom* merged = new AP4_CttsAtom();
+    merged->SetVersion(ctts->GetVersion());
+    AP4_UI32 run_count  = 0;
+    AP4_UI32 run_offset = 0;
+    for (unsigned int i=0; i<entries.ItemCount(); i++) {
+        if (entries[i].m_SampleCount == 0) continue;
+        if (run_count && entries[i].m_SampleOffset == run_offset &&
+            (AP4_UI64)run_count+entries[i].m_SampleCount <= 0xFFFFFFFF) {
+            run_count += entries[i].m_SampleCount;
+            continue;
+        }
+        if (run_count) merged->AddEntry(run_count, run_offset);
+        run_count  = entries[i].m_SampleCount;
+        run_offset = entries[i].m_SampleOffset;
+    }
+    if (run_count) merged->AddEntry(run_count, run_offset);
+
+    if (merged->GetSize() >= ctts->GetSize()) {
+        delete merged;
+        return AP4_SUCCESS;
+    }
+    reduction = (AP4_UI32)(ctts->GetSize()-merged->GetSize());
+
+    return ReplaceAtom(stbl, ctts, merged);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleTableCompacter::CompactCo64
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleTableCompacter::CompactCo64(AP4_ContainerAtom* stbl, AP4_UI32& reduction)
+{
+    reduction = 0;
+    AP4_Co64Atom* co64 = AP4_DYNAMIC_CAST(AP4_Co64Atom, stbl->GetChild(AP4_ATOM_TYPE_CO64));
+    if (co64 == NULL) return AP4_SUCCESS;
+
+    // check that all the offsets fit in 32 bits
+    AP4_Cardinal    chunk_count   = co64->GetChunkCount();
+    const AP4_UI64* chunk_offsets = co64->GetChunkOffsets();
+    for (unsigned int i=0; i<chunk_count; i++) {
+        if (chunk_offsets[i] > 0xFFFFFFFF) return AP4_SUCCESS;
+    }
+
+    // replace the co64 atom with an stco atom with the same offsets
+    AP4_UI32* small_offsets = new AP4_UI32[chunk_count];
+    for (unsigned int i=0; i<chunk_count; i++) {
+        small_offsets[i] = (AP4_UI32)chunk_offsets[i];
+    }
+    AP4_StcoAtom* stco = new AP4_StcoAtom(small_offsets, chunk_count);
+    delete[] small_offsets;
+    reduction = (AP4_UI32)(co64->GetSize()-stco->GetSize());
+
+    return ReplaceAtom(stbl, co64, stco);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleTableCompacter::CompactTrack
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleTableCompacter::CompactTrack(AP4_TrakAtom* trak)
+{
+    AP4_ContainerAtom* stbl = AP4_DYNAMIC_CAST(AP4_ContainerAtom, trak->FindChild("mdia/minf/stbl"));
+    if (stbl == NULL) return AP4_SUCCESS;
+
+    AP4_UI32 stsz_reduction          = 0;
+    AP4_UI32 stts_reduction          = 0;
+    AP4_UI32 ctts_reduction          = 0;
+    AP4_UI32 chunk_offsets_reduction = 0;
+    AP4_CHECK(CompactStsz(stbl, stsz_reduction));
+    AP4_CHECK(CompactStts(stbl, stts_reduction));
+    AP4_CHECK(CompactCtts(stbl, ctts_reduction));
+    if (m_DemoteChunkOffsets) {
+        AP4_CHECK(CompactCo64(stbl, chunk_offsets_reduction));
+    }
+    m_StszReduction         += stsz_reduction;
+    m_SttsReduction         += stts_reduction;
+    m_CttsReduction         += ctts_reduction;
+    m_ChunkOffsetsReduction += chunk_offsets_reduction;
+
+    if (m_Verbose) {
+        printf("Track %d: ", trak->GetId());
+        if (stsz_reduction+stts_reduction+ctts_reduction+chunk_offsets_reduction == 0) {
+            printf("no reduction possible\n");
+        } else {
+            printf("stz2 reduction = %d bytes, stts reduction = %d bytes, "
+                   "ctts reduction = %d bytes, stco reduction = %d bytes\n",
+                   stsz_reduction,
+                   stts_reduction,
+                   ctts_reduction,
+                   chunk_offsets_reduction);
+        }
+    }
+
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CompactingProcessor
++---------------------------------------------------------------------*/
+class AP4_CompactingProcessor : public AP4_Processor
+{
+public:
+    //  inner classes
+    class TrackHandler : public AP4_Processor::TrackHandler
+    {
+    public:
+        TrackHandler(AP4_CompactingProcessor& outer, AP4_TrakAtom* trak_atom) :
+            m_Outer(outer),
+            m_TrakAtom(trak_atom) {}
+        virtual AP4_Result ProcessTrack() {
+            return m_Outer.m_Compacter.CompactTrack(m_TrakAtom);
+        }
+        virtual AP4_Result ProcessSample(AP4_DataBuffer& data_in,
+                                         AP4_DataBuffer& data_out) {
+            return data_out.SetData(data_in.GetData(), data_in.GetDataSize());
+        }
+    private:
+        AP4_CompactingProcessor& m_Outer;
+        AP4_TrakAtom*            m_TrakAtom;
+    };
+
+    // methods
+    // (the chunk offsets are set after the tracks are processed, so
+    // they cannot be demoted to 32 bits here)
+    AP4_CompactingProcessor(bool verbose) : m_Compacter(verbose, false) {}
+    virtual TrackHandler* CreateTrackHandler(AP4_TrakAtom* trak_atom) {
+        return new TrackHandler(*this, trak_atom);
+    }
+
+    // members
+    AP4_SampleTableCompacter m_Compacter;
+};
+
+/*----------------------------------------------------------------------
+|   CompactMoov
++---------------------------------------------------------------------*/
+static AP4_Result
+CompactMoov(AP4_ByteStream& stream, AP4_Size padding, bool verbose)
+{
+    // only the moov atom is parsed
+    AP4_File* file = new AP4_File(stream, true);
+    AP4_Movie* movie = file->GetMovie();
+    if (movie == NULL) {
+        delete file;
+        return AP4_ERROR_INVALID_FORMAT;
+    }
+    AP4_MoovAtom* moov = movie->GetMoovAtom();
+
+    // the media data does not move, so the chunk offsets stay the same
+    AP4_Result result = AP4_SUCCESS;
+    AP4_MoovUpdater::Method method = AP4_MoovUpdater::METHOD_IN_PLACE;
+    {
+        AP4_SampleTableCompacter compacter(verbose, true);
+        for (AP4_List<AP4_TrakAtom>::Item* item = moov->GetTrakAtoms().FirstItem();
+             item && AP4_SUCCEEDED(result);
+             item = item->GetNext()) {
+            result = compacter.CompactTrack(item->GetData());
+        }
+        if (AP4_SUCCEEDED(result)) {
+            result = AP4_MoovUpdater::Update(stream, *moov, padding, &method);
+        }
+    }
+    if (AP4_SUCCEEDED(result) && verbose) {
+        printf("moov atom %s\n", method == AP4_MoovUpdater::METHOD_IN_PLACE ?
+                                 "updated in place" :
+                                 "moved to the end of the file");
+    }
+
+    delete file;
+    return result;
+}
+
 /*----------------------------------------------------------------------
 |   main
 +---------------------------------------------------------------------*/
@@ -179,16 +424,27 @@ main(int argc, char** argv)
     if (argc == 1) PrintUsageAndExit();
 
     // parse options
-    const char* input_filename  = NULL;
-    const char* output_filename = NULL;
-    bool        verbose         = false;
-    AP4_Result  result;
+    const char*  input_filename  = NULL;
+    const char*  output_filename = NULL;
+    bool         verbose         = false;
+    bool         moov_only       = false;
+    unsigned int padding         = 0;
+    AP4_Result   result;
 
     // parse the command line arguments
     char* arg;
     while ((arg = *++argv)) {
         if (!AP4_CompareStrings(arg, "--verbose")) {
             verbose = true;
+        } else if (!AP4_CompareStrings(arg, "--moov-only")) {
+            moov_only = true;
+        } else if (!AP4_CompareStrings(arg, "--padding")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --padding option\n");
+                return 1;
+            }
+            padding = (unsigned int)strtoul(arg, NULL, 10);
         } else if (input_filename == NULL) {
             input_filename = arg;
         } else if (output_filename == NULL) {
@@ -198,10 +454,17 @@ main(int argc, char** argv)
             return 1;
         }
     }
+    if (input_filename == NULL || (output_filename == NULL && !moov_only)) {
+        PrintUsageAndExit();
+    }
 
     // create the input stream
     AP4_ByteStream* input = NULL;
-    result = AP4_FileByteStream::Create(input_filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+    result = AP4_FileByteStream::Create(input_filename,
+                                        moov_only && output_filename == NULL ?
+                                        AP4_FileByteStream::STREAM_MODE_READ_WRITE :
+                                        AP4_FileByteStream::STREAM_MODE_READ,
+                                        input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file (%s)\n", input_filename);
         return 1;
@@ -209,23 +472,44 @@ main(int argc, char** argv)
 
     // create the output stream
     AP4_ByteStream* output = NULL;
-    result = AP4_FileByteStream::Create(output_filename, AP4_FileByteStream::STREAM_MODE_WRITE, output);
-    if (AP4_FAILED(result)) {
-        fprintf(stderr, "ERROR: cannot open output file (%s)\n", output_filename);
-        return 1;
+    if (output_filename) {
+        result = AP4_FileByteStream::Create(output_filename, AP4_FileByteStream::STREAM_MODE_WRITE, output);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot open output file (%s)\n", output_filename);
+            input->Release();
+            return 1;
+        }
     }
 
-    // process the file
-    AP4_CompactingProcessor* processor = new AP4_CompactingProcessor(verbose);
-    result = processor->Process(*input, *output, NULL);
-    if (AP4_FAILED(result)) {
-        fprintf(stderr, "ERROR: failed to process the file (%d)\n", result);
+    if (moov_only) {
+        // copy the file as is, then update its moov atom in place
+        AP4_ByteStream* stream = input;
+        if (output) {
+            AP4_LargeSize input_size = 0;
+            result = input->GetSize(input_size);
+            if (AP4_SUCCEEDED(result)) result = input->CopyTo(*output, input_size);
+            if (AP4_SUCCEEDED(result)) result = output->Seek(0);
+            stream = output;
+        }
+        if (AP4_SUCCEEDED(result)) {
+            result = CompactMoov(*stream, padding, verbose);
+        }
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: failed to compact the moov atom (%d:%s)\n", result, AP4_ResultText(result));
+        }
+    } else {
+        // process the file
+        AP4_CompactingProcessor* processor = new AP4_CompactingProcessor(verbose);
+        result = processor->Process(*input, *output, NULL);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: failed to process the file (%d)\n", result);
+        }
+        delete processor;
     }
 
     // cleanup
-    delete processor;
     input->Release();
-    output->Release();
+    if (output) output->Release();
 
-    return 0;
+    return AP4_FAILED(result) ? 1 : 0;
 }
@@ -44,6 +44,10 @@
                "(Bento4 Version " AP4_VERSION_STRING ")\n"\
                "(c) 2002-2017 Axiomatic Systems, LLC"
  
+const unsigned int MP4DIFF_MAX_REPORTED_DIFFERENCES = 20;
+const AP4_Size     MP4DIFF_HASH_JOB_SIZE            = 8*1024*1024; // bytes of sample data per job
+const AP4_Size     MP4DIFF_READ_SIZE                = 1024*1024;   // max bytes read at once
+
 /*----------------------------------------------------------------------
 |   globals
 +---------------------------------------------------------------------*/
@@ -57,6 +61,15 @@ PrintUsageAndExit()
     fprintf(stderr, 
             BANNER 
             "\n\nusage: mp4diff [options] <input1> <input2>\n"
+            "options:\n"
+            "  --parallel: compare the timing and the data of all the samples, fragmented\n"
+            "      or not, hashing the sample data on several threads and only comparing\n"
+            "      the bytes of the samples with different hashes\n"
+            "  --threads <n>: number of threads used with --parallel (default: number of\n"
+            "      processors)\n"
+            "  --timing-only: only compare the sample counts, timestamps, durations and\n"
+            "      sync flags, without reading the sample data\n"
+            "With --parallel or --timing-only, the exit status is 1 if differences are found.\n"
             );
     exit(1);
 }
@@ -143,6 +156,382 @@ DiffFragments(AP4_Movie& movie1, AP4_ByteStream* stream1, AP4_Movie& movie2, AP4
     }
 }
 
+/*----------------------------------------------------------------------
+|   SampleInfo
++---------------------------------------------------------------------*/
+struct SampleInfo {
+    AP4_Position m_Offset;
+    AP4_Size     m_Size;
+    AP4_UI64     m_Dts;
+    AP4_UI64     m_Cts;
+    AP4_UI32     m_Duration;
+    bool         m_IsSync;
+};
+
+/*----------------------------------------------------------------------
+|   TrackSamples
++---------------------------------------------------------------------*/
+struct TrackSamples {
+    TrackSamples(AP4_UI32 track_id) : m_TrackId(track_id) {}
+
+    AP4_UI32              m_TrackId;
+    AP4_Array<SampleInfo> m_Samples;
+    AP4_Array<AP4_UI64>   m_Hashes;
+};
+
+/*----------------------------------------------------------------------
+|   DeleteTrackSamples
++---------------------------------------------------------------------*/
+static void
+DeleteTrackSamples(AP4_Array<TrackSamples*>& tracks)
+{
+    for (unsigned int i=0; i<tracks.ItemCount(); i++) {
+        delete tracks[i];
+    }
+    tracks.Clear();
+}
+
+/*----------------------------------------------------------------------
+|   GetTrackSamples
+|
+|   Collect the sample tables of all the tracks, without reading the
+|   sample data, for fragmented and non-fragmented files alike
++---------------------------------------------------------------------*/
+static AP4_Result
+GetTrackSamples(AP4_Movie& movie, AP4_ByteStream* stream, AP4_Array<TrackSamples*>& tracks)
+{
+    stream->Seek(0);
+    AP4_LinearReader reader(movie, stream);
+    for (AP4_List<AP4_Track>::Item* item = movie.GetTracks().FirstItem();
+                                    item;
+                                    item = item->GetNext()) {
+        AP4_UI32 track_id = item->GetData()->GetId();
+        reader.EnableTrack(track_id);
+        tracks.Append(new TrackSamples(track_id));
+    }
+
+    AP4_Sample sample;
+    AP4_UI32   track_id = 0;
+    while (AP4_SUCCEEDED(reader.GetNextSample(sample, track_id))) {
+        TrackSamples* track = NULL;
+        for (unsigned int i=0; i<tracks.ItemCount(); i++) {
+            if (tracks[i]->m_TrackId == track_id) {
+                track = tracks[i];
+                break;
+            }
+        }
+        if (track == NULL) continue;
+
+        SampleInfo info;
+        info.m_Offset   = sample.GetOffset();
+        info.m_Size     = sample.GetSize();
+        info.m_Dts      = sample.GetDts();
+        info.m_Cts      = sample.GetCts();
+        info.m_Duration = sample.GetDuration();
+        info.m_IsSync   = sample.IsSync();
+        track->m_Samples.Append(info);
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   DiffTimings
++---------------------------------------------------------------------*/
+static unsigned int
+DiffTimings(TrackSamples& track1, TrackSamples& track2)
+{
+    unsigned int difference_count = 0;
+    if (track1.m_Samples.ItemCount() != track2.m_Samples.ItemCount()) {
+        printf("!!! sample counts not equal: %d, %d\n",
+               track1.m_Samples.ItemCount(),
+               track2.m_Samples.ItemCount());
+        ++difference_count;
+    }
+
+    unsigned int sample_count = track1.m_Samples.ItemCount() < track2.m_Samples.ItemCount() ?
+                                track1.m_Samples.ItemCount() : track2.m_Samples.ItemCount();
+    for (unsigned int i=0; i<sample_count; i++) {
+        const SampleInfo& sample1 = track1.m_Samples[i];
+        const SampleInfo& sample2 = track2.m_Samples[i];
+        if (sample1.m_Dts      == sample2.m_Dts      &&
+            sample1.m_Cts      == sample2.m_Cts      &&
+            sample1.m_Duration == sample2.m_Duration &&
+            sample1.m_IsSync   == sample2.m_IsSync) {
+            continue;
+        }
+        if (++difference_count <= MP4DIFF_MAX_REPORTED_DIFFERENCES) {
+            printf("!!! sample %d: dts=%lld/%lld, cts=%lld/%lld, duration=%d/%d, sync=%d/%d\n",
+                   i,
+                   sample1.m_Dts, sample2.m_Dts,
+                   sample1.m_Cts, sample2.m_Cts,
+                   sample1.m_Duration, sample2.m_Duration,
+                   sample1.m_IsSync ? 1 : 0, sample2.m_IsSync ? 1 : 0);
+        }
+    }
+    if (difference_count > MP4DIFF_MAX_REPORTED_DIFFERENCES) {
+        printf("!!! (%d more timing differences)\n", difference_count-MP4DIFF_MAX_REPORTED_DIFFERENCES);
+    }
+
+    return difference_count;
+}
+
+/*----------------------------------------------------------------------
+|   HashJob
++---------------------------------------------------------------------*/
+struct HashJob {
+    unsigned int  m_FileIndex;
+    TrackSamples* m_Track;
+    AP4_Ordinal   m_FirstSample;
+    AP4_Cardinal  m_SampleCount;
+};
+
+/*----------------------------------------------------------------------
+|   HashQueue
++---------------------------------------------------------------------*/
+class HashQueue : public AP4_Runnable
+{
+public:
+    HashQueue(AP4_Array<HashJob>& jobs, const char* filename1, const char* filename2) :
+        m_Jobs(jobs), m_Next(0), m_Result(AP4_SUCCESS) {
+        m_Filenames[0] = filename1;
+        m_Filenames[1] = filename2;
+    }
+    AP4_Result GetResult() { return m_Result; }
+
+    // AP4_Runnable methods, called by each thread to hash samples until there are no jobs left
+    void Run();
+
+private:
+    // methods
+    AP4_Result RunJob(HashJob& job, AP4_ByteStream& stream, AP4_DataBuffer& buffer);
+
+    // members
+    AP4_Array<HashJob>& m_Jobs;
+    const char*         m_Filenames[2];
+    AP4_Ordinal         m_Next;
+    AP4_Result          m_Result;
+    AP4_Mutex           m_Lock;
+};
+
+/*----------------------------------------------------------------------
+|   HashQueue::Run
++---------------------------------------------------------------------*/
+void
+HashQueue::Run()
+{
+    // each thread reads the files with its own streams
+    AP4_ByteStream* streams[2] = {NULL, NULL};
+    AP4_DataBuffer  buffer;
+    for (;;) {
+        AP4_Ordinal next;
+        {
+            AP4_AutoLock lock(m_Lock);
+            next = m_Next++;
+        }
+        if (next >= m_Jobs.ItemCount()) break;
+
+        HashJob& job = m_Jobs[next];
+        AP4_Result result = AP4_SUCCESS;
+        if (streams[job.m_FileIndex] == NULL) {
+            result = AP4_FileByteStream::Create(m_Filenames[job.m_FileIndex],
+                                                AP4_FileByteStream::STREAM_MODE_READ,
+                                                streams[job.m_FileIndex]);
+        }
+        if (AP4_SUCCEEDED(result)) {
+            result = RunJob(job, *streams[job.m_FileIndex], buffer);
+        }
+        if (AP4_FAILED(result)) {
+            AP4_AutoLock lock(m_Lock);
+            m_Result = result;
+        }
+    }
+    if (streams[0]) streams[0]->Release();
+    if (streams[1]) streams[1]->Release();
+}
+
+/*----------------------------------------------------------------------
+|   HashQueue::RunJob
++---------------------------------------------------------------------*/
+AP4_Result
+HashQueue::RunJob(HashJob& job, AP4_ByteStream& stream, AP4_DataBuffer& buffer)
+{
+    AP4_Array<SampleInfo>& samples = job.m_Track->m_Samples;
+    AP4_UI64*              hashes  = &job.m_Track->m_Hashes[0];
+    AP4_Ordinal            end     = job.m_FirstSample+job.m_SampleCount;
+    for (AP4_Ordinal i=job.m_FirstSample; i<end;) {
+        // read contiguous samples at once
+        AP4_Position span_start = samples[i].m_Offset;
+        AP4_Size     span_size  = samples[i].m_Size;
+        AP4_Ordinal  span_end   = i+1;
+        while (span_end < end &&
+               samples[span_end].m_Offset == span_start+span_size &&
+               span_size+samples[span_end].m_Size <= MP4DIFF_READ_SIZE) {
+            span_size += samples[span_end++].m_Size;
+        }
+        AP4_CHECK(buffer.SetDataSize(span_size));
+        AP4_CHECK(stream.Seek(span_start));
+        AP4_CHECK(stream.Read(buffer.UseData(), span_size));
+
+        const AP4_UI08* data = buffer.GetData();
+        for (; i<span_end; i++) {
+            hashes[i] = AP4_ComputeXxh64(data, samples[i].m_Size);
+            data += samples[i].m_Size;
+        }
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AddHashJobs
++---------------------------------------------------------------------*/
+static void
+AddHashJobs(AP4_Array<HashJob>& jobs, unsigned int file_index, TrackSamples& track)
+{
+    track.m_Hashes.SetItemCount(track.m_Samples.ItemCount());
+    HashJob job;
+    job.m_FileIndex   = file_index;
+    job.m_Track       = &track;
+    job.m_FirstSample = 0;
+    job.m_SampleCount = 0;
+    AP4_Size job_size = 0;
+    for (unsigned int i=0; i<track.m_Samples.ItemCount(); i++) {
+        ++job.m_SampleCount;
+        job_size += track.m_Samples[i].m_Size;
+        if (job_size >= MP4DIFF_HASH_JOB_SIZE) {
+            jobs.Append(job);
+            job.m_FirstSample = i+1;
+            job.m_SampleCount = 0;
+            job_size = 0;
+        }
+    }
+    if (job.m_SampleCount) jobs.Append(job);
+}
+
+/*----------------------------------------------------------------------
+|   ReadSampleData
++---------------------------------------------------------------------*/
+static AP4_Result
+ReadSampleData(AP4_ByteStream* stream, const SampleInfo& sample, AP4_DataBuffer& data)
+{
+    AP4_CHECK(data.SetDataSize(sample.m_Size));
+    AP4_CHECK(stream->Seek(sample.m_Offset));
+    return stream->Read(data.UseData(), sample.m_Size);
+}
+
+/*----------------------------------------------------------------------
+|   DiffSampleHashes
++---------------------------------------------------------------------*/
+static unsigned int
+DiffSampleHashes(TrackSamples&   track1,
+                 AP4_ByteStream* stream1,
+                 TrackSamples&   track2,
+                 AP4_ByteStream* stream2)
+{
+    unsigned int   difference_count = 0;
+    AP4_DataBuffer sample_data1;
+    AP4_DataBuffer sample_data2;
+    unsigned int   sample_count = track1.m_Samples.ItemCount() < track2.m_Samples.ItemCount() ?
+                                  track1.m_Samples.ItemCount() : track2.m_Samples.ItemCount();
+    for (unsigned int i=0; i<sample_count; i++) {
+        if (track1.m_Samples[i].m_Size == track2.m_Samples[i].m_Size &&
+            track1.m_Hashes[i]         == track2.m_Hashes[i]) {
+            continue;
+        }
+
+        // only compare the bytes of the samples that differ
+        if (++difference_count > MP4DIFF_MAX_REPORTED_DIFFERENCES) continue;
+        if (AP4_FAILED(ReadSampleData(stream1, track1.m_Samples[i], sample_data1)) ||
+            AP4_FAILED(ReadSampleData(stream2, track2.m_Samples[i], sample_data2))) {
+            printf("!!! sample %d: cannot read sample data\n", i);
+            continue;
+        }
+        DiffSamples(i, sample_data1, sample_data2);
+    }
+    if (difference_count > MP4DIFF_MAX_REPORTED_DIFFERENCES) {
+        printf("!!! (%d more samples with different data)\n", difference_count-MP4DIFF_MAX_REPORTED_DIFFERENCES);
+    }
+
+    return difference_count;
+}
+
+/*----------------------------------------------------------------------
+|   DiffTracks
++---------------------------------------------------------------------*/
+static unsigned int
+DiffTracks(AP4_Movie&      movie1,
+           AP4_ByteStream* stream1,
+           const char*     filename1,
+           AP4_Movie&      movie2,
+           AP4_ByteStream* stream2,
+           const char*     filename2,
+           bool            timing_only,
+           unsigned int    thread_count)
+{
+    AP4_Array<TrackSamples*> tracks1;
+    AP4_Array<TrackSamples*> tracks2;
+    GetTrackSamples(movie1, stream1, tracks1);
+    GetTrackSamples(movie2, stream2, tracks2);
+    unsigned int track_count = tracks1.ItemCount() < tracks2.ItemCount() ?
+                               tracks1.ItemCount() : tracks2.ItemCount();
+    unsigned int difference_count = 0;
+
+    // hash the sample data of both files
+    if (!timing_only) {
+        AP4_Array<HashJob> jobs;
+        for (unsigned int i=0; i<track_count; i++) {
+            AddHashJobs(jobs, 0, *tracks1[i]);
+            AddHashJobs(jobs, 1, *tracks2[i]);
+        }
+        if (thread_count == 0) {
+            thread_count = AP4_Thread::GetProcessorCount();
+        }
+        if (thread_count > jobs.ItemCount()) {
+            thread_count = jobs.ItemCount();
+        }
+        HashQueue queue(jobs, filename1, filename2);
+        AP4_Array<AP4_Thread*> threads;
+        for (unsigned int i=1; i<thread_count; i++) {
+            AP4_Thread* thread = new AP4_Thread(queue);
+            if (AP4_FAILED(thread->Start())) {
+                delete thread;
+                break;
+            }
+            threads.Append(thread);
+        }
+        queue.Run();
+        for (unsigned int i=0; i<threads.ItemCount(); i++) {
+            delete threads[i]; // waits for the thread to finish
+        }
+        if (AP4_FAILED(queue.GetResult())) {
+            fprintf(stderr, "ERROR: failed to read sample data (%d)\n", queue.GetResult());
+            DeleteTrackSamples(tracks1);
+            DeleteTrackSamples(tracks2);
+            return 1;
+        }
+    }
+
+    for (unsigned int i=0; i<track_count; i++) {
+        printf("Track %d:\n", tracks1[i]->m_TrackId);
+        unsigned int timing_differences = DiffTimings(*tracks1[i], *tracks2[i]);
+        unsigned int data_differences   = 0;
+        if (!timing_only) {
+            data_differences = DiffSampleHashes(*tracks1[i], stream1, *tracks2[i], stream2);
+        }
+        printf("### compared %d samples: %d timing differences, %d data differences\n",
+               tracks1[i]->m_Samples.ItemCount(),
+               timing_differences,
+               data_differences);
+        difference_count += timing_differences+data_differences;
+    }
+
+    DeleteTrackSamples(tracks1);
+    DeleteTrackSamples(tracks2);
+
+    return difference_count;
+}
+
 /*----------------------------------------------------------------------
 |   main
 +---------------------------------------------------------------------*/
@@ -152,11 +541,25 @@ main(int argc, char** argv)
     if (argc < 3) {
         PrintUsageAndExit();
     }
-    const char* filename1 = NULL;
-    const char* filename2 = NULL;
+    const char*  filename1    = NULL;
+    const char*  filename2    = NULL;
+    bool         parallel     = false;
+    bool         timing_only  = false;
+    unsigned int thread_count = 0;
     
     while (char* arg = *++argv) {
-        if (filename1 == NULL) {
+        if (!strcmp(arg, "--parallel")) {
+            parallel = true;
+        } else if (!strcmp(arg, "--timing-only")) {
+            timing_only = true;
+        } else if (!strcmp(arg, "--threads")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --threads option\n");
+                return 1;
+            }
+            thread_count = (unsigned int)strtoul(arg, NULL, 10);
+        } else if (filename1 == NULL) {
             filename1 = arg;
         } else if (filename2 == NULL) {
             filename2 = arg;
@@ -193,10 +596,11 @@ main(int argc, char** argv)
     
     AP4_Movie* movie1 = file1->GetMovie();
     AP4_Movie* movie2 = file2->GetMovie();
+    unsigned int difference_count = 0;
 
     if (movie1 && movie2) {
         AP4_List<AP4_Track>& tracks1 = movie1->GetTracks();
-        AP4_List<AP4_Track>& tracks2 = movie1->GetTracks();
+        AP4_List<AP4_Track>& tracks2 = movie2->GetTracks();
 
         if (tracks1.ItemCount() != tracks2.ItemCount()) {
             fprintf(stderr, "### file 1 has %d tracks, file 2 has %d tracks\n", tracks1.ItemCount(), tracks2.ItemCount());
@@ -215,7 +619,12 @@ main(int argc, char** argv)
                     movie1->HasFragments() ? "true" : "false",
                     movie2->HasFragments() ? "true" : "false");
         }
-        if (movie1->HasFragments() && movie2->HasFragments()) {
+        if (parallel || timing_only) {
+            difference_count = DiffTracks(*movie1, input1, filename1,
+                                          *movie2, input2, filename2,
+                                          timing_only,
+                                          thread_count);
+        } else if (movie1->HasFragments() && movie2->HasFragments()) {
             DiffFragments(*movie1, input1, *movie2, input2);
         }
     }
@@ -225,5 +634,5 @@ main(int argc, char** argv)
     input1->Release();
     input2->Release();
 
-    return 0;
+    return difference_count ? 1 : 0;
 }
@@ -57,6 +57,10 @@ PrintUsageAndExit()
             "options are:\n"
             "  --verbosity <n>\n"
             "      sets the verbosity (details) level to <n> (between 0 and 3)\n"
+            "  --atom-verbosity <type>:<n>\n"
+            "      sets the verbosity level of the atoms of type <type> (4 characters)\n"
+            "      and of the atoms they contain to <n>, or skips them if <n> is 'none'\n"
+            "      (several --atom-verbosity options can be used, one for each type)\n"
             "  --track <track_id>[:<key>]\n"
             "      writes the track data into a file\n"
             "      (<mp4filename>.<track_id>) and optionally\n"
@@ -66,7 +70,8 @@ PrintUsageAndExit()
             "      value in big-endian byte order\n"
             "  --format <format>\n"
             "      format to use for the output, where <format> is either \n"
-            "      'text' (default) or 'json'\n");
+            "      'text' (default), 'json' or 'cbor' (binary JSON, with\n"
+            "      integer tables written as typed arrays)\n");
     exit(1);
 }
 
@@ -238,7 +243,10 @@ main(int argc, char** argv)
     AP4_ProtectionKeyMap    key_map;
     AP4_Array<AP4_Ordinal>  tracks_to_dump;
     AP4_Ordinal             verbosity   = 0;
+    AP4_Array<AP4_UI32>     verbosity_atom_types;
+    AP4_Array<int>          verbosity_atom_levels;
     bool                    json_format = false;
+    bool                    cbor_format = false;
 
     // parse the command line
     argv++;
@@ -279,6 +287,22 @@ main(int argc, char** argv)
                 return 1;
             }
             verbosity = (unsigned int)strtoul(arg, NULL, 10);
+        } else if (!strcmp(arg, "--atom-verbosity")) {
+            arg = *argv++;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --atom-verbosity option\n");
+                return 1;
+            }
+            if (strlen(arg) < 6 || arg[4] != ':') {
+                fprintf(stderr, "ERROR: invalid argument for --atom-verbosity option\n");
+                return 1;
+            }
+            verbosity_atom_types.Append(AP4_ATOM_TYPE(arg[0], arg[1], arg[2], arg[3]));
+            if (!strcmp(arg+5, "none")) {
+                verbosity_atom_levels.Append(-1);
+            } else {
+                verbosity_atom_levels.Append((int)strtoul(arg+5, NULL, 10));
+            }
         } else if (!strcmp(arg, "--format")) {
             arg = *argv++;
             if (arg == NULL) {
@@ -287,6 +311,8 @@ main(int argc, char** argv)
             }
             if (strcmp(arg, "json") == 0) {
                 json_format = true;
+            } else if (strcmp(arg, "cbor") == 0) {
+                cbor_format = true;
             } else if (strcmp(arg, "text")) {
                 fprintf(stderr, "ERROR: unknown output format\n");
                 return 1;
@@ -325,16 +351,21 @@ main(int argc, char** argv)
     
     // open the output
     AP4_ByteStream* output = NULL;
-    AP4_FileByteStream::Create("-stdout", AP4_FileByteStream::STREAM_MODE_WRITE, output);
+    AP4_FileByteStream::Create(cbor_format ? "-stdout#" : "-stdout", AP4_FileByteStream::STREAM_MODE_WRITE, output);
     
     // create an inspector
     AP4_AtomInspector* inspector = NULL;
     if (json_format) {
         inspector = new AP4_JsonInspector(*output);
+    } else if (cbor_format) {
+        inspector = new AP4_CborInspector(*output);
     } else {
         inspector = new AP4_PrintInspector(*output);
     }
     inspector->SetVerbosity(verbosity);
+    for (unsigned int i=0; i<verbosity_atom_types.ItemCount(); i++) {
+        inspector->SetAtomVerbosity(verbosity_atom_types[i], verbosity_atom_levels[i]);
+    }
 
     // inspect the atoms one by one
     AP4_Atom* atom;
@@ -347,7 +378,7 @@ main(int argc, char** argv)
         input->Tell(position);
 
         // inspect the atom
-        atom->Inspect(*inspector);
+        inspector->InspectAtom(*atom);
 
         // restore the previous stream position
         input->Seek(position);
@@ -93,6 +93,10 @@ PrintUsageAndExit()
         "      (this option must appear *after* the --property options on the command line)\n"
         "  --kms-uri <uri>\n"
         "      Specifies the KMS URI for the ISMA-IAEC method\n"
+        "  --sample-hashes <filename>\n"
+        "      Write the hashes of the input samples to <filename>, so that they\n"
+        "      can later be verified with mp4samplehash --verify <filename>\n"
+        "      (cannot be used with --multi)\n"
         "\n"
         "  Method Specifics:\n"
         "    OMA-PDCF-CBC, MARLIN-IPMP-ACBC, MARLIN-IPMP-ACGK, PIFF-CBC, MPEG-CBC1, MPEG-CBCS: \n"
@@ -338,6 +342,7 @@ main(int argc, char** argv)
     const char*              input_filename = NULL;
     const char*              output_filename = NULL;
     const char*              fragments_info_filename = NULL;
+    const char*              sample_hashes_filename = NULL;
     bool                     multi = false;
     AP4_Array<const char*>   input_fragments;
     AP4_ProtectionKeyMap     key_map;
@@ -456,6 +461,13 @@ main(int argc, char** argv)
                 return 1;
             }
             kms_uri = arg;
+        } else if (!strcmp(arg, "--sample-hashes")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument for --sample-hashes option\n");
+                return 1;
+            }
+            sample_hashes_filename = arg;
         } else if (!strcmp(arg, "--show-progress")) {
             show_progress = true;
         } else if (!strcmp(arg, "--strict")) {
@@ -652,6 +664,10 @@ main(int argc, char** argv)
             fprintf(stderr, "ERROR: the output patter must contain a %%s placeholder\n");
             return 1;
         }
+        if (sample_hashes_filename) {
+            fprintf(stderr, "ERROR: --sample-hashes cannot be used with --multi\n");
+            return 1;
+        }
     } else {
         if (input_filename == NULL) {
             fprintf(stderr, "ERROR: missing input filename\n");
@@ -664,12 +680,16 @@ main(int argc, char** argv)
     }
     
     // create an encrypting processor
-    AP4_Processor* processor = NULL;
+    AP4_Processor*      processor = NULL;
+    AP4_SampleHashIndex sample_hashes;
     if (!multi) {
         processor = CreateProcessor(method, kms_uri, key_map, property_map, pssh_atoms);
         if (!processor) {
             return 1;
         }
+        if (sample_hashes_filename) {
+            processor->SetSampleHashIndex(&sample_hashes);
+        }
     }
     
     // create the input stream
@@ -775,6 +795,23 @@ main(int argc, char** argv)
         fprintf(stderr, "ERROR: failed to process the file (%d)\n", result);
     }
 
+    // save the sample hashes if needed
+    int exit_code = 0;
+    if (sample_hashes_filename && AP4_SUCCEEDED(result)) {
+        AP4_ByteStream* sample_hashes_stream = NULL;
+        result = AP4_FileByteStream::Create(sample_hashes_filename,
+                                            AP4_FileByteStream::STREAM_MODE_WRITE,
+                                            sample_hashes_stream);
+        if (AP4_SUCCEEDED(result)) {
+            result = sample_hashes.Write(*sample_hashes_stream);
+            sample_hashes_stream->Release();
+        }
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot write sample hashes file %s (%d)\n", sample_hashes_filename, result);
+            exit_code = 1;
+        }
+    }
+
     // cleanup
     delete processor;
     if (input) input->Release();
@@ -784,5 +821,5 @@ main(int argc, char** argv)
         delete pssh_atoms[i];
     }
     
-    return 0;
+    return exit_code;
 }
@@ -0,0 +1,148 @@
+/*****************************************************************
+|
+|    AP4 - MP4 Fast Start
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "MP4 Fast Start - Version 1.0.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2017 Axiomatic Systems, LLC"
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr,
+            BANNER
+            "\n\nusage: mp4faststart [options] <input> [<output>]\n"
+            "  Move the moov atom of <input> before the media data, without\n"
+            "  rewriting the samples (only the chunk offsets are updated).\n"
+            "  options:\n"
+            "    --in-place: modify <input> instead of writing to <output>\n"
+            "    --padding <n>: reserve <n> bytes of free space after the moov atom,\n"
+            "      for future in-place edits\n"
+            );
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        PrintUsageAndExit();
+    }
+    const char*  input_filename  = NULL;
+    const char*  output_filename = NULL;
+    bool         in_place = false;
+    unsigned int padding = 0;
+
+    ++argv;
+    while (char* arg = *argv++) {
+        if (!strcmp(arg, "--in-place")) {
+            in_place = true;
+        } else if (!strcmp(arg, "--padding")) {
+            arg = *argv++;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --padding option\n");
+                return 1;
+            }
+            padding = (unsigned int)strtoul(arg, NULL, 10);
+        } else if (input_filename == NULL) {
+            input_filename = arg;
+        } else if (output_filename == NULL) {
+            output_filename = arg;
+        } else {
+            fprintf(stderr, "ERROR: unexpected argument '%s'\n", arg);
+            return 1;
+        }
+    }
+    if (input_filename == NULL) {
+        fprintf(stderr, "ERROR: input filename missing\n");
+        return 1;
+    }
+    if (in_place && output_filename) {
+        fprintf(stderr, "ERROR: unexpected output filename with --in-place\n");
+        return 1;
+    }
+    if (!in_place && output_filename == NULL) {
+        fprintf(stderr, "ERROR: output filename missing\n");
+        return 1;
+    }
+
+    AP4_ByteStream* input = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(input_filename,
+                                                   in_place ?
+                                                   AP4_FileByteStream::STREAM_MODE_READ_WRITE :
+                                                   AP4_FileByteStream::STREAM_MODE_READ,
+                                                   input);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open input file %s (%d)\n", input_filename, result);
+        return 1;
+    }
+
+    bool moved = false;
+    if (in_place) {
+        result = AP4_FastStart::ProcessInPlace(*input, padding, &moved);
+    } else {
+        AP4_ByteStream* output = NULL;
+        result = AP4_FileByteStream::Create(output_filename,
+                                            AP4_FileByteStream::STREAM_MODE_WRITE,
+                                            output);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot open output file %s (%d)\n", output_filename, result);
+            input->Release();
+            return 1;
+        }
+        result = AP4_FastStart::Process(*input, *output, padding, &moved);
+        output->Release();
+    }
+    input->Release();
+
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: failed to move the moov atom (%d:%s)\n", result, AP4_ResultText(result));
+        return 1;
+    }
+    if (!moved) {
+        fprintf(stderr, "the moov atom is already before the media data\n");
+    }
+
+    return 0;
+}
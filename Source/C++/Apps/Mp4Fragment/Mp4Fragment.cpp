@@ -821,7 +821,7 @@ Fragment(AP4_File&                input_file,
     delete ftyp;
     
     // write the moov atom
-    output_movie->GetMoovAtom()->Write(output_stream);
+    output_movie->GetMoovAtom()->WriteBuffered(output_stream);
 
     // write the (not-yet fully computed) indexes if needed
     AP4_SidxAtom* sidx = NULL;
@@ -836,7 +836,7 @@ Fragment(AP4_File&                input_file,
                                 0);
         // reserve space for the entries now, but they will be computed and updated later
         sidx->SetReferenceCount(indexed_segments.ItemCount());
-        sidx->Write(output_stream);
+        sidx->WriteBuffered(output_stream);
     }
     
     // write all fragments
@@ -850,7 +850,7 @@ Fragment(AP4_File&                input_file,
         fragment->m_Tfra->AddEntry(fragment->m_Timestamp, fragment->m_MoofPosition);
         
         // write the moof
-        fragment->m_Moof->Write(output_stream);
+        fragment->m_Moof->WriteBuffered(output_stream);
         
         // write mdat
         output_stream.WriteUI32(fragment->m_MdatSize);
@@ -900,7 +900,7 @@ Fragment(AP4_File&                input_file,
         AP4_Position here = 0;
         output_stream.Tell(here);
         output_stream.Seek(sidx_position);
-        sidx->Write(output_stream);
+        sidx->WriteBuffered(output_stream);
         output_stream.Seek(here);
         delete sidx;
     }
@@ -913,7 +913,7 @@ Fragment(AP4_File&                input_file,
     }
     AP4_MfroAtom* mfro = new AP4_MfroAtom((AP4_UI32)mfra.GetSize()+16);
     mfra.AddChild(mfro);
-    result = mfra.Write(output_stream);
+    result = mfra.WriteBuffered(output_stream);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: failed to write 'mfra' (%d)\n", result);
         return;
@@ -1042,23 +1042,6 @@ AutoDetectAudioFragmentDuration(AP4_ByteStream& stream, TrackCursor* cursor)
     return (unsigned int)AP4_ConvertTime(total_duration/fragment_count, cursor->m_Track->GetMediaTimeScale(), 1000);
 }
 
-/*----------------------------------------------------------------------
-|   ReadGolomb
-+---------------------------------------------------------------------*/
-static unsigned int
-ReadGolomb(AP4_BitStream& bits)
-{
-    unsigned int leading_zeros = 0;
-    while (bits.ReadBit() == 0) {
-        leading_zeros++;
-    }
-    if (leading_zeros) {
-        return (1<<leading_zeros)-1+bits.ReadBits(leading_zeros);
-    } else {
-        return 0;
-    }
-}
-
 /*----------------------------------------------------------------------
 |   IsIFrame
 +---------------------------------------------------------------------*/
@@ -1096,10 +1079,9 @@ IsIFrame(AP4_Sample& sample, AP4_AvcSampleDescription* avc_desc) {
         
         switch (*data & 0x1F) {
             case 1: {
-                AP4_BitStream bits;
-                bits.WriteBytes(data+1, 8);
-                ReadGolomb(bits);
-                unsigned int slice_type = ReadGolomb(bits);
+                AP4_BitReader bits(data+1, 8);
+                bits.ReadUE();
+                unsigned int slice_type = bits.ReadUE();
                 if (slice_type == 2 || slice_type == 7) {
                     return true;
                 } else {
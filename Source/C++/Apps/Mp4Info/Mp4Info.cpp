@@ -31,9 +31,10 @@
 +---------------------------------------------------------------------*/
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
 
 #include "Ap4.h"
-#include "Ap4BitStream.h"
 #include "Ap4Mp4AudioInfo.h"
 #include "Ap4HevcParser.h"
 
@@ -78,7 +79,15 @@ PrintUsageAndExit()
             "  --show-layout:      show sample layout\n"
             "  --show-samples:     show sample details\n"
             "  --show-sample-data: show sample data\n"
-            "  --fast:             skip some details that are slow to compute\n");
+            "  --fast:             skip some details that are slow to compute\n"
+            "\n"
+            "usage: mp4info [options] --batch <list>\n"
+            "  Print a one-line JSON summary of each file listed in <list> (one filename\n"
+            "  per line, or - to read the list from stdin), without loading the sample\n"
+            "  tables.\n"
+            "Options:\n"
+            "  --threads <n>:      number of files to summarize concurrently\n"
+            "                      (default: number of processors)\n");
     exit(1);
 }
 
@@ -1171,23 +1180,6 @@ ShowDcfInfo(AP4_File& file)
     }
 }
 
-/*----------------------------------------------------------------------
-|   ReadGolomb
-+---------------------------------------------------------------------*/
-static unsigned int
-ReadGolomb(AP4_BitStream& bits)
-{
-    unsigned int leading_zeros = 0;
-    while (bits.ReadBit() == 0) {
-        leading_zeros++;
-    }
-    if (leading_zeros) {
-        return (1<<leading_zeros)-1+bits.ReadBits(leading_zeros);
-    } else {
-        return 0;
-    }
-}
-
 /*----------------------------------------------------------------------
 |   ShowAvcInfo
 +---------------------------------------------------------------------*/
@@ -1221,10 +1213,9 @@ ShowAvcInfo(const AP4_DataBuffer& sample_data, AP4_AvcSampleDescription* avc_des
         
         switch (*data & 0x1F) {
             case 1: {
-                AP4_BitStream bits;
-                bits.WriteBytes(data+1, 8);
-                ReadGolomb(bits);
-                unsigned int slice_type = ReadGolomb(bits);
+                AP4_BitReader bits(data+1, 8);
+                bits.ReadUE();
+                unsigned int slice_type = bits.ReadUE();
                 switch (slice_type) {
                     case 0: printf("<P>");  break;
                     case 1: printf("<B>");  break;
@@ -1855,6 +1846,211 @@ ShowFragments_Text(AP4_Movie& movie, bool verbose, bool show_sample_data, AP4_By
     }
 }
 
+/*----------------------------------------------------------------------
+|   AppendJsonFormat
++---------------------------------------------------------------------*/
+static void
+AppendJsonFormat(AP4_DataBuffer& json, const char* format, ...) // for short values only
+{
+    char buffer[128];
+    va_list args;
+    va_start(args, format);
+    int size = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (size > 0) {
+        json.AppendData((const AP4_UI08*)buffer, size < (int)sizeof(buffer) ? size : (int)sizeof(buffer)-1);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AppendJsonString
++---------------------------------------------------------------------*/
+static void
+AppendJsonString(AP4_DataBuffer& json, const char* string)
+{
+    json.AppendData((const AP4_UI08*)"\"", 1);
+    for (const char* c = string; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            AppendJsonFormat(json, "\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            AppendJsonFormat(json, "\\u%04x", (unsigned char)*c);
+        } else {
+            json.AppendData((const AP4_UI08*)c, 1);
+        }
+    }
+    json.AppendData((const AP4_UI08*)"\"", 1);
+}
+
+/*----------------------------------------------------------------------
+|   AppendJsonFourChars
++---------------------------------------------------------------------*/
+static void
+AppendJsonFourChars(AP4_DataBuffer& json, AP4_UI32 four_chars)
+{
+    char four_cc[5];
+    AP4_FormatFourChars(four_cc, four_chars);
+    AppendJsonString(json, four_cc);
+}
+
+/*----------------------------------------------------------------------
+|   MakeSummaryJson
++---------------------------------------------------------------------*/
+static void
+MakeSummaryJson(const char* filename, AP4_DataBuffer& json)
+{
+    json.SetDataSize(0);
+    AppendJsonFormat(json, "{\"file\":");
+    AppendJsonString(json, filename);
+
+    AP4_ByteStream* input = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(filename,
+                                                   AP4_FileByteStream::STREAM_MODE_READ,
+                                                   input);
+    AP4_FileSummary* summary = NULL;
+    if (AP4_SUCCEEDED(result)) {
+        result = AP4_FileSummary::Create(*input, summary);
+        input->Release();
+    }
+    if (AP4_FAILED(result)) {
+        AppendJsonFormat(json, ",\"error\":%d}\n", result);
+        return;
+    }
+
+    AppendJsonFormat(json, ",\"major_brand\":");
+    AppendJsonFourChars(json, summary->GetMajorBrand());
+    AppendJsonFormat(json, ",\"minor_version\":%u,\"compatible_brands\":[", summary->GetMinorVersion());
+    for (unsigned int i=0; i<summary->GetCompatibleBrands().ItemCount(); i++) {
+        if (i) AppendJsonFormat(json, ",");
+        AppendJsonFourChars(json, summary->GetCompatibleBrands()[i]);
+    }
+    AppendJsonFormat(json, "],\"fast_start\":%s,\"fragments\":%s",
+                     summary->IsFastStart()  ? "true" : "false",
+                     summary->IsFragmented() ? "true" : "false");
+    AppendJsonFormat(json, ",\"time_scale\":%u,\"duration\":%llu,\"duration_ms\":%u,\"tracks\":[",
+                     summary->GetTimeScale(),
+                     (unsigned long long)summary->GetDuration(),
+                     summary->GetDurationMs());
+    for (unsigned int i=0; i<summary->GetTracks().ItemCount(); i++) {
+        const AP4_FileSummary::Track& track = summary->GetTracks()[i];
+        if (i) AppendJsonFormat(json, ",");
+        AppendJsonFormat(json, "{\"id\":%u,\"type\":", track.m_Id);
+        switch (track.m_Type) {
+            case AP4_Track::TYPE_AUDIO:     AppendJsonString(json, "Audio");     break;
+            case AP4_Track::TYPE_VIDEO:     AppendJsonString(json, "Video");     break;
+            case AP4_Track::TYPE_HINT:      AppendJsonString(json, "Hint");      break;
+            case AP4_Track::TYPE_SYSTEM:    AppendJsonString(json, "System");    break;
+            case AP4_Track::TYPE_TEXT:      AppendJsonString(json, "Text");      break;
+            case AP4_Track::TYPE_JPEG:      AppendJsonString(json, "JPEG");      break;
+            case AP4_Track::TYPE_SUBTITLES: AppendJsonString(json, "Subtitles"); break;
+            default:                        AppendJsonString(json, "Unknown");   break;
+        }
+        AppendJsonFormat(json, ",\"handler\":");
+        AppendJsonFourChars(json, track.m_HandlerType);
+        AppendJsonFormat(json, ",\"language\":");
+        AppendJsonString(json, track.m_Language.GetChars());
+        AppendJsonFormat(json, ",\"codecs_string\":");
+        AppendJsonString(json, track.m_Codec.GetChars());
+        AppendJsonFormat(json, ",\"coding\":");
+        AppendJsonFourChars(json, track.m_Format);
+        if (track.m_ProtectionScheme) {
+            AppendJsonFormat(json, ",\"protection_scheme\":");
+            AppendJsonFourChars(json, track.m_ProtectionScheme);
+        }
+        AppendJsonFormat(json, ",\"sample_descriptions\":%u,\"duration_ms\":%u,\"sample_count\":%u",
+                         track.m_SampleDescriptionCount,
+                         track.m_DurationMs,
+                         track.m_SampleCount);
+        AppendJsonFormat(json, ",\"timescale\":%u,\"media_duration\":%llu,\"media_duration_ms\":%u",
+                         track.m_MediaTimeScale,
+                         (unsigned long long)track.m_MediaDuration,
+                         (AP4_UI32)AP4_ConvertTime(track.m_MediaDuration, track.m_MediaTimeScale, 1000));
+        if (track.m_Width || track.m_Height) {
+            AppendJsonFormat(json, ",\"width\":%u,\"height\":%u", track.m_Width, track.m_Height);
+        }
+        if (track.m_SampleRate) {
+            AppendJsonFormat(json, ",\"sample_rate\":%u,\"channels\":%u", track.m_SampleRate, track.m_ChannelCount);
+        }
+        AppendJsonFormat(json, "}");
+    }
+    AppendJsonFormat(json, "]}\n");
+
+    delete summary;
+}
+
+/*----------------------------------------------------------------------
+|   BatchQueue
++---------------------------------------------------------------------*/
+class BatchQueue : public AP4_Runnable
+{
+public:
+    BatchQueue(FILE* list) : m_List(list) {}
+
+    // AP4_Runnable methods, called by each thread to summarize files until the list is exhausted
+    void Run() {
+        char           filename[4096];
+        AP4_DataBuffer json;
+        for (;;) {
+            {
+                AP4_AutoLock lock(m_ListLock);
+                if (fgets(filename, sizeof(filename), m_List) == NULL) break;
+            }
+            size_t length = strlen(filename);
+            while (length && (filename[length-1] == '\n' || filename[length-1] == '\r')) {
+                filename[--length] = '\0';
+            }
+            if (length == 0) continue;
+
+            MakeSummaryJson(filename, json);
+            {
+                AP4_AutoLock lock(m_OutputLock);
+                fwrite(json.GetData(), json.GetDataSize(), 1, stdout);
+            }
+        }
+    }
+
+private:
+    FILE*     m_List;
+    AP4_Mutex m_ListLock;
+    AP4_Mutex m_OutputLock;
+};
+
+/*----------------------------------------------------------------------
+|   ShowBatchSummaries
++---------------------------------------------------------------------*/
+static int
+ShowBatchSummaries(const char* list_filename, unsigned int thread_count)
+{
+    FILE* list = strcmp(list_filename, "-") ? fopen(list_filename, "r") : stdin;
+    if (list == NULL) {
+        fprintf(stderr, "ERROR: cannot open list file %s\n", list_filename);
+        return 1;
+    }
+
+    if (thread_count == 0) {
+        thread_count = AP4_Thread::GetProcessorCount();
+    }
+    {
+        BatchQueue queue(list);
+        AP4_Array<AP4_Thread*> threads;
+        for (unsigned int i=1; i<thread_count; i++) {
+            AP4_Thread* thread = new AP4_Thread(queue);
+            if (AP4_FAILED(thread->Start())) {
+                delete thread;
+                break;
+            }
+            threads.Append(thread);
+        }
+        queue.Run();
+        for (unsigned int i=0; i<threads.ItemCount(); i++) {
+            delete threads[i]; // waits for the thread to finish
+        }
+    }
+
+    if (list != stdin) fclose(list);
+
+    return 0;
+}
+
 /*----------------------------------------------------------------------
 |   main
 +---------------------------------------------------------------------*/
@@ -1871,6 +2067,8 @@ main(int argc, char** argv)
     bool        show_sample_data = false;
     bool        show_layout      = false;
     bool        fast             = false;
+    const char* batch_filename   = NULL;
+    unsigned int thread_count    = 0;
     
     while (char* arg = *++argv) {
         if (!strcmp(arg, "--verbose")) {
@@ -1900,6 +2098,20 @@ main(int argc, char** argv)
             show_sample_data = true;
         } else if (!strcmp(arg, "--show-layout")) {
             show_layout = true;
+        } else if (!strcmp(arg, "--batch")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after '--batch' option\n");
+                return 1;
+            }
+            batch_filename = arg;
+        } else if (!strcmp(arg, "--threads")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after '--threads' option\n");
+                return 1;
+            }
+            thread_count = (unsigned int)strtoul(arg, NULL, 10);
         } else {
             if (filename == NULL) {
                 filename = arg;
@@ -1909,6 +2121,9 @@ main(int argc, char** argv)
             }
         }   
     }
+    if (batch_filename) {
+        return ShowBatchSummaries(batch_filename, thread_count);
+    }
     if (filename == NULL) {
         fprintf(stderr, "ERROR: filename missing\n");
         return 1;
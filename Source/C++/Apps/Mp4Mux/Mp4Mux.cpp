@@ -46,6 +46,8 @@
 
 const unsigned int AP4_MUX_DEFAULT_VIDEO_FRAME_RATE = 24;
 const unsigned int AP4_MUX_READ_BUFFER_SIZE         = 65536;
+const unsigned int AP4_MUX_DEFAULT_SPILL_THRESHOLD  = 256; // megabytes
+const unsigned int AP4_MUX_DIRECT_FTYP_SPACE        = 128; // room for 26 brands + a 'free' atom
 
 /*----------------------------------------------------------------------
 |   globals
@@ -118,7 +120,20 @@ PrintUsageAndExit()
             "If no type is specified for an input, the type will be inferred from the file extension\n"
             "\n"
             "Options:\n"
-            "  --verbose: show more details\n");
+            "  --verbose: show more details\n"
+            "  --spill-threshold <megabytes>: keep the sample data in memory until it exceeds\n"
+            "            this size (for all inputs together), and only then move it to\n"
+            "            temporary files (default: %d, 0 to always use temporary files)\n"
+            "  --threads <n>: number of inputs to parse concurrently (default: number of\n"
+            "            processors)\n"
+            "  --chunk-duration <milliseconds>: interleave the tracks in chunks of this\n"
+            "            duration (default: %d, 0 to write the samples track after track)\n"
+            "  --direct: write the sample data directly to the output, without a temporary\n"
+            "            file (the 'moov' atom is then written at the end of the output,\n"
+            "            the tracks are not interleaved, and the inputs are parsed one at\n"
+            "            a time, so --threads is ignored)\n",
+            AP4_MUX_DEFAULT_SPILL_THRESHOLD,
+            AP4_FILE_WRITER_DEFAULT_CHUNK_DURATION);
     exit(1);
 }
 
@@ -315,44 +330,141 @@ CheckDoviInputParameters(AP4_Array<Parameter>& parameters)
 class SampleFileStorage
 {
 public:
-    static AP4_Result Create(const char* basename, SampleFileStorage*& sample_file_storage);
+    static AP4_Result Create(const char*         basename,
+                             AP4_Size            spill_threshold,
+                             AP4_SpillBudget*    memory_budget,
+                             SampleFileStorage*& sample_file_storage);
+    // use an existing stream (the output, in direct mode) as the storage
+    SampleFileStorage(AP4_ByteStream& stream) : m_Stream(&stream) {
+        stream.AddReference();
+    }
     ~SampleFileStorage() {
         m_Stream->Release();
-        remove(m_Filename.GetChars());
     }
     
     AP4_ByteStream* GetStream() { return m_Stream; }
     
 private:
-    SampleFileStorage(const char* basename) : m_Stream(NULL) {
-        AP4_Size name_length = (AP4_Size)AP4_StringLength(basename);
-        char* filename = new char[name_length+2];
-        AP4_CopyMemory(filename, basename, name_length);
-        filename[name_length]   = '_';
-        filename[name_length+1] = '\0';
-        m_Filename = filename;
-        delete[] filename;
-    }
+    SampleFileStorage() : m_Stream(NULL) {}
 
     AP4_ByteStream* m_Stream;
-    AP4_String      m_Filename;
 };
 
 /*----------------------------------------------------------------------
 |   SampleFileStorage::Create
 +---------------------------------------------------------------------*/
 AP4_Result
-SampleFileStorage::Create(const char* basename, SampleFileStorage*& sample_file_storage)
+SampleFileStorage::Create(const char*         basename,
+                          AP4_Size            spill_threshold,
+                          AP4_SpillBudget*    memory_budget,
+                          SampleFileStorage*& sample_file_storage)
+{
+    // the samples are kept in memory, and moved to a <basename>_ temp file
+    // (deleted when the storage is released) if they exceed the threshold
+    AP4_Size name_length = (AP4_Size)AP4_StringLength(basename);
+    char* filename = new char[name_length+2];
+    AP4_CopyMemory(filename, basename, name_length);
+    filename[name_length]   = '_';
+    filename[name_length+1] = '\0';
+    SampleFileStorage* object = new SampleFileStorage();
+    object->m_Stream = new AP4_SpillByteStream(filename, spill_threshold, memory_budget);
+    delete[] filename;
+    sample_file_storage = object;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   SyncFrameReader
++---------------------------------------------------------------------*/
+/**
+ * Reads an audio elementary stream in blocks, for the FindFrameSpan methods
+ * of the sync frame parsers. Those only accept big-endian streams, so when
+ * the first sync word of the stream is byte-swapped, the data is swapped
+ * as it is read.
+ */
+class SyncFrameReader
+{
+public:
+    // swapped_sync_word is 0 for formats that are always big-endian
+    SyncFrameReader(AP4_ByteStream& input, AP4_UI16 sync_word, AP4_UI16 swapped_sync_word = 0) :
+        m_Input(input),
+        m_SyncWord(sync_word),
+        m_SwappedSyncWord(swapped_sync_word),
+        m_Offset(0),
+        m_Available(0),
+        m_ByteOrderKnown(swapped_sync_word == 0),
+        m_LittleEndian(false),
+        m_Eos(false) {}
+
+    // the data that has been read but not consumed yet
+    const AP4_UI08* GetData()              { return m_Buffer.GetData()+m_Offset; }
+    AP4_Size        GetDataSize()          { return m_Available-m_Offset;        }
+    void            Consume(AP4_Size size) { m_Offset += size;                   }
+    bool            IsEos()                { return m_Eos;                       }
+
+    AP4_Result Read();
+
+private:
+    AP4_ByteStream& m_Input;
+    AP4_UI16        m_SyncWord;
+    AP4_UI16        m_SwappedSyncWord;
+    AP4_DataBuffer  m_Buffer;
+    AP4_Size        m_Offset;
+    AP4_Size        m_Available; // the data after this is not swapped yet
+    bool            m_ByteOrderKnown;
+    bool            m_LittleEndian;
+    bool            m_Eos;
+};
+
+/*----------------------------------------------------------------------
+|   SyncFrameReader::Read
++---------------------------------------------------------------------*/
+AP4_Result
+SyncFrameReader::Read()
 {
-    sample_file_storage = NULL;
-    SampleFileStorage* object = new SampleFileStorage(basename);
-    AP4_Result result = AP4_FileByteStream::Create(object->m_Filename.GetChars(),
-                                                   AP4_FileByteStream::STREAM_MODE_WRITE,
-                                                   object->m_Stream);
+    // keep what has not been consumed, from an even offset so that the
+    // bytes to swap stay paired
+    AP4_Size keep_offset = m_Offset&~1;
+    AP4_Size bytes_left  = m_Buffer.GetDataSize()-keep_offset;
+    if (keep_offset) {
+        AP4_MoveMemory(m_Buffer.UseData(), m_Buffer.GetData()+keep_offset, bytes_left);
+        m_Offset    -= keep_offset;
+        m_Available -= keep_offset;
+    }
+
+    // read the next block
+    m_Buffer.SetDataSize(bytes_left+AP4_MUX_READ_BUFFER_SIZE);
+    AP4_Size bytes_read = 0;
+    AP4_Result result = m_Input.ReadPartial(m_Buffer.UseData()+bytes_left, AP4_MUX_READ_BUFFER_SIZE, bytes_read);
     if (AP4_FAILED(result)) {
-        return result;
+        if (result != AP4_ERROR_EOS) {
+            m_Buffer.SetDataSize(bytes_left);
+            return result;
+        }
+        bytes_read = 0;
+        m_Eos = true;
     }
-    sample_file_storage = object;
+    m_Buffer.SetDataSize(bytes_left+bytes_read);
+
+    // the byte order is that of the first sync word
+    if (!m_ByteOrderKnown && m_Buffer.GetDataSize()) {
+        m_ByteOrderKnown = true;
+        AP4_Size swapped_sync_offset = AP4_FindSyncWord(m_Buffer.GetData(), m_Buffer.GetDataSize(), m_SwappedSyncWord);
+        m_LittleEndian = swapped_sync_offset < AP4_FindSyncWord(m_Buffer.GetData(), m_Buffer.GetDataSize(), m_SyncWord);
+        if (m_LittleEndian && (swapped_sync_offset&1)) {
+            // drop one byte of the junk before it, so that the pairs start at the sync word
+            AP4_MoveMemory(m_Buffer.UseData(), m_Buffer.GetData()+1, m_Buffer.GetDataSize()-1);
+            m_Buffer.SetDataSize(m_Buffer.GetDataSize()-1);
+        }
+    }
+    if (m_LittleEndian) {
+        AP4_Size swap_size = (m_Buffer.GetDataSize()-m_Available)&~1;
+        AP4_ByteSwap16(m_Buffer.UseData()+m_Available, swap_size);
+        m_Available += swap_size;
+    } else {
+        m_Available = m_Buffer.GetDataSize();
+    }
+
     return AP4_SUCCESS;
 }
 
@@ -412,22 +524,25 @@ GetLanguageFromParameters(AP4_Array<Parameter>& parameters, const char* defaut_v
 /*----------------------------------------------------------------------
 |   AddAacTrack
 +---------------------------------------------------------------------*/
-static void
-AddAacTrack(AP4_Movie&            movie,
-            const char*           input_name,
-            AP4_Array<Parameter>& parameters,
-            SampleFileStorage&    sample_storage)
+static AP4_Result
+AddAacTrack(AP4_Array<AP4_Track*>& tracks,
+            const char*            input_name,
+            AP4_Array<Parameter>&  parameters,
+            SampleFileStorage&     sample_storage)
 {
     AP4_ByteStream* input;
     AP4_Result result = AP4_FileByteStream::Create(input_name, AP4_FileByteStream::STREAM_MODE_READ, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file '%s' (%d))\n", input_name, result);
-        return;
+        return result;
     }
 
     // check if we have a language parameter
     const char* language = GetLanguageFromParameters(parameters, "und");
-    if (!language) return;
+    if (!language) {
+        input->Release();
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
 
     // create a sample table
     AP4_SyntheticSampleTable* sample_table = new AP4_SyntheticSampleTable();
@@ -513,8 +628,10 @@ AddAacTrack(AP4_Movie&            movie,
                 AP4_Size to_feed = bytes_read;
                 result = parser.Feed(input_buffer, &to_feed);
                 if (AP4_FAILED(result)) {
-                    AP4_Debug("ERROR: parser.Feed() failed (%d)\n", result);
-                    return;
+                    fprintf(stderr, "ERROR: parser.Feed() failed (%d)\n", result);
+                    delete sample_table;
+                    input->Release();
+                    return result;
                 }
             } else {
                 if (result == AP4_ERROR_EOS) {
@@ -539,110 +656,115 @@ AddAacTrack(AP4_Movie&            movie,
     // cleanup
     input->Release();
 
-    movie.AddTrack(track);
+    tracks.Append(track);
+
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
  |   AddAc3Track
  +---------------------------------------------------------------------*/
-static void
-AddAc3Track(AP4_Movie&             movie,
-            const char*             input_name,
-            AP4_Array<Parameter>&   parameters,
-            SampleFileStorage&      sample_storage)
+static AP4_Result
+AddAc3Track(AP4_Array<AP4_Track*>& tracks,
+            const char*            input_name,
+            AP4_Array<Parameter>&  parameters,
+            SampleFileStorage&     sample_storage)
 {
     AP4_ByteStream* input;
     AP4_Result result = AP4_FileByteStream::Create(input_name, AP4_FileByteStream::STREAM_MODE_READ, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file '%s' (%d))\n", input_name, result);
-        return;
+        return result;
     }
 
     // check if we have a language parameter
     const char* language = GetLanguageFromParameters(parameters, "und");
-    if (!language) return;
+    if (!language) {
+        input->Release();
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
 
     // create a sample table
     AP4_SyntheticSampleTable* sample_table = new AP4_SyntheticSampleTable(); // chunk_size is used to control chunk size in 'stsc' box
 
-    // create an AC-3 Sync Frame parser
-    AP4_Ac3Parser parser;
     bool           initialized = false;
     unsigned int   sample_description_index = 0;
+    unsigned int   channel_count = 0;
 
-    // read from the input, feed, and get AC-3 frames
+    // read from the input and get AC-3 frames
     AP4_UI32     sample_rate = 0;
     AP4_Cardinal sample_count = 0;
 
-    bool eos = false;
+    SyncFrameReader reader(*input, AP4_AC3_SYNC_WORD_BIG_ENDIAN, AP4_AC3_SYNC_WORD_LITTLE_ENDIAN);
     for(;;) {
         // try to get a frame
-        AP4_Ac3Frame frame;
-        result = parser.FindFrame(frame);
+        AP4_Ac3FrameSpan frame;
+        AP4_Size bytes_consumed = 0;
+        result = AP4_Ac3Parser::FindFrameSpan(reader.GetData(), reader.GetDataSize(), bytes_consumed, frame, reader.IsEos());
         if (AP4_SUCCEEDED(result)) {
-            if (Options.verbose) {
-                printf("AC-3 frame [%06d]: size = %d, %d kHz, %d ch\n",
-                       sample_count,
-                       frame.m_Info.m_FrameSize,
-                       frame.m_Info.m_SampleRate,
-                       frame.m_Info.m_ChannelCount);
-            }
             if (!initialized) {
                 initialized = true;
 
+                // the sample description needs the fully parsed header of the first frame
+                AP4_Ac3Parser parser;
+                AP4_Ac3Frame  first_frame;
+                AP4_Size      to_feed = frame.m_Size;
+                parser.Feed(frame.m_Data, &to_feed, AP4_BITSTREAM_FLAG_EOS);
+                result = parser.FindFrame(first_frame);
+                if (AP4_FAILED(result)) {
+                    if ((result == AP4_ERROR_NOT_ENOUGH_DATA) && (parser.GetBytesAvailable() == (AP4_BITSTREAM_BUFFER_SIZE -1))) {
+                        fprintf(stderr, "WARN: The frame %d size is larger than the max buffer size, muxing stopped. The muxed MP4 only contains the first %d samples.\n", sample_count + 1, sample_count);
+                    } else {
+                        fprintf(stderr, "WARN: The stream in corrupted, muxing stopped. The muxed MP4 only contains the first %d samples.\n", sample_count);
+                    }
+                    break;
+                }
+
                 // create a sample description for our samples
-                AP4_Dac3Atom::StreamInfo *ac3_stream_info = &frame.m_Info.m_Ac3StreamInfo;
+                AP4_Dac3Atom::StreamInfo *ac3_stream_info = &first_frame.m_Info.m_Ac3StreamInfo;
 
                 AP4_Ac3SampleDescription* sample_description =
                 new AP4_Ac3SampleDescription(
-                                             frame.m_Info.m_SampleRate,       // sample rate
+                                             first_frame.m_Info.m_SampleRate, // sample rate
                                              16,                              // sample size
                                              2,                               // channel count
-                                             frame.m_Info.m_FrameSize,        // Access Unit size
+                                             first_frame.m_Info.m_FrameSize,  // Access Unit size
                                              ac3_stream_info);            // AC-3 SubStream
 
                 sample_description_index = sample_table->GetSampleDescriptionCount();
                 sample_table->AddSampleDescription(sample_description);
-                sample_rate      = frame.m_Info.m_SampleRate;
+                sample_rate      = first_frame.m_Info.m_SampleRate;
+                channel_count    = first_frame.m_Info.m_ChannelCount;
+            }
+            if (Options.verbose) {
+                printf("AC-3 frame [%06d]: size = %d, %d kHz, %d ch\n",
+                       sample_count,
+                       frame.m_Size,
+                       frame.m_SampleRate,
+                       channel_count);
             }
 
-            // read and store the sample data
+            // store the sample data
             AP4_Position position = 0;
             sample_storage.GetStream()->Tell(position);
-            AP4_DataBuffer sample_data(frame.m_Info.m_FrameSize);
-            sample_data.SetDataSize(frame.m_Info.m_FrameSize);
-            frame.m_Source->ReadBytes(sample_data.UseData(), frame.m_Info.m_FrameSize);
-            if (frame.m_LittleEndian) {
-                AP4_ByteSwap16(sample_data.UseData(), (unsigned int)frame.m_Info.m_FrameSize);
-            }
-            sample_storage.GetStream()->Write(sample_data.GetData(), frame.m_Info.m_FrameSize);
+            sample_storage.GetStream()->Write(frame.m_Data, frame.m_Size);
 
             // add the sample to the table
-            sample_table->AddSample(*sample_storage.GetStream(), position, frame.m_Info.m_FrameSize, 1536, sample_description_index, 0, 0, true);
+            sample_table->AddSample(*sample_storage.GetStream(), position, frame.m_Size, 1536, sample_description_index, 0, 0, true);
             sample_count++;
-        } else {
-            if (eos) break;
+        } else if (reader.IsEos()) {
+            break;
         }
+        reader.Consume(bytes_consumed);
 
-        // read some data and feed the parser
-        AP4_UI08 input_buffer[AP4_MUX_READ_BUFFER_SIZE];
-        AP4_Size to_read = parser.GetBytesFree();
-        if (to_read) {
-            AP4_Size bytes_read = 0;
-            if (to_read > sizeof(input_buffer)) to_read = sizeof(input_buffer);
-            result = input->ReadPartial(input_buffer, to_read, bytes_read);
-            if (AP4_SUCCEEDED(result)) {
-                AP4_Size to_feed = bytes_read;
-                result = parser.Feed(input_buffer, &to_feed);
-                if (AP4_FAILED(result)) {
-                    AP4_Debug("ERROR: parser.Feed() failed (%d)\n", result);
-                    return;
-                }
-            } else {
-                if (result == AP4_ERROR_EOS) {
-                    eos = true;
-                    parser.Feed(NULL, NULL, AP4_BITSTREAM_FLAG_EOS);
-                }
+        // read more data when no complete frame is left
+        if (AP4_FAILED(result)) {
+            result = reader.Read();
+            if (AP4_FAILED(result)) {
+                fprintf(stderr, "ERROR: failed to read from input file '%s' (%d)\n", input_name, result);
+                delete sample_table;
+                input->Release();
+                return result;
             }
         }
     }
@@ -663,12 +785,8 @@ AddAc3Track(AP4_Movie&             movie,
         // create an 'edts' container
         AP4_ContainerAtom* new_edts = new AP4_ContainerAtom(AP4_ATOM_TYPE_EDTS);
         AP4_ElstAtom* new_elst = new AP4_ElstAtom();
-        AP4_UI64 duration = 0;
-        if (!movie.GetTimeScale()) {
-            duration = sample_count * 1536;
-        } else {
-            duration = AP4_ConvertTime(1536*sample_table->GetSampleCount(), sample_rate, movie.GetTimeScale());
-        }
+        // the duration is in the media timescale, it is converted when the track is added to the movie
+        AP4_UI64 duration = 1536*sample_table->GetSampleCount();
         AP4_ElstEntry new_elst_entry = AP4_ElstEntry(duration, 0, 1);
         new_elst->AddEntry(new_elst_entry);
         new_edts->AddChild(new_elst);
@@ -678,118 +796,116 @@ AddAc3Track(AP4_Movie&             movie,
     // cleanup
     input->Release();
 
-    movie.AddTrack(track);
+    tracks.Append(track);
+
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
 |   AddEac3Track
 +---------------------------------------------------------------------*/
-static void
-AddEac3Track(AP4_Movie&             movie,
-            const char*             input_name,
-            AP4_Array<Parameter>&   parameters,
-            SampleFileStorage&      sample_storage)
+static AP4_Result
+AddEac3Track(AP4_Array<AP4_Track*>& tracks,
+             const char*            input_name,
+             AP4_Array<Parameter>&  parameters,
+             SampleFileStorage&     sample_storage)
 {
     AP4_ByteStream* input;
     AP4_Result result = AP4_FileByteStream::Create(input_name, AP4_FileByteStream::STREAM_MODE_READ, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file '%s' (%d))\n", input_name, result);
-        return;
+        return result;
     }
 
     // check if we have a language parameter
     const char* language = GetLanguageFromParameters(parameters, "und");
-    if (!language) return;
+    if (!language) {
+        input->Release();
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
 
     // create a sample table
     AP4_SyntheticSampleTable* sample_table = new AP4_SyntheticSampleTable(); // The parameter chunk_size is used to control chunk size in 'stsc' box
 
-    // create an E-AC-3 Sync Frame parser
-    AP4_Eac3Parser parser;
     bool           initialized = false;
     unsigned int   sample_description_index = 0;
+    unsigned int   channel_count = 0;
 
-    // read from the input, feed, and get E-AC-3 frames
+    // read from the input and get E-AC-3 frames
     AP4_UI32     sample_rate = 0;
     AP4_Cardinal sample_count = 0;
 
-    bool eos = false;
+    SyncFrameReader reader(*input, AP4_EAC3_SYNC_WORD_BIG_ENDIAN, AP4_EAC3_SYNC_WORD_LITTLE_ENDIAN);
     for(;;) {
         // try to get a frame
-        AP4_Eac3Frame frame;
-        result = parser.FindFrame(frame);
+        AP4_Eac3FrameSpan frame;
+        AP4_Size bytes_consumed = 0;
+        result = AP4_Eac3Parser::FindFrameSpan(reader.GetData(), reader.GetDataSize(), bytes_consumed, frame, reader.IsEos());
         if (AP4_SUCCEEDED(result)) {
-            if (Options.verbose) {
-                printf("E-AC-3 frame [%06d]: size = %d, %d kHz, %d ch\n",
-                       sample_count,
-                       frame.m_Info.m_FrameSize,
-                       frame.m_Info.m_SampleRate,
-                       frame.m_Info.m_ChannelCount);
-            }
             if (!initialized) {
                 initialized = true;
 
+                // the sample description needs the fully parsed headers of the first frame
+                AP4_Eac3Parser parser;
+                AP4_Eac3Frame  first_frame;
+                AP4_Size       to_feed = frame.m_Size;
+                parser.Feed(frame.m_Data, &to_feed, AP4_BITSTREAM_FLAG_EOS);
+                result = parser.FindFrame(first_frame);
+                if (AP4_FAILED(result)) {
+                    if ((result == AP4_ERROR_NOT_ENOUGH_DATA) && (parser.GetBytesAvailable() == (AP4_BITSTREAM_BUFFER_SIZE -1))) {
+                        fprintf(stderr, "WARN: The frame %d size is larger than pre-defined buffer size (8191 bytes), so stop muxing. The muxed MP4 only contains the first %d samples.\n", sample_count + 1, sample_count);
+                    } else {
+                        fprintf(stderr, "WARN: The stream in corrupted, so stop muxing. The muxed MP4 only contains the first %d samples.\n", sample_count);
+                    }
+                    break;
+                }
+
                 // create a sample description for our samples
-                AP4_Dec3Atom::SubStream *eac3_substream = &frame.m_Info.m_Eac3SubStream;
-                const unsigned int obj_num = frame.m_Info.complexity_index_type_a;
+                AP4_Dec3Atom::SubStream *eac3_substream = &first_frame.m_Info.m_Eac3SubStream;
+                const unsigned int obj_num = first_frame.m_Info.complexity_index_type_a;
 
                 AP4_Eac3SampleDescription* sample_description =
                     new AP4_Eac3SampleDescription(
-                    frame.m_Info.m_SampleRate,      // sample rate
+                    first_frame.m_Info.m_SampleRate, // sample rate
                     16,                             // sample size
                     2,                              // channel count
-                    frame.m_Info.m_FrameSize,       // Access Unit size
+                    first_frame.m_Info.m_FrameSize, // Access Unit size
                     eac3_substream,                 // E-AC-3 SubStream
                     obj_num);                       // DD+JOC object numbers
                 sample_description_index = sample_table->GetSampleDescriptionCount();
                 sample_table->AddSampleDescription(sample_description);
-                sample_rate      = frame.m_Info.m_SampleRate;
+                sample_rate      = first_frame.m_Info.m_SampleRate;
+                channel_count    = first_frame.m_Info.m_ChannelCount;
+            }
+            if (Options.verbose) {
+                printf("E-AC-3 frame [%06d]: size = %d, %d kHz, %d ch\n",
+                       sample_count,
+                       frame.m_Size,
+                       frame.m_SampleRate,
+                       channel_count);
             }
 
-            // read and store the sample data
+            // store the sample data
             AP4_Position position = 0;
             sample_storage.GetStream()->Tell(position);
-            AP4_DataBuffer sample_data(frame.m_Info.m_FrameSize);
-            sample_data.SetDataSize(frame.m_Info.m_FrameSize);
-            frame.m_Source->ReadBytes(sample_data.UseData(), frame.m_Info.m_FrameSize);
-            if (frame.m_LittleEndian) {
-                AP4_ByteSwap16(sample_data.UseData(), (unsigned int)frame.m_Info.m_FrameSize);
-            }
-            sample_storage.GetStream()->Write(sample_data.GetData(), frame.m_Info.m_FrameSize);
+            sample_storage.GetStream()->Write(frame.m_Data, frame.m_Size);
 
             // add the sample to the table
-            sample_table->AddSample(*sample_storage.GetStream(), position, frame.m_Info.m_FrameSize, 1536, sample_description_index, 0, 0, true);
+            sample_table->AddSample(*sample_storage.GetStream(), position, frame.m_Size, 1536, sample_description_index, 0, 0, true);
             sample_count++;
-        } else {
-            if (result == AP4_ERROR_CORRUPTED_BITSTREAM) {
-                fprintf(stderr, "WARN: The stream in corrupted, so stop muxing. The muxed MP4 only contains the first %d samples.\n", sample_count);
-                break;
-            } else if ((result == AP4_ERROR_NOT_ENOUGH_DATA) && (parser.GetBytesAvailable() == (AP4_BITSTREAM_BUFFER_SIZE -1))){
-                fprintf(stderr, "WARN: The frame %d size is larger than pre-defined buffer size (8191 bytes), so stop muxing. The muxed MP4 only contains the first %d samples.\n", sample_count + 1, sample_count);
-                break;
-            }
-            if (eos) break;
+        } else if (reader.IsEos()) {
+            break;
         }
+        reader.Consume(bytes_consumed);
 
-        // read some data and feed the parser
-        AP4_UI08 input_buffer[AP4_MUX_READ_BUFFER_SIZE];
-        AP4_Size to_read = parser.GetBytesFree();
-        if (to_read) {
-            AP4_Size bytes_read = 0;
-            if (to_read > sizeof(input_buffer)) to_read = sizeof(input_buffer);
-            result = input->ReadPartial(input_buffer, to_read, bytes_read);
-            if (AP4_SUCCEEDED(result)) {
-                AP4_Size to_feed = bytes_read;
-                result = parser.Feed(input_buffer, &to_feed);
-                if (AP4_FAILED(result)) {
-                    AP4_Debug("ERROR: parser.Feed() failed (%d)\n", result);
-                    return;
-                }
-            } else {
-                if (result == AP4_ERROR_EOS) {
-                    eos = true;
-                    parser.Feed(NULL, NULL, AP4_BITSTREAM_FLAG_EOS);
-                }
+        // read more data when no complete frame is left
+        if (AP4_FAILED(result)) {
+            result = reader.Read();
+            if (AP4_FAILED(result)) {
+                fprintf(stderr, "ERROR: failed to read from input file '%s' (%d)\n", input_name, result);
+                delete sample_table;
+                input->Release();
+                return result;
             }
         }
     }
@@ -810,12 +926,8 @@ AddEac3Track(AP4_Movie&             movie,
         // create an 'edts' container
         AP4_ContainerAtom* new_edts = new AP4_ContainerAtom(AP4_ATOM_TYPE_EDTS);
         AP4_ElstAtom* new_elst = new AP4_ElstAtom();
-        AP4_UI64 duration = 0;
-        if (!movie.GetTimeScale()) {
-            duration = sample_count * 1536;
-        } else {
-            duration = AP4_ConvertTime(1536*sample_table->GetSampleCount(), sample_rate, movie.GetTimeScale());
-        }
+        // the duration is in the media timescale, it is converted when the track is added to the movie
+        AP4_UI64 duration = 1536*sample_table->GetSampleCount();
         AP4_ElstEntry new_elst_entry = AP4_ElstEntry(duration, 0, 1);
         new_elst->AddEntry(new_elst_entry);
         new_edts->AddChild(new_elst);
@@ -825,119 +937,119 @@ AddEac3Track(AP4_Movie&             movie,
     // cleanup
     input->Release();
 
-    movie.AddTrack(track);
+    tracks.Append(track);
+
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
 |   AddAc4Track
 +---------------------------------------------------------------------*/
-static void
-AddAc4Track(AP4_Movie&            movie,
-            const char*           input_name,
-            AP4_Array<Parameter>& parameters,
-            SampleFileStorage&    sample_storage)
+static AP4_Result
+AddAc4Track(AP4_Array<AP4_Track*>& tracks,
+            const char*            input_name,
+            AP4_Array<Parameter>&  parameters,
+            SampleFileStorage&     sample_storage)
 {
     AP4_ByteStream* input;
     AP4_Result result = AP4_FileByteStream::Create(input_name, AP4_FileByteStream::STREAM_MODE_READ, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file '%s' (%d))\n", input_name, result);
-        return;
+        return result;
     }
 
     // check if we have a language parameter
     const char* language = GetLanguageFromParameters(parameters, "und");
-    if (!language) return;
+    if (!language) {
+        input->Release();
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
 
     // create a sample table
     AP4_SyntheticSampleTable* sample_table = new AP4_SyntheticSampleTable(); // The parameter chunk_size is used to control chunk size in 'stsc' box
 
-    // create an AC-4 Sync Frame parser
-    AP4_Ac4Parser parser;
     bool           initialized = false;
     unsigned int   sample_description_index = 0;
+    unsigned int   sample_rate = 0;
+    unsigned int   channel_count = 0;
 
-    // read from the input, feed, and get AC-4 frames
-    // AP4_UI32     sample_rate = 0;
+    // read from the input and get AC-4 frames
     AP4_Cardinal sample_count = 0;
     AP4_Cardinal sample_duration = 0;
     AP4_Cardinal media_time_scale = 0;
-    bool eos = false;
+    SyncFrameReader reader(*input, AP4_AC4_SYNC_WORD);
     for(;;) {
         // try to get a frame
-        AP4_Ac4Frame frame;
-        result = parser.FindFrame(frame);
+        AP4_Ac4FrameSpan frame;
+        AP4_Size bytes_consumed = 0;
+        result = AP4_Ac4Parser::FindFrameSpan(reader.GetData(), reader.GetDataSize(), bytes_consumed, frame, reader.IsEos());
         if (AP4_SUCCEEDED(result)) {
-            if (Options.verbose) {
-                printf("AC-4 frame [%06d]: size = %d, %d kHz, %d ch\n",
-                       sample_count,
-                       frame.m_Info.m_FrameSize,
-                       (int)frame.m_Info.m_Ac4Dsi.d.v1.fs,
-                       frame.m_Info.m_ChannelCount);
-            }
             if (!initialized) {
                 initialized = true;
 
+                // the sample description needs the fully parsed TOC of the first frame,
+                // so feed the whole sync frame (sync word and frame_size() included)
+                AP4_Ac4Parser   parser;
+                AP4_Ac4Frame    first_frame;
+                const AP4_UI08* sync_frame = frame.m_Data-(frame.m_Size < 0xFFFF ? 4 : 7);
+                AP4_Size        to_feed    = (AP4_Size)(reader.GetData()+bytes_consumed-sync_frame);
+                parser.Feed(sync_frame, &to_feed, AP4_BITSTREAM_FLAG_EOS);
+                result = parser.FindFrame(first_frame);
+                if (AP4_FAILED(result)) {
+                    if ((result == AP4_ERROR_NOT_ENOUGH_DATA) && (parser.GetBytesAvailable() == (AP4_BITSTREAM_BUFFER_SIZE -1))) {
+                        fprintf(stderr, "WARN: The frame %d size is larger than pre-defined buffer size (8191 bytes), so stop muxing. The muxed MP4 only contains the first %d samples.\n", sample_count + 1, sample_count);
+                    } else {
+                        fprintf(stderr, "WARN: The stream in corrupted, so stop muxing. The muxed MP4 only contains the first %d samples.\n", sample_count);
+                    }
+                    break;
+                }
+
                 // create a sample description for our samples
-                AP4_Dac4Atom::Ac4Dsi *ac4Dsi = &frame.m_Info.m_Ac4Dsi;
+                AP4_Dac4Atom::Ac4Dsi *ac4Dsi = &first_frame.m_Info.m_Ac4Dsi;
 
                 AP4_Ac4SampleDescription* sample_description =
                     new AP4_Ac4SampleDescription(
-                    frame.m_Info.m_Ac4Dsi.d.v1.fs,  // sample rate
-                    16,                             // sample size
-                    frame.m_Info.m_ChannelCount,    // channel count
-                    frame.m_Info.m_FrameSize,       // DIS size, can't calcuate the DSI size in advance, so assume the maximum value is frame size.
-                    ac4Dsi);                        // AC-4 DSI
+                    first_frame.m_Info.m_Ac4Dsi.d.v1.fs, // sample rate
+                    16,                                  // sample size
+                    first_frame.m_Info.m_ChannelCount,   // channel count
+                    first_frame.m_Info.m_FrameSize,      // DIS size, can't calcuate the DSI size in advance, so assume the maximum value is frame size.
+                    ac4Dsi);                             // AC-4 DSI
                 sample_description_index = sample_table->GetSampleDescriptionCount();
                 sample_table->AddSampleDescription(sample_description);
-                /* sample_rate = frame.m_Info.m_Ac4Dsi.d.v1.fs */;
-                sample_duration  = frame.m_Info.m_SampleDuration;
-                media_time_scale = frame.m_Info.m_MediaTimeScale;
-
+                sample_rate      = first_frame.m_Info.m_Ac4Dsi.d.v1.fs;
+                channel_count    = first_frame.m_Info.m_ChannelCount;
+                sample_duration  = frame.m_SampleDuration;
+                media_time_scale = frame.m_MediaTimeScale;
+            }
+            if (Options.verbose) {
+                printf("AC-4 frame [%06d]: size = %d, %d kHz, %d ch\n",
+                       sample_count,
+                       frame.m_Size,
+                       sample_rate,
+                       channel_count);
             }
 
-            // read and store the sample data
+            // store the sample data (the raw_ac4_frame(), without the CRC word of 0xAC41 streams)
             AP4_Position position = 0;
             sample_storage.GetStream()->Tell(position);
-            AP4_DataBuffer sample_data(frame.m_Info.m_FrameSize);
-            sample_data.SetDataSize(frame.m_Info.m_FrameSize);
-            frame.m_Source->ReadBytes(sample_data.UseData(), frame.m_Info.m_FrameSize);
-            sample_storage.GetStream()->Write(sample_data.GetData(), frame.m_Info.m_FrameSize);
+            sample_storage.GetStream()->Write(frame.m_Data, frame.m_Size);
 
             // add the sample to the table
-            sample_table->AddSample(*sample_storage.GetStream(), position, frame.m_Info.m_FrameSize, sample_duration, sample_description_index, 0, 0, (frame.m_Info.m_Iframe == 1));
+            sample_table->AddSample(*sample_storage.GetStream(), position, frame.m_Size, sample_duration, sample_description_index, 0, 0, (frame.m_Iframe == 1));
             sample_count++;
-            // Skip the CRC word for 0xAC41 stream
-            frame.m_Source->SkipBytes(frame.m_Info.m_CRCSize);
-        } else {
-            if (result == AP4_ERROR_CORRUPTED_BITSTREAM) {
-                fprintf(stderr, "WARN: The stream in corrupted, so stop muxing. The muxed MP4 only contains the first %d samples.\n", sample_count);
-                break;
-            } else if ((result == AP4_ERROR_NOT_ENOUGH_DATA) && (parser.GetBytesAvailable() == (AP4_BITSTREAM_BUFFER_SIZE -1))){
-                fprintf(stderr, "WARN: The frame %d size is larger than pre-defined buffer size (8191 bytes), so stop muxing. The muxed MP4 only contains the first %d samples.\n", sample_count + 1, sample_count);
-                break;
-            }
-            if (eos) break;
+        } else if (reader.IsEos()) {
+            break;
         }
+        reader.Consume(bytes_consumed);
 
-        // read some data and feed the parser
-        AP4_UI08 input_buffer[AP4_MUX_READ_BUFFER_SIZE];
-        AP4_Size to_read = parser.GetBytesFree();
-        if (to_read) {
-            AP4_Size bytes_read = 0;
-            if (to_read > sizeof(input_buffer)) to_read = sizeof(input_buffer);
-            result = input->ReadPartial(input_buffer, to_read, bytes_read);
-            if (AP4_SUCCEEDED(result)) {
-                AP4_Size to_feed = bytes_read;
-                result = parser.Feed(input_buffer, &to_feed);
-                if (AP4_FAILED(result)) {
-                    AP4_Debug("ERROR: parser.Feed() failed (%d)\n", result);
-                    return;
-                }
-            } else {
-                if (result == AP4_ERROR_EOS) {
-                    eos = true;
-                    parser.Feed(NULL, NULL, AP4_BITSTREAM_FLAG_EOS);
-                }
+        // read more data when no complete frame is left
+        if (AP4_FAILED(result)) {
+            result = reader.Read();
+            if (AP4_FAILED(result)) {
+                fprintf(stderr, "ERROR: failed to read from input file '%s' (%d)\n", input_name, result);
+                delete sample_table;
+                input->Release();
+                return result;
             }
         }
     }
@@ -958,12 +1070,8 @@ AddAc4Track(AP4_Movie&            movie,
         // create an 'edts' container
         AP4_ContainerAtom* new_edts = new AP4_ContainerAtom(AP4_ATOM_TYPE_EDTS);
         AP4_ElstAtom* new_elst = new AP4_ElstAtom();
-        AP4_UI64 duration = 0;
-        if (!movie.GetTimeScale()) {
-            duration = AP4_UI64(sample_count) * sample_duration;
-        } else {
-            duration = AP4_ConvertTime(AP4_UI64(sample_duration)*sample_table->GetSampleCount(), media_time_scale, movie.GetTimeScale());
-        }
+        // the duration is in the media timescale, it is converted when the track is added to the movie
+        AP4_UI64 duration = AP4_UI64(sample_duration)*sample_table->GetSampleCount();
         AP4_ElstEntry new_elst_entry = AP4_ElstEntry(duration, 0, 1);
         new_elst->AddEntry(new_elst_entry);
         new_edts->AddChild(new_elst);
@@ -973,29 +1081,34 @@ AddAc4Track(AP4_Movie&            movie,
     // cleanup
     input->Release();
 
-    movie.AddTrack(track);
+    tracks.Append(track);
+
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
 |   AddH264Track
 +---------------------------------------------------------------------*/
-static void
-AddH264Track(AP4_Movie&            movie,
-             const char*           input_name,
-             AP4_Array<Parameter>& parameters,
-             AP4_Array<AP4_UI32>&  brands,
-             SampleFileStorage&    sample_storage)
+static AP4_Result
+AddH264Track(AP4_Array<AP4_Track*>& tracks,
+             const char*            input_name,
+             AP4_Array<Parameter>&  parameters,
+             AP4_Array<AP4_UI32>&   brands,
+             SampleFileStorage&     sample_storage)
 {
     AP4_ByteStream* input;
     AP4_Result result = AP4_FileByteStream::Create(input_name, AP4_FileByteStream::STREAM_MODE_READ, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file '%s' (%d))\n", input_name, result);
-        return;
+        return result;
     }
 
     // check if we have a language parameter
     const char* language = GetLanguageFromParameters(parameters, "und");
-    if (!language) return;
+    if (!language) {
+        input->Release();
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
 
     // see if the frame rate is specified
     unsigned int video_frame_rate = AP4_MUX_DEFAULT_VIDEO_FRAME_RATE*1000;
@@ -1005,7 +1118,7 @@ AddH264Track(AP4_Movie&            movie,
             if (frame_rate == 0.0) {
                 fprintf(stderr, "ERROR: invalid video frame rate %s\n", parameters[i].m_Value.GetChars());
                 input->Release();
-                return;
+                return AP4_ERROR_INVALID_PARAMETERS;
             }
             video_frame_rate = (unsigned int)(1000.0*frame_rate);
         }
@@ -1123,7 +1236,7 @@ AddH264Track(AP4_Movie&            movie,
     if (sps == NULL) {
         fprintf(stderr, "ERROR: no sequence parameter set found in video\n");
         input->Release();
-        return;
+        return AP4_ERROR_INVALID_FORMAT;
     }
     unsigned int video_width = 0;
     unsigned int video_height = 0;
@@ -1189,12 +1302,8 @@ AddH264Track(AP4_Movie&            movie,
         // create an 'edts' container
         AP4_ContainerAtom* new_edts = new AP4_ContainerAtom(AP4_ATOM_TYPE_EDTS);
         AP4_ElstAtom* new_elst = new AP4_ElstAtom();
-        AP4_UI64 duration = 0;
-        if (!movie.GetTimeScale()) {
-            duration = video_media_duration;
-        } else {
-            duration = AP4_ConvertTime(1000*sample_table->GetSampleCount(), media_timescale, movie.GetTimeScale());
-        }
+        // the duration is in the media timescale, it is converted when the track is added to the movie
+        AP4_UI64 duration = 1000*sample_table->GetSampleCount();
         AP4_ElstEntry new_elst_entry = AP4_ElstEntry(duration, max_delta*1000ULL, 1);
         new_elst->AddEntry(new_elst_entry);
         new_edts->AddChild(new_elst);
@@ -1206,18 +1315,20 @@ AddH264Track(AP4_Movie&            movie,
     // cleanup
     input->Release();
 
-    movie.AddTrack(track);
+    tracks.Append(track);
+
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
 |   AddH264DoviTrack
 +---------------------------------------------------------------------*/
-static void
-AddH264DoviTrack(AP4_Movie&            movie,
-                 const char*           input_name,
-                 AP4_Array<Parameter>& parameters,
-                 AP4_Array<AP4_UI32>&  brands,
-                 SampleFileStorage&    sample_storage)
+static AP4_Result
+AddH264DoviTrack(AP4_Array<AP4_Track*>& tracks,
+                 const char*            input_name,
+                 AP4_Array<Parameter>&  parameters,
+                 AP4_Array<AP4_UI32>&   brands,
+                 SampleFileStorage&     sample_storage)
 {
     double frame_rate = 0.0;
     //based on the Dovi iso spec, set the following values to const 
@@ -1237,12 +1348,15 @@ AddH264DoviTrack(AP4_Movie&            movie,
     AP4_Result result = AP4_FileByteStream::Create(input_name, AP4_FileByteStream::STREAM_MODE_READ, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file '%s' (%d))\n", input_name, result);
-        return;
+        return result;
     }
 
     // check if we have a language parameter
     const char* language = GetLanguageFromParameters(parameters, "und");
-    if (!language) return;
+    if (!language) {
+        input->Release();
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
 
     // see if the frame rate is specified
     AP4_UI32 video_frame_rate = AP4_MUX_DEFAULT_VIDEO_FRAME_RATE*1000;
@@ -1252,7 +1366,7 @@ AddH264DoviTrack(AP4_Movie&            movie,
             if (frame_rate == 0.0) {
                 fprintf(stderr, "ERROR: invalid video frame rate %s\n", parameters[i].m_Value.GetChars());
                 input->Release();
-                return;
+                return AP4_ERROR_INVALID_PARAMETERS;
             }
             video_frame_rate = (unsigned int)(1000.0*frame_rate);
         } else if (parameters[i].m_Name == "format") {
@@ -1396,7 +1510,7 @@ AddH264DoviTrack(AP4_Movie&            movie,
     if (sps == NULL) {
         fprintf(stderr, "ERROR: no sequence parameter set found in video\n");
         input->Release();
-        return;
+        return AP4_ERROR_INVALID_FORMAT;
     }
     unsigned int video_width = 0;
     unsigned int video_height = 0;
@@ -1473,12 +1587,8 @@ AddH264DoviTrack(AP4_Movie&            movie,
         // create an 'edts' container
         AP4_ContainerAtom* new_edts = new AP4_ContainerAtom(AP4_ATOM_TYPE_EDTS);
         AP4_ElstAtom* new_elst = new AP4_ElstAtom();
-        AP4_UI64 duration = 0;
-        if (!movie.GetTimeScale()) {
-            duration = video_media_duration;
-        } else {
-            duration = AP4_ConvertTime(1000*sample_table->GetSampleCount(), media_timescale, movie.GetTimeScale());
-        }
+        // the duration is in the media timescale, it is converted when the track is added to the movie
+        AP4_UI64 duration = 1000*sample_table->GetSampleCount();
         AP4_ElstEntry new_elst_entry = AP4_ElstEntry(duration, max_delta*1000ULL, 1);
         new_elst->AddEntry(new_elst_entry);
         new_edts->AddChild(new_elst);
@@ -1490,18 +1600,20 @@ AddH264DoviTrack(AP4_Movie&            movie,
     // cleanup
     input->Release();
 
-    movie.AddTrack(track);
+    tracks.Append(track);
+
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
 |   AddH265Track
 +---------------------------------------------------------------------*/
-static void
-AddH265Track(AP4_Movie&            movie,
-             const char*           input_name,
-             AP4_Array<Parameter>& parameters,
-             AP4_Array<AP4_UI32>&  brands,
-             SampleFileStorage&    sample_storage)
+static AP4_Result
+AddH265Track(AP4_Array<AP4_Track*>& tracks,
+             const char*            input_name,
+             AP4_Array<Parameter>&  parameters,
+             AP4_Array<AP4_UI32>&   brands,
+             SampleFileStorage&     sample_storage)
 {
     unsigned int video_width = 0;
     unsigned int video_height = 0;
@@ -1511,12 +1623,15 @@ AddH265Track(AP4_Movie&            movie,
     AP4_Result result = AP4_FileByteStream::Create(input_name, AP4_FileByteStream::STREAM_MODE_READ, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file '%s' (%d))\n", input_name, result);
-        return;
+        return result;
     }
 
     // check if we have a language parameter
     const char* language = GetLanguageFromParameters(parameters, "und");
-    if (!language) return;
+    if (!language) {
+        input->Release();
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
 
     // see if the frame rate is specified
     unsigned int video_frame_rate = AP4_MUX_DEFAULT_VIDEO_FRAME_RATE*1000;
@@ -1526,7 +1641,7 @@ AddH265Track(AP4_Movie&            movie,
             if (frame_rate == 0.0) {
                 fprintf(stderr, "ERROR: invalid video frame rate %s\n", parameters[i].m_Value.GetChars());
                 input->Release();
-                return;
+                return AP4_ERROR_INVALID_PARAMETERS;
             }
             video_frame_rate = (unsigned int)(1000.0*frame_rate);
         } else if (parameters[i].m_Name == "format") {
@@ -1648,7 +1763,7 @@ AddH265Track(AP4_Movie&            movie,
     if (sps == NULL) {
         fprintf(stderr, "ERROR: no sequence parameter set found in video\n");
         input->Release();
-        return;
+        return AP4_ERROR_INVALID_FORMAT;
     }
     
     // collect parameters from the first SPS entry
@@ -1751,12 +1866,8 @@ AddH265Track(AP4_Movie&            movie,
         // create an 'edts' container
         AP4_ContainerAtom* new_edts = new AP4_ContainerAtom(AP4_ATOM_TYPE_EDTS);
         AP4_ElstAtom* new_elst = new AP4_ElstAtom();
-        AP4_UI64 duration = 0;
-        if (!movie.GetTimeScale()) {
-            duration = video_media_duration;
-        } else {
-            duration = AP4_ConvertTime(1000*sample_table->GetSampleCount(), media_timescale, movie.GetTimeScale());
-        }
+        // the duration is in the media timescale, it is converted when the track is added to the movie
+        AP4_UI64 duration = 1000*sample_table->GetSampleCount();
         AP4_ElstEntry new_elst_entry = AP4_ElstEntry(duration, max_delta*1000ULL, 1);
         new_elst->AddEntry(new_elst_entry);
         new_edts->AddChild(new_elst);
@@ -1768,18 +1879,20 @@ AddH265Track(AP4_Movie&            movie,
     // cleanup
     input->Release();
 
-    movie.AddTrack(track);
+    tracks.Append(track);
+
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
 |   AddH265DoviTrack
 +---------------------------------------------------------------------*/
-static void
-AddH265DoviTrack(AP4_Movie&           movie,
-                const char*           input_name,
-                AP4_Array<Parameter>& parameters,
-                AP4_Array<AP4_UI32>&  brands,
-                SampleFileStorage&    sample_storage)
+static AP4_Result
+AddH265DoviTrack(AP4_Array<AP4_Track*>& tracks,
+                 const char*            input_name,
+                 AP4_Array<Parameter>&  parameters,
+                 AP4_Array<AP4_UI32>&   brands,
+                 SampleFileStorage&     sample_storage)
 {
     AP4_UI32 video_width = 0;
     AP4_UI32 video_height = 0;
@@ -1802,12 +1915,15 @@ AddH265DoviTrack(AP4_Movie&           movie,
     AP4_Result result = AP4_FileByteStream::Create(input_name, AP4_FileByteStream::STREAM_MODE_READ, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file '%s' (%d))\n", input_name, result);
-        return;
+        return result;
     }
 
     // check if we have a language parameter
     const char* language = GetLanguageFromParameters(parameters, "und");
-    if (!language) return;
+    if (!language) {
+        input->Release();
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
 
     // see if the frame rate/format/dv_profile/dv_bc is specified
     unsigned int video_frame_rate = AP4_MUX_DEFAULT_VIDEO_FRAME_RATE*1000;
@@ -1817,7 +1933,7 @@ AddH265DoviTrack(AP4_Movie&           movie,
             if (frame_rate == 0.0) {
                 fprintf(stderr, "ERROR: invalid video frame rate %s\n", parameters[i].m_Value.GetChars());
                 input->Release();
-                return;
+                return AP4_ERROR_INVALID_PARAMETERS;
             }
             video_frame_rate = (unsigned int)(1000.0*frame_rate);
         } else if (parameters[i].m_Name == "format") {
@@ -1965,7 +2081,7 @@ AddH265DoviTrack(AP4_Movie&           movie,
     if (sps == NULL) {
         fprintf(stderr, "ERROR: no sequence parameter set found in video\n");
         input->Release();
-        return;
+        return AP4_ERROR_INVALID_FORMAT;
     }
     
     // collect parameters from the first SPS entry
@@ -2088,12 +2204,8 @@ AddH265DoviTrack(AP4_Movie&           movie,
         // create an 'edts' container
         AP4_ContainerAtom* new_edts = new AP4_ContainerAtom(AP4_ATOM_TYPE_EDTS);
         AP4_ElstAtom* new_elst = new AP4_ElstAtom();
-        AP4_UI64 duration = 0;
-        if (!movie.GetTimeScale()) {
-            duration = video_media_duration;
-        } else {
-            duration = AP4_ConvertTime(1000*sample_table->GetSampleCount(), media_timescale, movie.GetTimeScale());
-        }
+        // the duration is in the media timescale, it is converted when the track is added to the movie
+        AP4_UI64 duration = 1000*sample_table->GetSampleCount();
         AP4_ElstEntry new_elst_entry = AP4_ElstEntry(duration, max_delta*1000ULL, 1);
         new_elst->AddEntry(new_elst_entry);
         new_edts->AddChild(new_elst);
@@ -2112,17 +2224,19 @@ AddH265DoviTrack(AP4_Movie&           movie,
     // cleanup
     input->Release();
 
-    movie.AddTrack(track);
+    tracks.Append(track);
+
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
 |   AddMp4Tracks
 +---------------------------------------------------------------------*/
-static void
-AddMp4Tracks(AP4_Movie&            movie,
-             const char*           input_name,
-             AP4_Array<Parameter>& parameters,
-             AP4_Array<AP4_UI32>&  /*brands*/)
+static AP4_Result
+AddMp4Tracks(AP4_Array<AP4_Track*>& tracks,
+             const char*            input_name,
+             AP4_Array<Parameter>&  parameters,
+             AP4_Array<AP4_UI32>&   /*brands*/)
 {
     // open the input
     AP4_ByteStream* input_stream = NULL;
@@ -2131,14 +2245,17 @@ AddMp4Tracks(AP4_Movie&            movie,
                                                    input_stream);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file %s (%d)\n", input_name, result);
-        return;
+        return result;
     }
     
-    AP4_File file(*input_stream, true);
+    // use a private atom factory, since inputs may be parsed concurrently
+    AP4_DefaultAtomFactory atom_factory;
+    AP4_File file(*input_stream, atom_factory, true);
     input_stream->Release();
     AP4_Movie* input_movie = file.GetMovie();
     if (input_movie == NULL) {
-        return;
+        fprintf(stderr, "ERROR: no movie found in %s\n", input_name);
+        return AP4_ERROR_INVALID_FORMAT;
     }
 
     // check if we have a language parameter
@@ -2152,7 +2269,7 @@ AddMp4Tracks(AP4_Movie&            movie,
                 AP4_Track* track = input_movie->GetTrack(AP4_Track::TYPE_AUDIO);
                 if (track == NULL) {
                     fprintf(stderr, "ERROR: no audio track found in %s\n", input_name);
-                    return;
+                    return AP4_ERROR_NO_SUCH_ITEM;
                 } else {
                     track_id = track->GetId();
                 }
@@ -2160,15 +2277,15 @@ AddMp4Tracks(AP4_Movie&            movie,
                 AP4_Track* track = input_movie->GetTrack(AP4_Track::TYPE_VIDEO);
                 if (track == NULL) {
                     fprintf(stderr, "ERROR: no video track found in %s\n", input_name);
-                    return;
+                    return AP4_ERROR_NO_SUCH_ITEM;
                 } else {
                     track_id = track->GetId();
                 }
             } else {
                 track_id = (unsigned int)strtoul(parameters[i].m_Value.GetChars(), NULL, 10);
                 if (track_id == 0) {
-                    fprintf(stderr, "ERROR: invalid track ID specified");
-                    return;
+                    fprintf(stderr, "ERROR: invalid track ID specified\n");
+                    return AP4_ERROR_INVALID_PARAMETERS;
                 }
             }
         }
@@ -2196,10 +2313,299 @@ AddMp4Tracks(AP4_Movie&            movie,
                 track->SetTrackLanguage(language);
             }
 
-            movie.AddTrack(track);
+            tracks.Append(track);
         }
         track_item = track_item->GetNext();
     }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   WriteDirectOutputHeader
++---------------------------------------------------------------------*/
+static AP4_Result
+WriteDirectOutputHeader(AP4_ByteStream& output, AP4_Position& mdat_position)
+{
+    // reserve space for the 'ftyp' atom, since the brands are only known at the end
+    AP4_UI08 ftyp_space[AP4_MUX_DIRECT_FTYP_SPACE];
+    AP4_SetMemory(ftyp_space, 0, sizeof(ftyp_space));
+    AP4_Result result = output.Write(ftyp_space, sizeof(ftyp_space));
+    if (AP4_FAILED(result)) return result;
+
+    // start a large 'mdat' atom, the size will be updated at the end
+    mdat_position = AP4_MUX_DIRECT_FTYP_SPACE;
+    AP4_CHECK(output.WriteUI32(1));
+    AP4_CHECK(output.WriteUI32(AP4_ATOM_TYPE_MDAT));
+    return output.WriteUI64(0);
+}
+
+/*----------------------------------------------------------------------
+|   PromoteChunkOffsets
++---------------------------------------------------------------------*/
+static AP4_Result
+PromoteChunkOffsets(AP4_TrakAtom& trak, const AP4_Array<AP4_UI64>& chunk_offsets)
+{
+    // the 'stco' atom of a track must be replaced by a 'co64' atom when
+    // some of its chunks are past 4GB in the output
+    AP4_StcoAtom* stco = AP4_DYNAMIC_CAST(AP4_StcoAtom, trak.FindChild("mdia/minf/stbl/stco"));
+    AP4_ContainerAtom* stbl = AP4_DYNAMIC_CAST(AP4_ContainerAtom, trak.FindChild("mdia/minf/stbl"));
+    if (stco == NULL || stbl == NULL) return AP4_SUCCESS;
+    bool overflow = false;
+    for (unsigned int i=0; i<chunk_offsets.ItemCount(); i++) {
+        if (chunk_offsets[i] > 0xFFFFFFFF) {
+            overflow = true;
+            break;
+        }
+    }
+    if (!overflow) return AP4_SUCCESS;
+
+    AP4_Cardinal chunk_count = stco->GetChunkCount();
+    if (chunk_count > chunk_offsets.ItemCount()) return AP4_ERROR_OUT_OF_RANGE;
+    AP4_UI64* large_offsets = new AP4_UI64[chunk_count];
+    for (unsigned int i=0; i<chunk_count; i++) {
+        large_offsets[i] = chunk_offsets[i];
+    }
+    AP4_Co64Atom* co64 = new AP4_Co64Atom(large_offsets, chunk_count);
+    delete[] large_offsets;
+    int position = 0;
+    for (AP4_List<AP4_Atom>::Item* child = stbl->GetChildren().FirstItem();
+         child && child->GetData() != stco;
+         child = child->GetNext()) {
+        ++position;
+    }
+    stbl->RemoveChild(stco);
+    delete stco;
+    return stbl->AddChild(co64, position);
+}
+
+/*----------------------------------------------------------------------
+|   FinishDirectOutput
++---------------------------------------------------------------------*/
+static AP4_Result
+FinishDirectOutput(AP4_Movie&           movie,
+                   AP4_Array<AP4_UI32>& brands,
+                   AP4_ByteStream&      output,
+                   AP4_Position         mdat_position)
+{
+    // compute the chunk offsets of all the tracks from the position of their samples
+    // in the output, appending to the 'mdat' the samples that are stored elsewhere
+    // (tracks imported from MP4 files)
+    AP4_Array<AP4_Array<AP4_UI64>*> trak_chunk_offsets;
+    AP4_Result result = AP4_SUCCESS;
+    for (AP4_List<AP4_Track>::Item* track_item = movie.GetTracks().FirstItem();
+                                    track_item;
+                                    track_item = track_item->GetNext()) {
+        AP4_Track*           track = track_item->GetData();
+        AP4_Array<AP4_UI64>* chunk_offsets = new AP4_Array<AP4_UI64>();
+        trak_chunk_offsets.Append(chunk_offsets);
+        result = track->UseTrakAtom()->GetChunkOffsets(*chunk_offsets);
+        if (AP4_FAILED(result)) goto end;
+
+        AP4_Cardinal     sample_count = track->GetSampleCount();
+        AP4_SampleTable* sample_table = track->GetSampleTable();
+        AP4_Sample       sample;
+        AP4_DataBuffer   sample_data;
+        for (AP4_Ordinal i=0; i<sample_count; i++) {
+            AP4_Ordinal chunk_index = 0;
+            AP4_Ordinal position_in_chunk = 0;
+            sample_table->GetSampleChunkPosition(i, chunk_index, position_in_chunk);
+            result = track->GetSample(i, sample);
+            if (AP4_FAILED(result)) goto end;
+            AP4_Position    offset = sample.GetOffset();
+            AP4_ByteStream* sample_stream = sample.GetDataStream();
+            if (sample_stream != &output) {
+                result = track->ReadSample(i, sample, sample_data);
+                if (AP4_SUCCEEDED(result)) {
+                    output.Tell(offset);
+                    result = output.Write(sample_data.GetData(), sample_data.GetDataSize());
+                }
+            }
+            AP4_RELEASE(sample_stream);
+            if (AP4_FAILED(result)) goto end;
+            if (position_in_chunk == 0) {
+                if (chunk_index >= chunk_offsets->ItemCount()) {
+                    result = AP4_ERROR_INTERNAL;
+                    goto end;
+                }
+                (*chunk_offsets)[chunk_index] = offset;
+            }
+        }
+    }
+
+    {
+        // update the size of the 'mdat' atom
+        AP4_Position mdat_end = 0;
+        result = output.Tell(mdat_end);
+        if (AP4_SUCCEEDED(result)) result = output.Seek(mdat_position+8);
+        if (AP4_SUCCEEDED(result)) result = output.WriteUI64(mdat_end-mdat_position);
+        if (AP4_SUCCEEDED(result)) result = output.Seek(mdat_end);
+        if (AP4_FAILED(result)) goto end;
+
+        // update the chunk offsets (only now, since reading the samples of
+        // imported tracks depends on their original offsets) and write the 'moov' atom
+        unsigned int t = 0;
+        for (AP4_List<AP4_Track>::Item* track_item = movie.GetTracks().FirstItem();
+                                        track_item;
+                                        track_item = track_item->GetNext(), ++t) {
+            AP4_TrakAtom* trak = track_item->GetData()->UseTrakAtom();
+            result = PromoteChunkOffsets(*trak, *trak_chunk_offsets[t]);
+            if (AP4_SUCCEEDED(result)) result = trak->SetChunkOffsets(*trak_chunk_offsets[t]);
+            if (AP4_FAILED(result)) goto end;
+        }
+        result = movie.GetMoovAtom()->WriteBuffered(output);
+        if (AP4_FAILED(result)) goto end;
+
+        // write the 'ftyp' atom in the reserved space, followed by a 'free' atom
+        AP4_Cardinal brand_count = brands.ItemCount();
+        const AP4_Cardinal max_brand_count = (AP4_MUX_DIRECT_FTYP_SPACE-(AP4_ATOM_HEADER_SIZE+8)-AP4_ATOM_HEADER_SIZE)/4;
+        if (brand_count > max_brand_count) {
+            fprintf(stderr, "WARNING: too many compatible brands, only the first %d will be listed\n", max_brand_count);
+            brand_count = max_brand_count;
+        }
+        AP4_FtypAtom ftyp(AP4_FILE_BRAND_MP42, 1, &brands[0], brand_count);
+        result = output.Seek(0);
+        if (AP4_SUCCEEDED(result)) result = ftyp.Write(output);
+        if (AP4_SUCCEEDED(result)) result = output.WriteUI32((AP4_UI32)(AP4_MUX_DIRECT_FTYP_SPACE-ftyp.GetSize()));
+        if (AP4_SUCCEEDED(result)) result = output.WriteUI32(AP4_ATOM_TYPE_FREE);
+        if (AP4_SUCCEEDED(result)) result = output.Seek(mdat_end);
+    }
+
+end:
+    for (unsigned int i=0; i<trak_chunk_offsets.ItemCount(); i++) {
+        delete trak_chunk_offsets[i];
+    }
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   AdjustEditList
++---------------------------------------------------------------------*/
+static void
+AdjustEditList(AP4_Track& track, AP4_UI32 movie_timescale)
+{
+    // the edit lists of elementary stream tracks are created with durations
+    // in the media timescale, since the movie timescale is only known when
+    // the tracks are added to the movie
+    AP4_UI32 media_timescale = track.GetMediaTimeScale();
+    if (movie_timescale == 0 || movie_timescale == media_timescale) return;
+    AP4_ContainerAtom* edts = AP4_DYNAMIC_CAST(AP4_ContainerAtom, track.UseTrakAtom()->GetChild(AP4_ATOM_TYPE_EDTS));
+    if (edts == NULL) return;
+    AP4_ElstAtom* elst = AP4_DYNAMIC_CAST(AP4_ElstAtom, edts->GetChild(AP4_ATOM_TYPE_ELST));
+    if (elst == NULL) return;
+    AP4_ElstAtom* new_elst = new AP4_ElstAtom();
+    for (unsigned int i=0; i<elst->GetEntries().ItemCount(); i++) {
+        const AP4_ElstEntry& entry = elst->GetEntries()[i];
+        new_elst->AddEntry(AP4_ElstEntry(AP4_ConvertTime(entry.m_SegmentDuration, media_timescale, movie_timescale),
+                                         entry.m_MediaTime,
+                                         entry.m_MediaRate));
+    }
+    edts->RemoveChild(elst);
+    delete elst;
+    edts->AddChild(new_elst);
+}
+
+/*----------------------------------------------------------------------
+|   MuxInput
++---------------------------------------------------------------------*/
+class MuxInput : public AP4_Runnable
+{
+public:
+    MuxInput(const char* type, const char* name) :
+        m_Type(type),
+        m_Name(name),
+        m_IsDovi(false),
+        m_SampleStorage(NULL),
+        m_Result(AP4_SUCCESS) {}
+    ~MuxInput() {
+        for (unsigned int i=0; i<m_Tracks.ItemCount(); i++) {
+            delete m_Tracks[i];
+        }
+        delete m_SampleStorage;
+    }
+
+    // AP4_Runnable methods
+    void Run();
+
+    // members
+    const char*           m_Type;
+    const char*           m_Name;
+    AP4_Array<Parameter>  m_Parameters;
+    bool                  m_IsDovi;
+    SampleFileStorage*    m_SampleStorage;
+    AP4_Array<AP4_UI32>   m_Brands;
+    AP4_Array<AP4_Track*> m_Tracks;
+    AP4_Result            m_Result;
+};
+
+/*----------------------------------------------------------------------
+|   MuxInput::Run
++---------------------------------------------------------------------*/
+void
+MuxInput::Run()
+{
+    if (!strcmp(m_Type, "h264")) {
+        if (m_IsDovi) {
+            m_Result = AddH264DoviTrack(m_Tracks, m_Name, m_Parameters, m_Brands, *m_SampleStorage);
+        } else {
+            m_Result = AddH264Track(m_Tracks, m_Name, m_Parameters, m_Brands, *m_SampleStorage);
+        }
+    } else if (!strcmp(m_Type, "h265")) {
+        if (m_IsDovi) {
+            m_Result = AddH265DoviTrack(m_Tracks, m_Name, m_Parameters, m_Brands, *m_SampleStorage);
+        } else {
+            m_Result = AddH265Track(m_Tracks, m_Name, m_Parameters, m_Brands, *m_SampleStorage);
+        }
+    } else if (!strcmp(m_Type, "aac")) {
+        m_Result = AddAacTrack(m_Tracks, m_Name, m_Parameters, *m_SampleStorage);
+    } else if (!strcmp(m_Type, "ac3")) {
+        m_Result = AddAc3Track(m_Tracks, m_Name, m_Parameters, *m_SampleStorage);
+    } else if (!strcmp(m_Type, "ec3")) {
+        m_Result = AddEac3Track(m_Tracks, m_Name, m_Parameters, *m_SampleStorage);
+    } else if (!strcmp(m_Type, "ac4")) {
+        m_Result = AddAc4Track(m_Tracks, m_Name, m_Parameters, *m_SampleStorage);
+    } else if (!strcmp(m_Type, "mp4")) {
+        m_Result = AddMp4Tracks(m_Tracks, m_Name, m_Parameters, m_Brands);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   MuxInputQueue
++---------------------------------------------------------------------*/
+class MuxInputQueue : public AP4_Runnable
+{
+public:
+    MuxInputQueue(AP4_Array<MuxInput*>& inputs) : m_Inputs(inputs), m_Next(0) {}
+
+    // AP4_Runnable methods, called by each thread to process inputs until there are none left
+    void Run() {
+        for (;;) {
+            AP4_Ordinal next;
+            {
+                AP4_AutoLock lock(m_Lock);
+                next = m_Next++;
+            }
+            if (next >= m_Inputs.ItemCount()) break;
+            m_Inputs[next]->Run();
+        }
+    }
+
+private:
+    AP4_Array<MuxInput*>& m_Inputs;
+    AP4_Ordinal           m_Next;
+    AP4_Mutex             m_Lock;
+};
+
+/*----------------------------------------------------------------------
+|   DeleteInputs
++---------------------------------------------------------------------*/
+static void
+DeleteInputs(AP4_Array<MuxInput*>& inputs)
+{
+    for (unsigned int i=0; i<inputs.ItemCount(); i++) {
+        delete inputs[i];
+    }
+    inputs.Clear();
 }
 
 /*----------------------------------------------------------------------
@@ -2213,12 +2619,44 @@ main(int argc, char** argv)
     }
     Options.verbose = false;
     
-    const char* output_filename = NULL;
+    const char*  output_filename = NULL;
+    bool         direct = false;
+    unsigned int thread_count = 0;
+    unsigned int chunk_duration = AP4_FILE_WRITER_DEFAULT_CHUNK_DURATION;
+    AP4_Size     spill_threshold = AP4_MUX_DEFAULT_SPILL_THRESHOLD*1024*1024;
     AP4_Array<char*> input_names;
     
     while (char* arg = *++argv) {
         if (!strcmp(arg, "--verbose")) {
             Options.verbose = true;
+        } else if (!strcmp(arg, "--spill-threshold")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --spill-threshold option\n");
+                return 1;
+            }
+            unsigned long megabytes = strtoul(arg, NULL, 10);
+            if (megabytes >= 4096) {
+                fprintf(stderr, "ERROR: --spill-threshold must be less than 4096\n");
+                return 1;
+            }
+            spill_threshold = (AP4_Size)(megabytes*1024*1024);
+        } else if (!strcmp(arg, "--threads")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --threads option\n");
+                return 1;
+            }
+            thread_count = (unsigned int)strtoul(arg, NULL, 10);
+        } else if (!strcmp(arg, "--chunk-duration")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --chunk-duration option\n");
+                return 1;
+            }
+            chunk_duration = (unsigned int)strtoul(arg, NULL, 10);
+        } else if (!strcmp(arg, "--direct")) {
+            direct = true;
         } else if (!strcmp(arg, "--track")) {
             input_names.Append(*++argv);
         } else if (output_filename == NULL) {
@@ -2252,15 +2690,26 @@ main(int argc, char** argv)
     brands.Append(AP4_FILE_BRAND_ISOM);
     brands.Append(AP4_FILE_BRAND_MP42);
 
-    // create a temp file to store the sample data
-    SampleFileStorage* sample_storage = NULL;
-    AP4_Result result = SampleFileStorage::Create(output_filename, sample_storage);
-    if (AP4_FAILED(result)) {
-        fprintf(stderr, "ERROR: failed to create temporary sample data storage (%d)\n", result);
-        return 1;
+    // in direct mode, the sample data is stored in the output
+    AP4_ByteStream* output = NULL;
+    AP4_Position    mdat_position = 0;
+    AP4_Result      result;
+    if (direct) {
+        result = AP4_FileByteStream::Create(output_filename, AP4_FileByteStream::STREAM_MODE_WRITE, output);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot open output '%s' (%d)\n", output_filename, result);
+            return 1;
+        }
+        result = WriteDirectOutputHeader(*output, mdat_position);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: failed to write to output (%d)\n", result);
+            output->Release();
+            return 1;
+        }
     }
     
-    // add all the tracks
+    // setup all the inputs
+    AP4_Array<MuxInput*> inputs;
     bool hasDovi = false;
     AP4_UI08 dolby_vision_ccid = 0;
     for (unsigned int i=0; i<input_names.ItemCount(); i++) {
@@ -2305,13 +2754,28 @@ main(int argc, char** argv)
                 }
             } else {
                 fprintf(stderr, "ERROR: unable to determine type for input '%s'\n", input_name);
-                delete sample_storage;
+                DeleteInputs(inputs);
+                if (output) output->Release();
                 return 1;
             }
         }
+        if (strcmp(input_type, "h264") &&
+            strcmp(input_type, "h265") &&
+            strcmp(input_type, "aac")  &&
+            strcmp(input_type, "ac3")  &&
+            strcmp(input_type, "ec3")  &&
+            strcmp(input_type, "ac4")  &&
+            strcmp(input_type, "mp4")) {
+            fprintf(stderr, "ERROR: unsupported input type '%s'\n", input_type);
+            DeleteInputs(inputs);
+            if (output) output->Release();
+            return 1;
+        }
+        MuxInput* input = new MuxInput(input_type, input_name);
+        inputs.Append(input);
         
         // parse parameters
-        AP4_Array<Parameter> parameters;
+        AP4_Array<Parameter>& parameters = input->m_Parameters;
         if (input_params) {
             ParseParameters(input_params, parameters);
         }
@@ -2332,49 +2796,101 @@ main(int argc, char** argv)
             }
         }
 
-        if (!strcmp(input_type, "h264")) {
-            if (isDovi) {
-                if (CheckDoviInputParameters(parameters) != AP4_SUCCESS) {
-                    fprintf(stderr, "ERROR: dolby vision input parameter error\n");
-                    delete sample_storage;
-                    return 1;
-                } else {
-                    AddH264DoviTrack(*movie, input_name, parameters, brands, *sample_storage);
-                    hasDovi = true;
-                }
-            } else {
-                AddH264Track(*movie, input_name, parameters, brands, *sample_storage);
+        if (isDovi && (!strcmp(input_type, "h264") || !strcmp(input_type, "h265"))) {
+            if (CheckDoviInputParameters(parameters) != AP4_SUCCESS) {
+                fprintf(stderr, "ERROR: dolby vision input parameter error\n");
+                DeleteInputs(inputs);
+                if (output) output->Release();
+                return 1;
             }
-        } else if (!strcmp(input_type, "h265")) {
-            if (isDovi) {
-                if (CheckDoviInputParameters(parameters) != AP4_SUCCESS) {
-                    fprintf(stderr, "ERROR: dolby vision input parameter error\n");
-                    delete sample_storage;
-                    return 1;
-                } else {
-                    AddH265DoviTrack(*movie, input_name, parameters, brands, *sample_storage);
-                    hasDovi = true;
-                }
+            input->m_IsDovi = true;
+            hasDovi = true;
+        }
+    }
+
+    // create the storage for the sample data of each input: either the output,
+    // in direct mode, or a memory store (spilling to a temp file), all the
+    // memory stores sharing the same budget
+    AP4_SpillBudget memory_budget(spill_threshold);
+    for (unsigned int i=0; i<inputs.ItemCount(); i++) {
+        if (!strcmp(inputs[i]->m_Type, "mp4")) continue;
+        if (direct) {
+            inputs[i]->m_SampleStorage = new SampleFileStorage(*output);
+        } else {
+            char basename[1024];
+            if (inputs.ItemCount() == 1) {
+                AP4_FormatString(basename, sizeof(basename), "%s", output_filename);
             } else {
-                AddH265Track(*movie, input_name, parameters, brands, *sample_storage);
+                AP4_FormatString(basename, sizeof(basename), "%s_%d", output_filename, i);
             }
-        } else if (!strcmp(input_type, "aac")) {
-            AddAacTrack(*movie, input_name, parameters, *sample_storage);
-        } else if (!strcmp(input_type, "ac3")) {
-            AddAc3Track(*movie, input_name, parameters, *sample_storage);
-        } else if (!strcmp(input_type, "ec3")) {
-            AddEac3Track(*movie, input_name, parameters, *sample_storage);
-        } else if (!strcmp(input_type, "ac4")) {
-            AddAc4Track(*movie, input_name, parameters, *sample_storage);
-        } else if (!strcmp(input_type, "mp4")) {
-            AddMp4Tracks(*movie, input_name, parameters, brands);
-        } else {
-            fprintf(stderr, "ERROR: unsupported input type '%s'\n", input_type);
-            delete sample_storage;
+            result = SampleFileStorage::Create(basename,
+                                               spill_threshold,
+                                               &memory_budget,
+                                               inputs[i]->m_SampleStorage);
+            if (AP4_FAILED(result)) {
+                fprintf(stderr, "ERROR: failed to create temporary sample data storage (%d)\n", result);
+                DeleteInputs(inputs);
+                return 1;
+            }
+        }
+    }
+
+    // parse the inputs, concurrently unless they are all written to the output
+    if (direct) {
+        if (thread_count > 1) {
+            fprintf(stderr, "WARNING: --direct writes the inputs to the output one at a time, ignoring --threads\n");
+        }
+        thread_count = 1;
+    }
+    if (thread_count == 0) {
+        thread_count = AP4_Thread::GetProcessorCount();
+    }
+    if (thread_count > inputs.ItemCount()) {
+        thread_count = inputs.ItemCount();
+    }
+    {
+        MuxInputQueue queue(inputs);
+        AP4_Array<AP4_Thread*> threads;
+        for (unsigned int i=1; i<thread_count; i++) {
+            AP4_Thread* thread = new AP4_Thread(queue);
+            if (AP4_FAILED(thread->Start())) {
+                delete thread;
+                break;
+            }
+            threads.Append(thread);
+        }
+        queue.Run();
+        for (unsigned int i=0; i<threads.ItemCount(); i++) {
+            delete threads[i]; // waits for the thread to finish
+        }
+    }
+
+    // fail if any of the inputs could not be parsed
+    for (unsigned int i=0; i<inputs.ItemCount(); i++) {
+        if (AP4_FAILED(inputs[i]->m_Result)) {
+            delete movie;
+            DeleteInputs(inputs);
+            if (output) output->Release();
             return 1;
         }
     }
 
+    // add all the tracks to the movie, in the order of the inputs
+    for (unsigned int i=0; i<inputs.ItemCount(); i++) {
+        MuxInput* input = inputs[i];
+        for (unsigned int j=0; j<input->m_Brands.ItemCount(); j++) {
+            brands.Append(input->m_Brands[j]);
+        }
+        for (unsigned int j=0; j<input->m_Tracks.ItemCount(); j++) {
+            AP4_Track* track = input->m_Tracks[j];
+            if (strcmp(input->m_Type, "mp4")) {
+                AdjustEditList(*track, movie->GetTimeScale() ? movie->GetTimeScale() : track->GetMediaTimeScale());
+            }
+            movie->AddTrack(track);
+        }
+        input->m_Tracks.Clear();
+    }
+
     // for Dolby Vision, add the 'dby1' brand
     if (hasDovi) {
         brands.Append(AP4_FILE_BRAND_DBY1);
@@ -2389,12 +2905,24 @@ main(int argc, char** argv)
 
     movie->GetMvhdAtom()->SetNextTrackId(movie->GetTracks().ItemCount() + 1);
 
+    // in direct mode, complete the output
+    if (direct) {
+        result = FinishDirectOutput(*movie, brands, *output, mdat_position);
+        delete movie;
+        DeleteInputs(inputs);
+        output->Release();
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: failed to write to output (%d)\n", result);
+            return 1;
+        }
+        return 0;
+    }
+
     // open the output
-    AP4_ByteStream* output = NULL;
     result = AP4_FileByteStream::Create(output_filename, AP4_FileByteStream::STREAM_MODE_WRITE, output);
     if (AP4_FAILED(result)) {
         AP4_Debug("ERROR: cannot open output '%s' (%d)\n", output_filename, result);
-        delete sample_storage;
+        DeleteInputs(inputs);
         return 1;
     }
     
@@ -2406,12 +2934,19 @@ main(int argc, char** argv)
         file.SetFileType(AP4_FILE_BRAND_MP42, 1, &brands[0], brands.ItemCount());
 
         // write the file to the output
-        AP4_FileWriter::Write(file, *output);
+        if (chunk_duration) {
+            result = AP4_FileWriter::Write(file, *output, AP4_FileWriter::INTERLEAVING_TIME, chunk_duration);
+        } else {
+            result = AP4_FileWriter::Write(file, *output);
+        }
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: failed to write to output (%d)\n", result);
+        }
     }
     
     // cleanup
-    delete sample_storage;
+    DeleteInputs(inputs);
     output->Release();
     
-    return 0;
+    return AP4_SUCCEEDED(result) ? 0 : 1;
 }
@@ -0,0 +1,303 @@
+/*****************************************************************
+|
+|    AP4 - MP4 Sample Hash Index
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "MP4 Sample Hash Index - Version 1.0.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2017 Axiomatic Systems, LLC"
+
+const unsigned int MP4_SAMPLE_HASH_MAX_REPORTED_SAMPLES = 20;
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr,
+            BANNER
+            "\n\nusage: mp4samplehash [options] <input>\n"
+            "  Compute the hashes of the samples of <input>, to save them or to find\n"
+            "  out which samples have changed since they were saved.\n"
+            "  options:\n"
+            "    --output <file>: save the hashes in a sidecar file\n"
+            "    --embed: save the hashes in a uuid atom in the moov atom of <input>\n"
+            "      (the moov atom is updated in place, the media data is not rewritten;\n"
+            "      the hashes take 8 bytes per sample in the moov atom, which is moved\n"
+            "      to the end of the file when it no longer fits in place)\n"
+            "    --verify <file>: compare the hashes with those saved in a sidecar file\n"
+            "    --verify-embedded: compare the hashes with those saved in <input>\n"
+            "  (the exit code is 1 when verifying and some samples have changed)\n"
+            );
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   RemoveEmbeddedIndex
++---------------------------------------------------------------------*/
+static void
+RemoveEmbeddedIndex(AP4_AtomParent& parent)
+{
+    AP4_List<AP4_Atom>::Item* item = parent.GetChildren().FirstItem();
+    while (item) {
+        AP4_Atom* atom = item->GetData();
+        item = item->GetNext();
+        AP4_UuidAtom* uuid = AP4_DYNAMIC_CAST(AP4_UuidAtom, atom);
+        if (uuid && AP4_CompareMemory(uuid->GetUuid(), AP4_SAMPLE_HASH_INDEX_UUID, 16) == 0) {
+            parent.RemoveChild(atom);
+            delete atom;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------
+|   CompareTrack
++---------------------------------------------------------------------*/
+static AP4_Result
+CompareTrack(const AP4_SampleHashIndex& saved,
+             const AP4_SampleHashIndex& current,
+             AP4_UI32                   track_id,
+             unsigned int&              change_count)
+{
+    AP4_Array<AP4_Ordinal> changed;
+    AP4_Result result = current.Compare(saved, track_id, changed);
+    if (AP4_FAILED(result)) return result;
+    if (changed.ItemCount() == 0) {
+        printf("track %d: %d samples, unchanged\n", track_id, current.GetSampleCount(track_id));
+        return AP4_SUCCESS;
+    }
+
+    printf("track %d: %d samples changed (%d samples now, %d saved)\n",
+           track_id,
+           changed.ItemCount(),
+           current.GetSampleCount(track_id),
+           saved.GetSampleCount(track_id));
+    for (unsigned int i=0; i<changed.ItemCount(); i++) {
+        if (i == MP4_SAMPLE_HASH_MAX_REPORTED_SAMPLES) {
+            printf("  ...\n");
+            break;
+        }
+        printf("  sample %d\n", changed[i]);
+    }
+    change_count += changed.ItemCount();
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   Verify
++---------------------------------------------------------------------*/
+static int
+Verify(const AP4_SampleHashIndex& saved, const AP4_SampleHashIndex& current)
+{
+    unsigned int change_count = 0;
+    for (unsigned int i=0; i<current.GetTrackCount(); i++) {
+        AP4_Result result = CompareTrack(saved, current, current.GetTrackId(i), change_count);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: failed to compare the hashes (%d)\n", result);
+            return 1;
+        }
+    }
+    // tracks that have been removed
+    for (unsigned int i=0; i<saved.GetTrackCount(); i++) {
+        AP4_UI32 track_id = saved.GetTrackId(i);
+        if (current.GetSampleCount(track_id) == 0 && saved.GetSampleCount(track_id)) {
+            printf("track %d: removed\n", track_id);
+            ++change_count;
+        }
+    }
+
+    return change_count ? 1 : 0;
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        PrintUsageAndExit();
+    }
+    const char* input_filename  = NULL;
+    const char* output_filename = NULL;
+    const char* verify_filename = NULL;
+    bool        embed           = false;
+    bool        verify_embedded = false;
+
+    ++argv;
+    while (char* arg = *argv++) {
+        if (!strcmp(arg, "--output")) {
+            output_filename = *argv++;
+            if (output_filename == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --output option\n");
+                return 1;
+            }
+        } else if (!strcmp(arg, "--verify")) {
+            verify_filename = *argv++;
+            if (verify_filename == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --verify option\n");
+                return 1;
+            }
+        } else if (!strcmp(arg, "--embed")) {
+            embed = true;
+        } else if (!strcmp(arg, "--verify-embedded")) {
+            verify_embedded = true;
+        } else if (input_filename == NULL) {
+            input_filename = arg;
+        } else {
+            fprintf(stderr, "ERROR: unexpected argument '%s'\n", arg);
+            return 1;
+        }
+    }
+    if (input_filename == NULL) {
+        fprintf(stderr, "ERROR: input filename missing\n");
+        return 1;
+    }
+    if (verify_filename && verify_embedded) {
+        fprintf(stderr, "ERROR: --verify and --verify-embedded cannot be used together\n");
+        return 1;
+    }
+
+    AP4_ByteStream* input = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(input_filename,
+                                                   embed ?
+                                                   AP4_FileByteStream::STREAM_MODE_READ_WRITE :
+                                                   AP4_FileByteStream::STREAM_MODE_READ,
+                                                   input);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open input file %s (%d)\n", input_filename, result);
+        return 1;
+    }
+
+    AP4_File* file = new AP4_File(*input, true);
+    AP4_Movie* movie = file->GetMovie();
+    if (movie == NULL) {
+        fprintf(stderr, "ERROR: no movie found in the file\n");
+        delete file;
+        input->Release();
+        return 1;
+    }
+
+    // load the saved hashes before the moov atom may be updated
+    AP4_SampleHashIndex* saved = NULL;
+    if (verify_filename) {
+        AP4_ByteStream* saved_stream = NULL;
+        result = AP4_FileByteStream::Create(verify_filename,
+                                            AP4_FileByteStream::STREAM_MODE_READ,
+                                            saved_stream);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot open hash file %s (%d)\n", verify_filename, result);
+            delete file;
+            input->Release();
+            return 1;
+        }
+        result = AP4_SampleHashIndex::Load(*saved_stream, saved);
+        saved_stream->Release();
+    } else if (verify_embedded) {
+        result = AP4_SampleHashIndex::Load(*movie->GetMoovAtom(), saved);
+    }
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot load the saved hashes (%d:%s)\n", result, AP4_ResultText(result));
+        delete file;
+        input->Release();
+        return 1;
+    }
+
+    AP4_SampleHashIndex* index = NULL;
+    result = AP4_SampleHashIndex::Create(*movie, *input, index);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: failed to compute the hashes (%d:%s)\n", result, AP4_ResultText(result));
+        delete saved;
+        delete file;
+        input->Release();
+        return 1;
+    }
+
+    int exit_code = 0;
+    if (saved) {
+        exit_code = Verify(*saved, *index);
+    }
+
+    if (output_filename) {
+        AP4_ByteStream* output = NULL;
+        result = AP4_FileByteStream::Create(output_filename,
+                                            AP4_FileByteStream::STREAM_MODE_WRITE,
+                                            output);
+        if (AP4_SUCCEEDED(result)) {
+            result = index->Write(*output);
+            output->Release();
+        }
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot write hash file %s (%d)\n", output_filename, result);
+            exit_code = 1;
+        }
+    }
+
+    if (embed) {
+        AP4_MoovAtom* moov = movie->GetMoovAtom();
+        AP4_Atom* atom = NULL;
+        result = index->CreateAtom(atom);
+        if (AP4_SUCCEEDED(result)) {
+            RemoveEmbeddedIndex(*moov);
+            moov->AddChild(atom);
+            AP4_MoovUpdater::Method method = AP4_MoovUpdater::METHOD_IN_PLACE;
+            result = AP4_MoovUpdater::Update(*input, *moov, 0, &method);
+            if (AP4_SUCCEEDED(result)                          &&
+                method == AP4_MoovUpdater::METHOD_MOVED_TO_END &&
+                file->IsMoovBeforeMdat()) {
+                fprintf(stderr, "WARNING: the moov atom did not fit in place and was moved to the end of the file,\n"
+                                "after the media data (use mp4faststart to move it back)\n");
+            }
+        }
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: failed to update the moov atom (%d:%s)\n", result, AP4_ResultText(result));
+            if (result == AP4_ERROR_NOT_SUPPORTED) {
+                fprintf(stderr, "(there is not enough free space after the moov atom, use --output instead)\n");
+            }
+            exit_code = 1;
+        }
+    }
+
+    delete index;
+    delete saved;
+    delete file;
+    input->Release();
+
+    return exit_code;
+}
@@ -0,0 +1,207 @@
+/*****************************************************************
+|
+|    AP4 - MP4 Segment Indexer
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "MP4 Segment Index - Version 1.0.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2017 Axiomatic Systems, LLC"
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr,
+            BANNER
+            "\n\nusage: mp4segmentindex [options] <input> [<output>]\n"
+            "  <input> is either a fragmented MP4 file, from which an index is built\n"
+            "  and written to <output>, or a previously built index file.\n"
+            "  options:\n"
+            "    --track <id>: ID of the track to index (default: first track)\n"
+            "    --list: print the index entries\n"
+            "    --lookup <time>: print the byte range of the segment containing\n"
+            "      <time> (in seconds)\n"
+            );
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        PrintUsageAndExit();
+    }
+    const char*  input_filename  = NULL;
+    const char*  output_filename = NULL;
+    unsigned int track_id = 0;
+    bool         list = false;
+    bool         lookup = false;
+    double       lookup_time = 0.0;
+
+    ++argv;
+    while (char* arg = *argv++) {
+        if (!strcmp(arg, "--track")) {
+            arg = *argv++;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --track option\n");
+                return 1;
+            }
+            track_id = (unsigned int)strtoul(arg, NULL, 10);
+        } else if (!strcmp(arg, "--list")) {
+            list = true;
+        } else if (!strcmp(arg, "--lookup")) {
+            arg = *argv++;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --lookup option\n");
+                return 1;
+            }
+            lookup = true;
+            lookup_time = strtod(arg, NULL);
+        } else if (input_filename == NULL) {
+            input_filename = arg;
+        } else if (output_filename == NULL) {
+            output_filename = arg;
+        } else {
+            fprintf(stderr, "ERROR: unexpected argument '%s'\n", arg);
+            return 1;
+        }
+    }
+    if (input_filename == NULL) {
+        fprintf(stderr, "ERROR: input filename missing\n");
+        return 1;
+    }
+
+    AP4_ByteStream* input = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(input_filename,
+                                                   AP4_FileByteStream::STREAM_MODE_READ,
+                                                   input);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open input file %s (%d)\n", input_filename, result);
+        return 1;
+    }
+
+    // load the index, or build it if the input is not an index file
+    AP4_SegmentIndex* index = NULL;
+    AP4_UI32 magic = 0;
+    input->ReadUI32(magic);
+    input->Seek(0);
+    if (magic == AP4_SEGMENT_INDEX_MAGIC) {
+        result = AP4_SegmentIndex::Load(*input, index);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot load index (%d)\n", result);
+        }
+    } else {
+        result = AP4_SegmentIndex::Create(*input, track_id, index);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot index input file (%d)\n", result);
+        }
+    }
+    input->Release();
+    if (AP4_FAILED(result)) return 1;
+
+    // write the index
+    if (output_filename) {
+        AP4_ByteStream* output = NULL;
+        result = AP4_FileByteStream::Create(output_filename,
+                                            AP4_FileByteStream::STREAM_MODE_WRITE,
+                                            output);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot open output file %s (%d)\n", output_filename, result);
+            delete index;
+            return 1;
+        }
+        result = index->Write(*output);
+        output->Release();
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot write index (%d)\n", result);
+            delete index;
+            return 1;
+        }
+    }
+
+    // print the index
+    if (list || (output_filename == NULL && !lookup)) {
+        printf("track ID: %u, timescale: %u, init: %llu@%llu, entries: %u\n",
+               index->GetTrackId(),
+               index->GetTimeScale(),
+               (unsigned long long)index->GetInitSize(),
+               (unsigned long long)index->GetInitOffset(),
+               index->GetEntryCount());
+        if (list) {
+            for (unsigned int i=0; i<index->GetEntryCount(); i++) {
+                AP4_SegmentIndex::Entry entry;
+                index->GetEntry(i, entry);
+                printf("[%u] time=%llu, duration=%llu, range=%llu@%llu\n",
+                       i,
+                       (unsigned long long)entry.m_StartTime,
+                       (unsigned long long)entry.m_Duration,
+                       (unsigned long long)entry.m_Size,
+                       (unsigned long long)entry.m_Offset);
+            }
+        }
+    }
+
+    // lookup a segment
+    if (lookup) {
+        AP4_Ordinal entry_index = 0;
+        AP4_UI64 time = (AP4_UI64)(lookup_time*(double)index->GetTimeScale());
+        result = index->FindEntry(time, entry_index);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: no segment at time %f\n", lookup_time);
+        } else {
+            AP4_SegmentIndex::Entry entry;
+            index->GetEntry(entry_index, entry);
+            printf("segment %u: time=%llu, duration=%llu, init=%llu@%llu, range=%llu@%llu\n",
+                   entry_index,
+                   (unsigned long long)entry.m_StartTime,
+                   (unsigned long long)entry.m_Duration,
+                   (unsigned long long)index->GetInitSize(),
+                   (unsigned long long)index->GetInitOffset(),
+                   (unsigned long long)entry.m_Size,
+                   (unsigned long long)entry.m_Offset);
+        }
+    }
+
+    delete index;
+
+    return AP4_SUCCEEDED(result) ? 0 : 1;
+}
@@ -86,6 +86,8 @@ static struct {
     AP4_List<Command> commands;
     bool              need_input;
     bool              need_output;
+    bool              in_place;
+    AP4_Size          padding;
 } Options;
 
 static const int LINE_WIDTH = 79;
@@ -99,6 +101,13 @@ PrintUsageAndExit()
     fprintf(stderr, 
             BANNER 
             "\n\nusage: mp4tag [options] [commands...] <input> [<output>]\n"
+            "options:\n"
+            "  --in-place        modify the input file instead of writing an output file\n"
+            "                    (only the moov atom is rewritten: in place if it fits in\n"
+            "                    its current space and the free atoms next to it, or at\n"
+            "                    the end of the file otherwise)\n"
+            "  --padding <n>     reserve <n> bytes of free space after the moov atom, for\n"
+            "                    future in-place edits\n"
             "commands:\n"
             "  --help            print this usage information\n"
             "  --show-tags       show tags found in the input file\n"
@@ -152,6 +161,14 @@ ParseCommandLine(int argc, char** argv)
     for (int i=0; i<argc; i++) {
         if (AP4_CompareStrings("--help", argv[i]) == 0) {
         PrintUsageAndExit();
+        } else if (AP4_CompareStrings("--in-place", argv[i]) == 0) {
+            Options.in_place = true;
+        } else if (AP4_CompareStrings("--padding", argv[i]) == 0) {
+            if (i == argc-1) {
+                fprintf(stderr, "ERROR: missing argument after --padding option\n");
+                PrintUsageAndExit();
+            }
+            Options.padding = (AP4_Size)strtoul(argv[++i], NULL, 10);
         } else if (AP4_CompareStrings("--show-tags", argv[i]) == 0) {
             Options.commands.Add(new Command(Command::TYPE_SHOW_TAGS));
             Options.need_input = true;
@@ -778,6 +795,8 @@ main(int argc, char** argv)
     Options.output_filename = NULL;
     Options.need_input      = false;
     Options.need_output     = false;
+    Options.in_place        = false;
+    Options.padding         = 0;
 
     // parse command line
     ParseCommandLine(argc-1, argv+1);
@@ -794,7 +813,12 @@ main(int argc, char** argv)
             PrintUsageAndExit();
         }
     }
-    if (Options.need_output) {
+    if (Options.need_output && Options.in_place) {
+        if (Options.output_filename != NULL) {
+            fprintf(stderr, "ERROR: unexpected output file name with --in-place\n");
+            PrintUsageAndExit();
+        }
+    } else if (Options.need_output) {
         if (Options.output_filename == NULL) {
             fprintf(stderr, "ERROR: output file name missing\n");
             PrintUsageAndExit();
@@ -813,7 +837,11 @@ main(int argc, char** argv)
     AP4_LargeSize   moov_size = 0;
     AP4_Result      result    = AP4_SUCCESS;
     if (Options.need_input) {
-        result =AP4_FileByteStream::Create(Options.input_filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+        result =AP4_FileByteStream::Create(Options.input_filename,
+                                           Options.in_place && Options.need_output ?
+                                           AP4_FileByteStream::STREAM_MODE_READ_WRITE :
+                                           AP4_FileByteStream::STREAM_MODE_READ,
+                                           input);
         if (AP4_FAILED(result)) {
             fprintf(stderr, "ERROR: cannot open input file\n");
             return 1;
@@ -831,7 +859,7 @@ main(int argc, char** argv)
     }
 
     AP4_ByteStream* output = NULL;
-    if (Options.need_output) {
+    if (Options.need_output && !Options.in_place) {
         result = AP4_FileByteStream::Create(Options.output_filename, AP4_FileByteStream::STREAM_MODE_WRITE, output);
         if (AP4_FAILED(result)) {
             fprintf(stderr, "ERROR: cannot open output file for writing\n");
@@ -879,11 +907,46 @@ main(int argc, char** argv)
         if (AP4_FAILED(result)) goto end;
     }
 
-    if (output) {
+    if (Options.need_output && Options.in_place) {
+        // only rewrite the moov atom, the media data does not move
+        if (moov == NULL) {
+            fprintf(stderr, "ERROR: no moov atom found in the input file\n");
+            result = AP4_ERROR_INVALID_FORMAT;
+            goto end;
+        }
+        AP4_MoovUpdater::Method method = AP4_MoovUpdater::METHOD_IN_PLACE;
+        result = AP4_MoovUpdater::Update(*input, *moov, Options.padding, &method);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot update the file in place (%d:%s)\n",
+                    result, AP4_ResultText(result));
+        } else if (method == AP4_MoovUpdater::METHOD_MOVED_TO_END) {
+            fprintf(stderr, "WARNING: the moov atom did not fit in place and was moved to the end of the file\n");
+        }
+    } else if (output) {
+        // reserve some free space after the moov atom for future in-place edits
+        AP4_LargeSize padding_size = 0;
+        if (moov && Options.padding) {
+            AP4_List<AP4_Atom>::Item* moov_item = file->GetTopLevelAtoms().FirstItem();
+            while (moov_item && moov_item->GetData() != moov) {
+                moov_item = moov_item->GetNext();
+            }
+            if (moov_item) {
+                AP4_DataBuffer zeros(Options.padding);
+                zeros.SetDataSize(Options.padding);
+                AP4_SetMemory(zeros.UseData(), 0, Options.padding);
+                AP4_Atom* padding = new AP4_UnknownAtom(AP4_ATOM_TYPE_FREE,
+                                                        zeros.GetData(),
+                                                        Options.padding < AP4_ATOM_HEADER_SIZE ?
+                                                        0 : Options.padding-AP4_ATOM_HEADER_SIZE);
+                file->GetTopLevelAtoms().Insert(moov_item, padding);
+                padding_size = padding->GetSize();
+            }
+        }
+
         // adjust the chunk offsets if the moov is before the mdat
         if (moov && file->IsMoovBeforeMdat()) {
             AP4_LargeSize new_moov_size = moov->GetSize();
-            AP4_SI64 size_diff = new_moov_size-moov_size;
+            AP4_SI64 size_diff = new_moov_size+padding_size-moov_size;
             if (size_diff) {
                 moov->AdjustChunkOffsets(size_diff);
             }
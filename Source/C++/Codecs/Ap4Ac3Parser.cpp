@@ -330,3 +330,59 @@ AP4_Ac3Parser::GetBytesAvailable()
 {
     return (m_Bits.GetBytesAvailable());
 }
+
+/*----------------------------------------------------------------------+
+ |    AP4_Ac3Parser::FindFrameSpan
+ +----------------------------------------------------------------------*/
+AP4_Result
+AP4_Ac3Parser::FindFrameSpan(const AP4_UI08*   data,
+                             AP4_Size          data_size,
+                             AP4_Size&         bytes_consumed,
+                             AP4_Ac3FrameSpan& frame,
+                             bool              eos)
+{
+    AP4_Size offset = 0;
+    for (;;) {
+        offset += AP4_FindSyncWord(data+offset, data_size-offset, AP4_AC3_SYNC_WORD_BIG_ENDIAN);
+        if (offset+6 > data_size) break;
+
+        // syncinfo(): crc1, fscod, frmsizecod, and the bsid from bsi()
+        const AP4_UI08* header = data+offset;
+        unsigned int fscod      = header[4]>>6;
+        unsigned int frmsizecod = header[4]&0x3F;
+        unsigned int bsid       = header[5]>>3;
+        if (fscod < 3 && frmsizecod < 38 && bsid <= 8) {
+            AP4_Size frame_size = FRAME_SIZE_CODE_ARY_AC3[fscod][frmsizecod]*2;
+            AP4_Size end = offset+frame_size;
+            bool found = false;
+            if (end+2 <= data_size) {
+                // the next frame must start right after this one
+                found = (AP4_BytesToUInt16BE(data+end) == AP4_AC3_SYNC_WORD_BIG_ENDIAN);
+            } else if (eos) {
+                found = (end <= data_size);
+            } else {
+                bytes_consumed = offset;
+                return AP4_ERROR_NOT_ENOUGH_DATA;
+            }
+            if (found) {
+                frame.m_Data        = header;
+                frame.m_Size        = frame_size;
+                frame.m_SampleRate  = FSCOD_AC3[fscod];
+                frame.m_SampleCount = 1536;
+                bytes_consumed = end;
+                return AP4_SUCCESS;
+            }
+        }
+
+        // false sync word, look further
+        ++offset;
+    }
+
+    // keep the last byte, unless at the end, since it may be the start of a sync word
+    if (eos || offset < data_size) {
+        bytes_consumed = eos ? data_size : offset;
+    } else {
+        bytes_consumed = data_size ? data_size-1 : 0;
+    }
+    return AP4_ERROR_NOT_ENOUGH_DATA;
+}
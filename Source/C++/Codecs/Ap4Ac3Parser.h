@@ -46,7 +46,7 @@
 
 const AP4_UI32 FRAME_SIZE_CODE_ARY_AC3[3][38] = {
     {64,64,80,80,96,96,112,112,128,128,160,160,192,192,224,224,256,256,320,320,384,384,448,448,512,512,640,640,768,768,896,896,1024,1024,1152,1152,1280,1280},
-    {69,70,87,88,104,105,121,122,139,140,174,175,208,209,243,244,278,279,348,349,417,418,487,488,557,558696,697,835,836,976,977,1114,1115,1253,1254,1393,1394},
+    {69,70,87,88,104,105,121,122,139,140,174,175,208,209,243,244,278,279,348,349,417,418,487,488,557,558,696,697,835,836,976,977,1114,1115,1253,1254,1393,1394},
     {96,96,120,120,144,144,168,168,192,192,240,240,288,288,336,336,384,384,480,480,576,576,672,672,768,768,960,960,1152,1152,1344,1344,1536,1536,1728,1728,1920,1920}};
 const AP4_UI32 FSCOD_AC3[4] = {48000, 44100, 32000, 0};
 
@@ -95,6 +95,13 @@ typedef struct {
     AP4_Flags m_LittleEndian;
 } AP4_Ac3Frame;
 
+typedef struct {
+    const AP4_UI08* m_Data;        // points into the caller's buffer
+    AP4_Size        m_Size;
+    AP4_UI32        m_SampleRate;
+    AP4_UI32        m_SampleCount; // always 1536 for AC-3
+} AP4_Ac3FrameSpan;
+
 class AP4_Ac3Parser {
 public:
     // constructor and destructor
@@ -110,6 +117,25 @@ public:
     AP4_Result Skip(AP4_Size size);
     AP4_Size   GetBytesFree();
     AP4_Size   GetBytesAvailable();
+
+    // class methods
+    /**
+     * Find the next (big-endian) sync frame in a buffer, decoding only the
+     * fields of the header needed to compute the frame size and duration.
+     * The frame data is not copied: the returned span points into the
+     * buffer.
+     * When a frame is found, bytes_consumed is set to the offset of the end
+     * of the frame. When no complete frame can be found,
+     * AP4_ERROR_NOT_ENOUGH_DATA is returned and bytes_consumed is set to the
+     * number of bytes that can be discarded before the next call.
+     * Unless eos is true, a frame is only returned once the sync word of
+     * the next frame is in the buffer, which rejects most false sync words.
+     */
+    static AP4_Result FindFrameSpan(const AP4_UI08*   data,
+                                    AP4_Size          data_size,
+                                    AP4_Size&         bytes_consumed,
+                                    AP4_Ac3FrameSpan& frame,
+                                    bool              eos = false);
     
 private:
     // methods
@@ -31,6 +31,7 @@
 +---------------------------------------------------------------------*/
 #include "Ap4BitStream.h"
 #include "Ap4Ac4Parser.h"
+#include "Ap4Utils.h"
 
 bool AP4_Ac4Header::m_DeprecatedV0 = true;
 /*----------------------------------------------------------------------+
@@ -561,3 +562,91 @@ AP4_Ac4Parser::GetBytesAvailable()
 {
   return (m_Bits.GetBytesAvailable());
 }
+
+/*----------------------------------------------------------------------+
+|    AP4_Ac4_ReadTocBits
++----------------------------------------------------------------------*/
+static inline unsigned int
+AP4_Ac4_ReadTocBits(AP4_UI32 toc, unsigned int& position, unsigned int bit_count)
+{
+    unsigned int value = (toc<<position)>>(32-bit_count);
+    position += bit_count;
+    return value;
+}
+
+/*----------------------------------------------------------------------+
+|    AP4_Ac4Parser::FindFrameSpan
++----------------------------------------------------------------------*/
+AP4_Result
+AP4_Ac4Parser::FindFrameSpan(const AP4_UI08*   data,
+                             AP4_Size          data_size,
+                             AP4_Size&         bytes_consumed,
+                             AP4_Ac4FrameSpan& frame,
+                             bool              eos)
+{
+    AP4_Size offset = 0;
+    for (;;) {
+        // look for either AP4_AC4_SYNC_WORD or AP4_AC4_SYNC_WORD_CRC
+        offset += AP4_FindSyncWord(data+offset, data_size-offset, AP4_AC4_SYNC_WORD, 0xFE);
+        if (offset+AP4_AC4_HEADER_SIZE+3 > data_size) break;
+
+        // sync word and frame_size()
+        const AP4_UI08* header = data+offset;
+        AP4_Size header_size = 4;
+        AP4_Size frame_size  = AP4_BytesToUInt16BE(header+2);
+        if (frame_size == 0xFFFF) {
+            frame_size   = AP4_BytesToUInt24BE(header+4);
+            header_size += 3;
+        }
+        AP4_Size crc_size = (header[1] == (AP4_AC4_SYNC_WORD_CRC&0xFF)) ? 2 : 0;
+
+        // start of the TOC, up to b_iframe_global (at most 24 bits when bitstream_version is 2)
+        AP4_UI32     toc = AP4_BytesToUInt24BE(header+header_size)<<8;
+        unsigned int position = 0;
+        unsigned int bitstream_version = AP4_Ac4_ReadTocBits(toc, position, 2);
+        position += 10; // sequence_counter
+        if (AP4_Ac4_ReadTocBits(toc, position, 1)) { // b_wait_frames
+            if (AP4_Ac4_ReadTocBits(toc, position, 3)) position += 2; // wait_frames, br_code
+        }
+        unsigned int fs_index         = AP4_Ac4_ReadTocBits(toc, position, 1);
+        unsigned int frame_rate_index = AP4_Ac4_ReadTocBits(toc, position, 4);
+        unsigned int b_iframe_global  = AP4_Ac4_ReadTocBits(toc, position, 1);
+
+        // same checks as AP4_Ac4Header::Check
+        if (frame_size != 0 &&
+            bitstream_version == 2 &&
+            ((fs_index == 0 && frame_rate_index == 13) || (fs_index == 1 && frame_rate_index <= 13))) {
+            AP4_Size end = offset+header_size+frame_size+crc_size;
+            bool found = false;
+            if (end+2 <= data_size) {
+                // the next frame must start right after this one
+                found = ((AP4_BytesToUInt16BE(data+end)&0xFFFE) == AP4_AC4_SYNC_WORD);
+            } else if (eos) {
+                found = (end <= data_size);
+            } else {
+                bytes_consumed = offset;
+                return AP4_ERROR_NOT_ENOUGH_DATA;
+            }
+            if (found) {
+                frame.m_Data           = header+header_size;
+                frame.m_Size           = frame_size;
+                frame.m_SampleDuration = (fs_index == 0) ? 2048  : AP4_Ac4SampleDeltaTable   [frame_rate_index];
+                frame.m_MediaTimeScale = (fs_index == 0) ? 44100 : AP4_Ac4MediaTimeScaleTable[frame_rate_index];
+                frame.m_Iframe         = b_iframe_global;
+                bytes_consumed = end;
+                return AP4_SUCCESS;
+            }
+        }
+
+        // false sync word, look further
+        ++offset;
+    }
+
+    // keep the last byte, unless at the end, since it may be the start of a sync word
+    if (eos || offset < data_size) {
+        bytes_consumed = eos ? data_size : offset;
+    } else {
+        bytes_consumed = data_size ? data_size-1 : 0;
+    }
+    return AP4_ERROR_NOT_ENOUGH_DATA;
+}
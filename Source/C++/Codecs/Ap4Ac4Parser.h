@@ -112,6 +112,14 @@ typedef struct {
     AP4_Ac4FrameInfo m_Info;
 } AP4_Ac4Frame;
 
+typedef struct {
+    const AP4_UI08* m_Data;        // raw_ac4_frame(), points into the caller's buffer
+    AP4_Size        m_Size;
+    AP4_UI32        m_SampleDuration;
+    AP4_UI32        m_MediaTimeScale;
+    AP4_UI32        m_Iframe;
+} AP4_Ac4FrameSpan;
+
 class AP4_Ac4Parser {
 public:
     // constructor and destructor
@@ -128,6 +136,22 @@ public:
     AP4_Size   GetBytesFree();
     AP4_Size   GetBytesAvailable();
 
+    // class methods
+    /**
+     * Find the next sync frame in a buffer, decoding only the start of the
+     * TOC, which has the fields needed to compute the frame duration.
+     * The span covers the raw_ac4_frame() payload (without the sync word,
+     * frame size and CRC), which is what is stored in an MP4 sample, and
+     * points into the buffer.
+     * The bytes_consumed and eos parameters work like they do for
+     * AP4_Ac3Parser::FindFrameSpan.
+     */
+    static AP4_Result FindFrameSpan(const AP4_UI08*   data,
+                                    AP4_Size          data_size,
+                                    AP4_Size&         bytes_consumed,
+                                    AP4_Ac4FrameSpan& frame,
+                                    bool              eos = false);
+
 private:
     // methods
     AP4_Result FindHeader(AP4_UI08* header);
@@ -31,6 +31,7 @@
 +---------------------------------------------------------------------*/
 #include "Ap4BitStream.h"
 #include "Ap4AdtsParser.h"
+#include "Ap4Utils.h"
 
 /*----------------------------------------------------------------------
 |   constants
@@ -87,7 +88,7 @@ AP4_AdtsHeader::AP4_AdtsHeader(const AP4_UI08* bytes)
 |
 +----------------------------------------------------------------------*/
 bool
-AP4_AdtsHeader::MatchFixed(unsigned char* a, unsigned char* b)
+AP4_AdtsHeader::MatchFixed(const unsigned char* a, const unsigned char* b)
 {
     if (a[0]         ==  b[0] &&
         a[1]         ==  b[1] &&
@@ -118,6 +119,37 @@ AP4_AdtsHeader::Check()
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------+
+|    AP4_AdtsHeader_GetFrameInfo
++----------------------------------------------------------------------*/
+static void
+AP4_AdtsHeader_GetFrameInfo(const AP4_AdtsHeader& adts_header, AP4_AacFrameInfo& info)
+{
+    info.m_Standard = (adts_header.m_Id == 1 ?
+                       AP4_AAC_STANDARD_MPEG2 :
+                       AP4_AAC_STANDARD_MPEG4);
+    switch (adts_header.m_ProfileObjectType) {
+        case 0:
+            info.m_Profile = AP4_AAC_PROFILE_MAIN;
+            break;
+
+        case 1:
+            info.m_Profile = AP4_AAC_PROFILE_LC;
+            break;
+
+        case 2: 
+            info.m_Profile = AP4_AAC_PROFILE_SSR;
+            break;
+
+        case 3:
+            info.m_Profile = AP4_AAC_PROFILE_LTP;
+    }
+    info.m_FrameLength = adts_header.m_FrameLength-AP4_ADTS_HEADER_SIZE;
+    info.m_ChannelConfiguration = adts_header.m_ChannelConfiguration;
+    info.m_SamplingFrequencyIndex = adts_header.m_SamplingFrequencyIndex;
+    info.m_SamplingFrequency = AP4_AdtsSamplingFrequencyTable[adts_header.m_SamplingFrequencyIndex];
+}
+
 /*----------------------------------------------------------------------+
 |    AP4_AdtsParser::AP4_AdtsParser
 +----------------------------------------------------------------------*/
@@ -250,29 +282,7 @@ AP4_AdtsParser::FindFrame(AP4_AacFrame& frame)
     m_Bits.SkipBytes(AP4_ADTS_HEADER_SIZE);
 
     /* fill in the frame info */
-    frame.m_Info.m_Standard = (adts_header.m_Id == 1 ? 
-                            AP4_AAC_STANDARD_MPEG2 :
-                            AP4_AAC_STANDARD_MPEG4);
-    switch (adts_header.m_ProfileObjectType) {
-        case 0:
-            frame.m_Info.m_Profile = AP4_AAC_PROFILE_MAIN;
-            break;
-
-        case 1:
-            frame.m_Info.m_Profile = AP4_AAC_PROFILE_LC;
-            break;
-
-        case 2: 
-            frame.m_Info.m_Profile = AP4_AAC_PROFILE_SSR;
-            break;
-
-        case 3:
-            frame.m_Info.m_Profile = AP4_AAC_PROFILE_LTP;
-    }
-    frame.m_Info.m_FrameLength = adts_header.m_FrameLength-AP4_ADTS_HEADER_SIZE;
-    frame.m_Info.m_ChannelConfiguration = adts_header.m_ChannelConfiguration;
-    frame.m_Info.m_SamplingFrequencyIndex = adts_header.m_SamplingFrequencyIndex;
-    frame.m_Info.m_SamplingFrequency = AP4_AdtsSamplingFrequencyTable[adts_header.m_SamplingFrequencyIndex];
+    AP4_AdtsHeader_GetFrameInfo(adts_header, frame.m_Info);
 
     /* skip crc if present */
     if (adts_header.m_ProtectionAbsent == 0) {
@@ -313,3 +323,63 @@ AP4_AdtsParser::GetBytesAvailable()
 
 
 
+
+/*----------------------------------------------------------------------+
+|    AP4_AdtsParser::FindFrameSpan
++----------------------------------------------------------------------*/
+AP4_Result
+AP4_AdtsParser::FindFrameSpan(const AP4_UI08*   data,
+                              AP4_Size          data_size,
+                              AP4_Size&         bytes_consumed,
+                              AP4_AacFrameSpan& frame,
+                              bool              eos)
+{
+    AP4_Size offset = 0;
+    for (;;) {
+        offset += AP4_FindSyncWord(data+offset,
+                                   data_size-offset,
+                                   AP4_ADTS_SYNC_PATTERN,
+                                   (AP4_UI08)AP4_ADTS_SYNC_MASK);
+        if (offset+AP4_ADTS_HEADER_SIZE > data_size) break;
+
+        const AP4_UI08* raw_header = data+offset;
+        AP4_AdtsHeader adts_header(raw_header);
+        AP4_Size header_size = adts_header.m_ProtectionAbsent ? AP4_ADTS_HEADER_SIZE : AP4_ADTS_HEADER_SIZE+2;
+        if (AP4_SUCCEEDED(adts_header.Check()) && adts_header.m_FrameLength > header_size) {
+            AP4_Size end = offset+adts_header.m_FrameLength;
+            bool found = false;
+            if (end+AP4_ADTS_HEADER_SIZE <= data_size) {
+                // the next frame must start right after this one, with the same fixed header
+                const AP4_UI08* next_raw_header = data+end;
+                AP4_AdtsHeader next_adts_header(next_raw_header);
+                found = (AP4_BytesToUInt16BE(next_raw_header)&AP4_ADTS_SYNC_MASK) == AP4_ADTS_SYNC_PATTERN &&
+                        AP4_SUCCEEDED(next_adts_header.Check())                                          &&
+                        AP4_AdtsHeader::MatchFixed(raw_header, next_raw_header);
+            } else if (eos) {
+                found = (end <= data_size);
+            } else {
+                bytes_consumed = offset;
+                return AP4_ERROR_NOT_ENOUGH_DATA;
+            }
+            if (found) {
+                AP4_AdtsHeader_GetFrameInfo(adts_header, frame.m_Info);
+                frame.m_Data = raw_header+header_size;
+                frame.m_Size = adts_header.m_FrameLength-header_size;
+                frame.m_Info.m_FrameLength = frame.m_Size;
+                bytes_consumed = end;
+                return AP4_SUCCESS;
+            }
+        }
+
+        // false sync word, look further
+        ++offset;
+    }
+
+    // keep the last bytes, unless at the end, since they may be the start of a header
+    if (eos) {
+        bytes_consumed = data_size;
+    } else {
+        bytes_consumed = offset < data_size ? offset : (data_size ? data_size-1 : 0);
+    }
+    return AP4_ERROR_NOT_ENOUGH_DATA;
+}
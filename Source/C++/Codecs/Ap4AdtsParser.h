@@ -65,7 +65,7 @@ public:
     unsigned int m_RawDataBlocks;
 
     // class methods
-    static bool MatchFixed(unsigned char* a, unsigned char* b);
+    static bool MatchFixed(const unsigned char* a, const unsigned char* b);
 };
 
 typedef enum {
@@ -94,6 +94,12 @@ typedef struct {
     AP4_AacFrameInfo m_Info;
 } AP4_AacFrame;
 
+typedef struct {
+    const AP4_UI08*  m_Data; // raw data block(s), points into the caller's buffer
+    AP4_Size         m_Size;
+    AP4_AacFrameInfo m_Info;
+} AP4_AacFrameSpan;
+
 class AP4_AdtsParser {
 public:
     // constructor and destructor
@@ -110,6 +116,25 @@ public:
     AP4_Size   GetBytesFree();
     AP4_Size   GetBytesAvailable();
 
+    // class methods
+    /**
+     * Find the next ADTS frame in a buffer, without copying it: the returned
+     * span points into the buffer, and covers the frame payload (without
+     * the header and CRC).
+     * When a frame is found, bytes_consumed is set to the offset of the end
+     * of the frame. When no complete frame can be found,
+     * AP4_ERROR_NOT_ENOUGH_DATA is returned and bytes_consumed is set to the
+     * number of bytes that can be discarded before the next call.
+     * Unless eos is true, a frame is only returned once the header of the
+     * next frame is in the buffer and matches the fixed part of its header,
+     * like FindFrame does.
+     */
+    static AP4_Result FindFrameSpan(const AP4_UI08*   data,
+                                    AP4_Size          data_size,
+                                    AP4_Size&         bytes_consumed,
+                                    AP4_AacFrameSpan& frame,
+                                    bool              eos = false);
+
 private:
     // methods
     AP4_Result FindHeader(AP4_UI08* header);
@@ -131,6 +131,23 @@ AP4_AvcNalParser::AP4_AvcNalParser() :
 {
 }
 
+/*----------------------------------------------------------------------
+|   AP4_AvcFrameParser_ReadParameterSetId
++---------------------------------------------------------------------*/
+static unsigned int
+AP4_AvcFrameParser_ReadParameterSetId(const AP4_UI08* data,
+                                      AP4_Size        data_size,
+                                      unsigned int    nal_unit_type)
+{
+    // the id is the first field of a PPS, and comes after the profile
+    // and level in a SPS, so only the first few bytes need to be unescaped
+    AP4_DataBuffer unescaped;
+    AP4_NalParser::Unescape(data, data_size, unescaped, 16);
+    AP4_BitReader bits(unescaped.GetData(), unescaped.GetDataSize());
+    bits.SkipBits(nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_SPS ? 32 : 8);
+    return bits.ReadUE();
+}
+
 /*----------------------------------------------------------------------
 |   AP4_AvcFrameParser::AP4_AvcFrameParser
 +---------------------------------------------------------------------*/
@@ -150,6 +167,8 @@ AP4_AvcFrameParser::AP4_AvcFrameParser() :
     for (unsigned int i=0; i<256; i++) {
         m_PPS[i] = NULL;
         m_SPS[i] = NULL;
+        m_PPSHash[i] = 0;
+        m_SPSHash[i] = 0;
     }
 }
 
@@ -171,37 +190,6 @@ AP4_AvcFrameParser::~AP4_AvcFrameParser()
     }
 }
 
-/*----------------------------------------------------------------------
-|   ReadGolomb
-+---------------------------------------------------------------------*/
-static unsigned int
-ReadGolomb(AP4_BitReader& bits)
-{
-    unsigned int leading_zeros = 0;
-    while (bits.ReadBit() == 0) {
-        leading_zeros++;
-        if (leading_zeros > 32) return 0; // safeguard
-    }
-    if (leading_zeros) {
-        return (1<<leading_zeros)-1+bits.ReadBits(leading_zeros);
-    } else {
-        return 0;
-    }
-}
-
-/*----------------------------------------------------------------------
-|   SignedGolomb
-+---------------------------------------------------------------------*/
-static int
-SignedGolomb(unsigned int code_num)
-{
-    if (code_num % 2) {
-        return (code_num+1)/2;
-    } else {
-        return -((int)code_num/2);
-    }
-}
-
 /*----------------------------------------------------------------------
 |   AP4_AvcSequenceParameterSet::AP4_AvcSequenceParameterSet
 +---------------------------------------------------------------------*/
@@ -285,7 +273,7 @@ AP4_AvcFrameParser::ParseSPS(const unsigned char*         data,
     sps.constraint_set3_flag = bits.ReadBit();
     bits.SkipBits(4);
     sps.level_idc = bits.ReadBits(8);
-    sps.seq_parameter_set_id = ReadGolomb(bits);
+    sps.seq_parameter_set_id = bits.ReadUE();
     if (sps.seq_parameter_set_id > AP4_AVC_SPS_MAX_ID) {
         return AP4_ERROR_INVALID_FORMAT;
     }
@@ -296,13 +284,13 @@ AP4_AvcFrameParser::ParseSPS(const unsigned char*         data,
         sps.profile_idc  ==  44   ||
         sps.profile_idc  ==  83   ||
         sps.profile_idc  ==  86) {
-        sps.chroma_format_idc = ReadGolomb(bits);
+        sps.chroma_format_idc = bits.ReadUE();
         sps.separate_colour_plane_flag = 0;
         if (sps.chroma_format_idc == 3) {
             sps.separate_colour_plane_flag = bits.ReadBit();
         }
-        sps.bit_depth_luma_minus8 = ReadGolomb(bits);
-        sps.bit_depth_chroma_minus8 = ReadGolomb(bits);
+        sps.bit_depth_luma_minus8 = bits.ReadUE();
+        sps.bit_depth_chroma_minus8 = bits.ReadUE();
         sps.qpprime_y_zero_transform_bypass_flag = bits.ReadBit();
         sps.seq_scaling_matrix_present_flag = bits.ReadBit();
         if (sps.seq_scaling_matrix_present_flag) {
@@ -314,7 +302,7 @@ AP4_AvcFrameParser::ParseSPS(const unsigned char*         data,
                         int next_scale = 8;
                         for (unsigned int j=0; j<16; j++) {
                             if (next_scale) {
-                                int delta_scale = SignedGolomb(ReadGolomb(bits));
+                                int delta_scale = bits.ReadSE();
                                 next_scale = (last_scale + delta_scale + 256) % 256;
                                 sps.use_default_scaling_matrix_4x4[i] = (j == 0 && next_scale == 0);
                             }
@@ -326,7 +314,7 @@ AP4_AvcFrameParser::ParseSPS(const unsigned char*         data,
                         int next_scale = 8;
                         for (unsigned int j=0; j<64; j++) {
                             if (next_scale) {
-                                int delta_scale = SignedGolomb(ReadGolomb(bits));
+                                int delta_scale = bits.ReadSE();
                                 next_scale = (last_scale + delta_scale + 256) % 256;
                                 sps.use_default_scaling_matrix_8x8[i-6] = (j == 0 && next_scale == 0);
                             }
@@ -338,29 +326,29 @@ AP4_AvcFrameParser::ParseSPS(const unsigned char*         data,
             }
         }
     }
-    sps.log2_max_frame_num_minus4 = ReadGolomb(bits);
-    sps.pic_order_cnt_type = ReadGolomb(bits);
+    sps.log2_max_frame_num_minus4 = bits.ReadUE();
+    sps.pic_order_cnt_type = bits.ReadUE();
     if (sps.pic_order_cnt_type > 2) {
         return AP4_ERROR_INVALID_FORMAT;
     }
     if (sps.pic_order_cnt_type == 0) {
-        sps.log2_max_pic_order_cnt_lsb_minus4 = ReadGolomb(bits);
+        sps.log2_max_pic_order_cnt_lsb_minus4 = bits.ReadUE();
     } else if (sps.pic_order_cnt_type == 1) {
         sps.delta_pic_order_always_zero_flags = bits.ReadBit();
-        sps.offset_for_non_ref_pic = SignedGolomb(ReadGolomb(bits));
-        sps.offset_for_top_to_bottom_field = SignedGolomb(ReadGolomb(bits));
-        sps.num_ref_frames_in_pic_order_cnt_cycle = ReadGolomb(bits);
+        sps.offset_for_non_ref_pic = bits.ReadSE();
+        sps.offset_for_top_to_bottom_field = bits.ReadSE();
+        sps.num_ref_frames_in_pic_order_cnt_cycle = bits.ReadUE();
         if (sps.num_ref_frames_in_pic_order_cnt_cycle > AP4_AVC_SPS_MAX_NUM_REF_FRAMES_IN_PIC_ORDER_CNT_CYCLE) {
             return AP4_ERROR_INVALID_FORMAT;
         }
         for (unsigned int i=0; i<sps.num_ref_frames_in_pic_order_cnt_cycle; i++) {
-            sps.offset_for_ref_frame[i] = SignedGolomb(ReadGolomb(bits));
+            sps.offset_for_ref_frame[i] = bits.ReadSE();
         }
     }
-    sps.num_ref_frames                       = ReadGolomb(bits);
+    sps.num_ref_frames                       = bits.ReadUE();
     sps.gaps_in_frame_num_value_allowed_flag = bits.ReadBit();
-    sps.pic_width_in_mbs_minus1              = ReadGolomb(bits);
-    sps.pic_height_in_map_units_minus1       = ReadGolomb(bits);
+    sps.pic_width_in_mbs_minus1              = bits.ReadUE();
+    sps.pic_height_in_map_units_minus1       = bits.ReadUE();
     sps.frame_mbs_only_flag                  = bits.ReadBit();
     if (!sps.frame_mbs_only_flag) {
         sps.mb_adaptive_frame_field_flag = bits.ReadBit();
@@ -368,10 +356,10 @@ AP4_AvcFrameParser::ParseSPS(const unsigned char*         data,
     sps.direct_8x8_inference_flag = bits.ReadBit();
     sps.frame_cropping_flag       = bits.ReadBit();
     if (sps.frame_cropping_flag) {
-        sps.frame_crop_left_offset   = ReadGolomb(bits);
-        sps.frame_crop_right_offset  = ReadGolomb(bits);
-        sps.frame_crop_top_offset    = ReadGolomb(bits);
-        sps.frame_crop_bottom_offset = ReadGolomb(bits);
+        sps.frame_crop_left_offset   = bits.ReadUE();
+        sps.frame_crop_right_offset  = bits.ReadUE();
+        sps.frame_crop_top_offset    = bits.ReadUE();
+        sps.frame_crop_bottom_offset = bits.ReadUE();
     }
 
     return AP4_SUCCESS;
@@ -421,38 +409,38 @@ AP4_AvcFrameParser::ParsePPS(const unsigned char*        data,
     
     bits.SkipBits(8); // NAL Unit Type
 
-    pps.pic_parameter_set_id     = ReadGolomb(bits);
+    pps.pic_parameter_set_id     = bits.ReadUE();
     if (pps.pic_parameter_set_id > AP4_AVC_PPS_MAX_ID) {
         return AP4_ERROR_INVALID_FORMAT;
     }
-    pps.seq_parameter_set_id     = ReadGolomb(bits);
+    pps.seq_parameter_set_id     = bits.ReadUE();
     if (pps.seq_parameter_set_id > AP4_AVC_SPS_MAX_ID) {
         return AP4_ERROR_INVALID_FORMAT;
     }
     pps.entropy_coding_mode_flag = bits.ReadBit();
     pps.pic_order_present_flag   = bits.ReadBit();
-    pps.num_slice_groups_minus1  = ReadGolomb(bits);
+    pps.num_slice_groups_minus1  = bits.ReadUE();
     if (pps.num_slice_groups_minus1 >= AP4_AVC_PPS_MAX_SLICE_GROUPS) {
         return AP4_ERROR_INVALID_FORMAT;
     }
     if (pps.num_slice_groups_minus1 > 0) {
-        pps.slice_group_map_type = ReadGolomb(bits);
+        pps.slice_group_map_type = bits.ReadUE();
         if (pps.slice_group_map_type == 0) {
             for (unsigned int i=0; i<=pps.num_slice_groups_minus1; i++) {
-                pps.run_length_minus1[i] = ReadGolomb(bits);
+                pps.run_length_minus1[i] = bits.ReadUE();
             }
         } else if (pps.slice_group_map_type == 2) {
             for (unsigned int i=0; i<pps.num_slice_groups_minus1; i++) {
-                pps.top_left[i] = ReadGolomb(bits);
-                pps.bottom_right[i] = ReadGolomb(bits);
+                pps.top_left[i] = bits.ReadUE();
+                pps.bottom_right[i] = bits.ReadUE();
             }
         } else if (pps.slice_group_map_type == 3 ||
                    pps.slice_group_map_type == 4 ||
                    pps.slice_group_map_type == 5) {
             pps.slice_group_change_direction_flag = bits.ReadBit();
-            pps.slice_group_change_rate_minus1 = ReadGolomb(bits);
+            pps.slice_group_change_rate_minus1 = bits.ReadUE();
         } else if (pps.slice_group_map_type == 6) {
-            pps.pic_size_in_map_units_minus1 = ReadGolomb(bits);
+            pps.pic_size_in_map_units_minus1 = bits.ReadUE();
             if (pps.pic_size_in_map_units_minus1 >= AP4_AVC_PPS_MAX_PIC_SIZE_IN_MAP_UNITS) {
                 return AP4_ERROR_INVALID_FORMAT;
             }
@@ -469,13 +457,13 @@ AP4_AvcFrameParser::ParsePPS(const unsigned char*        data,
             }
         }
     }
-    pps.num_ref_idx_10_active_minus1 = ReadGolomb(bits);
-    pps.num_ref_idx_11_active_minus1 = ReadGolomb(bits);
+    pps.num_ref_idx_10_active_minus1 = bits.ReadUE();
+    pps.num_ref_idx_11_active_minus1 = bits.ReadUE();
     pps.weighted_pred_flag           = bits.ReadBit();
     pps.weighted_bipred_idc          = bits.ReadBits(2);
-    pps.pic_init_qp_minus26          = SignedGolomb(ReadGolomb(bits));
-    pps.pic_init_qs_minus26          = SignedGolomb(ReadGolomb(bits));
-    pps.chroma_qp_index_offset       = SignedGolomb(ReadGolomb(bits));
+    pps.pic_init_qp_minus26          = bits.ReadSE();
+    pps.pic_init_qs_minus26          = bits.ReadSE();
+    pps.chroma_qp_index_offset       = bits.ReadSE();
     pps.deblocking_filter_control_present_flag = bits.ReadBit();
     pps.constrained_intra_pred_flag            = bits.ReadBit();
     pps.redundant_pic_cnt_present_flag         = bits.ReadBit();
@@ -536,16 +524,48 @@ AP4_AvcFrameParser::ParseSliceHeader(const AP4_UI08*     data,
                                      unsigned int        nal_ref_idc,
                                      AP4_AvcSliceHeader& slice_header)
 {
-    AP4_DataBuffer unescaped(data, data_size);
-    AP4_NalParser::Unescape(unescaped);
-    AP4_BitReader bits(unescaped.GetData(), unescaped.GetDataSize());
+    // only unescape the beginning of the slice, unless the header
+    // turns out to be longer than that
+    AP4_AvcSliceHeader initial_slice_header = slice_header;
+    AP4_DataBuffer unescaped;
+    AP4_Size consumed = AP4_NalParser::Unescape(data, data_size, unescaped, AP4_AVC_SLICE_HEADER_UNESCAPE_SIZE);
+    AP4_Result result = ParseUnescapedSliceHeader(unescaped.GetData(),
+                                                  unescaped.GetDataSize(),
+                                                  nal_unit_type,
+                                                  nal_ref_idc,
+                                                  slice_header);
+    if (consumed < data_size &&
+        (AP4_FAILED(result) || slice_header.size > 8*unescaped.GetDataSize())) {
+        slice_header = initial_slice_header;
+        AP4_NalParser::Unescape(data, data_size, unescaped, data_size);
+        result = ParseUnescapedSliceHeader(unescaped.GetData(),
+                                           unescaped.GetDataSize(),
+                                           nal_unit_type,
+                                           nal_ref_idc,
+                                           slice_header);
+    }
+    
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AvcFrameParser::ParseUnescapedSliceHeader
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AvcFrameParser::ParseUnescapedSliceHeader(const AP4_UI08*     data,
+                                              unsigned int        data_size,
+                                              unsigned int        nal_unit_type,
+                                              unsigned int        nal_ref_idc,
+                                              AP4_AvcSliceHeader& slice_header)
+{
+    AP4_BitReader bits(data, data_size);
 
     // init the computer fields
     slice_header.size = 0;
     
-    slice_header.first_mb_in_slice    = ReadGolomb(bits);
-    slice_header.slice_type           = ReadGolomb(bits);
-    slice_header.pic_parameter_set_id = ReadGolomb(bits);
+    slice_header.first_mb_in_slice    = bits.ReadUE();
+    slice_header.slice_type           = bits.ReadUE();
+    slice_header.pic_parameter_set_id = bits.ReadUE();
     if (slice_header.pic_parameter_set_id > AP4_AVC_PPS_MAX_ID) {
         return AP4_ERROR_INVALID_FORMAT;
     }
@@ -568,22 +588,22 @@ AP4_AvcFrameParser::ParseSliceHeader(const AP4_UI08*     data,
         }
     }
     if (nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_OF_IDR_PICTURE) {
-        slice_header.idr_pic_id = ReadGolomb(bits);
+        slice_header.idr_pic_id = bits.ReadUE();
     }
     if (sps->pic_order_cnt_type == 0) {
         slice_header.pic_order_cnt_lsb = bits.ReadBits(sps->log2_max_pic_order_cnt_lsb_minus4 + 4);
         if (pps->pic_order_present_flag && !slice_header.field_pic_flag) {
-            slice_header.delta_pic_order_cnt[0] = SignedGolomb(ReadGolomb(bits));
+            slice_header.delta_pic_order_cnt[0] = bits.ReadSE();
         }
     }
     if (sps->pic_order_cnt_type == 1 && !sps->delta_pic_order_always_zero_flags) {
-        slice_header.delta_pic_order_cnt[0] = SignedGolomb(ReadGolomb(bits));
+        slice_header.delta_pic_order_cnt[0] = bits.ReadSE();
         if (pps->pic_order_present_flag && !slice_header.field_pic_flag) {
-            slice_header.delta_pic_order_cnt[1] = SignedGolomb(ReadGolomb(bits));
+            slice_header.delta_pic_order_cnt[1] = bits.ReadSE();
         }
     }
     if (pps->redundant_pic_cnt_present_flag) {
-        slice_header.redundant_pic_cnt = ReadGolomb(bits);
+        slice_header.redundant_pic_cnt = bits.ReadUE();
     }
     
     unsigned int slice_type = slice_header.slice_type % 5; // this seems to be implicit in the spec
@@ -598,9 +618,9 @@ AP4_AvcFrameParser::ParseSliceHeader(const AP4_UI08*     data,
         slice_header.num_ref_idx_active_override_flag = bits.ReadBit();
         
         if (slice_header.num_ref_idx_active_override_flag) {
-            slice_header.num_ref_idx_l0_active_minus1 = ReadGolomb(bits);
+            slice_header.num_ref_idx_l0_active_minus1 = bits.ReadUE();
             if ((slice_header.slice_type % 5) == AP4_AVC_SLICE_TYPE_B) {
-                slice_header.num_ref_idx_l1_active_minus1 = ReadGolomb(bits);
+                slice_header.num_ref_idx_l1_active_minus1 = bits.ReadUE();
             }
         } else {
             slice_header.num_ref_idx_l0_active_minus1 = pps->num_ref_idx_10_active_minus1;
@@ -613,12 +633,12 @@ AP4_AvcFrameParser::ParseSliceHeader(const AP4_UI08*     data,
         slice_header.ref_pic_list_reordering_flag_l0 = bits.ReadBit();
         if (slice_header.ref_pic_list_reordering_flag_l0) {
             do {
-                slice_header.reordering_of_pic_nums_idc = ReadGolomb(bits);
+                slice_header.reordering_of_pic_nums_idc = bits.ReadUE();
                 if (slice_header.reordering_of_pic_nums_idc == 0 ||
 					slice_header.reordering_of_pic_nums_idc == 1) {
-                    slice_header.abs_diff_pic_num_minus1 = ReadGolomb(bits);
+                    slice_header.abs_diff_pic_num_minus1 = bits.ReadUE();
                 } else if (slice_header.reordering_of_pic_nums_idc == 2) {
-                    slice_header.long_term_pic_num = ReadGolomb(bits);
+                    slice_header.long_term_pic_num = bits.ReadUE();
                 }
             } while (slice_header.reordering_of_pic_nums_idc != 3);
         }
@@ -627,12 +647,12 @@ AP4_AvcFrameParser::ParseSliceHeader(const AP4_UI08*     data,
         slice_header.ref_pic_list_reordering_flag_l1 = bits.ReadBit();
         if (slice_header.ref_pic_list_reordering_flag_l1) {
             do {
-                slice_header.reordering_of_pic_nums_idc = ReadGolomb(bits);
+                slice_header.reordering_of_pic_nums_idc = bits.ReadUE();
                 if (slice_header.reordering_of_pic_nums_idc == 0 ||
 					slice_header.reordering_of_pic_nums_idc == 1) {
-                    slice_header.abs_diff_pic_num_minus1 = ReadGolomb(bits);
+                    slice_header.abs_diff_pic_num_minus1 = bits.ReadUE();
                 } else if (slice_header.reordering_of_pic_nums_idc == 2) {
-                    slice_header.long_term_pic_num = ReadGolomb(bits);
+                    slice_header.long_term_pic_num = bits.ReadUE();
                 }
             } while (slice_header.reordering_of_pic_nums_idc != 3);
         }
@@ -642,24 +662,24 @@ AP4_AvcFrameParser::ParseSliceHeader(const AP4_UI08*     data,
         (slice_type == AP4_AVC_SLICE_TYPE_P || slice_type == AP4_AVC_SLICE_TYPE_SP)) ||
 		(pps->weighted_bipred_idc == 1 && slice_type == AP4_AVC_SLICE_TYPE_B)) {
         // pred_weight_table
-        slice_header.luma_log2_weight_denom = ReadGolomb(bits);
+        slice_header.luma_log2_weight_denom = bits.ReadUE();
         
         if (sps->chroma_format_idc != 0) {
-            slice_header.chroma_log2_weight_denom = ReadGolomb(bits);
+            slice_header.chroma_log2_weight_denom = bits.ReadUE();
         }
         
         for (unsigned int i=0; i<=slice_header.num_ref_idx_l0_active_minus1; i++) {
             unsigned int luma_weight_l0_flag = bits.ReadBit();
             if (luma_weight_l0_flag) {
-                /* slice_header.luma_weight_l0[i] = SignedGolomb( */ ReadGolomb(bits);
-                /* slice_header.luma_offset_l0[i] = SignedGolomb( */ ReadGolomb(bits);
+                /* slice_header.luma_weight_l0[i] = */ bits.ReadSE();
+                /* slice_header.luma_offset_l0[i] = */ bits.ReadSE();
             }
             if (sps->chroma_format_idc != 0) {
                 unsigned int chroma_weight_l0_flag = bits.ReadBit();
                 if (chroma_weight_l0_flag) {
                     for (unsigned int j=0; j<2; j++) {
-                        /* slice_header.chroma_weight_l0[i][j] = SignedGolomb( */ ReadGolomb(bits);
-                        /* slice_header.chroma_offset_l0[i][j] = SignedGolomb( */ ReadGolomb(bits);
+                        /* slice_header.chroma_weight_l0[i][j] = */ bits.ReadSE();
+                        /* slice_header.chroma_offset_l0[i][j] = */ bits.ReadSE();
                     }
                 }
             }
@@ -668,15 +688,15 @@ AP4_AvcFrameParser::ParseSliceHeader(const AP4_UI08*     data,
             for (unsigned int i=0; i<=slice_header.num_ref_idx_l1_active_minus1; i++) {
                 unsigned int luma_weight_l1_flag = bits.ReadBit();
                 if (luma_weight_l1_flag) {
-                    /* slice_header.luma_weight_l1[i] = SignedGolomb( */ ReadGolomb(bits);
-                    /* slice_header.luma_offset_l1[i] = SignedGolomb( */ ReadGolomb(bits);
+                    /* slice_header.luma_weight_l1[i] = */ bits.ReadSE();
+                    /* slice_header.luma_offset_l1[i] = */ bits.ReadSE();
                 }
                 if (sps->chroma_format_idc != 0) {
                     unsigned int chroma_weight_l1_flag = bits.ReadBit();
                     if (chroma_weight_l1_flag) {
                         for (unsigned int j=0; j<2; j++) {
-                            /* slice_header.chroma_weight_l1[i][j] = SignedGolomb( */ ReadGolomb(bits);
-                            /* slice_header.chroma_offset_l1[i][j] = SignedGolomb( */ ReadGolomb(bits);
+                            /* slice_header.chroma_weight_l1[i][j] = */ bits.ReadSE();
+                            /* slice_header.chroma_offset_l1[i][j] = */ bits.ReadSE();
                         }
                     }
                 }
@@ -694,44 +714,44 @@ AP4_AvcFrameParser::ParseSliceHeader(const AP4_UI08*     data,
             if (adaptive_ref_pic_marking_mode_flag) {
                 unsigned int memory_management_control_operation = 0;
                 do {
-                    memory_management_control_operation = ReadGolomb(bits);
+                    memory_management_control_operation = bits.ReadUE();
                     if (memory_management_control_operation == 1 || memory_management_control_operation == 3) {
-                        slice_header.difference_of_pic_nums_minus1 = ReadGolomb(bits);
+                        slice_header.difference_of_pic_nums_minus1 = bits.ReadUE();
                     }
                     if (memory_management_control_operation == 2) {
-                        slice_header.long_term_pic_num = ReadGolomb(bits);
+                        slice_header.long_term_pic_num = bits.ReadUE();
                     }
                     if (memory_management_control_operation == 3 || memory_management_control_operation == 6) {
-                        slice_header.long_term_frame_idx = ReadGolomb(bits);
+                        slice_header.long_term_frame_idx = bits.ReadUE();
                     }
                     if (memory_management_control_operation == 4) {
-                        slice_header.max_long_term_frame_idx_plus1 = ReadGolomb(bits);
+                        slice_header.max_long_term_frame_idx_plus1 = bits.ReadUE();
                     }
                 } while (memory_management_control_operation != 0);
             }
         }
     }
     if (pps->entropy_coding_mode_flag && slice_type != AP4_AVC_SLICE_TYPE_I && slice_type != AP4_AVC_SLICE_TYPE_SI) {
-        slice_header.cabac_init_idc = ReadGolomb(bits);
+        slice_header.cabac_init_idc = bits.ReadUE();
     }
-    slice_header.slice_qp_delta = ReadGolomb(bits);
+    slice_header.slice_qp_delta = bits.ReadUE();
     if (slice_type == AP4_AVC_SLICE_TYPE_SP || slice_type == AP4_AVC_SLICE_TYPE_SI) {
         if (slice_type == AP4_AVC_SLICE_TYPE_SP) {
             slice_header.sp_for_switch_flag = bits.ReadBit();
         }
-        slice_header.slice_qs_delta = SignedGolomb(ReadGolomb(bits));
+        slice_header.slice_qs_delta = bits.ReadSE();
     }
     if (pps->deblocking_filter_control_present_flag) {
-        slice_header.disable_deblocking_filter_idc = ReadGolomb(bits);
+        slice_header.disable_deblocking_filter_idc = bits.ReadUE();
         if (slice_header.disable_deblocking_filter_idc != 1) {
-            slice_header.slice_alpha_c0_offset_div2 = SignedGolomb(ReadGolomb(bits));
-            slice_header.slice_beta_offset_div2     = SignedGolomb(ReadGolomb(bits));
+            slice_header.slice_alpha_c0_offset_div2 = bits.ReadSE();
+            slice_header.slice_beta_offset_div2     = bits.ReadSE();
         }
     }
     if (pps->num_slice_groups_minus1 > 0 &&
         pps->slice_group_map_type >= 3   &&
         pps->slice_group_map_type <= 5) {
-        slice_header.slice_group_change_cycle = ReadGolomb(bits);
+        slice_header.slice_group_change_cycle = bits.ReadUE();
     }
 
     /* compute the size */
@@ -991,10 +1011,11 @@ AP4_AvcFrameParser::Feed(const void*     data,
                          AccessUnitInfo& access_unit_info,
                          bool            eos)
 {
-    const AP4_DataBuffer* nal_unit = NULL;
+    const AP4_UI08* nal_unit      = NULL;
+    AP4_Size        nal_unit_size = 0;
 
     // feed the NAL unit parser
-    AP4_Result result = m_NalParser.Feed(data, data_size, bytes_consumed, nal_unit, eos);
+    AP4_Result result = m_NalParser.Feed(data, data_size, bytes_consumed, nal_unit, nal_unit_size, eos);
     if (AP4_FAILED(result)) {
         return result;
     }
@@ -1004,10 +1025,7 @@ AP4_AvcFrameParser::Feed(const void*     data,
         eos = false;
     }
     
-    return Feed(nal_unit ? nal_unit->GetData() : NULL,
-                nal_unit ? nal_unit->GetDataSize() : 0,
-                access_unit_info,
-                eos);
+    return Feed(nal_unit, nal_unit_size, access_unit_info, eos);
 }
 
 /*----------------------------------------------------------------------
@@ -1084,30 +1102,53 @@ AP4_AvcFrameParser::Feed(const AP4_UI08* nal_unit,
             m_NalUnitType = nal_unit_type;
             m_NalRefIdc   = nal_ref_idc;
         } else if (nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_PPS) {
-            AP4_AvcPictureParameterSet* pps = new AP4_AvcPictureParameterSet;
-            result = ParsePPS(nal_unit, nal_unit_size, *pps);
-            if (AP4_FAILED(result)) {
-                DBG_PRINTF_0("PPS ERROR!!!\n");
-                delete pps;
+            // parameter sets are often repeated unchanged, only parse new ones
+            AP4_UI32     hash   = AP4_NalParser::ComputeHash(nal_unit, nal_unit_size);
+            unsigned int pps_id = AP4_AvcFrameParser_ReadParameterSetId(nal_unit, nal_unit_size, nal_unit_type);
+            if (pps_id <= AP4_AVC_PPS_MAX_ID &&
+                AP4_NalParser::IsSameParameterSet(m_PPS[pps_id], m_PPSHash[pps_id], nal_unit, nal_unit_size, hash)) {
+                DBG_PRINTF_0("PPS unchanged\n");
+                result = AP4_SUCCESS;
             } else {
-                delete m_PPS[pps->pic_parameter_set_id];
-                m_PPS[pps->pic_parameter_set_id] = pps;
-                DBG_PRINTF_2("PPS sps_id=%d, pps_id=%d\n", pps->seq_parameter_set_id, pps->pic_parameter_set_id);
-                
+                AP4_AvcPictureParameterSet* pps = new AP4_AvcPictureParameterSet;
+                result = ParsePPS(nal_unit, nal_unit_size, *pps);
+                if (AP4_FAILED(result)) {
+                    DBG_PRINTF_0("PPS ERROR!!!\n");
+                    delete pps;
+                } else {
+                    delete m_PPS[pps->pic_parameter_set_id];
+                    m_PPS[pps->pic_parameter_set_id] = pps;
+                    m_PPSHash[pps->pic_parameter_set_id] = hash;
+                    DBG_PRINTF_2("PPS sps_id=%d, pps_id=%d\n", pps->seq_parameter_set_id, pps->pic_parameter_set_id);
+                }
+            }
+            if (AP4_SUCCEEDED(result)) {
                 // keep the PPS with the NAL unit (this is optional)
                 AppendNalUnitData(nal_unit, nal_unit_size);
                 CheckIfAccessUnitIsCompleted(access_unit_info);
             }
         } else if (nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_SPS) {
-            AP4_AvcSequenceParameterSet* sps = new AP4_AvcSequenceParameterSet;
-            result = ParseSPS(nal_unit, nal_unit_size, *sps);
-            if (AP4_FAILED(result)) {
-                DBG_PRINTF_0("SPS ERROR!!!\n");
-                delete sps;
+            // parameter sets are often repeated unchanged, only parse new ones
+            AP4_UI32     hash   = AP4_NalParser::ComputeHash(nal_unit, nal_unit_size);
+            unsigned int sps_id = AP4_AvcFrameParser_ReadParameterSetId(nal_unit, nal_unit_size, nal_unit_type);
+            if (sps_id <= AP4_AVC_SPS_MAX_ID &&
+                AP4_NalParser::IsSameParameterSet(m_SPS[sps_id], m_SPSHash[sps_id], nal_unit, nal_unit_size, hash)) {
+                DBG_PRINTF_0("SPS unchanged\n");
+                result = AP4_SUCCESS;
             } else {
-                delete m_SPS[sps->seq_parameter_set_id];
-                m_SPS[sps->seq_parameter_set_id] = sps;
-                DBG_PRINTF_1("SPS sps_id=%d\n", sps->seq_parameter_set_id);
+                AP4_AvcSequenceParameterSet* sps = new AP4_AvcSequenceParameterSet;
+                result = ParseSPS(nal_unit, nal_unit_size, *sps);
+                if (AP4_FAILED(result)) {
+                    DBG_PRINTF_0("SPS ERROR!!!\n");
+                    delete sps;
+                } else {
+                    delete m_SPS[sps->seq_parameter_set_id];
+                    m_SPS[sps->seq_parameter_set_id] = sps;
+                    m_SPSHash[sps->seq_parameter_set_id] = hash;
+                    DBG_PRINTF_1("SPS sps_id=%d\n", sps->seq_parameter_set_id);
+                }
+            }
+            if (AP4_SUCCEEDED(result)) {
                 CheckIfAccessUnitIsCompleted(access_unit_info);
             }
         } else if (nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_SEI) {
@@ -76,6 +76,10 @@ const unsigned int AP4_AVC_PPS_MAX_ID                                      = 255
 const unsigned int AP4_AVC_PPS_MAX_SLICE_GROUPS                            = 256;
 const unsigned int AP4_AVC_PPS_MAX_PIC_SIZE_IN_MAP_UNITS                   = 65536;
 
+// number of bytes unescaped before parsing a slice header (more are
+// unescaped if the header is longer)
+const unsigned int AP4_AVC_SLICE_HEADER_UNESCAPE_SIZE                     = 256;
+
 /*----------------------------------------------------------------------
 |   types
 +---------------------------------------------------------------------*/
@@ -297,6 +301,11 @@ public:
 
 private:
     // methods
+    AP4_Result ParseUnescapedSliceHeader(const AP4_UI08*     data,
+                                         unsigned int        data_size,
+                                         unsigned int        nal_unit_type,
+                                         unsigned int        nal_ref_idc,
+                                         AP4_AvcSliceHeader& slice_header);
     bool SameFrame(unsigned int nal_unit_type_1, unsigned int nal_ref_idc_1, AP4_AvcSliceHeader& sh1,
                    unsigned int nal_unit_type_2, unsigned int nal_ref_idc_2, AP4_AvcSliceHeader& sh2);
     AP4_AvcSequenceParameterSet* GetSliceSPS(AP4_AvcSliceHeader& sh);
@@ -307,6 +316,8 @@ private:
     AP4_AvcNalParser             m_NalParser;
     AP4_AvcSequenceParameterSet* m_SPS[AP4_AVC_SPS_MAX_ID+1];
     AP4_AvcPictureParameterSet*  m_PPS[AP4_AVC_PPS_MAX_ID+1];
+    AP4_UI32                     m_SPSHash[AP4_AVC_SPS_MAX_ID+1]; // hash of the raw bytes
+    AP4_UI32                     m_PPSHash[AP4_AVC_PPS_MAX_ID+1]; // hash of the raw bytes
 
     // only updated on new VLC NAL Units
     unsigned int                 m_NalUnitType;
@@ -568,3 +568,122 @@ AP4_Eac3Parser::GetBytesAvailable()
 {
     return (m_Bits.GetBytesAvailable());
 }
+
+/*----------------------------------------------------------------------+
+|    AP4_Eac3SpanHeader
++----------------------------------------------------------------------*/
+typedef struct {
+    AP4_Size     m_FrameSize;
+    unsigned int m_SampleRate;
+    unsigned int m_SampleCount;
+    unsigned int m_Strmtyp;
+    unsigned int m_Substreamid;
+} AP4_Eac3SpanHeader;
+
+/*----------------------------------------------------------------------+
+|    AP4_Eac3_ParseSpanHeader
++----------------------------------------------------------------------*/
+static bool
+AP4_Eac3_ParseSpanHeader(const AP4_UI08* header, AP4_Eac3SpanHeader& span_header)
+{
+    // bsi(): strmtyp, substreamid, frmsiz, fscod, fscod2/numblkscod, ... bsid
+    unsigned int bsid = header[5]>>3;
+    if (bsid < 10 || bsid > 16) return false;
+    unsigned int fscod = header[4]>>6;
+    unsigned int numblkscod = (header[4]>>4)&3;
+    if (fscod == 3) {
+        // reduced sample rates, numblkscod is fscod2 and there are always 6 blocks
+        static const unsigned int ReducedSampleRates[3] = {24000, 22050, 16000};
+        if (numblkscod == 3) return false;
+        span_header.m_SampleRate  = ReducedSampleRates[numblkscod];
+        span_header.m_SampleCount = 6*256;
+    } else {
+        span_header.m_SampleRate  = EAC3_SAMPLE_RATE_ARY[fscod];
+        span_header.m_SampleCount = (numblkscod == 3 ? 6 : numblkscod+1)*256;
+    }
+    span_header.m_Strmtyp     = header[2]>>6;
+    span_header.m_Substreamid = (header[2]>>3)&7;
+    span_header.m_FrameSize   = ((((AP4_Size)header[2]&7)<<8 | header[3])+1)*2;
+    return span_header.m_Strmtyp != 3;
+}
+
+/*----------------------------------------------------------------------+
+|    AP4_Eac3Parser::FindFrameSpan
++----------------------------------------------------------------------*/
+AP4_Result
+AP4_Eac3Parser::FindFrameSpan(const AP4_UI08*    data,
+                              AP4_Size           data_size,
+                              AP4_Size&          bytes_consumed,
+                              AP4_Eac3FrameSpan& frame,
+                              bool               eos)
+{
+    AP4_Size offset = 0;
+    for (;;) {
+        offset += AP4_FindSyncWord(data+offset, data_size-offset, AP4_EAC3_SYNC_WORD_BIG_ENDIAN);
+        if (offset+6 > data_size) break;
+
+        AP4_Eac3SpanHeader header;
+        if (AP4_Eac3_ParseSpanHeader(data+offset, header)) {
+            // the access unit ends at the first sync frame that is not a dependent substream
+            AP4_Size end = offset+header.m_FrameSize;
+            bool found = false;
+            if (end > data_size && !eos) {
+                bytes_consumed = offset;
+                return AP4_ERROR_NOT_ENOUGH_DATA;
+            }
+            while (end <= data_size) {
+                AP4_Eac3SpanHeader next_header;
+                if (end+6 > data_size) {
+                    if (!eos) {
+                        bytes_consumed = offset;
+                        return AP4_ERROR_NOT_ENOUGH_DATA;
+                    }
+                    found = true;
+                    break;
+                }
+                if (AP4_BytesToUInt16BE(data+end) != AP4_EAC3_SYNC_WORD_BIG_ENDIAN ||
+                    !AP4_Eac3_ParseSpanHeader(data+end, next_header)) {
+                    // not followed by a sync frame: false sync word, unless
+                    // some dependent frames were already found
+                    found = (end != offset+header.m_FrameSize);
+                    break;
+                }
+                if (next_header.m_Strmtyp != 1) {
+                    found = true;
+                    break;
+                }
+                if (end+next_header.m_FrameSize > data_size) {
+                    if (!eos) {
+                        bytes_consumed = offset;
+                        return AP4_ERROR_NOT_ENOUGH_DATA;
+                    }
+                    // truncated dependent frame at the end of the stream, drop it
+                    found = true;
+                    break;
+                }
+                end += next_header.m_FrameSize;
+            }
+            if (found) {
+                frame.m_Data        = data+offset;
+                frame.m_Size        = end-offset;
+                frame.m_SampleRate  = header.m_SampleRate;
+                frame.m_SampleCount = header.m_SampleCount;
+                frame.m_StreamType  = header.m_Strmtyp;
+                frame.m_SubstreamId = header.m_Substreamid;
+                bytes_consumed = end;
+                return AP4_SUCCESS;
+            }
+        }
+
+        // false sync word, look further
+        ++offset;
+    }
+
+    // keep the last byte, unless at the end, since it may be the start of a sync word
+    if (eos || offset < data_size) {
+        bytes_consumed = eos ? data_size : offset;
+    } else {
+        bytes_consumed = data_size ? data_size-1 : 0;
+    }
+    return AP4_ERROR_NOT_ENOUGH_DATA;
+}
@@ -96,6 +96,15 @@ typedef struct {
     AP4_Flags m_LittleEndian;
 } AP4_Eac3Frame;
 
+typedef struct {
+    const AP4_UI08* m_Data;        // points into the caller's buffer
+    AP4_Size        m_Size;
+    AP4_UI32        m_SampleRate;
+    AP4_UI32        m_SampleCount; // 256 per audio block
+    AP4_UI32        m_StreamType;  // strmtyp of the first sync frame
+    AP4_UI32        m_SubstreamId; // substreamid of the first sync frame
+} AP4_Eac3FrameSpan;
+
 class AP4_Eac3Parser {
 public:
     // constructor and destructor
@@ -112,6 +121,22 @@ public:
     AP4_Size   GetBytesFree();
     AP4_Size   GetBytesAvailable();
 
+    // class methods
+    /**
+     * Find the next (big-endian) access unit in a buffer, decoding only the
+     * fields of the headers needed to compute its size and duration. Like
+     * the frames returned by FindFrame, an access unit is a sync frame
+     * followed by the dependent substream sync frames that come after it.
+     * The data is not copied: the returned span points into the buffer.
+     * The bytes_consumed and eos parameters work like they do for
+     * AP4_Ac3Parser::FindFrameSpan.
+     */
+    static AP4_Result FindFrameSpan(const AP4_UI08*    data,
+                                    AP4_Size           data_size,
+                                    AP4_Size&          bytes_consumed,
+                                    AP4_Eac3FrameSpan& frame,
+                                    bool               eos = false);
+
 private:
     // methods
     AP4_Result FindHeader(AP4_UI08* header, AP4_Size& skip_size);
@@ -139,37 +139,6 @@ AP4_HevcNalParser::SliceTypeName(unsigned int slice_type)
     }
 }
 
-/*----------------------------------------------------------------------
-|   ReadGolomb
-+---------------------------------------------------------------------*/
-static unsigned int
-ReadGolomb(AP4_BitReader& bits)
-{
-    unsigned int leading_zeros = 0;
-    while (bits.ReadBit() == 0) {
-        leading_zeros++;
-        if (leading_zeros > 32) return 0; // safeguard
-    }
-    if (leading_zeros) {
-        return (1<<leading_zeros)-1+bits.ReadBits(leading_zeros);
-    } else {
-        return 0;
-    }
-}
-
-/*----------------------------------------------------------------------
-|   SignedGolomb
-+---------------------------------------------------------------------*/
-static int
-SignedGolomb(unsigned int code_num)
-{
-    if (code_num % 2) {
-        return (code_num+1)/2;
-    } else {
-        return -((int)code_num/2);
-    }
-}
-
 /*----------------------------------------------------------------------
 |   BitsNeeded
 +---------------------------------------------------------------------*/
@@ -202,17 +171,17 @@ scaling_list_data(AP4_BitReader& bits)
         for (unsigned int matrixId = 0; matrixId < (unsigned int)((sizeId == 3)?2:6); matrixId++) {
             unsigned int flag = bits.ReadBit(); // scaling_list_pred_mode_flag[ sizeId ][ matrixId ]
             if (!flag) {
-                ReadGolomb(bits); // scaling_list_pred_matrix_id_delta[ sizeId ][ matrixId ]
+                bits.ReadUE(); // scaling_list_pred_matrix_id_delta[ sizeId ][ matrixId ]
             } else {
                 // nextCoef = 8;
                 unsigned int coefNum = (1 << (4+(sizeId << 1)));
                 if (coefNum > 64) coefNum = 64;
                 if (sizeId > 1) {
-                    ReadGolomb(bits); // scaling_list_dc_coef_minus8[ sizeId − 2 ][ matrixId ]
+                    bits.ReadUE(); // scaling_list_dc_coef_minus8[ sizeId − 2 ][ matrixId ]
                     // nextCoef = scaling_list_dc_coef_minus8[ sizeId − 2 ][ matrixId ] + 8
                 }
                 for (unsigned i = 0; i < coefNum; i++) {
-                    ReadGolomb(bits); // scaling_list_delta_coef
+                    bits.ReadUE(); // scaling_list_delta_coef
                     // nextCoef = ( nextCoef + scaling_list_delta_coef + 256 ) % 256
                     // ScalingList[ sizeId ][ matrixId ][ i ] = nextCoef
                 }
@@ -239,10 +208,10 @@ parse_st_ref_pic_set(AP4_HevcShortTermRefPicSet*         rps,
     if (inter_ref_pic_set_prediction_flag) {
         unsigned int delta_idx_minus1 = 0;
         if (stRpsIdx == num_short_term_ref_pic_sets) {
-            delta_idx_minus1 = ReadGolomb(bits);
+            delta_idx_minus1 = bits.ReadUE();
         }
         /* delta_rps_sign = */ bits.ReadBit();
-        /* abs_delta_rps_minus1 = */ ReadGolomb(bits);
+        /* abs_delta_rps_minus1 = */ bits.ReadUE();
         if (delta_idx_minus1+1 > stRpsIdx) return AP4_ERROR_INVALID_FORMAT; // should not happen
         unsigned int RefRpsIdx = stRpsIdx - (delta_idx_minus1 + 1);
         unsigned int NumDeltaPocs = sps->short_term_ref_pic_sets[RefRpsIdx].num_delta_pocs;
@@ -257,18 +226,18 @@ parse_st_ref_pic_set(AP4_HevcShortTermRefPicSet*         rps,
             }
         }
     } else {
-        rps->num_negative_pics = ReadGolomb(bits);
-        rps->num_positive_pics = ReadGolomb(bits);
+        rps->num_negative_pics = bits.ReadUE();
+        rps->num_positive_pics = bits.ReadUE();
         if (rps->num_negative_pics > 16 || rps->num_positive_pics > 16) {
             return AP4_ERROR_INVALID_FORMAT;
         }
         rps->num_delta_pocs = rps->num_negative_pics + rps->num_positive_pics;
         for (unsigned int i=0; i<rps->num_negative_pics; i++) {
-            rps->delta_poc_s0_minus1[i] = ReadGolomb(bits);
+            rps->delta_poc_s0_minus1[i] = bits.ReadUE();
             rps->used_by_curr_pic_s0_flag[i] = bits.ReadBit();
         }
         for (unsigned i=0; i<rps->num_positive_pics; i++) {
-            rps->delta_poc_s1_minus1[i] = ReadGolomb(bits);
+            rps->delta_poc_s1_minus1[i] = bits.ReadUE();
             rps->used_by_curr_pic_s1_flag[i] = bits.ReadBit();
         }
     }
@@ -319,6 +288,37 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
                                   unsigned int                   nal_unit_type,
                                   AP4_HevcPictureParameterSet**  picture_parameter_sets,
                                   AP4_HevcSequenceParameterSet** sequence_parameter_sets) {
+    // only unescape the beginning of the slice segment, unless the header
+    // turns out to be longer than that
+    AP4_DataBuffer unescaped;
+    AP4_Size consumed = AP4_NalParser::Unescape(data, data_size, unescaped, AP4_HEVC_SLICE_HEADER_UNESCAPE_SIZE);
+    AP4_Result result = ParseUnescaped(unescaped.GetData(),
+                                       unescaped.GetDataSize(),
+                                       nal_unit_type,
+                                       picture_parameter_sets,
+                                       sequence_parameter_sets);
+    if (consumed < data_size &&
+        (AP4_FAILED(result) || size > 8*unescaped.GetDataSize())) {
+        AP4_NalParser::Unescape(data, data_size, unescaped, data_size);
+        result = ParseUnescaped(unescaped.GetData(),
+                                unescaped.GetDataSize(),
+                                nal_unit_type,
+                                picture_parameter_sets,
+                                sequence_parameter_sets);
+    }
+    
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HevcSliceSegmentHeader::ParseUnescaped
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_HevcSliceSegmentHeader::ParseUnescaped(const AP4_UI08*                data,
+                                           unsigned int                   data_size,
+                                           unsigned int                   nal_unit_type,
+                                           AP4_HevcPictureParameterSet**  picture_parameter_sets,
+                                           AP4_HevcSequenceParameterSet** sequence_parameter_sets) {
     // initialize all members to 0
     AP4_SetMemory(this, 0, sizeof(*this));
     
@@ -326,15 +326,13 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
     pic_output_flag = 1;
 
     // start the parser
-    AP4_DataBuffer unescaped(data, data_size);
-    AP4_NalParser::Unescape(unescaped);
-    AP4_BitReader bits(unescaped.GetData(), unescaped.GetDataSize());
+    AP4_BitReader bits(data, data_size);
 
     first_slice_segment_in_pic_flag = bits.ReadBit();
     if (nal_unit_type >= AP4_HEVC_NALU_TYPE_BLA_W_LP && nal_unit_type <= AP4_HEVC_NALU_TYPE_RSV_IRAP_VCL23) {
         no_output_of_prior_pics_flag = bits.ReadBit();
     }
-    slice_pic_parameter_set_id = ReadGolomb(bits);
+    slice_pic_parameter_set_id = bits.ReadUE();
     if (slice_pic_parameter_set_id > AP4_HEVC_PPS_MAX_ID) {
         return AP4_ERROR_INVALID_FORMAT;
     }
@@ -376,7 +374,7 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
             bits.ReadBits(pps->num_extra_slice_header_bits); // slice_reserved_flag[...]
         }
     
-        slice_type = ReadGolomb(bits);
+        slice_type = bits.ReadUE();
         if (slice_type != AP4_HEVC_SLICE_TYPE_B && slice_type != AP4_HEVC_SLICE_TYPE_P && slice_type != AP4_HEVC_SLICE_TYPE_I) {
             return AP4_ERROR_INVALID_FORMAT;
         }
@@ -409,9 +407,9 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
             
             if (sps->long_term_ref_pics_present_flag) {
                 if (sps->num_long_term_ref_pics_sps > 0) {
-                    num_long_term_sps = ReadGolomb(bits);
+                    num_long_term_sps = bits.ReadUE();
                 }
-                num_long_term_pics = ReadGolomb(bits);
+                num_long_term_pics = bits.ReadUE();
                 
                 if (num_long_term_sps > sps->num_long_term_ref_pics_sps) {
                     return AP4_ERROR_INVALID_FORMAT;
@@ -430,7 +428,7 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
                     }
                     unsigned int delta_poc_msb_present_flag /*[i]*/ = bits.ReadBit();
                     if (delta_poc_msb_present_flag /*[i]*/) {
-                        /* delta_poc_msb_cycle_lt[i] = */ ReadGolomb(bits);
+                        /* delta_poc_msb_cycle_lt[i] = */ bits.ReadUE();
                     }
                 }
             }
@@ -450,9 +448,9 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
             unsigned int num_ref_idx_l1_active_minus1 = pps->num_ref_idx_l1_default_active_minus1;
             unsigned int num_ref_idx_active_override_flag = bits.ReadBit();
             if (num_ref_idx_active_override_flag) {
-                num_ref_idx_l0_active_minus1 = ReadGolomb(bits);
+                num_ref_idx_l0_active_minus1 = bits.ReadUE();
                 if (slice_type == AP4_HEVC_SLICE_TYPE_B) {
-                    num_ref_idx_l1_active_minus1 = ReadGolomb(bits);
+                    num_ref_idx_l1_active_minus1 = bits.ReadUE();
                 }
             }
             if (num_ref_idx_l0_active_minus1 > 14 || num_ref_idx_l1_active_minus1 > 14) {
@@ -489,15 +487,15 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
                 }
                 if (( collocated_from_l0_flag && num_ref_idx_l0_active_minus1 > 0) ||
                     (!collocated_from_l0_flag && num_ref_idx_l1_active_minus1 > 0)) {
-                    /* collocated_ref_idx = */ ReadGolomb(bits);
+                    /* collocated_ref_idx = */ bits.ReadUE();
                 }
             }
             if ((pps->weighted_pred_flag   && slice_type == AP4_HEVC_SLICE_TYPE_P) ||
                 (pps->weighted_bipred_flag && slice_type == AP4_HEVC_SLICE_TYPE_B)) {
                 // +++ pred_weight_table()
-                /* luma_log2_weight_denom = */ ReadGolomb(bits);
+                /* luma_log2_weight_denom = */ bits.ReadUE();
                 if (sps->chroma_format_idc != 0) {
-                    /* delta_chroma_log2_weight_denom = */ /* SignedGolomb( */ ReadGolomb(bits) /*)*/;
+                    /* delta_chroma_log2_weight_denom = */ bits.ReadSE();
                 }
                 unsigned int luma_weight_l0_flag[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
                 for (unsigned int i=0; i<=num_ref_idx_l0_active_minus1; i++) {
@@ -511,13 +509,13 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
                 }
                 for (unsigned int i=0; i<=num_ref_idx_l0_active_minus1; i++) {
                     if (luma_weight_l0_flag[i]) {
-                        /* delta_luma_weight_l0[i] = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
-                        /* luma_offset_l0[i] = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
+                        /* delta_luma_weight_l0[i] = */ bits.ReadSE();
+                        /* luma_offset_l0[i] = */ bits.ReadSE();
                     }
                     if (chroma_weight_l0_flag[i]) {
                         for (unsigned int j=0; j<2; j++) {
-                            /* delta_chroma_weight_l0[i][j] = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
-                            /* delta_chroma_offset_l0[i][j] = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
+                            /* delta_chroma_weight_l0[i][j] = */ bits.ReadSE();
+                            /* delta_chroma_offset_l0[i][j] = */ bits.ReadSE();
                         }
                     }
                 }
@@ -534,25 +532,25 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
                     }
                     for (unsigned int i=0; i<=num_ref_idx_l1_active_minus1; i++) {
                         if (luma_weight_l1_flag[i]) {
-                            /* delta_luma_weight_l1[i] = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
-                            /* luma_offset_l1[i] = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
+                            /* delta_luma_weight_l1[i] = */ bits.ReadSE();
+                            /* luma_offset_l1[i] = */ bits.ReadSE();
                         }
                         if (chroma_weight_l1_flag[i]) {
                             for (unsigned int j=0; j<2; j++) {
-                                /* delta_chroma_weight_l1[i][j] = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
-                                /* delta_chroma_offset_l1[i][j] = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
+                                /* delta_chroma_weight_l1[i][j] = */ bits.ReadSE();
+                                /* delta_chroma_offset_l1[i][j] = */ bits.ReadSE();
                             }
                         }
                     }
                 }
                 // --- pred_weight_table()
             }
-            /* five_minus_max_num_merge_cand = */ ReadGolomb(bits);
+            /* five_minus_max_num_merge_cand = */ bits.ReadUE();
         }
-        /* slice_qp_delta = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
+        /* slice_qp_delta = */ bits.ReadSE();
         if (pps->pps_slice_chroma_qp_offsets_present_flag) {
-            /* slice_cb_qp_offset = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
-            /* slice_cr_qp_offset = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
+            /* slice_cb_qp_offset = */ bits.ReadSE();
+            /* slice_cr_qp_offset = */ bits.ReadSE();
         }
         unsigned int deblocking_filter_override_flag = 0;
         if (pps->deblocking_filter_override_enabled_flag) {
@@ -561,8 +559,8 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
         if (deblocking_filter_override_flag) {
             slice_deblocking_filter_disabled_flag = bits.ReadBit();
             if (!slice_deblocking_filter_disabled_flag) {
-                /* slice_beta_offset_div2 = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
-                /* slice_tc_offset_div2   = */ /*SignedGolomb(*/ ReadGolomb(bits) /*)*/;
+                /* slice_beta_offset_div2 = */ bits.ReadSE();
+                /* slice_tc_offset_div2   = */ bits.ReadSE();
             }
         }
         if (pps->pps_loop_filter_across_slices_enabled_flag &&
@@ -572,9 +570,9 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
     }
 
     if (pps->tiles_enabled_flag || pps->entropy_coding_sync_enabled_flag) {
-        num_entry_point_offsets = ReadGolomb(bits);
+        num_entry_point_offsets = bits.ReadUE();
         if (num_entry_point_offsets > 0 ) {
-            offset_len_minus1 = ReadGolomb(bits);
+            offset_len_minus1 = bits.ReadUE();
             if (offset_len_minus1 > 31) {
                 return AP4_ERROR_INVALID_FORMAT;
             }
@@ -585,7 +583,7 @@ AP4_HevcSliceSegmentHeader::Parse(const AP4_UI08*                data,
     }
 
     if (pps->slice_segment_header_extension_present_flag) {
-        unsigned int slice_segment_header_extension_length = ReadGolomb(bits);
+        unsigned int slice_segment_header_extension_length = bits.ReadUE();
         for (unsigned int i=0; i<slice_segment_header_extension_length; i++) {
             bits.ReadBits(8); // slice_segment_header_extension_data_byte[i]
         }
@@ -772,11 +770,11 @@ AP4_HevcPictureParameterSet::Parse(const unsigned char* data, unsigned int data_
 
     bits.SkipBits(16); // NAL Unit Header
 
-    pps_pic_parameter_set_id = ReadGolomb(bits);
+    pps_pic_parameter_set_id = bits.ReadUE();
     if (pps_pic_parameter_set_id > AP4_HEVC_PPS_MAX_ID) {
         return AP4_ERROR_INVALID_FORMAT;
     }
-    pps_seq_parameter_set_id = ReadGolomb(bits);
+    pps_seq_parameter_set_id = bits.ReadUE();
     if (pps_seq_parameter_set_id > AP4_HEVC_SPS_MAX_ID) {
         return AP4_ERROR_INVALID_FORMAT;
     }
@@ -785,17 +783,17 @@ AP4_HevcPictureParameterSet::Parse(const unsigned char* data, unsigned int data_
     num_extra_slice_header_bits              = bits.ReadBits(3);
     sign_data_hiding_enabled_flag            = bits.ReadBit();
     cabac_init_present_flag                  = bits.ReadBit();
-    num_ref_idx_l0_default_active_minus1     = ReadGolomb(bits);
-    num_ref_idx_l1_default_active_minus1     = ReadGolomb(bits);
-    init_qp_minus26                          = SignedGolomb(ReadGolomb(bits));
+    num_ref_idx_l0_default_active_minus1     = bits.ReadUE();
+    num_ref_idx_l1_default_active_minus1     = bits.ReadUE();
+    init_qp_minus26                          = bits.ReadSE();
     constrained_intra_pred_flag              = bits.ReadBit();
     transform_skip_enabled_flag              = bits.ReadBit();
     cu_qp_delta_enabled_flag                 = bits.ReadBit();
     if (cu_qp_delta_enabled_flag) {
-        diff_cu_qp_delta_depth = ReadGolomb(bits);
+        diff_cu_qp_delta_depth = bits.ReadUE();
     }
-    pps_cb_qp_offset                         = SignedGolomb(ReadGolomb(bits));
-    pps_cr_qp_offset                         = SignedGolomb(ReadGolomb(bits));
+    pps_cb_qp_offset                         = bits.ReadSE();
+    pps_cr_qp_offset                         = bits.ReadSE();
     pps_slice_chroma_qp_offsets_present_flag = bits.ReadBit();
     weighted_pred_flag                       = bits.ReadBit();
     weighted_bipred_flag                     = bits.ReadBit();
@@ -803,15 +801,15 @@ AP4_HevcPictureParameterSet::Parse(const unsigned char* data, unsigned int data_
     tiles_enabled_flag                       = bits.ReadBit();
     entropy_coding_sync_enabled_flag         = bits.ReadBit();
     if (tiles_enabled_flag) {
-        num_tile_columns_minus1 = ReadGolomb(bits);
-        num_tile_rows_minus1    = ReadGolomb(bits);
+        num_tile_columns_minus1 = bits.ReadUE();
+        num_tile_rows_minus1    = bits.ReadUE();
         uniform_spacing_flag    = bits.ReadBit();
         if (!uniform_spacing_flag) {
             for (unsigned int i=0; i<num_tile_columns_minus1; i++) {
-                ReadGolomb(bits); // column_width_minus1[i]
+                bits.ReadUE(); // column_width_minus1[i]
             }
             for (unsigned int i = 0; i < num_tile_rows_minus1; i++) {
-                ReadGolomb(bits); // row_height_minus1[i]
+                bits.ReadUE(); // row_height_minus1[i]
             }
         }
         loop_filter_across_tiles_enabled_flag = bits.ReadBit();
@@ -822,8 +820,8 @@ AP4_HevcPictureParameterSet::Parse(const unsigned char* data, unsigned int data_
         deblocking_filter_override_enabled_flag = bits.ReadBit();
         pps_deblocking_filter_disabled_flag     = bits.ReadBit();
         if (!pps_deblocking_filter_disabled_flag) {
-            pps_beta_offset_div2 = SignedGolomb(ReadGolomb(bits));
-            pps_tc_offset_div2   = SignedGolomb(ReadGolomb(bits));
+            pps_beta_offset_div2 = bits.ReadSE();
+            pps_tc_offset_div2   = bits.ReadSE();
         }
     }
     pps_scaling_list_data_present_flag = bits.ReadBit();
@@ -831,7 +829,7 @@ AP4_HevcPictureParameterSet::Parse(const unsigned char* data, unsigned int data_
         scaling_list_data(bits);
     }
     lists_modification_present_flag = bits.ReadBit();
-    log2_parallel_merge_level_minus2 = ReadGolomb(bits);
+    log2_parallel_merge_level_minus2 = bits.ReadUE();
     slice_segment_header_extension_present_flag = bits.ReadBit();
     
     return AP4_SUCCESS;
@@ -914,28 +912,28 @@ AP4_HevcSequenceParameterSet::Parse(const unsigned char* data, unsigned int data
         return result;
     }
     
-    sps_seq_parameter_set_id = ReadGolomb(bits);
+    sps_seq_parameter_set_id = bits.ReadUE();
     if (sps_seq_parameter_set_id > AP4_HEVC_SPS_MAX_ID) {
         return AP4_ERROR_INVALID_FORMAT;
     }
 
-    chroma_format_idc = ReadGolomb(bits);
+    chroma_format_idc = bits.ReadUE();
     if (chroma_format_idc == 3) {
         separate_colour_plane_flag = bits.ReadBit();
     }
-    pic_width_in_luma_samples  = ReadGolomb(bits);
-    pic_height_in_luma_samples = ReadGolomb(bits);
+    pic_width_in_luma_samples  = bits.ReadUE();
+    pic_height_in_luma_samples = bits.ReadUE();
     conformance_window_flag    = bits.ReadBit();
     
     if (conformance_window_flag) {
-        conf_win_left_offset    = ReadGolomb(bits);
-        conf_win_right_offset   = ReadGolomb(bits);
-        conf_win_top_offset     = ReadGolomb(bits);
-        conf_win_bottom_offset  = ReadGolomb(bits);
-    }
-    bit_depth_luma_minus8                    = ReadGolomb(bits);
-    bit_depth_chroma_minus8                  = ReadGolomb(bits);
-    log2_max_pic_order_cnt_lsb_minus4        = ReadGolomb(bits);
+        conf_win_left_offset    = bits.ReadUE();
+        conf_win_right_offset   = bits.ReadUE();
+        conf_win_top_offset     = bits.ReadUE();
+        conf_win_bottom_offset  = bits.ReadUE();
+    }
+    bit_depth_luma_minus8                    = bits.ReadUE();
+    bit_depth_chroma_minus8                  = bits.ReadUE();
+    log2_max_pic_order_cnt_lsb_minus4        = bits.ReadUE();
     if (log2_max_pic_order_cnt_lsb_minus4 > 16) {
         return AP4_ERROR_INVALID_FORMAT;
     }
@@ -943,16 +941,16 @@ AP4_HevcSequenceParameterSet::Parse(const unsigned char* data, unsigned int data
     for (unsigned int i = (sps_sub_layer_ordering_info_present_flag ? 0 : sps_max_sub_layers_minus1);
                       i <= sps_max_sub_layers_minus1;
                       i++) {
-        sps_max_dec_pic_buffering_minus1[i] = ReadGolomb(bits);
-        sps_max_num_reorder_pics[i]         = ReadGolomb(bits);
-        sps_max_latency_increase_plus1[i]   = ReadGolomb(bits);
-    }
-    log2_min_luma_coding_block_size_minus3   = ReadGolomb(bits);
-    log2_diff_max_min_luma_coding_block_size = ReadGolomb(bits);
-    log2_min_transform_block_size_minus2     = ReadGolomb(bits);
-    log2_diff_max_min_transform_block_size   = ReadGolomb(bits);
-    max_transform_hierarchy_depth_inter      = ReadGolomb(bits);
-    max_transform_hierarchy_depth_intra      = ReadGolomb(bits);
+        sps_max_dec_pic_buffering_minus1[i] = bits.ReadUE();
+        sps_max_num_reorder_pics[i]         = bits.ReadUE();
+        sps_max_latency_increase_plus1[i]   = bits.ReadUE();
+    }
+    log2_min_luma_coding_block_size_minus3   = bits.ReadUE();
+    log2_diff_max_min_luma_coding_block_size = bits.ReadUE();
+    log2_min_transform_block_size_minus2     = bits.ReadUE();
+    log2_diff_max_min_transform_block_size   = bits.ReadUE();
+    max_transform_hierarchy_depth_inter      = bits.ReadUE();
+    max_transform_hierarchy_depth_intra      = bits.ReadUE();
     scaling_list_enabled_flag                = bits.ReadBit();
     if (scaling_list_enabled_flag) {
         sps_scaling_list_data_present_flag = bits.ReadBit();
@@ -966,11 +964,11 @@ AP4_HevcSequenceParameterSet::Parse(const unsigned char* data, unsigned int data
     if (pcm_enabled_flag) {
         pcm_sample_bit_depth_luma_minus1 = bits.ReadBits(4);
         pcm_sample_bit_depth_chroma_minus1 = bits.ReadBits(4);
-        log2_min_pcm_luma_coding_block_size_minus3 = ReadGolomb(bits);
-        log2_diff_max_min_pcm_luma_coding_block_size = ReadGolomb(bits);
+        log2_min_pcm_luma_coding_block_size_minus3 = bits.ReadUE();
+        log2_diff_max_min_pcm_luma_coding_block_size = bits.ReadUE();
         pcm_loop_filter_disabled_flag = bits.ReadBit();
     }
-    num_short_term_ref_pic_sets = ReadGolomb(bits);
+    num_short_term_ref_pic_sets = bits.ReadUE();
     if (num_short_term_ref_pic_sets > AP4_HEVC_SPS_MAX_RPS) {
         return AP4_ERROR_INVALID_FORMAT;
     }
@@ -980,7 +978,7 @@ AP4_HevcSequenceParameterSet::Parse(const unsigned char* data, unsigned int data
     }
     long_term_ref_pics_present_flag = bits.ReadBit();
     if (long_term_ref_pics_present_flag) {
-        num_long_term_ref_pics_sps = ReadGolomb(bits);
+        num_long_term_ref_pics_sps = bits.ReadUE();
         for (unsigned int i=0; i<num_long_term_ref_pics_sps; i++) {
             /* lt_ref_pic_poc_lsb_sps[i] = */ bits.ReadBits(log2_max_pic_order_cnt_lsb_minus4 + 4);
             /* used_by_curr_pic_lt_sps_flag[i] = */ bits.ReadBit();
@@ -1069,12 +1067,12 @@ AP4_HevcVideoParameterSet::Parse(const unsigned char* data, unsigned int data_si
     for (unsigned int i = (vps_sub_layer_ordering_info_present_flag ? 0 : vps_max_sub_layers_minus1);
                       i <= vps_max_sub_layers_minus1;
                       i++) {
-        vps_max_dec_pic_buffering_minus1[i] = ReadGolomb(bits);
-        vps_max_num_reorder_pics[i]         = ReadGolomb(bits);
-        vps_max_latency_increase_plus1[i]   = ReadGolomb(bits);
+        vps_max_dec_pic_buffering_minus1[i] = bits.ReadUE();
+        vps_max_num_reorder_pics[i]         = bits.ReadUE();
+        vps_max_latency_increase_plus1[i]   = bits.ReadUE();
     }
     vps_max_layer_id          = bits.ReadBits(6);
-    vps_num_layer_sets_minus1 = ReadGolomb(bits);
+    vps_num_layer_sets_minus1 = bits.ReadUE();
     for (unsigned int i = 1; i <= vps_num_layer_sets_minus1; i++) {
         for (unsigned int j = 0; j <= vps_max_layer_id; j++) {
             bits.ReadBit();
@@ -1086,13 +1084,42 @@ AP4_HevcVideoParameterSet::Parse(const unsigned char* data, unsigned int data_si
         vps_time_scale                      = bits.ReadBits(32);
         vps_poc_proportional_to_timing_flag = bits.ReadBit();
         if (vps_poc_proportional_to_timing_flag) {
-            vps_num_ticks_poc_diff_one_minus1 = ReadGolomb(bits);
+            vps_num_ticks_poc_diff_one_minus1 = bits.ReadUE();
         }
     }
     
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_HevcFrameParser_ReadParameterSetId
++---------------------------------------------------------------------*/
+static unsigned int
+AP4_HevcFrameParser_ReadParameterSetId(const AP4_UI08* data,
+                                       AP4_Size        data_size,
+                                       unsigned int    nal_unit_type)
+{
+    // the id comes right after the NAL unit header in a VPS or PPS, and
+    // after the profile_tier_level in a SPS, so only the first bytes
+    // need to be unescaped
+    AP4_DataBuffer unescaped;
+    AP4_NalParser::Unescape(data, data_size, unescaped, 128);
+    AP4_BitReader bits(unescaped.GetData(), unescaped.GetDataSize());
+    bits.SkipBits(16); // NAL Unit Header
+    if (nal_unit_type == AP4_HEVC_NALU_TYPE_VPS_NUT) {
+        return bits.ReadBits(4);
+    } else if (nal_unit_type == AP4_HEVC_NALU_TYPE_SPS_NUT) {
+        bits.SkipBits(4); // sps_video_parameter_set_id
+        unsigned int sps_max_sub_layers_minus1 = bits.ReadBits(3);
+        bits.SkipBits(1); // sps_temporal_id_nesting_flag
+        AP4_HevcProfileTierLevel profile_tier_level;
+        if (AP4_FAILED(profile_tier_level.Parse(bits, sps_max_sub_layers_minus1))) {
+            return AP4_HEVC_SPS_MAX_ID+1;
+        }
+    }
+    return bits.ReadUE();
+}
+
 /*----------------------------------------------------------------------
 |   AP4_HevcFrameParser::AP4_HevcFrameParser
 +---------------------------------------------------------------------*/
@@ -1110,12 +1137,15 @@ AP4_HevcFrameParser::AP4_HevcFrameParser() :
 {
     for (unsigned int i=0; i<=AP4_HEVC_PPS_MAX_ID; i++) {
         m_PPS[i] = NULL;
+        m_PPSHash[i] = 0;
     }
     for (unsigned int i=0; i<=AP4_HEVC_SPS_MAX_ID; i++) {
         m_SPS[i] = NULL;
+        m_SPSHash[i] = 0;
     }
     for (unsigned int i=0; i<=AP4_HEVC_VPS_MAX_ID; i++) {
         m_VPS[i] = NULL;
+        m_VPSHash[i] = 0;
     }
 }
 
@@ -1229,10 +1259,11 @@ AP4_HevcFrameParser::Feed(const void*     data,
                           AccessUnitInfo& access_unit_info,
                           bool            eos)
 {
-    const AP4_DataBuffer* nal_unit = NULL;
+    const AP4_UI08* nal_unit      = NULL;
+    AP4_Size        nal_unit_size = 0;
 
     // feed the NAL unit parser
-    AP4_Result result = m_NalParser.Feed(data, data_size, bytes_consumed, nal_unit, eos);
+    AP4_Result result = m_NalParser.Feed(data, data_size, bytes_consumed, nal_unit, nal_unit_size, eos);
     if (AP4_FAILED(result)) {
         return result;
     }
@@ -1242,10 +1273,7 @@ AP4_HevcFrameParser::Feed(const void*     data,
         eos = false;
     }
     
-    return Feed(nal_unit ? nal_unit->GetData() : NULL,
-                nal_unit ? nal_unit->GetDataSize() : 0,
-                access_unit_info,
-                eos);
+    return Feed(nal_unit, nal_unit_size, access_unit_info, eos);
 }
 
 /*----------------------------------------------------------------------
@@ -1346,46 +1374,73 @@ AP4_HevcFrameParser::Feed(const AP4_UI08* nal_unit,
 
             CheckIfAccessUnitIsCompleted(access_unit_info);
         } else if (nal_unit_type == AP4_HEVC_NALU_TYPE_PPS_NUT) {
-            AP4_HevcPictureParameterSet* pps = new AP4_HevcPictureParameterSet;
-            result = pps->Parse(nal_unit, nal_unit_size);
-            if (AP4_FAILED(result)) {
-                DBG_PRINTF_0("PPS ERROR!!!");
-                delete pps;
-                return AP4_ERROR_INVALID_FORMAT;
+            // parameter sets are often repeated unchanged, only parse new ones
+            AP4_UI32     hash   = AP4_NalParser::ComputeHash(nal_unit, nal_unit_size);
+            unsigned int pps_id = AP4_HevcFrameParser_ReadParameterSetId(nal_unit, nal_unit_size, nal_unit_type);
+            if (pps_id <= AP4_HEVC_PPS_MAX_ID &&
+                AP4_NalParser::IsSameParameterSet(m_PPS[pps_id], m_PPSHash[pps_id], nal_unit, nal_unit_size, hash)) {
+                DBG_PRINTF_0("PPS unchanged");
+            } else {
+                AP4_HevcPictureParameterSet* pps = new AP4_HevcPictureParameterSet;
+                result = pps->Parse(nal_unit, nal_unit_size);
+                if (AP4_FAILED(result)) {
+                    DBG_PRINTF_0("PPS ERROR!!!");
+                    delete pps;
+                    return AP4_ERROR_INVALID_FORMAT;
+                }
+                delete m_PPS[pps->pps_pic_parameter_set_id];
+                m_PPS[pps->pps_pic_parameter_set_id] = pps;
+                m_PPSHash[pps->pps_pic_parameter_set_id] = hash;
+                DBG_PRINTF_2("PPS pps_id=%d, sps_id=%d", pps->pps_pic_parameter_set_id, pps->pps_seq_parameter_set_id);
             }
-            delete m_PPS[pps->pps_pic_parameter_set_id];
-            m_PPS[pps->pps_pic_parameter_set_id] = pps;
-            DBG_PRINTF_2("PPS pps_id=%d, sps_id=%d", pps->pps_pic_parameter_set_id, pps->pps_seq_parameter_set_id);
             
             // keep the PPS with the NAL unit (this is optional)
             AppendNalUnitData(nal_unit, nal_unit_size);
             CheckIfAccessUnitIsCompleted(access_unit_info);
         } else if (nal_unit_type == AP4_HEVC_NALU_TYPE_SPS_NUT) {
-            AP4_HevcSequenceParameterSet* sps = new AP4_HevcSequenceParameterSet;
-            result = sps->Parse(nal_unit, nal_unit_size);
-            if (AP4_FAILED(result)) {
-                DBG_PRINTF_0("SPS ERROR!!!\n");
-                delete sps;
-                return AP4_ERROR_INVALID_FORMAT;
+            // parameter sets are often repeated unchanged, only parse new ones
+            AP4_UI32     hash   = AP4_NalParser::ComputeHash(nal_unit, nal_unit_size);
+            unsigned int sps_id = AP4_HevcFrameParser_ReadParameterSetId(nal_unit, nal_unit_size, nal_unit_type);
+            if (sps_id <= AP4_HEVC_SPS_MAX_ID &&
+                AP4_NalParser::IsSameParameterSet(m_SPS[sps_id], m_SPSHash[sps_id], nal_unit, nal_unit_size, hash)) {
+                DBG_PRINTF_0("SPS unchanged");
+            } else {
+                AP4_HevcSequenceParameterSet* sps = new AP4_HevcSequenceParameterSet;
+                result = sps->Parse(nal_unit, nal_unit_size);
+                if (AP4_FAILED(result)) {
+                    DBG_PRINTF_0("SPS ERROR!!!\n");
+                    delete sps;
+                    return AP4_ERROR_INVALID_FORMAT;
+                }
+                delete m_SPS[sps->sps_seq_parameter_set_id];
+                m_SPS[sps->sps_seq_parameter_set_id] = sps;
+                m_SPSHash[sps->sps_seq_parameter_set_id] = hash;
+                DBG_PRINTF_2("SPS sps_id=%d, vps_id=%d", sps->sps_seq_parameter_set_id, sps->sps_video_parameter_set_id);
             }
-            delete m_SPS[sps->sps_seq_parameter_set_id];
-            m_SPS[sps->sps_seq_parameter_set_id] = sps;
-            DBG_PRINTF_2("SPS sps_id=%d, vps_id=%d", sps->sps_seq_parameter_set_id, sps->sps_video_parameter_set_id);
             
             // keep the SPS with the NAL unit (this is optional)
             AppendNalUnitData(nal_unit, nal_unit_size);
             CheckIfAccessUnitIsCompleted(access_unit_info);
         } else if (nal_unit_type == AP4_HEVC_NALU_TYPE_VPS_NUT) {
-            AP4_HevcVideoParameterSet* vps = new AP4_HevcVideoParameterSet;
-            result = vps->Parse(nal_unit, nal_unit_size);
-            if (AP4_FAILED(result)) {
-                DBG_PRINTF_0("VPS ERROR!!!\n");
-                delete vps;
-                return AP4_ERROR_INVALID_FORMAT;
+            // parameter sets are often repeated unchanged, only parse new ones
+            AP4_UI32     hash   = AP4_NalParser::ComputeHash(nal_unit, nal_unit_size);
+            unsigned int vps_id = AP4_HevcFrameParser_ReadParameterSetId(nal_unit, nal_unit_size, nal_unit_type);
+            if (vps_id <= AP4_HEVC_VPS_MAX_ID &&
+                AP4_NalParser::IsSameParameterSet(m_VPS[vps_id], m_VPSHash[vps_id], nal_unit, nal_unit_size, hash)) {
+                DBG_PRINTF_0("VPS unchanged");
+            } else {
+                AP4_HevcVideoParameterSet* vps = new AP4_HevcVideoParameterSet;
+                result = vps->Parse(nal_unit, nal_unit_size);
+                if (AP4_FAILED(result)) {
+                    DBG_PRINTF_0("VPS ERROR!!!\n");
+                    delete vps;
+                    return AP4_ERROR_INVALID_FORMAT;
+                }
+                delete m_VPS[vps->vps_video_parameter_set_id];
+                m_VPS[vps->vps_video_parameter_set_id] = vps;
+                m_VPSHash[vps->vps_video_parameter_set_id] = hash;
+                DBG_PRINTF_1("VPS vps_id=%d", vps->vps_video_parameter_set_id);
             }
-            delete m_VPS[vps->vps_video_parameter_set_id];
-            m_VPS[vps->vps_video_parameter_set_id] = vps;
-            DBG_PRINTF_1("VPS vps_id=%d", vps->vps_video_parameter_set_id);
             
             // keep the VPS with the NAL unit (this is optional)
             AppendNalUnitData(nal_unit, nal_unit_size);
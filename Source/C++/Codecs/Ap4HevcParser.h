@@ -110,6 +110,10 @@ const unsigned int AP4_HEVC_SLICE_TYPE_B = 0;
 const unsigned int AP4_HEVC_SLICE_TYPE_P = 1;
 const unsigned int AP4_HEVC_SLICE_TYPE_I = 2;
 
+// number of bytes unescaped before parsing a slice segment header (more
+// are unescaped if the header is longer)
+const unsigned int AP4_HEVC_SLICE_HEADER_UNESCAPE_SIZE = 512;
+
 /*----------------------------------------------------------------------
 |   class references
 +---------------------------------------------------------------------*/
@@ -366,6 +370,11 @@ struct AP4_HevcSliceSegmentHeader {
                      unsigned int                   nal_unit_type,
                      AP4_HevcPictureParameterSet**  picture_parameter_sets,
                      AP4_HevcSequenceParameterSet** sequence_parameter_sets);
+    AP4_Result ParseUnescaped(const AP4_UI08*                data,
+                              unsigned int                   data_size,
+                              unsigned int                   nal_unit_type,
+                              AP4_HevcPictureParameterSet**  picture_parameter_sets,
+                              AP4_HevcSequenceParameterSet** sequence_parameter_sets);
 
     unsigned int size; // size of the parsed data
     
@@ -486,6 +495,9 @@ private:
     AP4_HevcPictureParameterSet*  m_PPS[AP4_HEVC_PPS_MAX_ID+1];
     AP4_HevcSequenceParameterSet* m_SPS[AP4_HEVC_SPS_MAX_ID+1];
     AP4_HevcVideoParameterSet*    m_VPS[AP4_HEVC_VPS_MAX_ID+1];
+    AP4_UI32                      m_PPSHash[AP4_HEVC_PPS_MAX_ID+1]; // hash of the raw bytes
+    AP4_UI32                      m_SPSHash[AP4_HEVC_SPS_MAX_ID+1]; // hash of the raw bytes
+    AP4_UI32                      m_VPSHash[AP4_HEVC_VPS_MAX_ID+1]; // hash of the raw bytes
 
     // accumulator for NAL unit data
     unsigned int               m_TotalNalUnitCount;
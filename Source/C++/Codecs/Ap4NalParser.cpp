@@ -41,32 +41,125 @@ AP4_NalParser::AP4_NalParser() :
 {
 }
 
+/*----------------------------------------------------------------------
+|   AP4_NalParser_FindPrefix
+|
+|   Find the first position where two zero bytes are followed by a byte b
+|   such that (b & mask) == value, for start code detection (00 00 01),
+|   emulation prevention byte removal (00 00 03) and insertion (00 00 0x,
+|   x <= 3).
++---------------------------------------------------------------------*/
+static AP4_Size
+AP4_NalParser_FindPrefix(const AP4_UI08* data, AP4_Size data_size, AP4_UI08 mask, AP4_UI08 value)
+{
+    const AP4_UI08 pattern[3] = { 0x00, 0x00, value };
+    const AP4_UI08 masks[3]   = { 0xFF, 0xFF, mask  };
+    return AP4_FindBytePattern(data, data_size, pattern, masks, 3);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_NalParser_Unescape
+|
+|   Copy escaped data to an output buffer (which may be the input buffer
+|   itself), without the emulation prevention bytes, until max_out_size
+|   bytes have been produced. When out is NULL, nothing is copied.
+|   Returns the number of bytes produced, and the number of input bytes
+|   used to produce them in in_consumed.
++---------------------------------------------------------------------*/
+static AP4_Size
+AP4_NalParser_Unescape(const AP4_UI08* in,
+                       AP4_Size        in_size,
+                       AP4_UI08*       out,
+                       AP4_Size        max_out_size,
+                       AP4_Size&       in_consumed)
+{
+    AP4_Size produced  = 0;
+    AP4_Size run_start = 0; // start of the run of bytes to copy
+    AP4_Size position  = 0; // where to continue looking for 00 00 03
+    for (;;) {
+        AP4_Size prefix = position+AP4_NalParser_FindPrefix(in+position, in_size-position, 0xFF, 0x03);
+        AP4_Size run_end = in_size;
+        if (prefix < in_size) {
+            // the 03 is only an emulation prevention byte when preceded
+            // by exactly two zeros, and followed by a byte <= 3
+            if ((prefix && in[prefix-1] == 0) || prefix+3 >= in_size || in[prefix+3] > 3) {
+                position = prefix+3;
+                continue;
+            }
+            run_end = prefix+2;
+        }
+        
+        // copy the run
+        AP4_Size run_size = run_end-run_start;
+        bool     done = false;
+        if (produced+run_size >= max_out_size) {
+            run_size = max_out_size-produced;
+            done = true;
+        }
+        if (out && out+produced != in+run_start) {
+            AP4_MoveMemory(out+produced, in+run_start, run_size);
+        }
+        produced += run_size;
+        if (done || run_end == in_size) {
+            in_consumed = run_start+run_size;
+            return produced;
+        }
+        
+        // skip the emulation prevention byte
+        run_start = position = run_end+1;
+    }
+}
+
 /*----------------------------------------------------------------------
 |   AP4_NalParser::Unescape
 +---------------------------------------------------------------------*/
 void
 AP4_NalParser::Unescape(AP4_DataBuffer &data)
 {
-    unsigned int zero_count = 0;
-    unsigned int bytes_removed = 0;
-    AP4_UI08* out      = data.UseData();
-    const AP4_UI08* in = data.GetData();
-    AP4_Size  in_size  = data.GetDataSize();
-    
-    for (unsigned int i=0; i<in_size; i++) {
-        if (zero_count == 2 && in[i] == 3 && i+1 < in_size && in[i+1] <= 3) {
-            ++bytes_removed;
-            zero_count = 0;
-        } else {
-            out[i-bytes_removed] = in[i];
-            if (in[i] == 0) {
-                ++zero_count;
-            } else {
-                zero_count = 0;
-            }
-        }
+    AP4_Size in_consumed = 0;
+    AP4_Size out_size = AP4_NalParser_Unescape(data.GetData(),
+                                               data.GetDataSize(),
+                                               data.UseData(),
+                                               data.GetDataSize(),
+                                               in_consumed);
+    data.SetDataSize(out_size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_NalParser::Unescape
++---------------------------------------------------------------------*/
+AP4_Size
+AP4_NalParser::Unescape(const AP4_UI08* data,
+                        AP4_Size        data_size,
+                        AP4_DataBuffer& unescaped,
+                        AP4_Size        max_unescaped_size)
+{
+    if (max_unescaped_size > data_size) max_unescaped_size = data_size;
+    unescaped.SetDataSize(0);
+    if (AP4_FAILED(unescaped.Reserve(max_unescaped_size))) return 0;
+    AP4_Size in_consumed = 0;
+    AP4_Size out_size = AP4_NalParser_Unescape(data,
+                                               data_size,
+                                               unescaped.UseData(),
+                                               max_unescaped_size,
+                                               in_consumed);
+    unescaped.SetDataSize(out_size);
+    return in_consumed;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_NalParser::ComputeHash
++---------------------------------------------------------------------*/
+AP4_UI32
+AP4_NalParser::ComputeHash(const AP4_UI08* data, AP4_Size data_size)
+{
+    // 32-bit FNV-1a
+    AP4_UI32 hash = 0x811C9DC5;
+    for (unsigned int i=0; i<data_size; i++) {
+        hash ^= data[i];
+        hash *= 0x01000193;
     }
-    data.SetDataSize(in_size-bytes_removed);
+    return hash;
 }
 
 /*----------------------------------------------------------------------
@@ -77,32 +170,50 @@ AP4_NalParser::CountEmulationPreventionBytes(const AP4_UI08* data,
                                              unsigned int    data_size,
                                              unsigned int    unescaped_size)
 {
-    unsigned int zero_count = 0;
-    unsigned int bytes_produced = 0;
-    unsigned int emulation_prevention_bytes = 0;
-    
-    // shortcut
-    if (data_size <= 2) {
-        // no escaping possible in just 2 bytes
-        return 0;
-    }
-    
-    for (unsigned int i=0; i<data_size; i++) {
-        if (zero_count == 2 && data[i] == 3 && i+1 < data_size && data[i+1] <= 3) {
-            ++emulation_prevention_bytes;
-            zero_count = 0;
-        } else {
-            if (++bytes_produced >= unescaped_size) {
-                break;
-            }
-            if (data[i] == 0) {
-                ++zero_count;
-            } else {
-                zero_count = 0;
-            }
-        }
+    AP4_Size in_consumed = 0;
+    AP4_Size out_size = AP4_NalParser_Unescape(data, data_size, NULL, unescaped_size, in_consumed);
+    return in_consumed-out_size;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_NalParser::Escape
++---------------------------------------------------------------------*/
+void
+AP4_NalParser::Escape(const AP4_UI08* data, AP4_Size data_size, AP4_DataBuffer& escaped)
+{
+    // at most one byte is inserted for every two input bytes
+    escaped.SetDataSize(0);
+    if (AP4_FAILED(escaped.Reserve(data_size+data_size/2))) return;
+    AP4_UI08* out       = escaped.UseData();
+    AP4_Size  out_size  = 0;
+    AP4_Size  run_start = 0;
+    AP4_Size  position  = 0;
+    for (;;) {
+        // look for 00 00 followed by 00, 01, 02 or 03
+        AP4_Size prefix = position+AP4_NalParser_FindPrefix(data+position, data_size-position, 0xFC, 0x00);
+        if (prefix >= data_size) break;
+        
+        // copy up to and including the two zeros, and insert a 03
+        AP4_CopyMemory(out+out_size, data+run_start, prefix+2-run_start);
+        out_size += prefix+2-run_start;
+        out[out_size++] = 3;
+        run_start = prefix+2;
+        
+        // a zero after the inserted byte counts towards the next prefix
+        position = data[prefix+2] ? prefix+3 : prefix+2;
     }
-    return emulation_prevention_bytes;
+    AP4_CopyMemory(out+out_size, data+run_start, data_size-run_start);
+    out_size += data_size-run_start;
+    escaped.SetDataSize(out_size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_NalParser::FindStartCode
++---------------------------------------------------------------------*/
+AP4_Size
+AP4_NalParser::FindStartCode(const AP4_UI08* data, AP4_Size data_size)
+{
+    return AP4_NalParser_FindPrefix(data, data_size, 0xFF, 0x01);
 }
 
 /*----------------------------------------------------------------------
@@ -115,17 +226,50 @@ AP4_NalParser::Feed(const void*            data,
                     const AP4_DataBuffer*& nalu,
                     bool                   is_eos)
 {
-    // default return values
+    // default return value
     nalu = NULL;
+    
+    const AP4_UI08* nalu_data = NULL;
+    AP4_Size        nalu_size = 0;
+    AP4_Result result = Feed(data, data_size, bytes_consumed, nalu_data, nalu_size, is_eos);
+    if (AP4_FAILED(result)) return result;
+    
+    if (nalu_data) {
+        if (nalu_data != m_Buffer.GetData()) {
+            // the NAL unit was not copied, do it now
+            result = m_Buffer.SetData(nalu_data, nalu_size);
+            if (AP4_FAILED(result)) return result;
+        }
+        nalu = &m_Buffer;
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_NalParser::Feed
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_NalParser::Feed(const void*      data,
+                    AP4_Size         data_size, 
+                    AP4_Size&        bytes_consumed,
+                    const AP4_UI08*& nalu_data,
+                    AP4_Size&        nalu_size,
+                    bool             is_eos)
+{
+    // default return values
+    nalu_data = NULL;
+    nalu_size = 0;
     bytes_consumed = 0;
-        
+    
     // iterate the state machine
+    const AP4_UI08* bytes = (const AP4_UI08*)data;
     unsigned int data_offset;
     unsigned int payload_start = 0;
     unsigned int payload_end  = 0;
     bool         found_nalu = false;
     for (data_offset=0; data_offset<data_size && !found_nalu; data_offset++) {
-        unsigned char byte = ((const unsigned char*)data)[data_offset];
+        unsigned char byte = bytes[data_offset];
         switch (m_State) {
             case STATE_RESET:
                 if (byte == 0) {
@@ -163,16 +307,21 @@ AP4_NalParser::Feed(const void*            data,
                     ++payload_end;
                     break;
                 } 
-                if (m_ZeroTrail >= 2) {
-                    if (byte == 1) {
-                        found_nalu = true;
-                        m_State = STATE_START_NALU;
-                        break;
-                    } else {
-                        ++payload_end;
-                    }
-                } else {
-                    ++payload_end;
+                if (m_ZeroTrail >= 2 && byte == 1) {
+                    found_nalu = true;
+                    m_State = STATE_START_NALU;
+                    break;
+                }
+                
+                // this byte is part of the payload, and so is everything up
+                // to the next start code, except for the zeros just before it,
+                // which are left to the state machine
+                {
+                    const AP4_UI08* next = bytes+data_offset+1;
+                    AP4_Size run = FindStartCode(next, data_size-data_offset-1);
+                    while (run && next[run-1] == 0) --run;
+                    payload_end += 1+run;
+                    data_offset += run;
                 }
                 m_ZeroTrail = 0; 
                 break;
@@ -183,29 +332,50 @@ AP4_NalParser::Feed(const void*            data,
         m_ZeroTrail = 0;
         m_State = STATE_RESET;
     }
-    if (payload_end > payload_start) {
-        AP4_Size current_payload_size = m_Buffer.GetDataSize();
-        m_Buffer.SetDataSize(m_Buffer.GetDataSize()+(payload_end-payload_start));
-        AP4_CopyMemory(((unsigned char *)m_Buffer.UseData())+current_payload_size, 
-                       ((const unsigned char*)data)+payload_start, 
-                       payload_end-payload_start);
-    }
     
     // compute how many bytes we have consumed
     bytes_consumed = data_offset;
     
-    // return the NALU if we found one
+    // number of zero bytes at the end of the payload that are part of the
+    // next start code
+    AP4_Size trim = 0;
     if (found_nalu) {
-        // trim zero bytes that are part of the next start code
-        if (m_ZeroTrail >= 3 && m_Buffer.GetDataSize() >= 3) {
+        if (m_ZeroTrail >= 3) {
             // 4 byte start code
-            m_Buffer.SetDataSize(m_Buffer.GetDataSize()-3);
-        } else if (m_ZeroTrail >= 2 && m_Buffer.GetDataSize() >= 2) {
+            trim = 3;
+        } else if (m_ZeroTrail >= 2) {
             // 3 byte start code
-            m_Buffer.SetDataSize(m_Buffer.GetDataSize()-2);
+            trim = 2;
         }
         m_ZeroTrail = 0;
-        nalu = &m_Buffer;
+    }
+
+    // return the NALU in place if it is entirely in this buffer
+    AP4_Size payload_size = payload_end-payload_start;
+    if (found_nalu && m_Buffer.GetDataSize() == 0) {
+        nalu_data = bytes+payload_start;
+        nalu_size = payload_size >= trim ? payload_size-trim : payload_size;
+        return AP4_SUCCESS;
+    }
+    
+    // accumulate the payload
+    if (payload_size) {
+        AP4_Size current_payload_size = m_Buffer.GetDataSize();
+        AP4_Result result = m_Buffer.Reserve(current_payload_size+payload_size);
+        if (AP4_FAILED(result)) return result;
+        m_Buffer.SetDataSize(current_payload_size+payload_size);
+        AP4_CopyMemory(m_Buffer.UseData()+current_payload_size, 
+                       bytes+payload_start, 
+                       payload_size);
+    }
+    
+    // return the NALU if we found one
+    if (found_nalu) {
+        if (m_Buffer.GetDataSize() >= trim) {
+            m_Buffer.SetDataSize(m_Buffer.GetDataSize()-trim);
+        }
+        nalu_data = m_Buffer.GetData();
+        nalu_size = m_Buffer.GetDataSize();
     }
     
     return AP4_SUCCESS;
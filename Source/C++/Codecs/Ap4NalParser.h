@@ -35,6 +35,7 @@
 #include "Ap4Types.h"
 #include "Ap4Results.h"
 #include "Ap4DataBuffer.h"
+#include "Ap4Utils.h"
 
 /*----------------------------------------------------------------------
 |   AP4_NalParser
@@ -48,6 +49,23 @@ public:
      */
     static void Unescape(AP4_DataBuffer& data);
     
+    /**
+     * Remove emulation prevention bytes from the beginning of a buffer,
+     * producing at most max_unescaped_size bytes, which is useful when
+     * only the header of a NAL unit needs to be parsed.
+     * Returns the number of input bytes that were used.
+     */
+    static AP4_Size Unescape(const AP4_UI08* data,
+                             AP4_Size        data_size,
+                             AP4_DataBuffer& unescaped,
+                             AP4_Size        max_unescaped_size);
+    
+    /**
+     * Insert emulation prevention bytes where needed, so that the
+     * output does not contain start code prefixes.
+     */
+    static void Escape(const AP4_UI08* data, AP4_Size data_size, AP4_DataBuffer& escaped);
+    
     /**
      * Count how many emualation prevention bytes are encountered until
      * a certain number of bytes can be produced from an escaped buffer
@@ -55,6 +73,36 @@ public:
     static unsigned int CountEmulationPreventionBytes(const AP4_UI08* data,
                                                       unsigned int    data_size,
                                                       unsigned int    unescaped_size);
+
+    /**
+     * Compute a (non-cryptographic) hash of a NAL unit, used by the frame
+     * parsers to recognize parameter sets that are repeated unchanged.
+     */
+    static AP4_UI32 ComputeHash(const AP4_UI08* data, AP4_Size data_size);
+
+    /**
+     * Check if a parameter set NAL unit, with a hash computed by ComputeHash,
+     * is the same as the one that a frame parser has stored (with its hash)
+     * for the same id. The stored parameter set may be NULL.
+     */
+    template <typename T>
+    static bool IsSameParameterSet(const T*        parameter_set,
+                                   AP4_UI32        parameter_set_hash,
+                                   const AP4_UI08* data,
+                                   AP4_Size        data_size,
+                                   AP4_UI32        hash) {
+        return parameter_set                                   &&
+               parameter_set_hash == hash                      &&
+               parameter_set->raw_bytes.GetDataSize() == data_size &&
+               AP4_CompareMemory(parameter_set->raw_bytes.GetData(), data, data_size) == 0;
+    }
+    
+    /**
+     * Find the first 00 00 01 start code prefix in a buffer.
+     * Returns the offset of the first byte of the prefix, or data_size if
+     * the buffer does not contain a complete start code prefix.
+     */
+    static AP4_Size FindStartCode(const AP4_UI08* data, AP4_Size data_size);
     
     // constructor
     AP4_NalParser();
@@ -88,6 +136,26 @@ public:
                     const AP4_DataBuffer*& nalu,
                     bool                   eos=false);
     
+    /**
+     * Feed some data to the parser and look for the next NAL Unit, without
+     * copying the NAL unit when possible.
+     *
+     * This method works like the Feed method above, except that the NAL
+     * unit is returned as a pointer and a size. When the NAL unit is entirely
+     * contained in the data passed to this call, the pointer points directly
+     * into that data, so it is only valid as long as the caller's buffer is.
+     * When the NAL unit straddles the boundary between two calls, it
+     * is assembled in an internal buffer, which remains valid until the
+     * next call to this parser.
+     * nalu_data is set to NULL when no NAL unit is found.
+     */
+    AP4_Result Feed(const void*      data,
+                    AP4_Size         data_size,
+                    AP4_Size&        bytes_consumed,
+                    const AP4_UI08*& nalu_data,
+                    AP4_Size&        nalu_size,
+                    bool             eos=false);
+    
     /**
      * Reset the state of the parser (for example, to parse a new stream).
      */
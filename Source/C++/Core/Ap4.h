@@ -261,6 +261,7 @@
 #include "Ap4StsdAtom.h"
 #include "Ap4StscAtom.h"
 #include "Ap4StcoAtom.h"
+#include "Ap4Co64Atom.h"
 #include "Ap4StszAtom.h"
 #include "Ap4Stz2Atom.h"
 #include "Ap4EsdsAtom.h"
@@ -324,6 +325,14 @@
 #include "Ap4Ac3Parser.h"
 #include "Ap4HevcParser.h"
 #include "Ap4SegmentBuilder.h"
+#include "Ap4PlaylistWriter.h"
+#include "Ap4SegmentIndex.h"
+#include "Ap4Threads.h"
+#include "Ap4FileSummary.h"
+#include "Ap4MoovUpdater.h"
+#include "Ap4FastStart.h"
+#include "Ap4Xxhash.h"
+#include "Ap4SampleHashIndex.h"
 
 /*----------------------------------------------------------------------
 |   global functions
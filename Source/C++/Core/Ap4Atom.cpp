@@ -175,6 +175,28 @@ AP4_Atom::GetHeaderSize() const
     return (m_IsFull ? AP4_FULL_ATOM_HEADER_SIZE : AP4_ATOM_HEADER_SIZE)+(m_Size32==1?8:0);
 }
 
+/*----------------------------------------------------------------------
+|   AP4_Atom::WriteBuffered
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Atom::WriteBuffered(AP4_ByteStream& stream)
+{
+    AP4_UI64 atom_size = GetSize();
+    if (atom_size > AP4_ATOM_MAX_BUFFERED_WRITE_SIZE) return Write(stream);
+
+    // serialize the atom to memory
+    AP4_DataBuffer buffer;
+    AP4_Result result = buffer.Reserve((AP4_Size)atom_size);
+    if (AP4_FAILED(result)) return result;
+    AP4_MemoryByteStream* memory = new AP4_MemoryByteStream(buffer);
+    result = Write(*memory);
+    memory->Release();
+    if (AP4_FAILED(result)) return result;
+
+    // write it out
+    return stream.Write(buffer.GetData(), buffer.GetDataSize());
+}
+
 /*----------------------------------------------------------------------
 |   AP4_Atom::WriteHeader
 +---------------------------------------------------------------------*/
@@ -777,6 +799,45 @@ AP4_AtomListWriter::Action(AP4_Atom* atom) const
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_AtomInspector::SetAtomVerbosity
++---------------------------------------------------------------------*/
+void
+AP4_AtomInspector::SetAtomVerbosity(AP4_UI32 atom_type, int verbosity)
+{
+    for (unsigned int i=0; i<m_AtomVerbosities.ItemCount(); i++) {
+        if (m_AtomVerbosities[i].m_AtomType == atom_type) {
+            m_AtomVerbosities[i].m_Verbosity = verbosity;
+            return;
+        }
+    }
+    AtomVerbosity atom_verbosity;
+    atom_verbosity.m_AtomType  = atom_type;
+    atom_verbosity.m_Verbosity = verbosity;
+    m_AtomVerbosities.Append(atom_verbosity);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AtomInspector::InspectAtom
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AtomInspector::InspectAtom(AP4_Atom& atom)
+{
+    for (unsigned int i=0; i<m_AtomVerbosities.ItemCount(); i++) {
+        if (m_AtomVerbosities[i].m_AtomType != atom.GetType()) continue;
+        if (m_AtomVerbosities[i].m_Verbosity < 0) return AP4_SUCCESS;
+
+        // use the verbosity for this atom and its children only
+        AP4_Ordinal verbosity = m_Verbosity;
+        m_Verbosity = (AP4_Ordinal)m_AtomVerbosities[i].m_Verbosity;
+        AP4_Result result = atom.Inspect(*this);
+        m_Verbosity = verbosity;
+        return result;
+    }
+
+    return atom.Inspect(*this);
+}
+
 /*----------------------------------------------------------------------
 |   AP4_MakePrefixString
 +---------------------------------------------------------------------*/
@@ -1527,3 +1588,487 @@ AP4_JsonInspector::AddField(const char*          name,
 }
 
 
+
+/*----------------------------------------------------------------------
+|   CBOR constants
++---------------------------------------------------------------------*/
+const AP4_UI08 AP4_CBOR_MAJOR_TYPE_UNSIGNED     = 0;
+const AP4_UI08 AP4_CBOR_MAJOR_TYPE_NEGATIVE     = 1;
+const AP4_UI08 AP4_CBOR_MAJOR_TYPE_BYTE_STRING  = 2;
+const AP4_UI08 AP4_CBOR_MAJOR_TYPE_TEXT_STRING  = 3;
+const AP4_UI08 AP4_CBOR_MAJOR_TYPE_ARRAY        = 4;
+const AP4_UI08 AP4_CBOR_MAJOR_TYPE_MAP          = 5;
+const AP4_UI08 AP4_CBOR_MAJOR_TYPE_TAG          = 6;
+const AP4_UI08 AP4_CBOR_ARRAY_INDEFINITE        = 0x9F;
+const AP4_UI08 AP4_CBOR_MAP_INDEFINITE          = 0xBF;
+const AP4_UI08 AP4_CBOR_FLOAT32                 = 0xFA;
+const AP4_UI08 AP4_CBOR_BREAK                   = 0xFF;
+
+// typed array tags (RFC 8746), big-endian
+const AP4_UI08 AP4_CBOR_TAG_TYPED_ARRAY_UINT8   = 64;
+const AP4_UI08 AP4_CBOR_TAG_TYPED_ARRAY_UINT16  = 65;
+const AP4_UI08 AP4_CBOR_TAG_TYPED_ARRAY_UINT32  = 66;
+const AP4_UI08 AP4_CBOR_TAG_TYPED_ARRAY_UINT64  = 67;
+const AP4_UI08 AP4_CBOR_TAG_TYPED_ARRAY_SINT8   = 72;
+const AP4_UI08 AP4_CBOR_TAG_TYPED_ARRAY_SINT16  = 73;
+const AP4_UI08 AP4_CBOR_TAG_TYPED_ARRAY_SINT32  = 74;
+const AP4_UI08 AP4_CBOR_TAG_TYPED_ARRAY_SINT64  = 75;
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::AP4_CborInspector
++---------------------------------------------------------------------*/
+AP4_CborInspector::AP4_CborInspector(AP4_ByteStream& stream) :
+    m_Stream(&stream),
+    m_TableStarted(false),
+    m_TableHasObjects(false),
+    m_TableInRow(false),
+    m_TableRowCount(0),
+    m_TableRowFieldCount(0)
+{
+    m_Stream->AddReference();
+    WriteByte(AP4_CBOR_ARRAY_INDEFINITE);
+    PushContext(Context::TOP_LEVEL);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::~AP4_CborInspector
++---------------------------------------------------------------------*/
+AP4_CborInspector::~AP4_CborInspector()
+{
+    WriteByte(AP4_CBOR_BREAK);
+    m_Stream->Release();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::WriteHead
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::WriteHead(AP4_UI08 major_type, AP4_UI64 value)
+{
+    AP4_UI08 head[9];
+    AP4_Size head_size;
+    major_type <<= 5;
+    if (value < 24) {
+        head[0] = major_type | (AP4_UI08)value;
+        head_size = 1;
+    } else if (value <= 0xFF) {
+        head[0] = major_type | 24;
+        head[1] = (AP4_UI08)value;
+        head_size = 2;
+    } else if (value <= 0xFFFF) {
+        head[0] = major_type | 25;
+        AP4_BytesFromUInt16BE(&head[1], (AP4_UI16)value);
+        head_size = 3;
+    } else if (value <= 0xFFFFFFFF) {
+        head[0] = major_type | 26;
+        AP4_BytesFromUInt32BE(&head[1], (AP4_UI32)value);
+        head_size = 5;
+    } else {
+        head[0] = major_type | 27;
+        AP4_BytesFromUInt64BE(&head[1], value);
+        head_size = 9;
+    }
+    m_Stream->Write(head, head_size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::WriteText
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::WriteText(const char* text)
+{
+    AP4_Size length = (AP4_Size)AP4_StringLength(text);
+    WriteHead(AP4_CBOR_MAJOR_TYPE_TEXT_STRING, length);
+    if (length) m_Stream->Write(text, length);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::WriteInteger
+|
+|   Values are signed, like in the JSON output
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::WriteInteger(AP4_UI64 value)
+{
+    if ((AP4_SI64)value < 0) {
+        WriteHead(AP4_CBOR_MAJOR_TYPE_NEGATIVE, ~value);
+    } else {
+        WriteHead(AP4_CBOR_MAJOR_TYPE_UNSIGNED, value);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::WriteFieldName
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::WriteFieldName(const char* name)
+{
+    // only atoms and objects are maps, names are ignored in arrays
+    Context::Type type = LastContext().m_Type;
+    if (type == Context::ATOM || type == Context::OBJECT) {
+        WriteText(name ? name : "");
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::WriteTypedArray
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::WriteTypedArray(AP4_Ordinal  first,
+                                   AP4_Cardinal stride,
+                                   AP4_Cardinal count)
+{
+    // use the smallest element type that can represent all the values
+    const AP4_UI64* values = &m_TableValues[0];
+    AP4_SI64 min_value = 0;
+    AP4_SI64 max_value = 0;
+    AP4_UI64 max_unsigned = 0;
+    for (unsigned int i=0; i<count; i++) {
+        AP4_UI64 value = values[first+i*stride];
+        if ((AP4_SI64)value < min_value) min_value = (AP4_SI64)value;
+        if ((AP4_SI64)value > max_value) max_value = (AP4_SI64)value;
+        if (value > max_unsigned) max_unsigned = value;
+    }
+    AP4_UI08 tag;
+    unsigned int element_size;
+    if (min_value >= 0) {
+        if (max_unsigned <= 0xFF) {
+            tag = AP4_CBOR_TAG_TYPED_ARRAY_UINT8;
+            element_size = 1;
+        } else if (max_unsigned <= 0xFFFF) {
+            tag = AP4_CBOR_TAG_TYPED_ARRAY_UINT16;
+            element_size = 2;
+        } else if (max_unsigned <= 0xFFFFFFFF) {
+            tag = AP4_CBOR_TAG_TYPED_ARRAY_UINT32;
+            element_size = 4;
+        } else {
+            tag = AP4_CBOR_TAG_TYPED_ARRAY_UINT64;
+            element_size = 8;
+        }
+    } else {
+        if (min_value >= -0x80 && max_value <= 0x7F) {
+            tag = AP4_CBOR_TAG_TYPED_ARRAY_SINT8;
+            element_size = 1;
+        } else if (min_value >= -0x8000 && max_value <= 0x7FFF) {
+            tag = AP4_CBOR_TAG_TYPED_ARRAY_SINT16;
+            element_size = 2;
+        } else if (min_value >= -(AP4_SI64)0x80000000 && max_value <= 0x7FFFFFFF) {
+            tag = AP4_CBOR_TAG_TYPED_ARRAY_SINT32;
+            element_size = 4;
+        } else {
+            tag = AP4_CBOR_TAG_TYPED_ARRAY_SINT64;
+            element_size = 8;
+        }
+    }
+
+    // serialize the values (two's complement for signed values)
+    AP4_Size data_size = count*element_size;
+    if (AP4_FAILED(m_TableBuffer.SetDataSize(data_size))) return;
+    AP4_UI08* data = m_TableBuffer.UseData();
+    for (unsigned int i=0; i<count; i++) {
+        AP4_UI64 value = values[first+i*stride];
+        switch (element_size) {
+            case 1: data[i] = (AP4_UI08)value;                       break;
+            case 2: AP4_BytesFromUInt16BE(&data[i*2], (AP4_UI16)value); break;
+            case 4: AP4_BytesFromUInt32BE(&data[i*4], (AP4_UI32)value); break;
+            case 8: AP4_BytesFromUInt64BE(&data[i*8], value);           break;
+        }
+    }
+    WriteHead(AP4_CBOR_MAJOR_TYPE_TAG, tag);
+    WriteHead(AP4_CBOR_MAJOR_TYPE_BYTE_STRING, data_size);
+    if (data_size) m_Stream->Write(data, data_size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::WriteTable
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::WriteTable()
+{
+    m_TableStarted = false;
+    if (m_TableHasObjects) {
+        // one typed array per field
+        AP4_Cardinal field_count = m_TableFieldNames.ItemCount();
+        WriteHead(AP4_CBOR_MAJOR_TYPE_MAP, field_count);
+        for (unsigned int i=0; i<field_count; i++) {
+            WriteText(m_TableFieldNames[i].GetChars());
+            WriteTypedArray(i, field_count, m_TableRowCount);
+        }
+    } else if (m_TableValues.ItemCount()) {
+        WriteTypedArray(0, 1, m_TableValues.ItemCount());
+    } else {
+        WriteHead(AP4_CBOR_MAJOR_TYPE_ARRAY, 0);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::FlushTable
+|
+|   Write what has been buffered for the current array as a regular
+|   array, when it turns out that it cannot be written as a table
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::FlushTable()
+{
+    m_TableStarted = false;
+    WriteByte(AP4_CBOR_ARRAY_INDEFINITE);
+    if (!m_TableHasObjects) {
+        for (unsigned int i=0; i<m_TableValues.ItemCount(); i++) {
+            WriteInteger(m_TableValues[i]);
+        }
+        return;
+    }
+
+    // complete rows
+    AP4_Cardinal field_count = m_TableRowCount ? m_TableFieldNames.ItemCount() : 0;
+    AP4_Ordinal  value_index = 0;
+    for (unsigned int i=0; i<m_TableRowCount; i++) {
+        WriteByte(AP4_CBOR_MAP_INDEFINITE);
+        for (unsigned int j=0; j<field_count; j++) {
+            WriteText(m_TableFieldNames[j].GetChars());
+            WriteInteger(m_TableValues[value_index++]);
+        }
+        WriteByte(AP4_CBOR_BREAK);
+    }
+
+    // the row in progress is left open
+    if (m_TableInRow) {
+        WriteByte(AP4_CBOR_MAP_INDEFINITE);
+        for (unsigned int j=0; j<m_TableRowFieldCount; j++) {
+            WriteText(m_TableFieldNames[j].GetChars());
+            WriteInteger(m_TableValues[value_index++]);
+        }
+        m_TableInRow = false;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::StartAtom
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::StartAtom(const char* name,
+                             AP4_UI08    version,
+                             AP4_UI32    flags,
+                             AP4_Size    header_size,
+                             AP4_UI64    size)
+{
+    if (m_TableStarted) FlushTable();
+
+    // starting the first atom within an atom means starting a children array
+    if (LastContext().m_Type == Context::ATOM) {
+        if (++LastContext().m_ChildrenCount == 1) {
+            WriteText("children");
+            WriteByte(AP4_CBOR_ARRAY_INDEFINITE);
+        }
+    } else {
+        WriteFieldName(name);
+    }
+
+    WriteByte(AP4_CBOR_MAP_INDEFINITE);
+    PushContext(Context::ATOM);
+
+    WriteText("name");
+    WriteText(name);
+    WriteText("header_size");
+    WriteInteger(header_size);
+    WriteText("size");
+    WriteInteger(size);
+    if (version) {
+        WriteText("version");
+        WriteInteger(version);
+    }
+    if (flags) {
+        WriteText("flags");
+        WriteInteger(flags);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::EndAtom
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::EndAtom()
+{
+    // ending an atom with children means we need to close the children array
+    if (LastContext().m_ChildrenCount) {
+        WriteByte(AP4_CBOR_BREAK);
+    }
+    WriteByte(AP4_CBOR_BREAK);
+    PopContext();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::StartDescriptor
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::StartDescriptor(const char* name,
+                                   AP4_Size    header_size,
+                                   AP4_UI64    size)
+{
+    StartAtom(name, 0, 0, header_size, size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::EndDescriptor
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::EndDescriptor()
+{
+    EndAtom();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::StartArray
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::StartArray(const char* name, unsigned int /* element_count */)
+{
+    if (m_TableStarted) FlushTable();
+    WriteFieldName(name);
+    PushContext(Context::ARRAY);
+
+    // the array is written when it ends, or as soon as it has an
+    // element that does not fit in a table
+    m_TableStarted       = true;
+    m_TableHasObjects    = false;
+    m_TableInRow         = false;
+    m_TableRowCount      = 0;
+    m_TableRowFieldCount = 0;
+    m_TableFieldNames.Clear();
+    m_TableValues.Clear();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::EndArray
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::EndArray()
+{
+    if (m_TableStarted) {
+        WriteTable();
+    } else {
+        WriteByte(AP4_CBOR_BREAK);
+    }
+    PopContext();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::StartObject
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::StartObject(const char* name, unsigned int /* field_count */, bool compact)
+{
+    if (m_TableStarted) {
+        // compact objects directly in the array are the rows of a table
+        if (compact && !m_TableInRow &&
+            (m_TableHasObjects || m_TableValues.ItemCount() == 0)) {
+            m_TableHasObjects    = true;
+            m_TableInRow         = true;
+            m_TableRowFieldCount = 0;
+            PushContext(Context::OBJECT);
+            return;
+        }
+        FlushTable();
+    }
+
+    WriteFieldName(name);
+    WriteByte(AP4_CBOR_MAP_INDEFINITE);
+    PushContext(Context::OBJECT);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::EndObject
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::EndObject()
+{
+    if (m_TableStarted && m_TableInRow) {
+        // all the rows must have the same fields
+        if (m_TableRowFieldCount && m_TableRowFieldCount == m_TableFieldNames.ItemCount()) {
+            ++m_TableRowCount;
+            m_TableInRow = false;
+            PopContext();
+            return;
+        }
+        FlushTable();
+    }
+
+    WriteByte(AP4_CBOR_BREAK);
+    PopContext();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::AddField
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::AddField(const char* name, AP4_UI64 value, FormatHint /* hint */)
+{
+    if (m_TableStarted) {
+        if (!m_TableHasObjects) {
+            m_TableValues.Append(value);
+            return;
+        }
+        if (m_TableInRow && name) {
+            if (m_TableRowCount == 0) {
+                // the first row defines the fields
+                m_TableFieldNames.Append(AP4_String(name));
+                m_TableValues.Append(value);
+                ++m_TableRowFieldCount;
+                return;
+            }
+            if (m_TableRowFieldCount < m_TableFieldNames.ItemCount() &&
+                m_TableFieldNames[m_TableRowFieldCount] == name) {
+                m_TableValues.Append(value);
+                ++m_TableRowFieldCount;
+                return;
+            }
+        }
+        FlushTable();
+    }
+
+    WriteFieldName(name);
+    WriteInteger(value);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::AddFieldF
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::AddFieldF(const char* name, float value, FormatHint /* hint */)
+{
+    if (m_TableStarted) FlushTable();
+    WriteFieldName(name);
+
+    AP4_UI32 bits;
+    AP4_CopyMemory(&bits, &value, 4);
+    AP4_UI08 data[5];
+    data[0] = AP4_CBOR_FLOAT32;
+    AP4_BytesFromUInt32BE(&data[1], bits);
+    m_Stream->Write(data, sizeof(data));
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::AddField
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::AddField(const char* name, const char* value, FormatHint /* hint */)
+{
+    if (m_TableStarted) FlushTable();
+    WriteFieldName(name);
+    WriteText(value);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CborInspector::AddField
++---------------------------------------------------------------------*/
+void
+AP4_CborInspector::AddField(const char*          name,
+                            const unsigned char* bytes,
+                            AP4_Size             byte_count,
+                            FormatHint           /* hint */)
+{
+    if (m_TableStarted) FlushTable();
+    WriteFieldName(name);
+    WriteHead(AP4_CBOR_MAJOR_TYPE_BYTE_STRING, byte_count);
+    if (byte_count) m_Stream->Write(bytes, byte_count);
+}
@@ -62,10 +62,13 @@ const AP4_UI32 AP4_FULL_ATOM_HEADER_SIZE    = 12;
 const AP4_UI32 AP4_FULL_ATOM_HEADER_SIZE_64 = 20;
 const AP4_UI32 AP4_ATOM_MAX_NAME_SIZE       = 256;
 const AP4_UI32 AP4_ATOM_MAX_URI_SIZE        = 512;
+const AP4_UI32 AP4_ATOM_TABLE_WRITE_BLOCK_SIZE  = 4080;      // multiple of all table entry sizes (4 to 16)
+const AP4_UI32 AP4_ATOM_MAX_BUFFERED_WRITE_SIZE = 0x4000000; // 64MB
 
 /*----------------------------------------------------------------------
 |   forward references
 +---------------------------------------------------------------------*/
+class AP4_Atom;
 class AP4_AtomParent;
 
 /*----------------------------------------------------------------------
@@ -91,6 +94,18 @@ public:
     // methods
     void        SetVerbosity(AP4_Ordinal verbosity) { m_Verbosity = verbosity; }
     AP4_Ordinal GetVerbosity()                      { return m_Verbosity;      }
+
+    /**
+     * Set the verbosity used for atoms of a given type and for the atoms
+     * they contain, instead of the verbosity of the inspector. Atoms of
+     * that type are not inspected at all if the verbosity is negative.
+     */
+    void SetAtomVerbosity(AP4_UI32 atom_type, int verbosity);
+
+    /**
+     * Inspect an atom, applying the verbosity set for its type, if any.
+     */
+    AP4_Result InspectAtom(AP4_Atom& atom);
     
     // virtual methods
     virtual void StartAtom(const char* /* name        */,
@@ -130,7 +145,15 @@ public:
     }
     
 protected:
-    AP4_Ordinal m_Verbosity;
+    // types
+    struct AtomVerbosity {
+        AP4_UI32 m_AtomType;
+        int      m_Verbosity;
+    };
+
+    // members
+    AP4_Ordinal              m_Verbosity;
+    AP4_Array<AtomVerbosity> m_AtomVerbosities;
 };
 
 /*----------------------------------------------------------------------
@@ -249,6 +272,85 @@ private:
     char               m_Prefix[256];
 };
 
+/*----------------------------------------------------------------------
+|   AP4_CborInspector
++---------------------------------------------------------------------*/
+/**
+ * Inspector that writes the same tree as AP4_JsonInspector, encoded as
+ * CBOR (RFC 8949) instead of text. Arrays and maps are written with an
+ * indefinite length, so that nothing needs to be buffered, except for
+ * tables: an array of integers is written as a typed array (RFC 8746),
+ * and an array of compact objects that all have the same integer fields
+ * (like the entries of stts, ctts, trun or sidx atoms) is written as a
+ * map from each field name to a typed array of its values.
+ */
+class AP4_CborInspector : public AP4_AtomInspector {
+public:
+    AP4_CborInspector(AP4_ByteStream& stream);
+    ~AP4_CborInspector();
+
+    // methods
+    void StartAtom(const char* name,
+                   AP4_UI08    version,
+                   AP4_UI32    flags,
+                   AP4_Size    header_size,
+                   AP4_UI64    size);
+    void EndAtom();
+    void StartDescriptor(const char* name,
+                         AP4_Size    header_size,
+                         AP4_UI64    size);
+    void EndDescriptor();
+    void StartArray(const char* name, unsigned int element_count);
+    void EndArray();
+    void StartObject(const char* name, unsigned int field_count, bool compact);
+    void EndObject();
+    void AddField(const char* name, AP4_UI64 value, FormatHint hint);
+    void AddFieldF(const char* name, float value, FormatHint hint);
+    void AddField(const char* name, const char* value, FormatHint hint);
+    void AddField(const char* name, const unsigned char* bytes, AP4_Size size, FormatHint hint);
+
+private:
+    // types
+    struct Context {
+        typedef enum {
+            TOP_LEVEL,
+            ATOM,
+            ARRAY,
+            OBJECT
+        } Type;
+
+        Context(Type type) : m_Type(type), m_ChildrenCount(0) {}
+
+        Type         m_Type;
+        AP4_Cardinal m_ChildrenCount; // to count atoms within atoms
+    };
+
+    // methods
+    void     PushContext(Context::Type type) { m_Contexts.Append(Context(type)); }
+    void     PopContext()                     { m_Contexts.RemoveLast();        }
+    Context& LastContext() { return m_Contexts[m_Contexts.ItemCount() - 1]; }
+    void     WriteHead(AP4_UI08 major_type, AP4_UI64 value);
+    void     WriteByte(AP4_UI08 value) { m_Stream->Write(&value, 1); }
+    void     WriteText(const char* text);
+    void     WriteInteger(AP4_UI64 value);
+    void     WriteFieldName(const char* name);
+    void     WriteTypedArray(AP4_Ordinal first, AP4_Cardinal stride, AP4_Cardinal count);
+    void     WriteTable();
+    void     FlushTable();
+
+    // members
+    AP4_ByteStream*       m_Stream;
+    AP4_Array<Context>    m_Contexts;
+    bool                  m_TableStarted;
+    bool                  m_TableHasObjects;
+    bool                  m_TableInRow;
+    AP4_Cardinal          m_TableRowCount;
+    AP4_Cardinal          m_TableRowFieldCount;
+    AP4_Array<AP4_String> m_TableFieldNames;
+    AP4_Array<AP4_UI64>   m_TableValues;
+    AP4_DataBuffer        m_TableBuffer;
+};
+
 /*----------------------------------------------------------------------
 |   AP4_Atom
 +---------------------------------------------------------------------*/
@@ -314,6 +416,12 @@ public:
     AP4_UI64           GetSize64() const { return m_Size64; }
     void               SetSize64(AP4_UI64 size) { m_Size64 = size; }
     virtual AP4_Result Write(AP4_ByteStream& stream);
+    /**
+     * Write the atom with a single write to the stream: the atom is first
+     * serialized to a memory buffer of its size (atoms larger than
+     * AP4_ATOM_MAX_BUFFERED_WRITE_SIZE are written directly).
+     */
+    AP4_Result         WriteBuffered(AP4_ByteStream& stream);
     virtual AP4_Result WriteHeader(AP4_ByteStream& stream);
     virtual AP4_Result WriteFields(AP4_ByteStream& stream) = 0;
     virtual AP4_Result Inspect(AP4_AtomInspector& inspector);
@@ -518,6 +626,7 @@ const AP4_Atom::Type AP4_ATOM_TYPE_HMHD = AP4_ATOM_TYPE('h','m','h','d');
 const AP4_Atom::Type AP4_ATOM_TYPE_FRMA = AP4_ATOM_TYPE('f','r','m','a');
 const AP4_Atom::Type AP4_ATOM_TYPE_MDAT = AP4_ATOM_TYPE('m','d','a','t');
 const AP4_Atom::Type AP4_ATOM_TYPE_FREE = AP4_ATOM_TYPE('f','r','e','e');
+const AP4_Atom::Type AP4_ATOM_TYPE_SKIP = AP4_ATOM_TYPE('s','k','i','p');
 const AP4_Atom::Type AP4_ATOM_TYPE_TIMS = AP4_ATOM_TYPE('t','i','m','s');
 const AP4_Atom::Type AP4_ATOM_TYPE_RTP_ = AP4_ATOM_TYPE('r','t','p',' ');
 const AP4_Atom::Type AP4_ATOM_TYPE_HNTI = AP4_ATOM_TYPE('h','n','t','i');
@@ -601,7 +710,7 @@ class AP4_AtomListInspector : public AP4_List<AP4_Atom>::Item::Operator
     AP4_AtomListInspector(AP4_AtomInspector& inspector) :
         m_Inspector(inspector) {}
     AP4_Result Action(AP4_Atom* atom) const {
-        atom->Inspect(m_Inspector);
+        m_Inspector.InspectAtom(*atom);
         return AP4_SUCCESS;
     }
 
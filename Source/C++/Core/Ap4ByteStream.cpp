@@ -33,11 +33,14 @@
 #include "Ap4Utils.h"
 #include "Ap4Debug.h"
 #include "Ap4String.h"
+#include "Ap4FileByteStream.h"
+#include "Ap4Threads.h"
 
 /*----------------------------------------------------------------------
 |   constants
 +---------------------------------------------------------------------*/
-const int AP4_BYTE_STREAM_COPY_BUFFER_SIZE = 65536;
+const unsigned int AP4_BYTE_STREAM_COPY_BUFFER_SIZE = 1024*1024;
+const int AP4_BYTE_STREAM_ARRAY_BLOCK_SIZE = 4096;
 
 /*----------------------------------------------------------------------
 |   AP4_ByteStream::Read
@@ -130,6 +133,48 @@ AP4_ByteStream::WriteUI64(AP4_UI64 value)
     return Write((void*)buffer, 8);
 }
 
+/*----------------------------------------------------------------------
+|   AP4_ByteStream::WriteUI64Array
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ByteStream::WriteUI64Array(const AP4_UI64* values, AP4_Cardinal count)
+{
+    unsigned char buffer[AP4_BYTE_STREAM_ARRAY_BLOCK_SIZE];
+
+    // convert and write the values a block at a time
+    while (count) {
+        AP4_Cardinal block_count = count < sizeof(buffer)/8 ? count : sizeof(buffer)/8;
+        AP4_BytesFromUInt64ArrayBE(buffer, values, block_count);
+        AP4_Result result = Write((void*)buffer, block_count*8);
+        if (AP4_FAILED(result)) return result;
+        values += block_count;
+        count  -= block_count;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ByteStream::WriteUI32Array
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ByteStream::WriteUI32Array(const AP4_UI32* values, AP4_Cardinal count)
+{
+    unsigned char buffer[AP4_BYTE_STREAM_ARRAY_BLOCK_SIZE];
+
+    // convert and write the values a block at a time
+    while (count) {
+        AP4_Cardinal block_count = count < sizeof(buffer)/4 ? count : sizeof(buffer)/4;
+        AP4_BytesFromUInt32ArrayBE(buffer, values, block_count);
+        AP4_Result result = Write((void*)buffer, block_count*4);
+        if (AP4_FAILED(result)) return result;
+        values += block_count;
+        count  -= block_count;
+    }
+
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_ByteStream::WriteUI32
 +---------------------------------------------------------------------*/
@@ -375,15 +420,19 @@ AP4_ByteStream::ReadNullTerminatedString(AP4_String& string)
 AP4_Result
 AP4_ByteStream::CopyTo(AP4_ByteStream& stream, AP4_LargeSize size)
 {
-    unsigned char buffer[AP4_BYTE_STREAM_COPY_BUFFER_SIZE];
+    // the buffer is on the heap, and no larger than what is copied
+    AP4_Size buffer_size = size < AP4_BYTE_STREAM_COPY_BUFFER_SIZE ?
+                           (AP4_Size)size : AP4_BYTE_STREAM_COPY_BUFFER_SIZE;
+    AP4_DataBuffer buffer_data(buffer_size);
+    AP4_UI08* buffer = buffer_data.UseData();
     while (size) {
         AP4_Size bytes_read;
         AP4_Size bytes_to_read;
         AP4_Result result;
 
         // decide how much to read
-        if (size >= sizeof(buffer)) {
-            bytes_to_read = sizeof(buffer);
+        if (size >= buffer_size) {
+            bytes_to_read = buffer_size;
         } else {
             bytes_to_read = (AP4_Size)size;
         }
@@ -986,3 +1035,208 @@ AP4_BufferedInputStream::Release()
         delete this;
     }
 }
+
+/*----------------------------------------------------------------------
+|   AP4_SpillBudget::AP4_SpillBudget
++---------------------------------------------------------------------*/
+AP4_SpillBudget::AP4_SpillBudget(AP4_LargeSize size) :
+    m_Lock(new AP4_Mutex()),
+    m_Size(size),
+    m_Used(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillBudget::~AP4_SpillBudget
++---------------------------------------------------------------------*/
+AP4_SpillBudget::~AP4_SpillBudget()
+{
+    delete m_Lock;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillBudget::Reserve
++---------------------------------------------------------------------*/
+bool
+AP4_SpillBudget::Reserve(AP4_LargeSize size)
+{
+    AP4_AutoLock lock(*m_Lock);
+    if (m_Used+size > m_Size) return false;
+    m_Used += size;
+    return true;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillBudget::Release
++---------------------------------------------------------------------*/
+void
+AP4_SpillBudget::Release(AP4_LargeSize size)
+{
+    AP4_AutoLock lock(*m_Lock);
+    m_Used = size < m_Used ? m_Used-size : 0;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::AP4_SpillByteStream
++---------------------------------------------------------------------*/
+AP4_SpillByteStream::AP4_SpillByteStream(const char*      spill_filename, 
+                                         AP4_Size         memory_threshold,
+                                         AP4_SpillBudget* budget) :
+    m_SpillFilename(spill_filename),
+    m_MemoryThreshold(memory_threshold),
+    m_Budget(budget),
+    m_Reserved(0),
+    m_Memory(new AP4_MemoryByteStream()),
+    m_File(NULL),
+    m_ReferenceCount(1)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::~AP4_SpillByteStream
++---------------------------------------------------------------------*/
+AP4_SpillByteStream::~AP4_SpillByteStream()
+{
+    if (m_Budget && m_Reserved) m_Budget->Release(m_Reserved);
+    if (m_Memory) m_Memory->Release();
+    if (m_File) {
+        m_File->Release();
+#if defined(AP4_CONFIG_HAVE_STDIO_H)
+        remove(m_SpillFilename.GetChars());
+#endif
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::Spill
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SpillByteStream::Spill()
+{
+    AP4_ByteStream* file = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(m_SpillFilename.GetChars(),
+                                                   AP4_FileByteStream::STREAM_MODE_WRITE,
+                                                   file);
+    if (AP4_FAILED(result)) return result;
+    AP4_Position position = 0;
+    m_Memory->Tell(position);
+    result = file->Write(m_Memory->GetData(), m_Memory->GetDataSize());
+    if (AP4_SUCCEEDED(result)) result = file->Seek(position);
+    if (AP4_FAILED(result)) {
+        file->Release();
+        return result;
+    }
+    m_Memory->Release();
+    m_Memory = NULL;
+    m_File = file;
+    if (m_Budget && m_Reserved) {
+        m_Budget->Release(m_Reserved);
+        m_Reserved = 0;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::ReadPartial
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_SpillByteStream::ReadPartial(void*     buffer, 
+                                 AP4_Size  bytes_to_read, 
+                                 AP4_Size& bytes_read)
+{
+    if (m_File) return m_File->ReadPartial(buffer, bytes_to_read, bytes_read);
+    return m_Memory->ReadPartial(buffer, bytes_to_read, bytes_read);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::WritePartial
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_SpillByteStream::WritePartial(const void* buffer, 
+                                  AP4_Size    bytes_to_write, 
+                                  AP4_Size&   bytes_written)
+{
+    if (m_File == NULL) {
+        // move to a file if the data would not fit under the threshold,
+        // or in what is left of the budget
+        AP4_Position position = 0;
+        m_Memory->Tell(position);
+        AP4_LargeSize end  = position+bytes_to_write;
+        bool          fits = end <= m_MemoryThreshold;
+        if (fits && m_Budget && end > m_Reserved) {
+            fits = m_Budget->Reserve(end-m_Reserved);
+            if (fits) m_Reserved = end;
+        }
+        if (!fits) {
+            AP4_Result result = Spill();
+            if (AP4_FAILED(result)) {
+                bytes_written = 0;
+                return result;
+            }
+        } else {
+            return m_Memory->WritePartial(buffer, bytes_to_write, bytes_written);
+        }
+    }
+    return m_File->WritePartial(buffer, bytes_to_write, bytes_written);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::Seek
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_SpillByteStream::Seek(AP4_Position position)
+{
+    if (m_File) return m_File->Seek(position);
+    return m_Memory->Seek(position);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::Tell
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_SpillByteStream::Tell(AP4_Position& position)
+{
+    if (m_File) return m_File->Tell(position);
+    return m_Memory->Tell(position);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::GetSize
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_SpillByteStream::GetSize(AP4_LargeSize& size)
+{
+    if (m_File) return m_File->GetSize(size);
+    return m_Memory->GetSize(size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::Flush
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_SpillByteStream::Flush()
+{
+    if (m_File) return m_File->Flush();
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::AddReference
++---------------------------------------------------------------------*/
+void
+AP4_SpillByteStream::AddReference()
+{
+    m_ReferenceCount++;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream::Release
++---------------------------------------------------------------------*/
+void
+AP4_SpillByteStream::Release()
+{
+    if (--m_ReferenceCount == 0) {
+        delete this;
+    }
+}
@@ -36,11 +36,12 @@
 #include "Ap4Interfaces.h"
 #include "Ap4Results.h"
 #include "Ap4DataBuffer.h"
+#include "Ap4String.h"
 
 /*----------------------------------------------------------------------
 |   class references
 +---------------------------------------------------------------------*/
-class AP4_String;
+class AP4_Mutex;
 
 /*----------------------------------------------------------------------
 |   AP4_ByteStream
@@ -72,11 +73,27 @@ class AP4_ByteStream : public AP4_Referenceable
     AP4_Result WriteUI24(AP4_UI32 value);
     AP4_Result WriteUI16(AP4_UI16 value);
     AP4_Result WriteUI08(AP4_UI08 value);
+    AP4_Result WriteUI64Array(const AP4_UI64* values, AP4_Cardinal count);
+    AP4_Result WriteUI32Array(const AP4_UI32* values, AP4_Cardinal count);
     virtual AP4_Result Seek(AP4_Position position) = 0;
     virtual AP4_Result Tell(AP4_Position& position) = 0;
     virtual AP4_Result GetSize(AP4_LargeSize& size) = 0;
     virtual AP4_Result CopyTo(AP4_ByteStream& stream, AP4_LargeSize size);
     virtual AP4_Result Flush() { return AP4_SUCCESS; }
+
+    /**
+     * Get the file descriptor of a stream that is backed by a file, for I/O
+     * that bypasses the stream (like kernel-assisted copies). Pending writes
+     * must be flushed before using the descriptor, and the stream must be
+     * re-positioned with Seek() after the file has been accessed through it.
+     */
+    virtual AP4_Result GetFileDescriptor(int& /* fd */) { return AP4_ERROR_NOT_SUPPORTED; }
+
+    /**
+     * Cut the stream to a given size (no larger than its current size).
+     * Streams that cannot be resized return AP4_ERROR_NOT_SUPPORTED.
+     */
+    virtual AP4_Result Truncate(AP4_LargeSize /* size */) { return AP4_ERROR_NOT_SUPPORTED; }
 };
 
 /*----------------------------------------------------------------------
@@ -243,4 +260,91 @@ private:
     AP4_Cardinal    m_ReferenceCount;
 };
 
+/*----------------------------------------------------------------------
+|   AP4_SpillBudget
++---------------------------------------------------------------------*/
+/**
+ * Amount of memory shared by several AP4_SpillByteStream objects, which
+ * may be used from different threads. The budget must outlive the
+ * streams that use it.
+ */
+class AP4_SpillBudget
+{
+public:
+    AP4_SpillBudget(AP4_LargeSize size);
+    ~AP4_SpillBudget();
+
+    /**
+     * Reserve some memory, returning false if that would exceed the budget.
+     */
+    bool Reserve(AP4_LargeSize size);
+    void Release(AP4_LargeSize size);
+
+private:
+    // members
+    AP4_Mutex*    m_Lock;
+    AP4_LargeSize m_Size;
+    AP4_LargeSize m_Used;
+
+    // not copyable
+    AP4_SpillBudget(const AP4_SpillBudget&);
+    AP4_SpillBudget& operator=(const AP4_SpillBudget&);
+};
+
+/*----------------------------------------------------------------------
+|   AP4_SpillByteStream
++---------------------------------------------------------------------*/
+/**
+ * Read/write stream that keeps its data in memory until its size would
+ * exceed a threshold, at which point the data is moved to a file and the
+ * file is used from then on. The file is deleted when the stream is
+ * destroyed, so this can be used as a temporary storage that only touches
+ * the disk for large amounts of data.
+ * When a budget is given, the memory used by all the streams that share it
+ * is also limited, and a stream that cannot get more memory from the budget
+ * is moved to its file.
+ */
+class AP4_SpillByteStream : public AP4_ByteStream
+{
+public:
+    AP4_SpillByteStream(const char*      spill_filename,
+                        AP4_Size         memory_threshold,
+                        AP4_SpillBudget* budget = NULL);
+
+    // AP4_ByteStream methods
+    AP4_Result ReadPartial(void*     buffer, 
+                           AP4_Size  bytes_to_read, 
+                           AP4_Size& bytes_read);
+    AP4_Result WritePartial(const void* buffer, 
+                            AP4_Size    bytes_to_write, 
+                            AP4_Size&   bytes_written);
+    AP4_Result Seek(AP4_Position position);
+    AP4_Result Tell(AP4_Position& position);
+    AP4_Result GetSize(AP4_LargeSize& size);
+    AP4_Result Flush();
+
+    // AP4_Referenceable methods
+    void AddReference();
+    void Release();
+
+    // methods
+    bool HasSpilled() { return m_File != NULL; }
+
+protected:
+    virtual ~AP4_SpillByteStream();
+
+private:
+    // methods
+    AP4_Result Spill();
+
+    // members
+    AP4_String            m_SpillFilename;
+    AP4_Size              m_MemoryThreshold;
+    AP4_SpillBudget*      m_Budget;
+    AP4_LargeSize         m_Reserved; // memory reserved from the budget
+    AP4_MemoryByteStream* m_Memory;
+    AP4_ByteStream*       m_File;
+    AP4_Cardinal          m_ReferenceCount;
+};
+
 #endif // _AP4_BYTE_STREAM_H_
@@ -152,12 +152,7 @@ AP4_Co64Atom::WriteFields(AP4_ByteStream& stream)
     if (AP4_FAILED(result)) return result;
 
     // entries
-    for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
-        result = stream.WriteUI64(m_Entries[i]);
-        if (AP4_FAILED(result)) return result;
-    }
-
-    return result;
+    return stream.WriteUI64Array(m_Entries, m_EntryCount);
 }
 
 /*----------------------------------------------------------------------
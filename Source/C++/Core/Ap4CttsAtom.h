@@ -77,6 +77,7 @@ public:
     virtual AP4_Result WriteFields(AP4_ByteStream& stream);
     AP4_Result AddEntry(AP4_UI32 count, AP4_UI32 cts_offset);
     AP4_Result GetCtsOffset(AP4_Ordinal sample, AP4_UI32& cts_offset);
+    const AP4_Array<AP4_CttsTableEntry>& GetEntries() { return m_Entries; }
 
 private:
     // methods
@@ -197,6 +197,26 @@ AP4_DataBuffer::AppendData(const AP4_Byte* data, AP4_Size data_size)
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_DataBuffer::Swap
++---------------------------------------------------------------------*/
+void
+AP4_DataBuffer::Swap(AP4_DataBuffer& other)
+{
+    bool      buffer_is_local = m_BufferIsLocal;
+    AP4_Byte* buffer          = m_Buffer;
+    AP4_Size  buffer_size     = m_BufferSize;
+    AP4_Size  data_size       = m_DataSize;
+    m_BufferIsLocal = other.m_BufferIsLocal;
+    m_Buffer        = other.m_Buffer;
+    m_BufferSize    = other.m_BufferSize;
+    m_DataSize      = other.m_DataSize;
+    other.m_BufferIsLocal = buffer_is_local;
+    other.m_Buffer        = buffer;
+    other.m_BufferSize    = buffer_size;
+    other.m_DataSize      = data_size;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_DataBuffer::ReallocateBuffer
 +---------------------------------------------------------------------*/
@@ -62,6 +62,7 @@ class AP4_DataBuffer
 
     // memory management
     AP4_Result      Reserve(AP4_Size size);
+    void            Swap(AP4_DataBuffer& other); // exchange the buffers, no copy
 
  protected:
     // members
@@ -0,0 +1,381 @@
+/*****************************************************************
+|
+|    AP4 - Fast Start (moov Relocation)
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4FastStart.h"
+#include "Ap4MoovUpdater.h"
+#include "Ap4AtomFactory.h"
+#include "Ap4ByteStream.h"
+#include "Ap4ContainerAtom.h"
+#include "Ap4MoovAtom.h"
+#include "Ap4TrakAtom.h"
+#include "Ap4StcoAtom.h"
+#include "Ap4Co64Atom.h"
+#include "Ap4DataBuffer.h"
+
+/*----------------------------------------------------------------------
+|   AP4_FastStartLayout
++---------------------------------------------------------------------*/
+struct AP4_FastStartLayout {
+    AP4_LargeSize m_StreamSize;
+    AP4_Position  m_InsertPosition; // where the moov atom goes (after ftyp)
+    AP4_Position  m_MoovPosition;
+    AP4_LargeSize m_MoovSize;
+    bool          m_MoovFirst;      // the moov atom is already before the media data
+};
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart_Scan
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_FastStart_Scan(AP4_ByteStream& stream, AP4_FastStartLayout& layout)
+{
+    AP4_CHECK(stream.GetSize(layout.m_StreamSize));
+    layout.m_InsertPosition = 0;
+    layout.m_MoovPosition   = 0;
+    layout.m_MoovSize       = 0;
+    layout.m_MoovFirst      = false;
+
+    bool         moov_found = false;
+    bool         mdat_found = false;
+    bool         fragmented = false;
+    AP4_Position position   = 0;
+    while (position+AP4_ATOM_HEADER_SIZE <= layout.m_StreamSize) {
+        AP4_UI32 size_32 = 0;
+        AP4_UI32 type    = 0;
+        AP4_CHECK(stream.Seek(position));
+        AP4_CHECK(stream.ReadUI32(size_32));
+        AP4_CHECK(stream.ReadUI32(type));
+        AP4_LargeSize size = size_32;
+        if (size_32 == 0) {
+            size = layout.m_StreamSize-position;
+        } else if (size_32 == 1) {
+            AP4_UI64 size_64 = 0;
+            AP4_CHECK(stream.ReadUI64(size_64));
+            size = size_64;
+        }
+        if (size < AP4_ATOM_HEADER_SIZE || position+size > layout.m_StreamSize) {
+            return AP4_ERROR_INVALID_FORMAT;
+        }
+
+        if (position == 0 && type == AP4_ATOM_TYPE_FTYP) {
+            layout.m_InsertPosition = size;
+        } else if (type == AP4_ATOM_TYPE_MDAT) {
+            mdat_found = true;
+        } else if (type == AP4_ATOM_TYPE_MOOF) {
+            fragmented = true;
+        } else if (type == AP4_ATOM_TYPE_MOOV) {
+            if (moov_found) return AP4_ERROR_INVALID_FORMAT;
+            moov_found            = true;
+            layout.m_MoovPosition = position;
+            layout.m_MoovSize     = size;
+            layout.m_MoovFirst    = !mdat_found;
+        }
+
+        position += size;
+    }
+    if (!moov_found) return AP4_ERROR_INVALID_FORMAT;
+    if (fragmented && !layout.m_MoovFirst) return AP4_ERROR_NOT_SUPPORTED;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart_MapOffset
++---------------------------------------------------------------------*/
+static AP4_UI64
+AP4_FastStart_MapOffset(const AP4_FastStartLayout& layout,
+                        AP4_UI64                   offset,
+                        AP4_LargeSize              moov_space)
+{
+    if (offset >= layout.m_MoovPosition+layout.m_MoovSize) {
+        // after the old moov atom: the moov atom was removed and inserted before
+        return offset+moov_space-layout.m_MoovSize;
+    } else if (offset >= layout.m_InsertPosition) {
+        // between the insertion point and the old moov atom
+        return offset+moov_space;
+    } else {
+        return offset;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart_PromoteChunkOffsets
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_FastStart_PromoteChunkOffsets(AP4_MoovAtom&              moov,
+                                  const AP4_FastStartLayout& layout,
+                                  AP4_LargeSize              moov_space,
+                                  bool&                      promoted)
+{
+    promoted = false;
+    for (AP4_List<AP4_TrakAtom>::Item* item = moov.GetTrakAtoms().FirstItem();
+         item;
+         item = item->GetNext()) {
+        AP4_TrakAtom* trak = item->GetData();
+        AP4_StcoAtom* stco = AP4_DYNAMIC_CAST(AP4_StcoAtom, trak->FindChild("mdia/minf/stbl/stco"));
+        AP4_ContainerAtom* stbl = AP4_DYNAMIC_CAST(AP4_ContainerAtom, trak->FindChild("mdia/minf/stbl"));
+        if (stco == NULL || stbl == NULL) continue;
+
+        // check if the new offsets still fit in 32 bits
+        AP4_Cardinal    chunk_count   = stco->GetChunkCount();
+        const AP4_UI32* chunk_offsets = stco->GetChunkOffsets();
+        bool            overflow      = false;
+        for (unsigned int i=0; i<chunk_count; i++) {
+            if (AP4_FastStart_MapOffset(layout, chunk_offsets[i], moov_space) > 0xFFFFFFFF) {
+                overflow = true;
+                break;
+            }
+        }
+        if (!overflow) continue;
+
+        // replace the stco atom with a co64 atom with the same offsets
+        AP4_UI64* large_offsets = new AP4_UI64[chunk_count];
+        for (unsigned int i=0; i<chunk_count; i++) {
+            large_offsets[i] = chunk_offsets[i];
+        }
+        AP4_Co64Atom* co64 = new AP4_Co64Atom(large_offsets, chunk_count);
+        delete[] large_offsets;
+        int position = 0;
+        for (AP4_List<AP4_Atom>::Item* child = stbl->GetChildren().FirstItem();
+             child && child->GetData() != stco;
+             child = child->GetNext()) {
+            ++position;
+        }
+        stbl->RemoveChild(stco);
+        delete stco;
+        AP4_CHECK(stbl->AddChild(co64, position));
+        promoted = true;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart_PrepareMoov
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_FastStart_PrepareMoov(AP4_ByteStream&            stream,
+                          const AP4_FastStartLayout& layout,
+                          AP4_Size                   padding_size,
+                          bool                       in_place,
+                          AP4_DataBuffer&            moov_data,
+                          AP4_LargeSize&             free_size)
+{
+    // load the moov atom
+    AP4_CHECK(stream.Seek(layout.m_MoovPosition));
+    AP4_DefaultAtomFactory atom_factory;
+    AP4_Atom* atom = NULL;
+    AP4_CHECK(atom_factory.CreateAtomFromStream(stream, atom));
+    AP4_MoovAtom* moov = AP4_DYNAMIC_CAST(AP4_MoovAtom, atom);
+    if (moov == NULL) {
+        delete atom;
+        return AP4_ERROR_INVALID_FORMAT;
+    }
+
+    // compute the space taken by the moov atom and the padding, which
+    // changes when stco atoms need to be promoted to co64
+    AP4_LargeSize moov_space = 0;
+    AP4_Result    result     = AP4_SUCCESS;
+    for (;;) {
+        AP4_LargeSize moov_size = moov->GetSize();
+        free_size = padding_size ? (padding_size < AP4_ATOM_HEADER_SIZE ? AP4_ATOM_HEADER_SIZE : padding_size) : 0;
+        if (in_place                                  &&
+            layout.m_MoovSize > moov_size+free_size   &&
+            layout.m_MoovSize-moov_size-free_size < AP4_ATOM_HEADER_SIZE) {
+            // the space left at the end of the file must be large enough for a free atom
+            free_size += AP4_ATOM_HEADER_SIZE;
+        }
+        moov_space = moov_size+free_size;
+
+        bool promoted = false;
+        result = AP4_FastStart_PromoteChunkOffsets(*moov, layout, moov_space, promoted);
+        if (AP4_FAILED(result) || !promoted) break;
+    }
+
+    // update the chunk offsets
+    for (AP4_List<AP4_TrakAtom>::Item* item = moov->GetTrakAtoms().FirstItem();
+         item && AP4_SUCCEEDED(result);
+         item = item->GetNext()) {
+        AP4_TrakAtom* trak = item->GetData();
+        AP4_Array<AP4_UI64> chunk_offsets;
+        if (AP4_FAILED(trak->GetChunkOffsets(chunk_offsets))) continue;
+        for (unsigned int i=0; i<chunk_offsets.ItemCount(); i++) {
+            chunk_offsets[i] = AP4_FastStart_MapOffset(layout, chunk_offsets[i], moov_space);
+        }
+        result = trak->SetChunkOffsets(chunk_offsets);
+    }
+
+    // serialize the moov atom, which may still read some of its payload from the stream
+    if (AP4_SUCCEEDED(result)) {
+        result = moov_data.Reserve((AP4_Size)moov->GetSize());
+    }
+    if (AP4_SUCCEEDED(result)) {
+        AP4_MemoryByteStream* memory = new AP4_MemoryByteStream(moov_data);
+        result = moov->Write(*memory);
+        memory->Release();
+    }
+    delete moov;
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart_CopyRange
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_FastStart_CopyRange(AP4_ByteStream& input,
+                        AP4_Position    start,
+                        AP4_LargeSize   size,
+                        AP4_ByteStream& output)
+{
+    if (size == 0) return AP4_SUCCESS;
+    AP4_CHECK(input.Seek(start));
+    return input.CopyTo(output, size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart_MoveRange
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_FastStart_MoveRange(AP4_ByteStream& stream,
+                        AP4_Position    start,
+                        AP4_LargeSize   size,
+                        AP4_SI64        shift,
+                        AP4_UI08*       buffer)
+{
+    if (size == 0 || shift == 0) return AP4_SUCCESS;
+
+    // when moving towards the end, start from the end so that the
+    // data is not overwritten before it is moved, and vice versa
+    AP4_LargeSize done = 0;
+    while (done < size) {
+        AP4_Size chunk = (size-done) < AP4_FAST_START_MOVE_BLOCK_SIZE ?
+                         (AP4_Size)(size-done) : AP4_FAST_START_MOVE_BLOCK_SIZE;
+        AP4_Position position = shift > 0 ? start+size-done-chunk : start+done;
+        AP4_CHECK(stream.Seek(position));
+        AP4_CHECK(stream.Read(buffer, chunk));
+        AP4_CHECK(stream.Seek(position+shift));
+        AP4_CHECK(stream.Write(buffer, chunk));
+        done += chunk;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart::Process
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_FastStart::Process(AP4_ByteStream& input,
+                       AP4_ByteStream& output,
+                       AP4_Size        padding_size,
+                       bool*           moved)
+{
+    AP4_FastStartLayout layout;
+    AP4_CHECK(AP4_FastStart_Scan(input, layout));
+    if (moved) *moved = !layout.m_MoovFirst;
+    if (layout.m_MoovFirst) {
+        return AP4_FastStart_CopyRange(input, 0, layout.m_StreamSize, output);
+    }
+
+    AP4_DataBuffer moov_data;
+    AP4_LargeSize  free_size = 0;
+    AP4_CHECK(AP4_FastStart_PrepareMoov(input, layout, padding_size, false, moov_data, free_size));
+
+    // ftyp, moov and padding, then everything else in the same order
+    AP4_Position moov_end = layout.m_MoovPosition+layout.m_MoovSize;
+    AP4_CHECK(AP4_FastStart_CopyRange(input, 0, layout.m_InsertPosition, output));
+    AP4_CHECK(output.Write(moov_data.GetData(), moov_data.GetDataSize()));
+    if (free_size) {
+        AP4_CHECK(AP4_MoovUpdater::WriteFreeAtom(output, free_size));
+    }
+    AP4_CHECK(AP4_FastStart_CopyRange(input,
+                                      layout.m_InsertPosition,
+                                      layout.m_MoovPosition-layout.m_InsertPosition,
+                                      output));
+    AP4_CHECK(AP4_FastStart_CopyRange(input, moov_end, layout.m_StreamSize-moov_end, output));
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart::ProcessInPlace
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_FastStart::ProcessInPlace(AP4_ByteStream& stream,
+                              AP4_Size        padding_size,
+                              bool*           moved)
+{
+    AP4_FastStartLayout layout;
+    AP4_CHECK(AP4_FastStart_Scan(stream, layout));
+    if (moved) *moved = !layout.m_MoovFirst;
+    if (layout.m_MoovFirst) return AP4_SUCCESS;
+
+    AP4_DataBuffer moov_data;
+    AP4_LargeSize  free_size = 0;
+    AP4_CHECK(AP4_FastStart_PrepareMoov(stream, layout, padding_size, true, moov_data, free_size));
+    AP4_LargeSize moov_space   = moov_data.GetDataSize()+free_size;
+    AP4_SI64      shift_after  = (AP4_SI64)moov_space-(AP4_SI64)layout.m_MoovSize;
+    AP4_Position  moov_end     = layout.m_MoovPosition+layout.m_MoovSize;
+
+    // move what follows the moov atom first, then what precedes it (the
+    // moov atom has been serialized, so its old space can be overwritten)
+    AP4_UI08* buffer = new AP4_UI08[AP4_FAST_START_MOVE_BLOCK_SIZE];
+    AP4_Result result = AP4_FastStart_MoveRange(stream,
+                                                moov_end,
+                                                layout.m_StreamSize-moov_end,
+                                                shift_after,
+                                                buffer);
+    if (AP4_SUCCEEDED(result)) {
+        result = AP4_FastStart_MoveRange(stream,
+                                         layout.m_InsertPosition,
+                                         layout.m_MoovPosition-layout.m_InsertPosition,
+                                         moov_space,
+                                         buffer);
+    }
+    delete[] buffer;
+    if (AP4_FAILED(result)) return result;
+
+    // write the moov atom and the padding
+    AP4_CHECK(stream.Seek(layout.m_InsertPosition));
+    AP4_CHECK(stream.Write(moov_data.GetData(), moov_data.GetDataSize()));
+    if (free_size) {
+        AP4_CHECK(AP4_MoovUpdater::WriteFreeAtom(stream, free_size));
+    }
+
+    // the end of the file is no longer used if the moov atom got smaller
+    if (shift_after < 0) {
+        AP4_CHECK(stream.Seek(layout.m_StreamSize+shift_after));
+        AP4_CHECK(AP4_MoovUpdater::WriteFreeAtom(stream, (AP4_LargeSize)(-shift_after)));
+    }
+
+    return stream.Flush();
+}
@@ -0,0 +1,90 @@
+/*****************************************************************
+|
+|    AP4 - Fast Start (moov Relocation)
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_FAST_START_H_
+#define _AP4_FAST_START_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ByteStream;
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_Size AP4_FAST_START_MOVE_BLOCK_SIZE = 1024*1024;
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart
++---------------------------------------------------------------------*/
+/**
+ * Move the moov atom of a non-fragmented MP4 file in front of the media
+ * data (right after the ftyp atom), so that the file can be played while
+ * it is being downloaded.
+ *
+ * Unlike AP4_Processor, the samples are not read and written one by one:
+ * the other top-level atoms are copied as byte ranges, and only the chunk
+ * offsets (stco/co64) of the moov atom are changed. stco atoms are
+ * converted to co64 atoms when the new offsets do not fit in 32 bits.
+ * A free atom of padding_size bytes can be inserted after the moov atom,
+ * so that it can later be updated in place (see AP4_MoovUpdater).
+ */
+class AP4_FastStart {
+public:
+    // class methods
+    /**
+     * Write a copy of the input with the moov atom moved. If the moov atom
+     * is already before the media data, the input is copied unchanged.
+     * If moved is not NULL, it is set to whether the moov atom was moved.
+     */
+    static AP4_Result Process(AP4_ByteStream& input,
+                              AP4_ByteStream& output,
+                              AP4_Size        padding_size = 0,
+                              bool*           moved = NULL);
+
+    /**
+     * Move the moov atom in a stream opened for reading and writing. The
+     * data before the moov atom is shifted in blocks, starting from the
+     * end. If the file gets shorter, the unused space at the end becomes
+     * a free atom.
+     */
+    static AP4_Result ProcessInPlace(AP4_ByteStream& stream,
+                                     AP4_Size        padding_size = 0,
+                                     bool*           moved = NULL);
+
+private:
+    // don't instantiate this class
+    AP4_FastStart() {}
+};
+
+#endif // _AP4_FAST_START_H_
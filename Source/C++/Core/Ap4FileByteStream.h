@@ -61,6 +61,17 @@ public:
      */
     static AP4_Result Create(const char* name, Mode mode, AP4_ByteStream*& stream);
 
+    /**
+     * Rename a file, replacing the destination if it exists. On systems
+     * where renaming is atomic, readers of the destination see either the
+     * old or the new file, never a partial one.
+     *
+     * @param from Name of the file to rename
+     * @param to New name of the file
+     * @return AP4_SUCCESS if the file was renamed, or an error code if not
+     */
+    static AP4_Result Rename(const char* from, const char* to);
+
     // constructors
     AP4_FileByteStream(AP4_ByteStream* delegate) : m_Delegate(delegate) {}
 
@@ -86,6 +97,11 @@ public:
     AP4_Result Tell(AP4_Position& position) { return m_Delegate->Tell(position); }
     AP4_Result GetSize(AP4_LargeSize& size) { return m_Delegate->GetSize(size);  }
     AP4_Result Flush()                      { return m_Delegate->Flush();        }
+    AP4_Result CopyTo(AP4_ByteStream& stream, AP4_LargeSize size) {
+        return m_Delegate->CopyTo(stream, size);
+    }
+    AP4_Result GetFileDescriptor(int& fd)   { return m_Delegate->GetFileDescriptor(fd); }
+    AP4_Result Truncate(AP4_LargeSize size) { return m_Delegate->Truncate(size); }
 
     // AP4_Referenceable methods
     void AddReference() { m_Delegate->AddReference(); }
@@ -0,0 +1,227 @@
+/*****************************************************************
+|
+|    AP4 - File Summary
+|
+|    Copyright 2002-2014 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4FileSummary.h"
+#include "Ap4ByteStream.h"
+#include "Ap4AtomFactory.h"
+#include "Ap4File.h"
+#include "Ap4FtypAtom.h"
+#include "Ap4Movie.h"
+#include "Ap4StszAtom.h"
+#include "Ap4SampleDescription.h"
+#include "Ap4Protection.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   AP4_SummaryAtomFactory
++---------------------------------------------------------------------*/
+/**
+ * Atom factory that skips the sample tables: the stbl children that
+ * are proportional to the number of samples are replaced by empty atoms,
+ * and stsz/stz2 atoms are reduced to their sample count.
+ * The atoms created by this factory are only meant to be inspected, not
+ * written back.
+ */
+class AP4_SummaryAtomFactory : public AP4_DefaultAtomFactory
+{
+public:
+    // AP4_AtomFactory methods
+    virtual AP4_Result CreateAtomFromStream(AP4_ByteStream& stream,
+                                            AP4_UI32        type,
+                                            AP4_UI32        size_32,
+                                            AP4_UI64        size_64,
+                                            AP4_Atom*&      atom);
+};
+
+/*----------------------------------------------------------------------
+|   AP4_SummaryAtomFactory::CreateAtomFromStream
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SummaryAtomFactory::CreateAtomFromStream(AP4_ByteStream& stream,
+                                             AP4_UI32        type,
+                                             AP4_UI32        size_32,
+                                             AP4_UI64        size_64,
+                                             AP4_Atom*&      atom)
+{
+    if (GetContext() == AP4_ATOM_TYPE_STBL) {
+        switch (type) {
+            case AP4_ATOM_TYPE_STTS:
+            case AP4_ATOM_TYPE_CTTS:
+            case AP4_ATOM_TYPE_STSC:
+            case AP4_ATOM_TYPE_STCO:
+            case AP4_ATOM_TYPE_CO64:
+            case AP4_ATOM_TYPE_STSS:
+            case AP4_ATOM_TYPE_SBGP:
+            case AP4_ATOM_TYPE_SAIZ:
+            case AP4_ATOM_TYPE_SAIO:
+                // the caller skips to the end of the atom
+                atom = new AP4_UnknownAtom(type, NULL, 0);
+                return AP4_SUCCESS;
+
+            case AP4_ATOM_TYPE_STSZ:
+            case AP4_ATOM_TYPE_STZ2: {
+                // only read the header (version and flags, sample size or
+                // field size, sample count), and make an stsz atom with a
+                // constant sample size, which has no entries
+                // (size_64 is the atom size, whether its header is 32 or 64-bit)
+                AP4_UI08 header[12];
+                AP4_UI32 header_size = (size_32 == 1) ? AP4_ATOM_HEADER_SIZE_64 : AP4_ATOM_HEADER_SIZE;
+                if (size_64 < header_size+sizeof(header) ||
+                    AP4_FAILED(stream.Read(header, sizeof(header)))) {
+                    return AP4_ERROR_INVALID_FORMAT;
+                }
+                AP4_UI08 stsz[AP4_FULL_ATOM_HEADER_SIZE+8-AP4_ATOM_HEADER_SIZE] = {0};
+                AP4_BytesFromUInt32BE(&stsz[4], 1);
+                AP4_CopyMemory(&stsz[8], &header[8], 4);
+                AP4_MemoryByteStream* stsz_stream = new AP4_MemoryByteStream(stsz, sizeof(stsz));
+                atom = AP4_StszAtom::Create(AP4_ATOM_HEADER_SIZE+sizeof(stsz), *stsz_stream);
+                stsz_stream->Release();
+                return atom ? AP4_SUCCESS : AP4_ERROR_INVALID_FORMAT;
+            }
+        }
+    }
+
+    return AP4_DefaultAtomFactory::CreateAtomFromStream(stream, type, size_32, size_64, atom);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FileSummary::Track::Track
++---------------------------------------------------------------------*/
+AP4_FileSummary::Track::Track() :
+    m_Id(0),
+    m_Type(AP4_Track::TYPE_UNKNOWN),
+    m_HandlerType(0),
+    m_Format(0),
+    m_ProtectionScheme(0),
+    m_SampleDescriptionCount(0),
+    m_SampleCount(0),
+    m_DurationMs(0),
+    m_MediaTimeScale(0),
+    m_MediaDuration(0),
+    m_Width(0),
+    m_Height(0),
+    m_SampleRate(0),
+    m_ChannelCount(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FileSummary::AP4_FileSummary
++---------------------------------------------------------------------*/
+AP4_FileSummary::AP4_FileSummary() :
+    m_MajorBrand(0),
+    m_MinorVersion(0),
+    m_FastStart(true),
+    m_Fragmented(false),
+    m_TimeScale(0),
+    m_Duration(0),
+    m_DurationMs(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FileSummary::Create
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_FileSummary::Create(AP4_ByteStream& stream, AP4_FileSummary*& summary)
+{
+    summary = NULL;
+
+    // parse the file up to the moov atom, with a factory of our own
+    // since atom factories keep a parsing context
+    AP4_SummaryAtomFactory factory;
+    AP4_File file(stream, factory, true);
+    AP4_Movie* movie = file.GetMovie();
+    if (movie == NULL) return AP4_ERROR_INVALID_FORMAT;
+
+    summary = new AP4_FileSummary();
+
+    // file info
+    AP4_FtypAtom* ftyp = file.GetFileType();
+    if (ftyp) {
+        summary->m_MajorBrand   = ftyp->GetMajorBrand();
+        summary->m_MinorVersion = ftyp->GetMinorVersion();
+        for (unsigned int i=0; i<ftyp->GetCompatibleBrands().ItemCount(); i++) {
+            AP4_UI32 brand = ftyp->GetCompatibleBrands()[i];
+            if (brand) summary->m_CompatibleBrands.Append(brand);
+        }
+    }
+    summary->m_FastStart  = file.IsMoovBeforeMdat();
+    summary->m_Fragmented = movie->HasFragments();
+    summary->m_TimeScale  = movie->GetTimeScale();
+    summary->m_Duration   = movie->GetDuration();
+    summary->m_DurationMs = movie->GetDurationMs();
+
+    // tracks
+    summary->m_Tracks.EnsureCapacity(movie->GetTracks().ItemCount());
+    for (AP4_List<AP4_Track>::Item* item = movie->GetTracks().FirstItem();
+                                    item;
+                                    item = item->GetNext()) {
+        AP4_Track* track = item->GetData();
+        Track      info;
+        info.m_Id                     = track->GetId();
+        info.m_Type                   = track->GetType();
+        info.m_HandlerType            = track->GetHandlerType();
+        info.m_Language               = track->GetTrackLanguage();
+        info.m_SampleDescriptionCount = track->GetSampleDescriptionCount();
+        info.m_SampleCount            = track->GetSampleCount();
+        info.m_DurationMs             = track->GetDurationMs();
+        info.m_MediaTimeScale         = track->GetMediaTimeScale();
+        info.m_MediaDuration          = track->GetMediaDuration();
+
+        AP4_SampleDescription* desc = track->GetSampleDescription(0);
+        if (desc && desc->GetType() == AP4_SampleDescription::TYPE_PROTECTED) {
+            AP4_ProtectedSampleDescription* prot_desc = AP4_DYNAMIC_CAST(AP4_ProtectedSampleDescription, desc);
+            if (prot_desc) {
+                info.m_ProtectionScheme = prot_desc->GetSchemeType();
+                desc = prot_desc->GetOriginalSampleDescription();
+            }
+        }
+        if (desc) {
+            info.m_Format = desc->GetFormat();
+            desc->GetCodecString(info.m_Codec);
+            AP4_AudioSampleDescription* audio_desc = AP4_DYNAMIC_CAST(AP4_AudioSampleDescription, desc);
+            if (audio_desc) {
+                info.m_SampleRate   = audio_desc->GetSampleRate();
+                info.m_ChannelCount = audio_desc->GetChannelCount();
+            }
+            AP4_VideoSampleDescription* video_desc = AP4_DYNAMIC_CAST(AP4_VideoSampleDescription, desc);
+            if (video_desc) {
+                info.m_Width  = video_desc->GetWidth();
+                info.m_Height = video_desc->GetHeight();
+            }
+        }
+        summary->m_Tracks.Append(info);
+    }
+
+    return AP4_SUCCESS;
+}
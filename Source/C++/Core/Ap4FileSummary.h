@@ -0,0 +1,118 @@
+/*****************************************************************
+|
+|    AP4 - File Summary
+|
+|    Copyright 2002-2014 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+
+#ifndef _AP4_FILE_SUMMARY_H_
+#define _AP4_FILE_SUMMARY_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+#include "Ap4Array.h"
+#include "Ap4String.h"
+#include "Ap4Track.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ByteStream;
+
+/*----------------------------------------------------------------------
+|   AP4_FileSummary
++---------------------------------------------------------------------*/
+/**
+ * Compact summary of an MP4 file and its tracks (brands, durations,
+ * codec strings, ...), for cataloging large numbers of files.
+ *
+ * Only the atoms up to and including the moov atom are parsed, and the
+ * sample tables are not loaded: of the stbl children, only the stsd atom
+ * and the sample count of the stsz/stz2 atoms are read, so the cost of
+ * a summary does not depend on the number of samples.
+ * Creating summaries of different files from different threads is safe.
+ */
+class AP4_FileSummary
+{
+public:
+    // types
+    struct Track {
+        Track();
+
+        AP4_UI32        m_Id;
+        AP4_Track::Type m_Type;
+        AP4_UI32        m_HandlerType;
+        AP4_String      m_Language;
+        AP4_String      m_Codec;        // codec string of the first sample description
+        AP4_UI32        m_Format;       // format of the first sample description (original format if protected)
+        AP4_UI32        m_ProtectionScheme; // 0 if the track is not protected
+        AP4_Cardinal    m_SampleDescriptionCount;
+        AP4_Cardinal    m_SampleCount;  // samples in the moov atom only
+        AP4_UI32        m_DurationMs;
+        AP4_UI32        m_MediaTimeScale;
+        AP4_UI64        m_MediaDuration;
+        AP4_UI16        m_Width;        // video tracks only
+        AP4_UI16        m_Height;       // video tracks only
+        AP4_UI32        m_SampleRate;   // audio tracks only
+        AP4_UI16        m_ChannelCount; // audio tracks only
+    };
+
+    // class methods
+    /**
+     * Create the summary of a file. Returns AP4_ERROR_INVALID_FORMAT if
+     * the file has no moov atom.
+     */
+    static AP4_Result Create(AP4_ByteStream& stream, AP4_FileSummary*& summary);
+
+    // methods
+    AP4_UI32                     GetMajorBrand()       const { return m_MajorBrand;       }
+    AP4_UI32                     GetMinorVersion()     const { return m_MinorVersion;     }
+    const AP4_Array<AP4_UI32>&   GetCompatibleBrands() const { return m_CompatibleBrands; }
+    bool                         IsFastStart()         const { return m_FastStart;        }
+    bool                         IsFragmented()        const { return m_Fragmented;       }
+    AP4_UI32                     GetTimeScale()        const { return m_TimeScale;        }
+    AP4_UI64                     GetDuration()         const { return m_Duration;         }
+    AP4_UI32                     GetDurationMs()       const { return m_DurationMs;       }
+    const AP4_Array<Track>&      GetTracks()           const { return m_Tracks;           }
+
+private:
+    // constructor
+    AP4_FileSummary();
+
+    // members
+    AP4_UI32            m_MajorBrand;
+    AP4_UI32            m_MinorVersion;
+    AP4_Array<AP4_UI32> m_CompatibleBrands;
+    bool                m_FastStart;
+    bool                m_Fragmented;
+    AP4_UI32            m_TimeScale;
+    AP4_UI64            m_Duration;
+    AP4_UI32            m_DurationMs;
+    AP4_Array<Track>    m_Tracks;
+};
+
+#endif // _AP4_FILE_SUMMARY_H_
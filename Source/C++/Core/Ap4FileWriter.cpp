@@ -39,18 +39,112 @@
 #include "Ap4DataBuffer.h"
 #include "Ap4FtypAtom.h"
 #include "Ap4SampleTable.h"
+#include "Ap4StscAtom.h"
+#include "Ap4StcoAtom.h"
+#include "Ap4Co64Atom.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriterChunk
++---------------------------------------------------------------------*/
+struct AP4_FileWriterChunk {
+    AP4_Track*   m_Track;
+    AP4_Ordinal  m_FirstSample;
+    AP4_Cardinal m_SampleCount;
+    AP4_Ordinal  m_DescriptionIndex;
+    AP4_UI64     m_StartTime; // in microseconds
+    AP4_UI64     m_Size;
+    AP4_UI64     m_Offset;    // relative to the start of the mdat payload
+};
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriterTrack
++---------------------------------------------------------------------*/
+struct AP4_FileWriterTrack {
+    AP4_FileWriterTrack(AP4_Track* track) :
+        m_Track(track),
+        m_Stbl(NULL),
+        m_Stsc(NULL),
+        m_ChunkOffsets(NULL),
+        m_NewStsc(NULL),
+        m_NewChunkOffsets(NULL),
+        m_NextChunk(0) {}
+    ~AP4_FileWriterTrack() {
+        delete m_NewStsc;
+        delete m_NewChunkOffsets;
+    }
+
+    AP4_Track*                     m_Track;
+    AP4_Array<AP4_FileWriterChunk> m_Chunks;
+    AP4_ContainerAtom*             m_Stbl;
+    AP4_Atom*                      m_Stsc;            // original
+    AP4_Atom*                      m_ChunkOffsets;    // original stco or co64
+    AP4_StscAtom*                  m_NewStsc;         // only for re-chunked tracks
+    AP4_Atom*                      m_NewChunkOffsets; // stco or co64, while it is not attached
+    AP4_Ordinal                    m_NextChunk;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriter_ReplaceChild
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_FileWriter_ReplaceChild(AP4_ContainerAtom* parent, AP4_Atom* child, AP4_Atom* replacement)
+{
+    int position = 0;
+    for (AP4_List<AP4_Atom>::Item* item = parent->GetChildren().FirstItem();
+                                   item;
+                                   item = item->GetNext(), ++position) {
+        if (item->GetData() == child) {
+            AP4_Result result = parent->RemoveChild(child);
+            if (AP4_FAILED(result)) return result;
+            return parent->AddChild(replacement, position);
+        }
+    }
+    return AP4_ERROR_NO_SUCH_ITEM;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriter_CreateChunkOffsets
++---------------------------------------------------------------------*/
+static AP4_Atom*
+AP4_FileWriter_CreateChunkOffsets(const AP4_Array<AP4_FileWriterChunk>& chunks,
+                                  AP4_UI64                              base,
+                                  bool                                  large)
+{
+    AP4_Cardinal chunk_count = chunks.ItemCount();
+    if (large) {
+        AP4_UI64* offsets = new AP4_UI64[chunk_count];
+        for (unsigned int i=0; i<chunk_count; i++) {
+            offsets[i] = base+chunks[i].m_Offset;
+        }
+        AP4_Co64Atom* co64 = new AP4_Co64Atom(offsets, chunk_count);
+        delete[] offsets;
+        return co64;
+    } else {
+        AP4_UI32* offsets = new AP4_UI32[chunk_count];
+        for (unsigned int i=0; i<chunk_count; i++) {
+            offsets[i] = (AP4_UI32)(base+chunks[i].m_Offset);
+        }
+        AP4_StcoAtom* stco = new AP4_StcoAtom(offsets, chunk_count);
+        delete[] offsets;
+        return stco;
+    }
+}
 
 /*----------------------------------------------------------------------
 |   AP4_FileWriter::Write
 +---------------------------------------------------------------------*/
 AP4_Result
-AP4_FileWriter::Write(AP4_File& file, AP4_ByteStream& stream, Interleaving /* interleaving */)
+AP4_FileWriter::Write(AP4_File&       file, 
+                      AP4_ByteStream& stream, 
+                      Interleaving    interleaving,
+                      AP4_UI32        chunk_duration_ms)
 {
     // get the file type
     AP4_FtypAtom* file_type = file.GetFileType();
 
     // write the ftyp atom (always first)
-    if (file_type) file_type->Write(stream);
+    if (file_type) file_type->WriteBuffered(stream);
 
     // write the top-level atoms, except for ftyp, moov and mdat
     for (AP4_List<AP4_Atom>::Item* atom_item = file.GetChildren().FirstItem();
@@ -60,7 +154,7 @@ AP4_FileWriter::Write(AP4_File& file, AP4_ByteStream& stream, Interleaving /* in
         if (atom->GetType() != AP4_ATOM_TYPE_MDAT &&
             atom->GetType() != AP4_ATOM_TYPE_FTYP &&
             atom->GetType() != AP4_ATOM_TYPE_MOOV) {
-            atom->Write(stream);
+            atom->WriteBuffered(stream);
         }
     }
              
@@ -71,108 +165,199 @@ AP4_FileWriter::Write(AP4_File& file, AP4_ByteStream& stream, Interleaving /* in
     // see how much we've written so far
     AP4_Position position;
     stream.Tell(position);
-    
-    // compute the total size of all the samples
-    AP4_UI64 total_sample_size = 0;
-    for (AP4_List<AP4_Track>::Item* track_item = movie->GetTracks().FirstItem();
-                                    track_item;
-                                    track_item = track_item->GetNext()) {
-        AP4_Track*   track = track_item->GetData();
-        AP4_Cardinal sample_count = track->GetSampleCount();
-        AP4_Sample   sample;
-        for (AP4_Ordinal i=0; i<sample_count; i++) {
-            track->GetSample(i, sample);
-            total_sample_size += sample.GetSize();
-        }
-    }
 
-    // decide if we need a 32-bit or 64-bit mdat header
-    AP4_UI64 mdat_size;
-    bool mdat_is_large;
-    if (total_sample_size <= 0xFFFFFFFF - AP4_ATOM_HEADER_SIZE) {
-        mdat_size = AP4_ATOM_HEADER_SIZE;
-        mdat_is_large = false;
-    } else {
-        mdat_size = 16;
-        mdat_is_large = true;
-    }
-    
-    // backup and recompute all the chunk offsets
-    unsigned int t=0;
+    // split the samples of each track into chunks, either keeping the
+    // track's chunks or making chunks of chunk_duration_ms
     AP4_Result result = AP4_SUCCESS;
-    AP4_UI64   mdat_position = position+movie->GetMoovAtom()->GetSize();
-    AP4_Array<AP4_Array<AP4_UI64>*> trak_chunk_offsets_backup;
-    AP4_Array<AP4_UI64>             chunk_offsets;
+    AP4_Array<AP4_FileWriterTrack*> tracks;
+    AP4_Array<AP4_FileWriterChunk*> layout;
     for (AP4_List<AP4_Track>::Item* track_item = movie->GetTracks().FirstItem();
                                     track_item;
                                     track_item = track_item->GetNext()) {
-        AP4_Track*    track = track_item->GetData();
-        AP4_TrakAtom* trak  = track->UseTrakAtom();
-        
-        // backup the chunk offsets
-        AP4_Array<AP4_UI64>* chunk_offsets_backup = new AP4_Array<AP4_UI64>();
-        trak_chunk_offsets_backup.Append(chunk_offsets_backup);
-        result = trak->GetChunkOffsets(*chunk_offsets_backup);
-        if (AP4_FAILED(result)) goto end;
+        AP4_Track*           track = track_item->GetData();
+        AP4_FileWriterTrack* info  = new AP4_FileWriterTrack(track);
+        tracks.Append(info);
 
-        // allocate space for the new chunk offsets
-        chunk_offsets.SetItemCount(chunk_offsets_backup->ItemCount());
-        
-        // compute the new chunk offsets
-        AP4_Cardinal     sample_count = track->GetSampleCount();
+        AP4_Cardinal sample_count = track->GetSampleCount();
+        if (sample_count == 0) continue;
         AP4_SampleTable* sample_table = track->GetSampleTable();
-        AP4_Sample       sample;
+        info->m_Stbl = AP4_DYNAMIC_CAST(AP4_ContainerAtom, track->UseTrakAtom()->FindChild("mdia/minf/stbl"));
+        if (info->m_Stbl) {
+            info->m_Stsc = info->m_Stbl->GetChild(AP4_ATOM_TYPE_STSC);
+            info->m_ChunkOffsets = info->m_Stbl->GetChild(AP4_ATOM_TYPE_STCO);
+            if (info->m_ChunkOffsets == NULL) {
+                info->m_ChunkOffsets = info->m_Stbl->GetChild(AP4_ATOM_TYPE_CO64);
+            }
+        }
+        if (info->m_Stsc == NULL || info->m_ChunkOffsets == NULL) {
+            result = AP4_ERROR_INVALID_FORMAT;
+            goto end;
+        }
+
+        AP4_UI32 media_time_scale = track->GetMediaTimeScale();
+        AP4_UI64 chunk_duration   = AP4_ConvertTime(chunk_duration_ms, 1000, media_time_scale);
+        AP4_UI64 chunk_start      = 0;
+        AP4_Sample sample;
         for (AP4_Ordinal i=0; i<sample_count; i++) {
-            AP4_Ordinal chunk_index = 0;
-            AP4_Ordinal position_in_chunk = 0;
-            sample_table->GetSampleChunkPosition(i, chunk_index, position_in_chunk);
-            sample_table->GetSample(i, sample);
-            if (position_in_chunk == 0) {
-                // this sample is the first sample in a chunk, so this is the start of a chunk
-                if (chunk_index >= chunk_offsets.ItemCount()) return AP4_ERROR_INTERNAL;
-                chunk_offsets[chunk_index] = mdat_position+mdat_size;
+            result = sample_table->GetSample(i, sample);
+            if (AP4_FAILED(result)) goto end;
+            bool new_chunk;
+            if (i == 0) {
+                new_chunk = true;
+            } else if (interleaving == INTERLEAVING_SEQUENTIAL) {
+                AP4_Ordinal chunk_index = 0;
+                AP4_Ordinal position_in_chunk = 0;
+                sample_table->GetSampleChunkPosition(i, chunk_index, position_in_chunk);
+                new_chunk = (position_in_chunk == 0);
+            } else {
+                AP4_FileWriterChunk& chunk = info->m_Chunks[info->m_Chunks.ItemCount()-1];
+                new_chunk = sample.GetDescriptionIndex() != chunk.m_DescriptionIndex ||
+                            sample.GetDts()-chunk_start >= chunk_duration;
             }
-            mdat_size += sample.GetSize();
-        }        
-        result = trak->SetChunkOffsets(chunk_offsets);
+            if (new_chunk) {
+                AP4_FileWriterChunk chunk;
+                chunk.m_Track            = track;
+                chunk.m_FirstSample      = i;
+                chunk.m_SampleCount      = 0;
+                chunk.m_DescriptionIndex = sample.GetDescriptionIndex();
+                chunk.m_StartTime        = AP4_ConvertTime(sample.GetDts(), media_time_scale, 1000000);
+                chunk.m_Size             = 0;
+                chunk.m_Offset           = 0;
+                info->m_Chunks.Append(chunk);
+                chunk_start = sample.GetDts();
+            }
+            AP4_FileWriterChunk& chunk = info->m_Chunks[info->m_Chunks.ItemCount()-1];
+            ++chunk.m_SampleCount;
+            chunk.m_Size += sample.GetSize();
+        }
     }
-    
-    // write the moov atom
-    movie->GetMoovAtom()->Write(stream);
-    
-    // create and write the media data (mdat)
-    if (mdat_is_large) {
-        stream.WriteUI32(1);
-        stream.WriteUI32(AP4_ATOM_TYPE_MDAT);
-        stream.WriteUI64(mdat_size);
-    } else {
-        stream.WriteUI32((AP4_UI32)mdat_size);
-        stream.WriteUI32(AP4_ATOM_TYPE_MDAT);
+
+    // lay the chunks out in the mdat, track after track or in time order,
+    // and compute their offsets relative to the start of the mdat payload
+    {
+        AP4_UI64 mdat_payload_size = 0;
+        for (;;) {
+            AP4_FileWriterTrack* next = NULL;
+            for (unsigned int t=0; t<tracks.ItemCount(); t++) {
+                AP4_FileWriterTrack* info = tracks[t];
+                if (info->m_NextChunk >= info->m_Chunks.ItemCount()) continue;
+                if (interleaving == INTERLEAVING_SEQUENTIAL) {
+                    next = info;
+                    break;
+                }
+                if (next == NULL ||
+                    info->m_Chunks[info->m_NextChunk].m_StartTime < next->m_Chunks[next->m_NextChunk].m_StartTime) {
+                    next = info;
+                }
+            }
+            if (next == NULL) break;
+            AP4_FileWriterChunk* chunk = &next->m_Chunks[next->m_NextChunk++];
+            chunk->m_Offset = mdat_payload_size;
+            mdat_payload_size += chunk->m_Size;
+            layout.Append(chunk);
+        }
+
+        // decide if we need a 32-bit or 64-bit mdat header
+        AP4_UI32 mdat_header_size = AP4_ATOM_HEADER_SIZE;
+        if (mdat_payload_size > 0xFFFFFFFF - AP4_ATOM_HEADER_SIZE) {
+            mdat_header_size = 16;
+        }
+
+        // replace the chunk tables, keeping the original ones for reading the samples
+        // (in sequential mode, only the offsets change)
+        for (unsigned int t=0; t<tracks.ItemCount(); t++) {
+            AP4_FileWriterTrack* info = tracks[t];
+            if (info->m_Chunks.ItemCount() == 0) continue;
+            if (interleaving != INTERLEAVING_SEQUENTIAL) {
+                info->m_NewStsc = new AP4_StscAtom();
+                AP4_Cardinal chunk_count = 0;
+                for (unsigned int i=0; i<info->m_Chunks.ItemCount(); i++) {
+                    AP4_FileWriterChunk& chunk = info->m_Chunks[i];
+                    ++chunk_count;
+                    if (i+1 == info->m_Chunks.ItemCount() ||
+                        info->m_Chunks[i+1].m_SampleCount      != chunk.m_SampleCount ||
+                        info->m_Chunks[i+1].m_DescriptionIndex != chunk.m_DescriptionIndex) {
+                        info->m_NewStsc->AddEntry(chunk_count, chunk.m_SampleCount, chunk.m_DescriptionIndex+1);
+                        chunk_count = 0;
+                    }
+                }
+                result = AP4_FileWriter_ReplaceChild(info->m_Stbl, info->m_Stsc, info->m_NewStsc);
+                if (AP4_FAILED(result)) goto end;
+            }
+            info->m_NewChunkOffsets = AP4_FileWriter_CreateChunkOffsets(info->m_Chunks, 0, info->m_ChunkOffsets->GetType() == AP4_ATOM_TYPE_CO64);
+            result = AP4_FileWriter_ReplaceChild(info->m_Stbl, info->m_ChunkOffsets, info->m_NewChunkOffsets);
+            if (AP4_FAILED(result)) goto end;
+        }
+
+        // now that the size of the moov atom is known, set the chunk offsets,
+        // switching to co64 atoms if the offsets do not all fit in 32 bits
+        AP4_UI64 mdat_payload_position = position+movie->GetMoovAtom()->GetSize()+mdat_header_size;
+        bool     large_offsets         = (mdat_payload_position+mdat_payload_size > 0xFFFFFFFF);
+        if (large_offsets) {
+            for (unsigned int t=0; t<tracks.ItemCount(); t++) {
+                AP4_FileWriterTrack* info = tracks[t];
+                if (info->m_NewChunkOffsets == NULL || info->m_NewChunkOffsets->GetType() == AP4_ATOM_TYPE_CO64) continue;
+                AP4_Atom* co64 = AP4_FileWriter_CreateChunkOffsets(info->m_Chunks, 0, true);
+                result = AP4_FileWriter_ReplaceChild(info->m_Stbl, info->m_NewChunkOffsets, co64);
+                delete info->m_NewChunkOffsets;
+                info->m_NewChunkOffsets = co64;
+                if (AP4_FAILED(result)) goto end;
+            }
+            mdat_payload_position = position+movie->GetMoovAtom()->GetSize()+mdat_header_size;
+        }
+        for (unsigned int t=0; t<tracks.ItemCount(); t++) {
+            AP4_FileWriterTrack* info = tracks[t];
+            if (info->m_NewChunkOffsets == NULL) continue;
+            AP4_StcoAtom* stco = AP4_DYNAMIC_CAST(AP4_StcoAtom, info->m_NewChunkOffsets);
+            AP4_Co64Atom* co64 = AP4_DYNAMIC_CAST(AP4_Co64Atom, info->m_NewChunkOffsets);
+            for (unsigned int i=0; i<info->m_Chunks.ItemCount(); i++) {
+                if (stco) stco->GetChunkOffsets()[i] = (AP4_UI32)(mdat_payload_position+info->m_Chunks[i].m_Offset);
+                if (co64) co64->GetChunkOffsets()[i] = mdat_payload_position+info->m_Chunks[i].m_Offset;
+            }
+        }
+
+        // write the moov atom
+        result = movie->GetMoovAtom()->WriteBuffered(stream);
+        if (AP4_FAILED(result)) goto end;
+
+        // create and write the media data (mdat)
+        if (mdat_header_size == 16) {
+            stream.WriteUI32(1);
+            stream.WriteUI32(AP4_ATOM_TYPE_MDAT);
+            result = stream.WriteUI64(mdat_header_size+mdat_payload_size);
+        } else {
+            stream.WriteUI32((AP4_UI32)(mdat_header_size+mdat_payload_size));
+            result = stream.WriteUI32(AP4_ATOM_TYPE_MDAT);
+        }
+        if (AP4_FAILED(result)) goto end;
     }
-    
-    // write all tracks and restore the chunk offsets to their backed-up values
-    for (AP4_List<AP4_Track>::Item* track_item = movie->GetTracks().FirstItem();
-         track_item;
-         track_item = track_item->GetNext(), ++t) {
-        AP4_Track*    track = track_item->GetData();
-        AP4_TrakAtom* trak  = track->UseTrakAtom();
-        
-        // restore the backed-up chunk offsets
-        result = trak->SetChunkOffsets(*trak_chunk_offsets_backup[t]);
-
-        // write all the track's samples
-        AP4_Cardinal   sample_count = track->GetSampleCount();
+
+    // write the chunks (the samples are read with the original chunk tables)
+    {
         AP4_Sample     sample;
         AP4_DataBuffer sample_data;
-        for (AP4_Ordinal i=0; i<sample_count; i++) {
-            track->ReadSample(i, sample, sample_data);
-            stream.Write(sample_data.GetData(), sample_data.GetDataSize());
+        for (unsigned int c=0; c<layout.ItemCount(); c++) {
+            AP4_FileWriterChunk* chunk = layout[c];
+            for (AP4_Ordinal i=chunk->m_FirstSample; i<chunk->m_FirstSample+chunk->m_SampleCount; i++) {
+                result = chunk->m_Track->ReadSample(i, sample, sample_data);
+                if (AP4_FAILED(result)) goto end;
+                result = stream.Write(sample_data.GetData(), sample_data.GetDataSize());
+                if (AP4_FAILED(result)) goto end;
+            }
         }
     }
 
 end:
-    for (unsigned int i=0; i<trak_chunk_offsets_backup.ItemCount(); i++) {
-        delete trak_chunk_offsets_backup[i];
+    // restore the original chunk tables
+    for (unsigned int t=0; t<tracks.ItemCount(); t++) {
+        AP4_FileWriterTrack* info = tracks[t];
+        if (info->m_NewChunkOffsets && info->m_NewChunkOffsets->GetParent()) {
+            AP4_FileWriter_ReplaceChild(info->m_Stbl, info->m_NewChunkOffsets, info->m_ChunkOffsets);
+        }
+        if (info->m_NewStsc && info->m_NewStsc->GetParent()) {
+            AP4_FileWriter_ReplaceChild(info->m_Stbl, info->m_NewStsc, info->m_Stsc);
+        }
+        delete info;
     }
     
     return result;
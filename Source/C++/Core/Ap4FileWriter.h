@@ -40,6 +40,11 @@
 class AP4_ByteStream;
 class AP4_File;
 
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_UI32 AP4_FILE_WRITER_DEFAULT_CHUNK_DURATION = 500; // ms
+
 /*----------------------------------------------------------------------
 |   AP4_FileWriter
 +---------------------------------------------------------------------*/
@@ -47,13 +52,21 @@ class AP4_FileWriter {
 public:
     // types
     typedef enum {
-        INTERLEAVING_SEQUENTIAL
+        INTERLEAVING_SEQUENTIAL, // all the chunks of a track, then the next track, keeping the chunks as they are
+        INTERLEAVING_TIME        // chunks of all the tracks in time order, with chunks of chunk_duration_ms
     } Interleaving;
     
     // class methods
+    /**
+     * Write a file, with the sample data of all its tracks in a single mdat
+     * atom after the moov atom. The chunk tables of the tracks are only
+     * modified while the moov atom is written, so the file is unchanged
+     * when this method returns.
+     */
     static AP4_Result Write(AP4_File&       file, 
                             AP4_ByteStream& stream, 
-                            Interleaving    interleaving = INTERLEAVING_SEQUENTIAL);
+                            Interleaving    interleaving = INTERLEAVING_SEQUENTIAL,
+                            AP4_UI32        chunk_duration_ms = AP4_FILE_WRITER_DEFAULT_CHUNK_DURATION);
                             
 private:
     // don't instantiate this class
@@ -36,6 +36,7 @@
 #include "Ap4FragmentSampleTable.h"
 #include "Ap4AtomFactory.h"
 #include "Ap4TfraAtom.h"
+#include "Ap4SampleHashIndex.h"
 
 /*----------------------------------------------------------------------
 |   AP4_LinearReader::AP4_LinearReader
@@ -49,7 +50,8 @@ AP4_LinearReader::AP4_LinearReader(AP4_Movie&      movie,
     m_NextFragmentPosition(0),
     m_BufferFullness(0),
     m_BufferFullnessPeak(0),
-    m_Mfra(NULL)
+    m_Mfra(NULL),
+    m_SampleHashIndex(NULL)
 {
     m_HasFragments = movie.HasFragments();
     if (fragment_stream) {
@@ -466,6 +468,12 @@ AP4_LinearReader::Advance(bool read_data)
 
             // detach the sample from its source now that we've read its data
             buffer->m_Sample->Detach();
+
+            if (m_SampleHashIndex) {
+                m_SampleHashIndex->AddSample(next_tracker->m_Track->GetId(),
+                                             buffer->m_Data.GetData(),
+                                             buffer->m_Data.GetDataSize());
+            }
         }
         
         // add the buffer to the queue
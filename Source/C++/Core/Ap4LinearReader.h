@@ -43,6 +43,7 @@
 +---------------------------------------------------------------------*/
 class AP4_Track;
 class AP4_MovieFragment;
+class AP4_SampleHashIndex;
 
 /*----------------------------------------------------------------------
 |   constants
@@ -85,6 +86,13 @@ public:
     AP4_Result SetSampleIndex(AP4_UI32 track_id, AP4_UI32 sample_index);
     
     AP4_Result SeekTo(AP4_UI32 time_ms, AP4_UI32* actual_time_ms = 0);
+
+    /**
+     * Record the hash of the data of each sample read, in the order in
+     * which the samples of each track are read (so the reader should not
+     * seek while recording). The index is not owned by the reader.
+     */
+    void SetSampleHashIndex(AP4_SampleHashIndex* index) { m_SampleHashIndex = index; }
     
     // accessors
     AP4_Size GetBufferFullness() { return m_BufferFullness; }
@@ -183,6 +191,7 @@ protected:
     AP4_Size            m_BufferFullness;
     AP4_Size            m_BufferFullnessPeak;
     AP4_ContainerAtom*  m_Mfra;
+    AP4_SampleHashIndex* m_SampleHashIndex;
 };
 
 /*----------------------------------------------------------------------
@@ -0,0 +1,291 @@
+/*****************************************************************
+|
+|    AP4 - In-Place moov Updates
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4MoovUpdater.h"
+#include "Ap4Atom.h"
+#include "Ap4ByteStream.h"
+#include "Ap4Utils.h"
+#include "Ap4DataBuffer.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const unsigned int AP4_MOOV_UPDATER_ZERO_BUFFER_SIZE = 4096;
+
+/*----------------------------------------------------------------------
+|   AP4_MoovUpdater_WriteFreeAtomHeader
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_MoovUpdater_WriteFreeAtomHeader(AP4_ByteStream& stream, AP4_LargeSize size)
+{
+    if (size < AP4_ATOM_HEADER_SIZE) return AP4_ERROR_INVALID_PARAMETERS;
+    if (size > 0xFFFFFFFF) {
+        AP4_CHECK(stream.WriteUI32(1));
+        AP4_CHECK(stream.WriteUI32(AP4_ATOM_TYPE_FREE));
+        return stream.WriteUI64(size);
+    } else {
+        AP4_CHECK(stream.WriteUI32((AP4_UI32)size));
+        return stream.WriteUI32(AP4_ATOM_TYPE_FREE);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_MoovUpdater_GrowTrailingFreeAtom
++---------------------------------------------------------------------*/
+/**
+ * Grow, by size bytes, the free atom that is the last child of the atom
+ * serialized at offset in buffer, or the last child of a trailing udta
+ * atom, updating the sizes of the atoms that contain it. The buffer must
+ * have room for the extra bytes after the end of the atom, which must be
+ * the last of the buffer, and the new sizes must fit in 32 bits.
+ */
+static AP4_Result
+AP4_MoovUpdater_GrowTrailingFreeAtom(AP4_UI08* buffer, AP4_Size offset, AP4_Size size)
+{
+    // find the last child of the atom
+    AP4_UI08*     atom      = buffer+offset;
+    AP4_UI32      atom_size = AP4_BytesToUInt32BE(atom);
+    AP4_LargeSize end       = offset+atom_size;
+    AP4_Size      child     = offset+AP4_ATOM_HEADER_SIZE;
+    if (atom_size == 1) {
+        end   = offset+AP4_BytesToUInt64BE(atom+8);
+        child = offset+AP4_ATOM_HEADER_SIZE_64;
+    }
+    AP4_Size last_child = 0;
+    while (child+AP4_ATOM_HEADER_SIZE <= end) {
+        AP4_UI32 child_size = AP4_BytesToUInt32BE(buffer+child);
+        if (child_size < AP4_ATOM_HEADER_SIZE || child+child_size > end) {
+            // 64-bit or invalid sizes
+            return AP4_ERROR_NOT_SUPPORTED;
+        }
+        last_child = child;
+        child += child_size;
+    }
+    if (last_child == 0 || child != end) return AP4_ERROR_NOT_SUPPORTED;
+
+    // grow it, or its own last child
+    AP4_UI32 type       = AP4_BytesToUInt32BE(buffer+last_child+4);
+    AP4_UI32 child_size = AP4_BytesToUInt32BE(buffer+last_child);
+    if (type == AP4_ATOM_TYPE_FREE || type == AP4_ATOM_TYPE_SKIP) {
+        AP4_SetMemory(buffer+end, 0, size);
+    } else if (type == AP4_ATOM_TYPE_UDTA) {
+        AP4_CHECK(AP4_MoovUpdater_GrowTrailingFreeAtom(buffer, last_child, size));
+    } else {
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+    AP4_BytesFromUInt32BE(buffer+last_child, child_size+size);
+    if (atom_size == 1) {
+        AP4_BytesFromUInt64BE(atom+8, AP4_BytesToUInt64BE(atom+8)+size);
+    } else {
+        AP4_BytesFromUInt32BE(atom, atom_size+size);
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_MoovUpdater::WriteFreeAtom
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_MoovUpdater::WriteFreeAtom(AP4_ByteStream& stream, AP4_LargeSize size)
+{
+    AP4_CHECK(AP4_MoovUpdater_WriteFreeAtomHeader(stream, size));
+    AP4_LargeSize remaining = size-(size > 0xFFFFFFFF ? AP4_ATOM_HEADER_SIZE_64 :
+                                                        AP4_ATOM_HEADER_SIZE);
+    AP4_UI08 zeros[AP4_MOOV_UPDATER_ZERO_BUFFER_SIZE];
+    AP4_SetMemory(zeros, 0, sizeof(zeros));
+    while (remaining) {
+        AP4_Size chunk = remaining < sizeof(zeros) ? (AP4_Size)remaining : sizeof(zeros);
+        AP4_CHECK(stream.Write(zeros, chunk));
+        remaining -= chunk;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_MoovUpdater::Update
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_MoovUpdater::Update(AP4_ByteStream& stream,
+                        AP4_Atom&       moov,
+                        AP4_Size        padding_size,
+                        Method*         method)
+{
+    // serialize the new moov atom before writing anything, because some of
+    // its atoms may read their payload from the stream that is being updated
+    if (moov.GetSize() > 0xFFFFFFFF) return AP4_ERROR_OUT_OF_RANGE;
+    AP4_DataBuffer moov_data;
+    AP4_CHECK(moov_data.Reserve((AP4_Size)moov.GetSize()));
+    AP4_MemoryByteStream* memory = new AP4_MemoryByteStream(moov_data);
+    AP4_Result result = moov.Write(*memory);
+    memory->Release();
+    if (AP4_FAILED(result)) return result;
+
+    AP4_LargeSize stream_size = 0;
+    AP4_CHECK(stream.GetSize(stream_size));
+
+    // scan the top-level atoms to find the moov atom and the free space around it
+    AP4_Position region_start = 0;
+    AP4_Position region_end   = 0;
+    AP4_Position moov_start   = 0;
+    AP4_Position moov_end     = 0;
+    AP4_Position free_start   = 0;
+    bool         in_free_run  = false;
+    bool         moov_found   = false;
+    bool         moov_done    = false;
+    bool         fragmented   = false;
+    bool         open_ended   = false;
+    AP4_Position position     = 0;
+    while (position+AP4_ATOM_HEADER_SIZE <= stream_size) {
+        AP4_UI32 size_32 = 0;
+        AP4_UI32 type    = 0;
+        AP4_CHECK(stream.Seek(position));
+        AP4_CHECK(stream.ReadUI32(size_32));
+        AP4_CHECK(stream.ReadUI32(type));
+        AP4_LargeSize size = size_32;
+        if (size_32 == 0) {
+            // this atom extends to the end of the file
+            size = stream_size-position;
+            if (type != AP4_ATOM_TYPE_MOOV) open_ended = true;
+        } else if (size_32 == 1) {
+            AP4_UI64 size_64 = 0;
+            AP4_CHECK(stream.ReadUI64(size_64));
+            size = size_64;
+        }
+        if (size < AP4_ATOM_HEADER_SIZE || position+size > stream_size) {
+            return AP4_ERROR_INVALID_FORMAT;
+        }
+
+        bool is_free = (type == AP4_ATOM_TYPE_FREE ||
+                        type == AP4_ATOM_TYPE_SKIP ||
+                        type == AP4_ATOM_TYPE_WIDE);
+        if (type == AP4_ATOM_TYPE_MOOV) {
+            if (moov_found) {
+                // an earlier update was interrupted after appending the new
+                // moov atom: keep the last one, turn the earlier one into a
+                // free atom and scan again
+                AP4_CHECK(stream.Seek(moov_start));
+                AP4_CHECK(AP4_MoovUpdater_WriteFreeAtomHeader(stream, moov_end-moov_start));
+                region_start = region_end = free_start = 0;
+                in_free_run = moov_found = moov_done = fragmented = open_ended = false;
+                position = 0;
+                continue;
+            }
+            moov_found   = true;
+            moov_start   = position;
+            moov_end     = position+size;
+            region_start = in_free_run ? free_start : position;
+            region_end   = position+size;
+        } else if (moov_found && !moov_done) {
+            if (is_free) {
+                region_end = position+size;
+            } else {
+                moov_done = true;
+            }
+        }
+        if (type == AP4_ATOM_TYPE_MOOF) fragmented = true;
+        if (is_free) {
+            if (!in_free_run) {
+                free_start  = position;
+                in_free_run = true;
+            }
+        } else {
+            in_free_run = false;
+        }
+
+        position += size;
+    }
+    if (!moov_found) return AP4_ERROR_INVALID_FORMAT;
+
+    // a gap that is too small for a free atom is absorbed by growing the
+    // free atom that ends the new moov atom (or its udta atom), if any
+    AP4_LargeSize moov_size = moov_data.GetDataSize();
+    AP4_LargeSize available = region_end-region_start;
+    bool          at_end    = (region_end == stream_size);
+    if (moov_size < available                      &&
+        moov_size+AP4_ATOM_HEADER_SIZE > available &&
+        available <= 0xFFFFFFFF) {
+        AP4_CHECK(moov_data.SetDataSize((AP4_Size)available));
+        if (AP4_SUCCEEDED(AP4_MoovUpdater_GrowTrailingFreeAtom(moov_data.UseData(), 0, (AP4_Size)(available-moov_size)))) {
+            moov_size = available;
+        } else {
+            moov_data.SetDataSize((AP4_Size)moov_size);
+        }
+    }
+
+    // write the new moov atom in place if it fits, leaving either no space
+    // or enough space for a free atom, or if nothing follows it
+    if (moov_size == available                      ||
+        moov_size+AP4_ATOM_HEADER_SIZE <= available ||
+        at_end) {
+        AP4_CHECK(stream.Seek(region_start));
+        AP4_CHECK(stream.Write(moov_data.GetData(), moov_data.GetDataSize()));
+        AP4_Position end = region_start+moov_size;
+        if (at_end && padding_size) {
+            AP4_LargeSize free_size = padding_size < AP4_ATOM_HEADER_SIZE ? AP4_ATOM_HEADER_SIZE : padding_size;
+            AP4_CHECK(WriteFreeAtom(stream, free_size));
+            end += free_size;
+        }
+
+        // the space left at the end of the file is cut off when the stream
+        // can be resized, and is otherwise filled with a free atom (that may
+        // extend past the current end of the file)
+        if (end < region_end && !(at_end && AP4_SUCCEEDED(stream.Truncate(end)))) {
+            AP4_CHECK(stream.Seek(end));
+            AP4_CHECK(WriteFreeAtom(stream, region_end-end < AP4_ATOM_HEADER_SIZE ?
+                                            AP4_ATOM_HEADER_SIZE : region_end-end));
+        }
+        if (method) *method = METHOD_IN_PLACE;
+        return stream.Flush();
+    }
+
+    // the moov atom of a fragmented file must stay before the fragments, and
+    // an atom that extends to the end of the file cannot be followed by anything
+    if (fragmented || open_ended) return AP4_ERROR_NOT_SUPPORTED;
+
+    // append the new moov atom first, so that the file still has a valid
+    // moov atom if the update is interrupted
+    AP4_CHECK(stream.Seek(stream_size));
+    AP4_CHECK(stream.Write(moov_data.GetData(), moov_data.GetDataSize()));
+    if (padding_size) {
+        AP4_CHECK(WriteFreeAtom(stream, padding_size < AP4_ATOM_HEADER_SIZE ?
+                                        AP4_ATOM_HEADER_SIZE : padding_size));
+    }
+    AP4_CHECK(stream.Flush());
+
+    // turn the old moov atom and the free space around it into a single free atom
+    AP4_CHECK(stream.Seek(region_start));
+    AP4_CHECK(AP4_MoovUpdater_WriteFreeAtomHeader(stream, available));
+    if (method) *method = METHOD_MOVED_TO_END;
+
+    return stream.Flush();
+}
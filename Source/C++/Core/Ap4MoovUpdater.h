@@ -0,0 +1,94 @@
+/*****************************************************************
+|
+|    AP4 - In-Place moov Updates
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_MOOV_UPDATER_H_
+#define _AP4_MOOV_UPDATER_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ByteStream;
+class AP4_Atom;
+
+/*----------------------------------------------------------------------
+|   AP4_MoovUpdater
++---------------------------------------------------------------------*/
+/**
+ * Replace the moov atom of an MP4 file without rewriting the rest of the
+ * file (in particular the media data, which does not move, so the chunk
+ * offsets of the new moov atom must be the same as in the file).
+ *
+ * The new moov atom is written over the current one when it fits in the
+ * space of the current moov atom and the free/skip atoms next to it, the
+ * remaining space being filled with a free atom (or, if it is smaller than
+ * an atom header, added to a free atom that ends the new moov atom or its
+ * udta atom). It is also written there when nothing follows that space,
+ * followed by padding_size bytes of free space (if not 0), the file being
+ * cut after that when the stream can be resized. Otherwise, the new moov
+ * atom is appended at the end of the file, followed by padding_size bytes
+ * of free space (if not 0), and the current moov atom is turned into a
+ * free atom. Fragmented files, where the moov atom must stay before the
+ * moof atoms, can only be updated in place.
+ * A file with two moov atoms, left by an interrupted update, is repaired by
+ * keeping the last one.
+ */
+class AP4_MoovUpdater {
+public:
+    // types
+    typedef enum {
+        METHOD_IN_PLACE,
+        METHOD_MOVED_TO_END
+    } Method;
+
+    // class methods
+    /**
+     * Write a new moov atom in a stream opened for reading and writing.
+     * If method is not NULL, it is set to the method used to write the
+     * new moov atom.
+     */
+    static AP4_Result Update(AP4_ByteStream& stream,
+                             AP4_Atom&       moov,
+                             AP4_Size        padding_size = 0,
+                             Method*         method = NULL);
+
+    /**
+     * Write a free atom of a given size (including its header).
+     */
+    static AP4_Result WriteFreeAtom(AP4_ByteStream& stream, AP4_LargeSize size);
+
+private:
+    // don't instantiate this class
+    AP4_MoovUpdater() {}
+};
+
+#endif // _AP4_MOOV_UPDATER_H_
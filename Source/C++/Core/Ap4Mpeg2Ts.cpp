@@ -36,6 +36,8 @@
 #include "Ap4Utils.h"
 #include "Ap4Mp4AudioInfo.h"
 #include "Ap4AvcParser.h"
+#include "Ap4HevcParser.h"
+#include "Ap4AdtsParser.h"
 
 /*----------------------------------------------------------------------
 |   constants
@@ -73,9 +75,15 @@ static unsigned char const StuffingBytes[AP4_MPEG2TS_PACKET_SIZE] =
     0xFF, 0xFF, 0xFF, 0xFF
 };
 
-const unsigned int AP4_HEVC_NALU_TYPE_VPS_NUT        = 32;
-const unsigned int AP4_HEVC_NALU_TYPE_SPS_NUT        = 33;
-const unsigned int AP4_HEVC_NALU_TYPE_PPS_NUT        = 34;
+const unsigned int AP4_MPEG2TS_READER_BUFFER_PACKETS = 512;
+const unsigned int AP4_MPEG2TS_READER_PROBE_PACKETS  = 8192;
+const unsigned int AP4_MPEG2TS_PID_PAT                = 0;
+const unsigned int AP4_MPEG2TS_PID_NULL               = 0x1FFF;
+const unsigned int AP4_MPEG2TS_TABLE_ID_PAT           = 0x00;
+const unsigned int AP4_MPEG2TS_TABLE_ID_PMT           = 0x02;
+const unsigned int AP4_MPEG2TS_DESCRIPTOR_TAG_AC3     = 0x6A; // DVB AC-3_descriptor
+const unsigned int AP4_MPEG2TS_DESCRIPTOR_TAG_EAC3    = 0x7A; // DVB enhanced_AC-3_descriptor
+const AP4_UI64     AP4_MPEG2TS_TIMESTAMP_WRAP         = ((AP4_UI64)1)<<33;
 
 /*----------------------------------------------------------------------
 |   GetSamplingFrequencyIndex
@@ -208,19 +216,18 @@ ComputeCRC(const unsigned char* data, unsigned int data_size)
 }
 
 /*----------------------------------------------------------------------
-|   AP4_Mpeg2TsWriter::Stream::WritePacketHeader
+|   AP4_Mpeg2TsWriter::Stream::MakePacketHeader
 +---------------------------------------------------------------------*/
-void
-AP4_Mpeg2TsWriter::Stream::WritePacketHeader(bool            payload_start, 
-                                             unsigned int&   payload_size,
-                                             bool            with_pcr,
-                                             AP4_UI64        pcr,
-                                             AP4_ByteStream& output)
+unsigned int
+AP4_Mpeg2TsWriter::Stream::MakePacketHeader(bool           payload_start,
+                                            unsigned int&  payload_size,
+                                            bool           with_pcr,
+                                            AP4_UI64       pcr,
+                                            unsigned char* packet)
 {
-    unsigned char header[4];
-    header[0] = AP4_MPEG2TS_SYNC_BYTE;
-    header[1] = (AP4_UI08)(((payload_start?1:0)<<6) | (m_PID >> 8));
-    header[2] = m_PID & 0xFF;
+    packet[0] = AP4_MPEG2TS_SYNC_BYTE;
+    packet[1] = (AP4_UI08)(((payload_start?1:0)<<6) | (m_PID >> 8));
+    packet[2] = m_PID & 0xFF;
     
     unsigned int adaptation_field_size = 0;
     if (with_pcr) adaptation_field_size += 2+AP4_MPEG2TS_PCR_ADAPTATION_SIZE;
@@ -237,37 +244,55 @@ AP4_Mpeg2TsWriter::Stream::WritePacketHeader(bool            payload_start,
     
     if (adaptation_field_size == 0) {
         // no adaptation field
-        header[3] = (1<<4) | ((m_ContinuityCounter++)&0x0F);
-        output.Write(header, 4);
-    } else {
-        // adaptation field present
-        header[3] = (3<<4) | ((m_ContinuityCounter++)&0x0F);
-        output.Write(header, 4);
-        
-        if (adaptation_field_size == 1) {
-            // just one byte (stuffing)
-            output.WriteUI08(0);
-        } else {
-            // two or more bytes (stuffing and/or PCR)
-            output.WriteUI08((AP4_UI08)(adaptation_field_size-1));
-            output.WriteUI08(with_pcr?(1<<4):0);
-            unsigned int pcr_size = 0;
-            if (with_pcr) {
-                pcr_size = AP4_MPEG2TS_PCR_ADAPTATION_SIZE;
-                AP4_UI64 pcr_base = pcr/300;
-                AP4_UI32 pcr_ext  = (AP4_UI32)(pcr%300);
-                AP4_BitWriter writer(pcr_size);
-                writer.Write((AP4_UI32)(pcr_base>>32), 1);
-                writer.Write((AP4_UI32)pcr_base, 32);
-                writer.Write(0x3F, 6);
-                writer.Write(pcr_ext, 9);
-                output.Write(writer.GetData(), pcr_size);
-            } 
-            if (adaptation_field_size > 2) {
-                output.Write(StuffingBytes, adaptation_field_size-pcr_size-2);
-            }
-        }
+        packet[3] = (AP4_UI08)((1<<4) | ((m_ContinuityCounter++)&0x0F));
+        return 4;
+    }
+    
+    // adaptation field present
+    packet[3] = (AP4_UI08)((3<<4) | ((m_ContinuityCounter++)&0x0F));
+    if (adaptation_field_size == 1) {
+        // just one byte (stuffing)
+        packet[4] = 0;
+        return 5;
+    }
+    
+    // two or more bytes (stuffing and/or PCR)
+    unsigned char* field = &packet[4];
+    *field++ = (AP4_UI08)(adaptation_field_size-1);
+    *field++ = with_pcr?(1<<4):0;
+    unsigned int pcr_size = 0;
+    if (with_pcr) {
+        // 33 bits of base, 6 reserved bits, 9 bits of extension
+        pcr_size = AP4_MPEG2TS_PCR_ADAPTATION_SIZE;
+        AP4_UI64 pcr_base = pcr/300;
+        AP4_UI32 pcr_ext  = (AP4_UI32)(pcr%300);
+        *field++ = (AP4_UI08)(pcr_base>>25);
+        *field++ = (AP4_UI08)(pcr_base>>17);
+        *field++ = (AP4_UI08)(pcr_base>> 9);
+        *field++ = (AP4_UI08)(pcr_base>> 1);
+        *field++ = (AP4_UI08)(((pcr_base&1)<<7) | 0x7E | (pcr_ext>>8));
+        *field++ = (AP4_UI08)(pcr_ext);
+    }
+    if (adaptation_field_size > 2) {
+        AP4_CopyMemory(field, StuffingBytes, adaptation_field_size-pcr_size-2);
     }
+    
+    return 4+adaptation_field_size;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsWriter::Stream::WritePacketHeader
++---------------------------------------------------------------------*/
+void
+AP4_Mpeg2TsWriter::Stream::WritePacketHeader(bool            payload_start, 
+                                             unsigned int&   payload_size,
+                                             bool            with_pcr,
+                                             AP4_UI64        pcr,
+                                             AP4_ByteStream& output)
+{
+    unsigned char header[AP4_MPEG2TS_PACKET_SIZE];
+    unsigned int header_size = MakePacketHeader(payload_start, payload_size, with_pcr, pcr, header);
+    output.Write(header, header_size);
 } 
 
 /*----------------------------------------------------------------------
@@ -331,27 +356,35 @@ AP4_Mpeg2TsWriter::SampleStream::WritePES(const unsigned char* data,
         pes_header.Write(1, 1);                    // market_bit
     }
     
-    bool first_packet = true;
+    // compute an upper bound for the number of packets and reserve space
+    // for all of them, so that the whole PES can be emitted in one write
     data_size += pes_header_size; // add size of PES header
+    unsigned int packet_count = 1+(data_size+AP4_MPEG2TS_PCR_ADAPTATION_SIZE+2)/AP4_MPEG2TS_PACKET_PAYLOAD_SIZE;
+    AP4_Result result = m_PacketBuffer.Reserve(packet_count*AP4_MPEG2TS_PACKET_SIZE);
+    if (AP4_FAILED(result)) return result;
+    unsigned char* packet = m_PacketBuffer.UseData();
+    
+    bool first_packet = true;
     while (data_size) {
         unsigned int payload_size = data_size;
         if (payload_size > AP4_MPEG2TS_PACKET_PAYLOAD_SIZE) payload_size = AP4_MPEG2TS_PACKET_PAYLOAD_SIZE;
         
         if (first_packet)  {
-            WritePacketHeader(first_packet, payload_size, with_pcr, ((with_dts?dts:pts)-m_PcrOffset)*300, output);
+            unsigned int header_size = MakePacketHeader(first_packet, payload_size, with_pcr, ((with_dts?dts:pts)-m_PcrOffset)*300, packet);
             first_packet = false;
-            output.Write(pes_header.GetData(), pes_header_size);
-            output.Write(data, payload_size-pes_header_size);
+            AP4_CopyMemory(packet+header_size, pes_header.GetData(), pes_header_size);
+            AP4_CopyMemory(packet+header_size+pes_header_size, data, payload_size-pes_header_size);
             data += payload_size-pes_header_size;
         } else {
-            WritePacketHeader(first_packet, payload_size, false, 0, output);
-            output.Write(data, payload_size);
+            unsigned int header_size = MakePacketHeader(first_packet, payload_size, false, 0, packet);
+            AP4_CopyMemory(packet+header_size, data, payload_size);
             data += payload_size;
         }
+        packet += AP4_MPEG2TS_PACKET_SIZE;
         data_size -= payload_size;
     }
     
-    return AP4_SUCCESS;
+    return output.Write(m_PacketBuffer.GetData(), (AP4_Size)(packet-m_PacketBuffer.GetData()));
 }
 
 /*----------------------------------------------------------------------
@@ -768,8 +801,9 @@ AP4_Mpeg2TsWriter::~AP4_Mpeg2TsWriter()
 AP4_Result
 AP4_Mpeg2TsWriter::WritePAT(AP4_ByteStream& output)
 {
+    unsigned char packet[AP4_MPEG2TS_PACKET_SIZE];
     unsigned int payload_size = AP4_MPEG2TS_PACKET_PAYLOAD_SIZE;
-    m_PAT->WritePacketHeader(true, payload_size, false, 0, output);
+    unsigned int header_size = m_PAT->MakePacketHeader(true, payload_size, false, 0, packet);
     
     AP4_BitWriter writer(1024);
     
@@ -790,11 +824,10 @@ AP4_Mpeg2TsWriter::WritePAT(AP4_ByteStream& output)
     writer.Write(m_PMT->GetPID(), 13); // program_map_PID
     writer.Write(ComputeCRC(writer.GetData()+1, 17-1-4), 32);
     
-    output.Write(writer.GetData(), 17);
-    
-    output.Write(StuffingBytes, AP4_MPEG2TS_PACKET_PAYLOAD_SIZE-17);
+    AP4_CopyMemory(packet+header_size, writer.GetData(), 17);
+    AP4_CopyMemory(packet+header_size+17, StuffingBytes, AP4_MPEG2TS_PACKET_PAYLOAD_SIZE-17);
     
-    return AP4_SUCCESS;
+    return output.Write(packet, AP4_MPEG2TS_PACKET_SIZE);
 }
 
 /*----------------------------------------------------------------------
@@ -808,8 +841,9 @@ AP4_Mpeg2TsWriter::WritePMT(AP4_ByteStream& output)
         return AP4_ERROR_INVALID_STATE;
     }
     
+    unsigned char packet[AP4_MPEG2TS_PACKET_SIZE];
     unsigned int payload_size = AP4_MPEG2TS_PACKET_PAYLOAD_SIZE;
-    m_PMT->WritePacketHeader(true, payload_size, false, 0, output);
+    unsigned int header_size = m_PMT->MakePacketHeader(true, payload_size, false, 0, packet);
     
     AP4_BitWriter writer(1024);
     
@@ -865,10 +899,10 @@ AP4_Mpeg2TsWriter::WritePMT(AP4_ByteStream& output)
     
     writer.Write(ComputeCRC(writer.GetData()+1, section_length-1), 32); // CRC
     
-    output.Write(writer.GetData(), section_length+4);
-    output.Write(StuffingBytes, AP4_MPEG2TS_PACKET_PAYLOAD_SIZE-(section_length+4));
+    AP4_CopyMemory(packet+header_size, writer.GetData(), section_length+4);
+    AP4_CopyMemory(packet+header_size+section_length+4, StuffingBytes, AP4_MPEG2TS_PACKET_PAYLOAD_SIZE-(section_length+4));
     
-    return AP4_SUCCESS;
+    return output.Write(packet, AP4_MPEG2TS_PACKET_SIZE);
 }
 
 /*----------------------------------------------------------------------
@@ -948,4 +982,750 @@ AP4_Mpeg2TsWriter::SampleStream::WriteSample(AP4_Sample&            sample,
                        output);
 }
 
+/*----------------------------------------------------------------------
+|   ReadPesTimestamp
++---------------------------------------------------------------------*/
+static AP4_UI64
+ReadPesTimestamp(const AP4_UI08* bits)
+{
+    return (((AP4_UI64)((bits[0]>>1)&0x07))<<30) |
+           (((AP4_UI64)bits[1])<<22)             |
+           (((AP4_UI64)(bits[2]>>1))<<15)        |
+           (((AP4_UI64)bits[3])<<7)              |
+           ((AP4_UI64)(bits[4]>>1));
+}
+
+/*----------------------------------------------------------------------
+|   ContainsRandomAccessPoint
++---------------------------------------------------------------------*/
+static bool
+ContainsRandomAccessPoint(AP4_UI08 stream_type, const AP4_UI08* data, AP4_Size data_size)
+{
+    AP4_Size offset = AP4_NalParser::FindStartCode(data, data_size);
+    while (offset+3 < data_size) {
+        unsigned int nalu_header = data[offset+3];
+        if (stream_type == AP4_MPEG2_STREAM_TYPE_AVC) {
+            if ((nalu_header&0x1F) == AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_OF_IDR_PICTURE) return true;
+        } else {
+            unsigned int nalu_type = (nalu_header>>1)&0x3F;
+            if (nalu_type >= AP4_HEVC_NALU_TYPE_BLA_W_LP && nalu_type <= AP4_HEVC_NALU_TYPE_RSV_IRAP_VCL23) {
+                return true;
+            }
+        }
+        offset += 3+AP4_NalParser::FindStartCode(data+offset+3, data_size-offset-3);
+    }
+    return false;
+}
+
+/*----------------------------------------------------------------------
+|   CollectParameterSets
++---------------------------------------------------------------------*/
+static void
+CollectParameterSets(AP4_UI08                   stream_type,
+                     const AP4_UI08*            data,
+                     AP4_Size                   data_size,
+                     AP4_Array<AP4_DataBuffer>& vps_array,
+                     AP4_Array<AP4_DataBuffer>& sps_array,
+                     AP4_Array<AP4_DataBuffer>& pps_array)
+{
+    AP4_Size offset = AP4_NalParser::FindStartCode(data, data_size);
+    while (offset+3 < data_size) {
+        const AP4_UI08* nalu      = data+offset+3;
+        AP4_Size        next      = AP4_NalParser::FindStartCode(nalu, data_size-offset-3);
+        AP4_Size        nalu_size = next;
+        
+        // the zero byte of a 4-byte start code is not part of the NAL unit
+        while (nalu_size && nalu[nalu_size-1] == 0) --nalu_size;
+        
+        AP4_Array<AP4_DataBuffer>* parameter_sets = NULL;
+        if (stream_type == AP4_MPEG2_STREAM_TYPE_AVC) {
+            unsigned int nalu_type = nalu[0]&0x1F;
+            if (nalu_type == AP4_AVC_NAL_UNIT_TYPE_SPS) {
+                parameter_sets = &sps_array;
+            } else if (nalu_type == AP4_AVC_NAL_UNIT_TYPE_PPS) {
+                parameter_sets = &pps_array;
+            }
+        } else if (nalu_size >= 2) {
+            unsigned int nalu_type = (nalu[0]>>1)&0x3F;
+            if (nalu_type == AP4_HEVC_NALU_TYPE_VPS_NUT) {
+                parameter_sets = &vps_array;
+            } else if (nalu_type == AP4_HEVC_NALU_TYPE_SPS_NUT) {
+                parameter_sets = &sps_array;
+            } else if (nalu_type == AP4_HEVC_NALU_TYPE_PPS_NUT) {
+                parameter_sets = &pps_array;
+            }
+        }
+        if (parameter_sets && nalu_size) {
+            // parameter sets are usually repeated before every key frame
+            bool duplicate = false;
+            for (unsigned int i=0; i<parameter_sets->ItemCount(); i++) {
+                const AP4_DataBuffer& existing = (*parameter_sets)[i];
+                if (existing.GetDataSize() == nalu_size &&
+                    AP4_CompareMemory(existing.GetData(), nalu, nalu_size) == 0) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (!duplicate) parameter_sets->Append(AP4_DataBuffer(nalu, nalu_size));
+        }
+        
+        offset += 3+next;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::Stream::Stream
++---------------------------------------------------------------------*/
+AP4_Mpeg2TsReader::Stream::Stream(AP4_UI16    pid,
+                                  AP4_UI08    stream_type,
+                                  AP4_UI32    format,
+                                  AP4_Ordinal index) :
+    m_PID(pid),
+    m_StreamType(stream_type),
+    m_Index(index),
+    m_HasDecoderConfig(false),
+    m_PesStarted(false),
+    m_PesLength(0),
+    m_PesDts(0),
+    m_PesPts(0),
+    m_PesHasTimestamp(false),
+    m_PesRandomAccess(false),
+    m_HasPending(false),
+    m_LastDuration(0),
+    m_TimestampWrapOffset(0)
+{
+    // until the decoder configuration is found in the stream, the
+    // sample description only carries the format
+    m_SampleDescription = new AP4_SampleDescription(AP4_SampleDescription::TYPE_UNKNOWN, format, NULL);
+    
+    // AC-3 and E-AC-3 sync frames are self-describing
+    m_HasDecoderConfig = !IsVideo() && stream_type != AP4_MPEG2_STREAM_TYPE_ISO_IEC_13818_7;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::Stream::~Stream
++---------------------------------------------------------------------*/
+AP4_Mpeg2TsReader::Stream::~Stream()
+{
+    delete m_SampleDescription;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::Stream::IsVideo
++---------------------------------------------------------------------*/
+bool
+AP4_Mpeg2TsReader::Stream::IsVideo()
+{
+    return m_StreamType == AP4_MPEG2_STREAM_TYPE_AVC || m_StreamType == AP4_MPEG2_STREAM_TYPE_HEVC;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::AP4_Mpeg2TsReader
++---------------------------------------------------------------------*/
+AP4_Mpeg2TsReader::AP4_Mpeg2TsReader(AP4_ByteStream& input) :
+    m_Input(input),
+    m_BufferSize(AP4_MPEG2TS_READER_BUFFER_PACKETS*AP4_MPEG2TS_PACKET_SIZE),
+    m_BufferFill(0),
+    m_BufferOffset(0),
+    m_Eos(false),
+    m_Flushed(false),
+    m_PmtPid(0),
+    m_PmtParsed(false)
+{
+    m_Input.AddReference();
+    m_Buffer = new AP4_UI08[m_BufferSize];
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::~AP4_Mpeg2TsReader
++---------------------------------------------------------------------*/
+AP4_Mpeg2TsReader::~AP4_Mpeg2TsReader()
+{
+    Reset();
+    for (unsigned int i=0; i<m_Streams.ItemCount(); i++) {
+        delete m_Streams[i];
+    }
+    delete[] m_Buffer;
+    m_Input.Release();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::Reset
++---------------------------------------------------------------------*/
+void
+AP4_Mpeg2TsReader::Reset()
+{
+    m_ReadySamples.DeleteReferences();
+    m_BufferFill   = 0;
+    m_BufferOffset = 0;
+    m_Eos          = false;
+    m_Flushed      = false;
+    for (unsigned int i=0; i<m_Streams.ItemCount(); i++) {
+        Stream* stream = m_Streams[i];
+        stream->m_PesStarted          = false;
+        stream->m_HasPending          = false;
+        stream->m_LastDuration        = 0;
+        stream->m_TimestampWrapOffset = 0;
+        stream->m_PesPayload.SetDataSize(0);
+        stream->m_PendingData.SetDataSize(0);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::FindStream
++---------------------------------------------------------------------*/
+AP4_Mpeg2TsReader::Stream*
+AP4_Mpeg2TsReader::FindStream(AP4_UI16 pid)
+{
+    for (unsigned int i=0; i<m_Streams.ItemCount(); i++) {
+        if (m_Streams[i]->m_PID == pid) return m_Streams[i];
+    }
+    return NULL;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::GetSampleDescription
++---------------------------------------------------------------------*/
+AP4_SampleDescription*
+AP4_Mpeg2TsReader::GetSampleDescription(AP4_Ordinal indx)
+{
+    if (indx >= m_Streams.ItemCount()) return NULL;
+    return m_Streams[indx]->m_SampleDescription;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::SeekToTime
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::SeekToTime(AP4_UI32 time_ms, bool /* before */)
+{
+    // transport streams have no index, so we can only rewind (seeking
+    // by PCR or PTS would require scanning the stream)
+    if (time_ms != 0) return AP4_ERROR_NOT_SUPPORTED;
+    AP4_Result result = m_Input.Seek(0);
+    if (AP4_FAILED(result)) return result;
+    Reset();
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::ReadPacket
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::ReadPacket(const AP4_UI08*& packet)
+{
+    packet = NULL;
+    for (;;) {
+        // refill the buffer when less than two packets are left, so that
+        // we can always check the sync byte of the next packet
+        if (!m_Eos && m_BufferFill-m_BufferOffset < 2*AP4_MPEG2TS_PACKET_SIZE) {
+            AP4_Size remaining = m_BufferFill-m_BufferOffset;
+            if (remaining && m_BufferOffset) {
+                AP4_MoveMemory(m_Buffer, m_Buffer+m_BufferOffset, remaining);
+            }
+            m_BufferOffset = 0;
+            m_BufferFill   = remaining;
+            while (m_BufferFill < m_BufferSize) {
+                AP4_Size bytes_read = 0;
+                AP4_Result result = m_Input.ReadPartial(m_Buffer+m_BufferFill, m_BufferSize-m_BufferFill, bytes_read);
+                if (AP4_FAILED(result) || bytes_read == 0) {
+                    if (result != AP4_ERROR_EOS && AP4_FAILED(result)) return result;
+                    m_Eos = true;
+                    break;
+                }
+                m_BufferFill += bytes_read;
+            }
+        }
+        AP4_Size available = m_BufferFill-m_BufferOffset;
+        if (available < AP4_MPEG2TS_PACKET_SIZE) return AP4_ERROR_EOS;
+        
+        // fast path: we are in sync
+        const AP4_UI08* data = m_Buffer+m_BufferOffset;
+        if (data[0] == AP4_MPEG2TS_SYNC_BYTE) {
+            packet = data;
+            m_BufferOffset += AP4_MPEG2TS_PACKET_SIZE;
+            return AP4_SUCCESS;
+        }
+        
+        // we lost sync, look for a sync byte followed by another one
+        // one packet later (when that one is available)
+        const AP4_UI08 sync_pattern[1] = { AP4_MPEG2TS_SYNC_BYTE };
+        const AP4_UI08 sync_mask[1]    = { 0xFF };
+        AP4_Size skip = 1;
+        for (;;) {
+            skip += AP4_FindBytePattern(data+skip, available-skip, sync_pattern, sync_mask, 1);
+            if (skip >= available) break;
+            if (skip+AP4_MPEG2TS_PACKET_SIZE >= available ||
+                data[skip+AP4_MPEG2TS_PACKET_SIZE] == AP4_MPEG2TS_SYNC_BYTE) {
+                break;
+            }
+            ++skip;
+        }
+        m_BufferOffset += skip;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::ParsePAT
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::ParsePAT(const AP4_UI08* payload, unsigned int payload_size)
+{
+    if (payload_size < 1) return AP4_ERROR_INVALID_FORMAT;
+    unsigned int pointer = payload[0];
+    if (1+pointer+8 > payload_size) return AP4_ERROR_INVALID_FORMAT;
+    const AP4_UI08* section = payload+1+pointer;
+    payload_size -= 1+pointer;
+    if (section[0] != AP4_MPEG2TS_TABLE_ID_PAT) return AP4_ERROR_INVALID_FORMAT;
+    unsigned int section_length = ((section[1]&0x0F)<<8) | section[2];
+    if (section_length < 9 || 3+section_length > payload_size) return AP4_ERROR_INVALID_FORMAT;
+    
+    // the program loop is between the 8 byte header and the CRC
+    const AP4_UI08* programs = section+8;
+    unsigned int program_count = (section_length-9)/4;
+    for (unsigned int i=0; i<program_count; i++) {
+        unsigned int program_number = AP4_BytesToUInt16BE(&programs[4*i]);
+        AP4_UI16     pid            = (AP4_UI16)(AP4_BytesToUInt16BE(&programs[4*i+2])&0x1FFF);
+        if (program_number != 0) {
+            // only the first program is demuxed
+            m_PmtPid = pid;
+            break;
+        }
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::ParsePMT
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::ParsePMT(const AP4_UI08* payload, unsigned int payload_size)
+{
+    if (payload_size < 1) return AP4_ERROR_INVALID_FORMAT;
+    unsigned int pointer = payload[0];
+    if (1+pointer+12 > payload_size) return AP4_ERROR_INVALID_FORMAT;
+    const AP4_UI08* section = payload+1+pointer;
+    payload_size -= 1+pointer;
+    if (section[0] != AP4_MPEG2TS_TABLE_ID_PMT) return AP4_ERROR_INVALID_FORMAT;
+    unsigned int section_length = ((section[1]&0x0F)<<8) | section[2];
+    if (section_length < 13 || 3+section_length > payload_size) return AP4_ERROR_INVALID_FORMAT;
+    unsigned int program_info_length = ((section[10]&0x0F)<<8) | section[11];
+    
+    // walk the elementary stream loop, which ends with the 4 byte CRC
+    unsigned int offset = 12+program_info_length;
+    unsigned int end    = 3+section_length-4;
+    while (offset+5 <= end) {
+        AP4_UI08     stream_type    = section[offset];
+        AP4_UI16     pid            = (AP4_UI16)(AP4_BytesToUInt16BE(&section[offset+1])&0x1FFF);
+        unsigned int es_info_length = AP4_BytesToUInt16BE(&section[offset+3])&0x0FFF;
+        if (offset+5+es_info_length > end) break;
+        
+        // private PES streams may carry AC-3 or E-AC-3, as signaled by a descriptor
+        if (stream_type == AP4_MPEG2_STREAM_TYPE_ISO_IEC_13818_1_PES) {
+            const AP4_UI08* descriptors = &section[offset+5];
+            for (unsigned int i=0; i+2 <= es_info_length; i += 2+descriptors[i+1]) {
+                if (descriptors[i] == AP4_MPEG2TS_DESCRIPTOR_TAG_AC3) {
+                    stream_type = AP4_MPEG2_STREAM_TYPE_ATSC_AC3;
+                } else if (descriptors[i] == AP4_MPEG2TS_DESCRIPTOR_TAG_EAC3) {
+                    stream_type = AP4_MPEG2_STREAM_TYPE_ATSC_EAC3;
+                }
+            }
+        }
+        
+        AP4_UI32 format = 0;
+        switch (stream_type) {
+            case AP4_MPEG2_STREAM_TYPE_AVC:            format = AP4_SAMPLE_FORMAT_AVC1; break;
+            case AP4_MPEG2_STREAM_TYPE_HEVC:           format = AP4_SAMPLE_FORMAT_HEV1; break;
+            case AP4_MPEG2_STREAM_TYPE_ISO_IEC_13818_7: format = AP4_SAMPLE_FORMAT_MP4A; break;
+            case AP4_MPEG2_STREAM_TYPE_ATSC_AC3:       format = AP4_SAMPLE_FORMAT_AC_3; break;
+            case AP4_MPEG2_STREAM_TYPE_ATSC_EAC3:      format = AP4_SAMPLE_FORMAT_EC_3; break;
+        }
+        if (format && FindStream(pid) == NULL) {
+            m_Streams.Append(new Stream(pid, stream_type, format, m_Streams.ItemCount()));
+        }
+        
+        offset += 5+es_info_length;
+    }
+    m_PmtParsed = true;
+    
+    return AP4_SUCCESS;
+}
 
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::FlushPending
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::FlushPending(Stream* stream, AP4_UI32 duration)
+{
+    if (!stream->m_HasPending) return AP4_SUCCESS;
+    stream->m_HasPending = false;
+    
+    ReadySample* ready = new ReadySample();
+    ready->m_Sample = stream->m_PendingSample;
+    ready->m_Sample.SetDuration(duration);
+    ready->m_Data.Swap(stream->m_PendingData);
+    ready->m_TrackId = stream->m_PID;
+    
+    return m_ReadySamples.Add(ready);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::UpdateSampleDescription
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::UpdateSampleDescription(Stream* stream, const AP4_UI08* data, AP4_Size data_size)
+{
+    AP4_SampleDescription* sample_description = NULL;
+    if (stream->m_StreamType == AP4_MPEG2_STREAM_TYPE_AVC) {
+        AP4_Array<AP4_DataBuffer> vps_array;
+        AP4_Array<AP4_DataBuffer> sps_array;
+        AP4_Array<AP4_DataBuffer> pps_array;
+        CollectParameterSets(stream->m_StreamType, data, data_size, vps_array, sps_array, pps_array);
+        if (sps_array.ItemCount() == 0 || pps_array.ItemCount() == 0) return AP4_SUCCESS;
+        
+        AP4_AvcFrameParser          parser;
+        AP4_AvcSequenceParameterSet sps;
+        AP4_Result result = parser.ParseSPS(sps_array[0].GetData(), sps_array[0].GetDataSize(), sps);
+        if (AP4_FAILED(result)) return AP4_SUCCESS;
+        unsigned int width  = 0;
+        unsigned int height = 0;
+        sps.GetInfo(width, height);
+        sample_description =
+            new AP4_AvcSampleDescription(AP4_SAMPLE_FORMAT_AVC1,
+                                         (AP4_UI16)width,
+                                         (AP4_UI16)height,
+                                         24,
+                                         "h264",
+                                         (AP4_UI08)sps.profile_idc,
+                                         (AP4_UI08)sps.level_idc,
+                                         (AP4_UI08)(sps.constraint_set0_flag<<7 |
+                                                    sps.constraint_set1_flag<<6 |
+                                                    sps.constraint_set2_flag<<5 |
+                                                    sps.constraint_set3_flag<<4),
+                                         4,
+                                         (AP4_UI08)sps.chroma_format_idc,
+                                         (AP4_UI08)sps.bit_depth_luma_minus8,
+                                         (AP4_UI08)sps.bit_depth_chroma_minus8,
+                                         sps_array,
+                                         pps_array);
+    } else if (stream->m_StreamType == AP4_MPEG2_STREAM_TYPE_HEVC) {
+        AP4_Array<AP4_DataBuffer> vps_array;
+        AP4_Array<AP4_DataBuffer> sps_array;
+        AP4_Array<AP4_DataBuffer> pps_array;
+        CollectParameterSets(stream->m_StreamType, data, data_size, vps_array, sps_array, pps_array);
+        if (vps_array.ItemCount() == 0 || sps_array.ItemCount() == 0 || pps_array.ItemCount() == 0) {
+            return AP4_SUCCESS;
+        }
+        
+        AP4_HevcSequenceParameterSet sps;
+        AP4_Result result = sps.Parse(sps_array[0].GetData(), sps_array[0].GetDataSize());
+        if (AP4_FAILED(result)) return AP4_SUCCESS;
+        unsigned int width  = 0;
+        unsigned int height = 0;
+        sps.GetInfo(width, height);
+        
+        // the parameter sets are also carried in-band, hence hev1
+        sample_description =
+            new AP4_HevcSampleDescription(AP4_SAMPLE_FORMAT_HEV1,
+                                          (AP4_UI16)width,
+                                          (AP4_UI16)height,
+                                          24,
+                                          "HEVC Coding",
+                                          sps.profile_tier_level.general_profile_space,
+                                          sps.profile_tier_level.general_tier_flag,
+                                          sps.profile_tier_level.general_profile_idc,
+                                          sps.profile_tier_level.general_profile_compatibility_flags,
+                                          sps.profile_tier_level.general_constraint_indicator_flags,
+                                          sps.profile_tier_level.general_level_idc,
+                                          0, // min_spatial_segmentation
+                                          0, // parallelism_type
+                                          (AP4_UI08)sps.chroma_format_idc,
+                                          (AP4_UI08)(sps.bit_depth_luma_minus8+8),
+                                          (AP4_UI08)(sps.bit_depth_chroma_minus8+8),
+                                          0, // average_frame_rate
+                                          0, // constant_frame_rate
+                                          0, // num_temporal_layers
+                                          0, // temporal_id_nested
+                                          4,
+                                          vps_array,
+                                          0,
+                                          sps_array,
+                                          0,
+                                          pps_array,
+                                          0);
+    } else if (stream->m_StreamType == AP4_MPEG2_STREAM_TYPE_ISO_IEC_13818_7) {
+        if (data_size < 7 || data[0] != 0xFF || (data[1]&0xF6) != 0xF0) return AP4_SUCCESS;
+        AP4_AdtsHeader adts(data);
+        if (AP4_FAILED(adts.Check())) return AP4_SUCCESS;
+        
+        // build the AudioSpecificConfig from the ADTS header
+        unsigned int   object_type = adts.m_ProfileObjectType+1;
+        unsigned char  aac_dsi[2];
+        AP4_DataBuffer dsi;
+        aac_dsi[0] = (AP4_UI08)((object_type<<3) | (adts.m_SamplingFrequencyIndex>>1));
+        aac_dsi[1] = (AP4_UI08)(((adts.m_SamplingFrequencyIndex&1)<<7) | (adts.m_ChannelConfiguration<<3));
+        dsi.SetData(aac_dsi, 2);
+        sample_description =
+            new AP4_MpegAudioSampleDescription(AP4_OTI_MPEG4_AUDIO,
+                                               AP4_AdtsSamplingFrequencyTable[adts.m_SamplingFrequencyIndex],
+                                               16,
+                                               (AP4_UI16)adts.m_ChannelConfiguration,
+                                               &dsi,
+                                               6144,
+                                               128000,
+                                               128000);
+    }
+    if (sample_description == NULL) return AP4_SUCCESS;
+    
+    delete stream->m_SampleDescription;
+    stream->m_SampleDescription = sample_description;
+    stream->m_HasDecoderConfig  = true;
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::FinishPes
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::FinishPes(Stream* stream)
+{
+    if (!stream->m_PesStarted) return AP4_SUCCESS;
+    stream->m_PesStarted = false;
+    if (stream->m_PesPayload.GetDataSize() == 0) return AP4_SUCCESS;
+    
+    // compute the timestamps, extrapolating when the PES has none
+    AP4_UI64 dts;
+    AP4_UI64 pts;
+    if (stream->m_PesHasTimestamp) {
+        dts = stream->m_PesDts+stream->m_TimestampWrapOffset;
+        pts = stream->m_PesPts+stream->m_TimestampWrapOffset;
+        if (stream->m_HasPending) {
+            // unwrap the 33-bit timestamps
+            AP4_UI64 previous = stream->m_PendingSample.GetDts();
+            if (dts+AP4_MPEG2TS_TIMESTAMP_WRAP/2 < previous) {
+                stream->m_TimestampWrapOffset += AP4_MPEG2TS_TIMESTAMP_WRAP;
+                dts += AP4_MPEG2TS_TIMESTAMP_WRAP;
+                pts += AP4_MPEG2TS_TIMESTAMP_WRAP;
+            }
+        }
+    } else if (stream->m_HasPending) {
+        dts = pts = stream->m_PendingSample.GetDts()+stream->m_LastDuration;
+    } else {
+        dts = pts = 0;
+    }
+    
+    // the previous PES is now complete
+    if (stream->m_HasPending) {
+        AP4_UI64 previous = stream->m_PendingSample.GetDts();
+        if (dts > previous) stream->m_LastDuration = (AP4_UI32)(dts-previous);
+        AP4_Result result = FlushPending(stream, stream->m_LastDuration);
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    // look for the decoder configuration until we have it
+    if (!stream->m_HasDecoderConfig) {
+        AP4_Result result = UpdateSampleDescription(stream,
+                                                    stream->m_PesPayload.GetData(),
+                                                    stream->m_PesPayload.GetDataSize());
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    bool is_sync = true;
+    if (stream->IsVideo()) {
+        is_sync = stream->m_PesRandomAccess ||
+                  ContainsRandomAccessPoint(stream->m_StreamType,
+                                            stream->m_PesPayload.GetData(),
+                                            stream->m_PesPayload.GetDataSize());
+    }
+    AP4_Sample& sample = stream->m_PendingSample;
+    sample.SetDescriptionIndex(stream->m_Index);
+    sample.SetDts(dts);
+    sample.SetCts(pts);
+    sample.SetSize(stream->m_PesPayload.GetDataSize());
+    sample.SetSync(is_sync);
+    // hand the payload over instead of copying it
+    stream->m_PendingData.Swap(stream->m_PesPayload);
+    stream->m_PesPayload.SetDataSize(0);
+    stream->m_HasPending = true;
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::ProcessPesPayload
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::ProcessPesPayload(Stream*         stream,
+                                     bool            unit_start,
+                                     bool            random_access,
+                                     const AP4_UI08* payload,
+                                     unsigned int    payload_size)
+{
+    if (unit_start) {
+        AP4_Result result = FinishPes(stream);
+        if (AP4_FAILED(result)) return result;
+        
+        // parse the PES header
+        if (payload_size < 9 || payload[0] != 0 || payload[1] != 0 || payload[2] != 1) {
+            return AP4_SUCCESS; // not a valid PES packet start, skip
+        }
+        unsigned int pes_packet_length = AP4_BytesToUInt16BE(&payload[4]);
+        unsigned int flags             = payload[7];
+        unsigned int header_size       = 9+payload[8];
+        if (header_size > payload_size) return AP4_SUCCESS;
+        if (pes_packet_length && header_size > pes_packet_length+6) {
+            return AP4_SUCCESS; // malformed PES header, skip
+        }
+        stream->m_PesHasTimestamp = false;
+        if ((flags&0x80) && header_size >= 14) {
+            stream->m_PesPts = stream->m_PesDts = ReadPesTimestamp(&payload[9]);
+            stream->m_PesHasTimestamp = true;
+            if ((flags&0x40) && header_size >= 19) {
+                stream->m_PesDts = ReadPesTimestamp(&payload[14]);
+            }
+        }
+        stream->m_PesLength       = pes_packet_length ? pes_packet_length+6-header_size : 0;
+        stream->m_PesRandomAccess = random_access;
+        stream->m_PesStarted      = true;
+        payload      += header_size;
+        payload_size -= header_size;
+    } else if (!stream->m_PesStarted) {
+        // we have not seen the start of this PES packet
+        return AP4_SUCCESS;
+    }
+    
+    // accumulate the payload, growing the buffer geometrically
+    AP4_DataBuffer& pes = stream->m_PesPayload;
+    AP4_Result result = pes.Reserve(pes.GetDataSize()+payload_size);
+    if (AP4_FAILED(result)) return result;
+    pes.AppendData(payload, payload_size);
+    
+    // bounded PES packets can be completed right away
+    if (stream->m_PesLength && pes.GetDataSize() >= stream->m_PesLength) {
+        pes.SetDataSize(stream->m_PesLength);
+        return FinishPes(stream);
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::ProcessPacket
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::ProcessPacket(const AP4_UI08* packet)
+{
+    bool     transport_error = (packet[1]&0x80) != 0;
+    bool     unit_start      = (packet[1]&0x40) != 0;
+    AP4_UI16 pid             = (AP4_UI16)(((packet[1]&0x1F)<<8) | packet[2]);
+    unsigned int adaptation_field_control = (packet[3]>>4)&3;
+    if (transport_error || pid == AP4_MPEG2TS_PID_NULL) return AP4_SUCCESS;
+    
+    // skip the adaptation field
+    unsigned int offset        = 4;
+    bool         random_access = false;
+    if (adaptation_field_control & 2) {
+        unsigned int adaptation_field_length = packet[4];
+        if (adaptation_field_length) random_access = (packet[5]&0x40) != 0;
+        offset += 1+adaptation_field_length;
+    }
+    if ((adaptation_field_control & 1) == 0 || offset >= AP4_MPEG2TS_PACKET_SIZE) {
+        return AP4_SUCCESS; // no payload
+    }
+    const AP4_UI08* payload      = packet+offset;
+    unsigned int    payload_size = AP4_MPEG2TS_PACKET_SIZE-offset;
+    
+    if (pid == AP4_MPEG2TS_PID_PAT) {
+        if (unit_start && m_PmtPid == 0) return ParsePAT(payload, payload_size);
+        return AP4_SUCCESS;
+    }
+    if (m_PmtPid && pid == m_PmtPid) {
+        if (unit_start && !m_PmtParsed) return ParsePMT(payload, payload_size);
+        return AP4_SUCCESS;
+    }
+    Stream* stream = FindStream(pid);
+    if (stream == NULL) return AP4_SUCCESS;
+    
+    return ProcessPesPayload(stream, unit_start, random_access, payload, payload_size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::ParseProgram
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::ParseProgram()
+{
+    while (!m_PmtParsed) {
+        const AP4_UI08* packet = NULL;
+        AP4_Result result = ReadPacket(packet);
+        if (AP4_FAILED(result)) return result;
+        result = ProcessPacket(packet);
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    // keep reading, for a bounded number of packets, until every stream
+    // has its decoder configuration
+    for (unsigned int probed=0; probed < AP4_MPEG2TS_READER_PROBE_PACKETS; probed++) {
+        bool configured = true;
+        for (unsigned int i=0; i<m_Streams.ItemCount(); i++) {
+            if (!m_Streams[i]->m_HasDecoderConfig) {
+                configured = false;
+                break;
+            }
+        }
+        if (configured) break;
+        
+        const AP4_UI08* packet = NULL;
+        AP4_Result result = ReadPacket(packet);
+        if (result == AP4_ERROR_EOS) break;
+        if (AP4_FAILED(result)) return result;
+        result = ProcessPacket(packet);
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader::ReadNextSample
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mpeg2TsReader::ReadNextSample(AP4_Sample&     sample,
+                                  AP4_DataBuffer& buffer,
+                                  AP4_UI32&       track_id)
+{
+    track_id = 0;
+    while (m_ReadySamples.ItemCount() == 0) {
+        if (m_Flushed) return AP4_ERROR_EOS;
+        
+        const AP4_UI08* packet = NULL;
+        AP4_Result result = ReadPacket(packet);
+        if (result == AP4_ERROR_EOS) {
+            // complete everything that is still in progress
+            for (unsigned int i=0; i<m_Streams.ItemCount(); i++) {
+                Stream* stream = m_Streams[i];
+                result = FinishPes(stream);
+                if (AP4_FAILED(result)) return result;
+                result = FlushPending(stream, stream->m_LastDuration);
+                if (AP4_FAILED(result)) return result;
+            }
+            m_Flushed = true;
+            continue;
+        }
+        if (AP4_FAILED(result)) return result;
+        result = ProcessPacket(packet);
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    ReadySample* ready = NULL;
+    m_ReadySamples.PopHead(ready);
+    sample   = ready->m_Sample;
+    track_id = ready->m_TrackId;
+    buffer.Swap(ready->m_Data);
+    delete ready;
+    
+    return AP4_SUCCESS;
+}
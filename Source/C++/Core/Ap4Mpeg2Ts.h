@@ -34,6 +34,10 @@
 +---------------------------------------------------------------------*/
 #include "Ap4Types.h"
 #include "Ap4DataBuffer.h"
+#include "Ap4Array.h"
+#include "Ap4List.h"
+#include "Ap4Sample.h"
+#include "Ap4SampleSource.h"
 
 /*----------------------------------------------------------------------
 |   classes
@@ -61,6 +65,8 @@ const AP4_UI08 AP4_MPEG2_STREAM_TYPE_ATSC_EAC3           = 0x87;
 
 const AP4_UI64 AP4_MPEG2_TS_DEFAULT_PCR_OFFSET = 10000;
 
+const AP4_UI32 AP4_MPEG2_TS_TIMESCALE = 90000;
+
 /*----------------------------------------------------------------------
 |   AP4_Mpeg2TsWriter
 +---------------------------------------------------------------------*/
@@ -86,6 +92,17 @@ public:
                                bool            with_pcr,
                                AP4_UI64        pcr,
                                AP4_ByteStream& output);
+        /**
+         * Format a packet header (including the adaptation field, if any)
+         * directly into a memory buffer of at least 188 bytes.
+         * Returns the number of header bytes written. The payload, of
+         * size payload_size (clamped on return), follows immediately.
+         */
+        unsigned int MakePacketHeader(bool           payload_start,
+                                      unsigned int&  payload_size,
+                                      bool           with_pcr,
+                                      AP4_UI64       pcr,
+                                      unsigned char* packet);
         
     private:
         AP4_UI16     m_PID;
@@ -142,6 +159,7 @@ public:
         AP4_UI32       m_TimeScale;
         AP4_DataBuffer m_Descriptor;
         AP4_UI64       m_PcrOffset;
+        AP4_DataBuffer m_PacketBuffer; // reused across calls to WritePES
     };
     
     // constructor
@@ -176,4 +194,131 @@ private:
     SampleStream* m_Video;
 };
 
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsReader
++---------------------------------------------------------------------*/
+/**
+ * This class is a simple demultiplexer for MPEG2 transport streams.
+ * It parses the PAT and the PMT of the first program, and reassembles
+ * the PES packets of the AVC, HEVC, AAC (ADTS), AC-3 and E-AC-3
+ * elementary streams listed in the PMT.
+ * Each PES packet is returned as one sample, with timestamps in a 90kHz
+ * timescale and with the elementary stream payload (Annex-B for video,
+ * ADTS or sync frames for audio) as sample data, so that it can be fed
+ * directly to an AP4_FeedSegmentBuilder or a frame parser.
+ * The track ID returned by ReadNextSample is the PID of the stream, and
+ * the sample description index is the index of the stream in the PMT.
+ * The sample descriptions of AVC, HEVC and AAC streams carry a decoder
+ * configuration built from the first in-band parameter sets or ADTS header,
+ * which ParseProgram() reads ahead to find.
+ * The payload of each PES packet is handed over to the buffer passed to
+ * ReadNextSample, whose previous storage is released, rather than copied.
+ */
+class AP4_Mpeg2TsReader : public AP4_SampleSource
+{
+public:
+    // classes
+    class Stream {
+    public:
+        Stream(AP4_UI16 pid, AP4_UI08 stream_type, AP4_UI32 format, AP4_Ordinal index);
+        ~Stream();
+        
+        AP4_UI16               GetPID()               { return m_PID;               }
+        AP4_UI08               GetStreamType()        { return m_StreamType;        }
+        AP4_Ordinal            GetIndex()             { return m_Index;             }
+        AP4_SampleDescription* GetSampleDescription() { return m_SampleDescription; }
+        bool                   IsVideo();
+        
+    private:
+        friend class AP4_Mpeg2TsReader;
+        
+        AP4_UI16               m_PID;
+        AP4_UI08               m_StreamType;
+        AP4_Ordinal            m_Index;
+        AP4_SampleDescription* m_SampleDescription;
+        bool                   m_HasDecoderConfig;
+        
+        // PES packet being reassembled
+        bool                   m_PesStarted;
+        AP4_Size               m_PesLength; // 0 when unbounded
+        AP4_UI64               m_PesDts;
+        AP4_UI64               m_PesPts;
+        bool                   m_PesHasTimestamp;
+        bool                   m_PesRandomAccess;
+        AP4_DataBuffer         m_PesPayload;
+        
+        // last complete PES packet, waiting for the next one to know its duration
+        bool                   m_HasPending;
+        AP4_Sample             m_PendingSample;
+        AP4_DataBuffer         m_PendingData;
+        AP4_UI32               m_LastDuration;
+        AP4_UI64               m_TimestampWrapOffset;
+    };
+    
+    // constructor and destructor
+    AP4_Mpeg2TsReader(AP4_ByteStream& input);
+    ~AP4_Mpeg2TsReader();
+    
+    // AP4_SampleSource methods
+    virtual AP4_UI32               GetTimeScale()  { return AP4_MPEG2_TS_TIMESCALE; }
+    virtual AP4_UI32               GetDurationMs() { return 0; }
+    virtual AP4_Result             ReadNextSample(AP4_Sample&     sample,
+                                                  AP4_DataBuffer& buffer,
+                                                  AP4_UI32&       track_id);
+    /**
+     * Transport streams have no index: only a time of 0, which rewinds
+     * the input, is supported. Other times return AP4_ERROR_NOT_SUPPORTED.
+     */
+    virtual AP4_Result             SeekToTime(AP4_UI32 time_ms, bool before=true);
+    virtual AP4_SampleDescription* GetSampleDescription(AP4_Ordinal indx);
+    
+    // methods
+    /**
+     * Read packets until the PMT has been parsed, so that the list of
+     * streams is known, and then until every stream has its decoder
+     * configuration (or until a bounded number of packets has been read).
+     * Packets read while doing so are not lost.
+     */
+    AP4_Result   ParseProgram();
+    unsigned int GetStreamCount()                { return m_Streams.ItemCount(); }
+    Stream*      GetStream(AP4_Ordinal indx)     { return indx < m_Streams.ItemCount() ? m_Streams[indx] : NULL; }
+    Stream*      FindStream(AP4_UI16 pid);
+    
+private:
+    // types
+    struct ReadySample {
+        AP4_Sample     m_Sample;
+        AP4_DataBuffer m_Data;
+        AP4_UI32       m_TrackId;
+    };
+    
+    // methods
+    AP4_Result ReadPacket(const AP4_UI08*& packet);
+    AP4_Result ProcessPacket(const AP4_UI08* packet);
+    AP4_Result ParsePAT(const AP4_UI08* payload, unsigned int payload_size);
+    AP4_Result ParsePMT(const AP4_UI08* payload, unsigned int payload_size);
+    AP4_Result ProcessPesPayload(Stream*         stream,
+                                 bool            unit_start,
+                                 bool            random_access,
+                                 const AP4_UI08* payload,
+                                 unsigned int    payload_size);
+    AP4_Result UpdateSampleDescription(Stream* stream, const AP4_UI08* data, AP4_Size data_size);
+    AP4_Result FinishPes(Stream* stream);
+    AP4_Result FlushPending(Stream* stream, AP4_UI32 duration);
+    void       Reset();
+    
+    // members
+    AP4_ByteStream&          m_Input;
+    AP4_UI08*                m_Buffer;
+    AP4_Size                 m_BufferSize;
+    AP4_Size                 m_BufferFill;
+    AP4_Size                 m_BufferOffset;
+    bool                     m_Eos;
+    bool                     m_Flushed;
+    AP4_UI16                 m_PmtPid;
+    bool                     m_PmtParsed;
+    AP4_Array<Stream*>       m_Streams;
+    AP4_List<ReadySample>    m_ReadySamples;
+};
+
 #endif // _AP4_MPEG2_TS_H_
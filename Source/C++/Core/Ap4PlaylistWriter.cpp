@@ -0,0 +1,721 @@
+/*****************************************************************
+|
+|    AP4 - HLS Playlist and DASH Manifest Writers
+|
+|    Copyright 2002-2014 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4PlaylistWriter.h"
+#include "Ap4ByteStream.h"
+#include "Ap4FileByteStream.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const char* const AP4_HLS_LINE_END               = "\r\n";
+const unsigned int AP4_HLS_PART_RETENTION_TARGETS = 3; // in target durations
+const char* const AP4_PLAYLIST_TEMP_SUFFIX        = ".tmp";
+
+/*----------------------------------------------------------------------
+|   AP4_Playlist_AppendString
++---------------------------------------------------------------------*/
+static void
+AP4_Playlist_AppendString(AP4_DataBuffer& buffer, const char* chars)
+{
+    AP4_Size size = (AP4_Size)AP4_StringLength(chars);
+    buffer.Reserve(buffer.GetDataSize()+size); // grows geometrically
+    buffer.AppendData((const AP4_Byte*)chars, size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Playlist_AppendBuffer
++---------------------------------------------------------------------*/
+static void
+AP4_Playlist_AppendBuffer(AP4_DataBuffer& buffer, const AP4_DataBuffer& data)
+{
+    buffer.Reserve(buffer.GetDataSize()+data.GetDataSize());
+    buffer.AppendData(data.GetData(), data.GetDataSize());
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Playlist_AppendXmlAttribute
++---------------------------------------------------------------------*/
+static void
+AP4_Playlist_AppendXmlAttribute(AP4_DataBuffer& buffer, const char* name, const char* value)
+{
+    AP4_Playlist_AppendString(buffer, " ");
+    AP4_Playlist_AppendString(buffer, name);
+    AP4_Playlist_AppendString(buffer, "=\"");
+    const char* run = value;
+    for (const char* c = value; ; c++) {
+        const char* escape = NULL;
+        switch (*c) {
+            case '&': escape = "&amp;";  break;
+            case '<': escape = "&lt;";   break;
+            case '>': escape = "&gt;";   break;
+            case '"': escape = "&quot;"; break;
+            case '\0': break;
+            default: continue;
+        }
+        buffer.Reserve(buffer.GetDataSize()+(AP4_Size)(c-run));
+        buffer.AppendData((const AP4_Byte*)run, (AP4_Size)(c-run));
+        if (escape == NULL) break;
+        AP4_Playlist_AppendString(buffer, escape);
+        run = c+1;
+    }
+    AP4_Playlist_AppendString(buffer, "\"");
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Playlist_WriteFile
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_Playlist_WriteFile(const char* filename, const AP4_DataBuffer& data)
+{
+    // write everything to a temporary file
+    AP4_Size name_length = (AP4_Size)AP4_StringLength(filename);
+    AP4_Size suffix_length = (AP4_Size)AP4_StringLength(AP4_PLAYLIST_TEMP_SUFFIX);
+    char* temp_filename = new char[name_length+suffix_length+1];
+    AP4_CopyMemory(temp_filename, filename, name_length);
+    AP4_CopyMemory(temp_filename+name_length, AP4_PLAYLIST_TEMP_SUFFIX, suffix_length+1);
+    AP4_ByteStream* stream = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(temp_filename,
+                                                   AP4_FileByteStream::STREAM_MODE_WRITE,
+                                                   stream);
+    if (AP4_SUCCEEDED(result)) {
+        result = stream->Write(data.GetData(), data.GetDataSize());
+        if (AP4_SUCCEEDED(result)) result = stream->Flush();
+        stream->Release();
+    }
+
+    // replace the file
+    if (AP4_SUCCEEDED(result)) {
+        result = AP4_FileByteStream::Rename(temp_filename, filename);
+    }
+    delete[] temp_filename;
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::AP4_HlsPlaylistWriter
++---------------------------------------------------------------------*/
+AP4_HlsPlaylistWriter::AP4_HlsPlaylistWriter(PlaylistType type, unsigned int version) :
+    m_Type(type),
+    m_Version(version),
+    m_IndependentSegments(false),
+    m_IFramesOnly(false),
+    m_TargetDuration(0),
+    m_MaxSegmentDuration(0),
+    m_WindowSize(0),
+    m_PartTargetDuration(0.0),
+    m_SegmentCount(0),
+    m_MediaSequence(0),
+    m_DiscontinuitySequence(0),
+    m_EndList(false),
+    m_Published(false),
+    m_PublishedTargetDuration(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::~AP4_HlsPlaylistWriter
++---------------------------------------------------------------------*/
+AP4_HlsPlaylistWriter::~AP4_HlsPlaylistWriter()
+{
+    m_Segments.DeleteReferences();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::SetAllowCache
++---------------------------------------------------------------------*/
+void
+AP4_HlsPlaylistWriter::SetAllowCache(const char* allow_cache)
+{
+    m_AllowCache = allow_cache?allow_cache:"";
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::AddHeaderTag
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_HlsPlaylistWriter::AddHeaderTag(const char* tag)
+{
+    if (tag == NULL) return AP4_ERROR_INVALID_PARAMETERS;
+    AP4_Playlist_AppendString(m_HeaderTags, tag);
+    AP4_Playlist_AppendString(m_HeaderTags, AP4_HLS_LINE_END);
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::GetTargetDuration
++---------------------------------------------------------------------*/
+unsigned int
+AP4_HlsPlaylistWriter::GetTargetDuration()
+{
+    // clients do not expect the target duration to change once published
+    if (m_Published) return m_PublishedTargetDuration;
+    return m_MaxSegmentDuration > m_TargetDuration ? m_MaxSegmentDuration : m_TargetDuration;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::FormatDuration
++---------------------------------------------------------------------*/
+void
+AP4_HlsPlaylistWriter::FormatDuration(char* buffer, AP4_Size buffer_size, double duration)
+{
+    // integer durations before version 3
+    if (m_Version >= 3) {
+        AP4_FormatString(buffer, buffer_size, "%f", duration);
+    } else {
+        AP4_FormatString(buffer, buffer_size, "%u", (unsigned int)(duration+0.5));
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::AddPart
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_HlsPlaylistWriter::AddPart(const char*  uri,
+                               double       duration,
+                               bool         independent,
+                               AP4_UI32     byte_range_size,
+                               AP4_Position byte_range_offset)
+{
+    if (uri == NULL) return AP4_ERROR_INVALID_PARAMETERS;
+
+    char line[256];
+    AP4_FormatString(line, sizeof(line), "#EXT-X-PART:DURATION=%f,URI=\"", duration);
+    AP4_Playlist_AppendString(m_PendingParts, line);
+    AP4_Playlist_AppendString(m_PendingParts, uri);
+    AP4_Playlist_AppendString(m_PendingParts, "\"");
+    if (independent) {
+        AP4_Playlist_AppendString(m_PendingParts, ",INDEPENDENT=YES");
+    }
+    if (byte_range_size) {
+        AP4_FormatString(line, sizeof(line), ",BYTERANGE=\"%u@%llu\"", byte_range_size, (unsigned long long)byte_range_offset);
+        AP4_Playlist_AppendString(m_PendingParts, line);
+    }
+    AP4_Playlist_AppendString(m_PendingParts, AP4_HLS_LINE_END);
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::AddSegment
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_HlsPlaylistWriter::AddSegment(const char*  uri,
+                                  double       duration,
+                                  AP4_UI32     byte_range_size,
+                                  AP4_Position byte_range_offset,
+                                  bool         discontinuity)
+{
+    if (uri == NULL) return AP4_ERROR_INVALID_PARAMETERS;
+
+    // format the segment lines once and for all
+    Segment* segment = new Segment();
+    segment->m_Duration      = duration;
+    segment->m_Discontinuity = discontinuity;
+    if (m_PendingParts.GetDataSize()) {
+        segment->m_PartLines.SetData(m_PendingParts.GetData(), m_PendingParts.GetDataSize());
+        m_PendingParts.SetDataSize(0);
+    }
+    char line[256];
+    if (discontinuity) {
+        AP4_Playlist_AppendString(segment->m_Lines, "#EXT-X-DISCONTINUITY");
+        AP4_Playlist_AppendString(segment->m_Lines, AP4_HLS_LINE_END);
+    }
+    AP4_Playlist_AppendString(segment->m_Lines, "#EXTINF:");
+    FormatDuration(line, sizeof(line), duration);
+    AP4_Playlist_AppendString(segment->m_Lines, line);
+    AP4_Playlist_AppendString(segment->m_Lines, ",");
+    AP4_Playlist_AppendString(segment->m_Lines, AP4_HLS_LINE_END);
+    if (byte_range_size) {
+        AP4_FormatString(line, sizeof(line), "#EXT-X-BYTERANGE:%u@%llu", byte_range_size, (unsigned long long)byte_range_offset);
+        AP4_Playlist_AppendString(segment->m_Lines, line);
+        AP4_Playlist_AppendString(segment->m_Lines, AP4_HLS_LINE_END);
+    }
+    AP4_Playlist_AppendString(segment->m_Lines, uri);
+    AP4_Playlist_AppendString(segment->m_Lines, AP4_HLS_LINE_END);
+    m_Segments.Add(segment);
+    ++m_SegmentCount;
+
+    // the target duration can only grow, until the playlist is published
+    unsigned int rounded_duration = (unsigned int)(duration+0.5);
+    if (rounded_duration > m_MaxSegmentDuration) {
+        m_MaxSegmentDuration = rounded_duration;
+    }
+
+    // slide the window
+    if (m_Type == PLAYLIST_TYPE_LIVE && m_WindowSize) {
+        while (m_Segments.ItemCount() > m_WindowSize) {
+            Segment* removed = NULL;
+            m_Segments.PopHead(removed);
+            ++m_MediaSequence;
+            if (removed->m_Discontinuity) ++m_DiscontinuitySequence;
+            delete removed;
+        }
+    }
+
+    // drop the parts that are too old to be useful
+    if (m_PartTargetDuration > 0.0) {
+        double max_age = (double)(AP4_HLS_PART_RETENTION_TARGETS*GetTargetDuration());
+        double age = 0.0;
+        for (AP4_List<Segment>::Item* item = m_Segments.LastItem(); item; item = item->GetPrev()) {
+            Segment* older = item->GetData();
+            if (age >= max_age) {
+                if (older->m_PartLines.GetDataSize() == 0) break;
+                older->m_PartLines.SetDataSize(0);
+                older->m_PartLines.SetBufferSize(0);
+            }
+            age += older->m_Duration;
+        }
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::Render
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_HlsPlaylistWriter::Render(AP4_DataBuffer& buffer)
+{
+    char line[256];
+    buffer.SetDataSize(0);
+
+    // header
+    AP4_Playlist_AppendString(buffer, "#EXTM3U");
+    AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    if (m_Version > 1) {
+        AP4_FormatString(line, sizeof(line), "#EXT-X-VERSION:%u", m_Version);
+        AP4_Playlist_AppendString(buffer, line);
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    }
+    if (m_Type == PLAYLIST_TYPE_VOD) {
+        AP4_Playlist_AppendString(buffer, "#EXT-X-PLAYLIST-TYPE:VOD");
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    } else if (m_Type == PLAYLIST_TYPE_EVENT) {
+        AP4_Playlist_AppendString(buffer, "#EXT-X-PLAYLIST-TYPE:EVENT");
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    }
+    if (m_IFramesOnly) {
+        AP4_Playlist_AppendString(buffer, "#EXT-X-I-FRAMES-ONLY");
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    }
+    if (m_IndependentSegments) {
+        AP4_Playlist_AppendString(buffer, "#EXT-X-INDEPENDENT-SEGMENTS");
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    }
+    if (m_AllowCache.GetLength()) {
+        AP4_Playlist_AppendString(buffer, "#EXT-X-ALLOW-CACHE:");
+        AP4_Playlist_AppendString(buffer, m_AllowCache.GetChars());
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    }
+    if (!m_Published) {
+        m_PublishedTargetDuration = GetTargetDuration();
+        m_Published               = true;
+    }
+    AP4_FormatString(line, sizeof(line), "#EXT-X-TARGETDURATION:%u", m_PublishedTargetDuration);
+    AP4_Playlist_AppendString(buffer, line);
+    AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    if (m_PartTargetDuration > 0.0) {
+        AP4_FormatString(line, sizeof(line), "#EXT-X-PART-INF:PART-TARGET=%f", m_PartTargetDuration);
+        AP4_Playlist_AppendString(buffer, line);
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+        AP4_FormatString(line, sizeof(line), "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%f", 3.0*m_PartTargetDuration);
+        AP4_Playlist_AppendString(buffer, line);
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    }
+    AP4_FormatString(line, sizeof(line), "#EXT-X-MEDIA-SEQUENCE:%llu", (unsigned long long)m_MediaSequence);
+    AP4_Playlist_AppendString(buffer, line);
+    AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    if (m_DiscontinuitySequence) {
+        AP4_FormatString(line, sizeof(line), "#EXT-X-DISCONTINUITY-SEQUENCE:%llu", (unsigned long long)m_DiscontinuitySequence);
+        AP4_Playlist_AppendString(buffer, line);
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    }
+    AP4_Playlist_AppendBuffer(buffer, m_HeaderTags);
+
+    // segments and parts
+    for (AP4_List<Segment>::Item* item = m_Segments.FirstItem(); item; item = item->GetNext()) {
+        Segment* segment = item->GetData();
+        AP4_Playlist_AppendBuffer(buffer, segment->m_PartLines);
+        AP4_Playlist_AppendBuffer(buffer, segment->m_Lines);
+    }
+    AP4_Playlist_AppendBuffer(buffer, m_PendingParts);
+
+    if (m_EndList) {
+        AP4_Playlist_AppendString(buffer, "#EXT-X-ENDLIST");
+        AP4_Playlist_AppendString(buffer, AP4_HLS_LINE_END);
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::Write
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_HlsPlaylistWriter::Write(AP4_ByteStream& stream)
+{
+    AP4_Result result = Render(m_Output);
+    if (AP4_FAILED(result)) return result;
+    return stream.Write(m_Output.GetData(), m_Output.GetDataSize());
+}
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter::WriteFile
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_HlsPlaylistWriter::WriteFile(const char* filename)
+{
+    AP4_Result result = Render(m_Output);
+    if (AP4_FAILED(result)) return result;
+    return AP4_Playlist_WriteFile(filename, m_Output);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::AP4_DashManifestWriter
++---------------------------------------------------------------------*/
+AP4_DashManifestWriter::AP4_DashManifestWriter(bool dynamic) :
+    m_Dynamic(dynamic),
+    m_MinBufferTime(2.0),
+    m_TimeShiftBufferDepth(0.0),
+    m_MinimumUpdatePeriod(0.0),
+    m_AvailabilityStartTime("1970-01-01T00:00:00Z")
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::~AP4_DashManifestWriter
++---------------------------------------------------------------------*/
+AP4_DashManifestWriter::~AP4_DashManifestWriter()
+{
+    for (unsigned int i=0; i<m_Representations.ItemCount(); i++) {
+        delete m_Representations[i];
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::SetAvailabilityStartTime
++---------------------------------------------------------------------*/
+void
+AP4_DashManifestWriter::SetAvailabilityStartTime(const char* time)
+{
+    m_AvailabilityStartTime = time?time:"";
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::SetPublishTime
++---------------------------------------------------------------------*/
+void
+AP4_DashManifestWriter::SetPublishTime(const char* time)
+{
+    m_PublishTime = time?time:"";
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::AddRepresentation
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DashManifestWriter::AddRepresentation(const char*  id,
+                                          const char*  mime_type,
+                                          const char*  codecs,
+                                          AP4_UI32     bandwidth,
+                                          AP4_UI32     timescale,
+                                          const char*  initialization,
+                                          const char*  media,
+                                          AP4_Ordinal& index)
+{
+    if (id == NULL || mime_type == NULL || media == NULL || timescale == 0) {
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
+
+    Representation* representation = new Representation();
+    representation->m_Id             = id;
+    representation->m_MimeType       = mime_type;
+    representation->m_Codecs         = codecs?codecs:"";
+    representation->m_Bandwidth      = bandwidth;
+    representation->m_Timescale      = timescale;
+    representation->m_Initialization = initialization?initialization:"";
+    representation->m_Media          = media;
+    representation->m_Width          = 0;
+    representation->m_Height         = 0;
+    representation->m_SamplingRate   = 0;
+    representation->m_FirstEntry     = 0;
+    representation->m_StartNumber    = 1;
+    representation->m_EndTime        = 0;
+    index = m_Representations.ItemCount();
+    return m_Representations.Append(representation);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::SetVideoAttributes
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DashManifestWriter::SetVideoAttributes(AP4_Ordinal index, unsigned int width, unsigned int height)
+{
+    if (index >= m_Representations.ItemCount()) return AP4_ERROR_OUT_OF_RANGE;
+    m_Representations[index]->m_Width  = width;
+    m_Representations[index]->m_Height = height;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::SetAudioAttributes
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DashManifestWriter::SetAudioAttributes(AP4_Ordinal index, unsigned int sampling_rate)
+{
+    if (index >= m_Representations.ItemCount()) return AP4_ERROR_OUT_OF_RANGE;
+    m_Representations[index]->m_SamplingRate = sampling_rate;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::SetStartNumber
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DashManifestWriter::SetStartNumber(AP4_Ordinal index, AP4_UI64 start_number)
+{
+    if (index >= m_Representations.ItemCount()) return AP4_ERROR_OUT_OF_RANGE;
+    Representation& representation = *m_Representations[index];
+    if (representation.m_Timeline.ItemCount()) return AP4_ERROR_INVALID_STATE;
+    representation.m_StartNumber = start_number;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::AddSegment
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DashManifestWriter::AddSegment(AP4_Ordinal index, AP4_UI64 start_time, AP4_UI64 duration)
+{
+    if (index >= m_Representations.ItemCount()) return AP4_ERROR_OUT_OF_RANGE;
+    Representation& representation = *m_Representations[index];
+    AP4_Array<TimelineEntry>& timeline = representation.m_Timeline;
+
+    // extend the last entry if this segment continues it with the same duration
+    if (timeline.ItemCount() > representation.m_FirstEntry) {
+        TimelineEntry& last = timeline[timeline.ItemCount()-1];
+        if (last.m_Duration == duration && representation.m_EndTime == start_time) {
+            ++last.m_RepeatCount;
+            representation.m_EndTime = start_time+duration;
+            TrimTimeline(representation);
+            return AP4_SUCCESS;
+        }
+    }
+
+    TimelineEntry entry;
+    entry.m_Time        = start_time;
+    entry.m_Duration    = duration;
+    entry.m_RepeatCount = 0;
+    AP4_Result result = timeline.Append(entry);
+    if (AP4_FAILED(result)) return result;
+    representation.m_EndTime = start_time+duration;
+    TrimTimeline(representation);
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::TrimTimeline
++---------------------------------------------------------------------*/
+void
+AP4_DashManifestWriter::TrimTimeline(Representation& representation)
+{
+    if (!m_Dynamic || m_TimeShiftBufferDepth <= 0.0) return;
+    AP4_UI64 depth = (AP4_UI64)(m_TimeShiftBufferDepth*(double)representation.m_Timescale);
+    if (representation.m_EndTime <= depth) return;
+    AP4_UI64 cutoff = representation.m_EndTime-depth;
+
+    // remove the segments that end before the start of the buffer
+    AP4_Array<TimelineEntry>& timeline = representation.m_Timeline;
+    while (representation.m_FirstEntry < timeline.ItemCount()) {
+        TimelineEntry& first = timeline[representation.m_FirstEntry];
+        if (first.m_Time+first.m_Duration > cutoff) break;
+        if (first.m_RepeatCount) {
+            first.m_Time += first.m_Duration;
+            --first.m_RepeatCount;
+        } else if (representation.m_FirstEntry+1 < timeline.ItemCount()) {
+            ++representation.m_FirstEntry;
+        } else {
+            break; // always keep at least one segment
+        }
+        ++representation.m_StartNumber;
+    }
+
+    // compact the array once enough entries have been removed
+    if (representation.m_FirstEntry >= 64 && representation.m_FirstEntry*2 >= timeline.ItemCount()) {
+        AP4_Cardinal remaining = timeline.ItemCount()-representation.m_FirstEntry;
+        for (unsigned int i=0; i<remaining; i++) {
+            timeline[i] = timeline[representation.m_FirstEntry+i];
+        }
+        timeline.SetItemCount(remaining);
+        representation.m_FirstEntry = 0;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::Render
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DashManifestWriter::Render(AP4_DataBuffer& buffer)
+{
+    char value[256];
+    buffer.SetDataSize(0);
+
+    // compute the duration of the presentation
+    double duration = 0.0;
+    for (unsigned int i=0; i<m_Representations.ItemCount(); i++) {
+        Representation& representation = *m_Representations[i];
+        if (representation.m_FirstEntry >= representation.m_Timeline.ItemCount()) continue;
+        AP4_UI64 start = representation.m_Timeline[representation.m_FirstEntry].m_Time;
+        double representation_duration = (double)(representation.m_EndTime-start)/(double)representation.m_Timescale;
+        if (representation_duration > duration) duration = representation_duration;
+    }
+
+    // MPD element
+    AP4_Playlist_AppendString(buffer, "<?xml version=\"1.0\" ?>\n");
+    AP4_Playlist_AppendString(buffer, "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\"");
+    AP4_Playlist_AppendXmlAttribute(buffer, "profiles", "urn:mpeg:dash:profile:isoff-live:2011");
+    AP4_Playlist_AppendXmlAttribute(buffer, "type", m_Dynamic?"dynamic":"static");
+    AP4_FormatString(value, sizeof(value), "PT%.2fS", m_MinBufferTime);
+    AP4_Playlist_AppendXmlAttribute(buffer, "minBufferTime", value);
+    if (m_Dynamic) {
+        AP4_Playlist_AppendXmlAttribute(buffer, "availabilityStartTime", m_AvailabilityStartTime.GetChars());
+        if (m_PublishTime.GetLength()) {
+            AP4_Playlist_AppendXmlAttribute(buffer, "publishTime", m_PublishTime.GetChars());
+        }
+        if (m_MinimumUpdatePeriod > 0.0) {
+            AP4_FormatString(value, sizeof(value), "PT%.3fS", m_MinimumUpdatePeriod);
+            AP4_Playlist_AppendXmlAttribute(buffer, "minimumUpdatePeriod", value);
+        }
+        if (m_TimeShiftBufferDepth > 0.0) {
+            AP4_FormatString(value, sizeof(value), "PT%.3fS", m_TimeShiftBufferDepth);
+            AP4_Playlist_AppendXmlAttribute(buffer, "timeShiftBufferDepth", value);
+        }
+    } else {
+        AP4_FormatString(value, sizeof(value), "PT%.3fS", duration);
+        AP4_Playlist_AppendXmlAttribute(buffer, "mediaPresentationDuration", value);
+    }
+    AP4_Playlist_AppendString(buffer, ">\n");
+    AP4_Playlist_AppendString(buffer, "  <Period id=\"1\" start=\"PT0S\">\n");
+
+    // one adaptation set per representation
+    for (unsigned int i=0; i<m_Representations.ItemCount(); i++) {
+        Representation& representation = *m_Representations[i];
+        AP4_Playlist_AppendString(buffer, "    <AdaptationSet");
+        AP4_Playlist_AppendXmlAttribute(buffer, "mimeType", representation.m_MimeType.GetChars());
+        AP4_Playlist_AppendXmlAttribute(buffer, "segmentAlignment", "true");
+        AP4_Playlist_AppendXmlAttribute(buffer, "startWithSAP", "1");
+        AP4_Playlist_AppendString(buffer, ">\n");
+
+        AP4_Playlist_AppendString(buffer, "      <Representation");
+        AP4_Playlist_AppendXmlAttribute(buffer, "id", representation.m_Id.GetChars());
+        if (representation.m_Codecs.GetLength()) {
+            AP4_Playlist_AppendXmlAttribute(buffer, "codecs", representation.m_Codecs.GetChars());
+        }
+        AP4_FormatString(value, sizeof(value), "%u", representation.m_Bandwidth);
+        AP4_Playlist_AppendXmlAttribute(buffer, "bandwidth", value);
+        if (representation.m_Width && representation.m_Height) {
+            AP4_FormatString(value, sizeof(value), "%u", representation.m_Width);
+            AP4_Playlist_AppendXmlAttribute(buffer, "width", value);
+            AP4_FormatString(value, sizeof(value), "%u", representation.m_Height);
+            AP4_Playlist_AppendXmlAttribute(buffer, "height", value);
+        }
+        if (representation.m_SamplingRate) {
+            AP4_FormatString(value, sizeof(value), "%u", representation.m_SamplingRate);
+            AP4_Playlist_AppendXmlAttribute(buffer, "audioSamplingRate", value);
+        }
+        AP4_Playlist_AppendString(buffer, ">\n");
+
+        AP4_Playlist_AppendString(buffer, "        <SegmentTemplate");
+        AP4_FormatString(value, sizeof(value), "%u", representation.m_Timescale);
+        AP4_Playlist_AppendXmlAttribute(buffer, "timescale", value);
+        if (representation.m_Initialization.GetLength()) {
+            AP4_Playlist_AppendXmlAttribute(buffer, "initialization", representation.m_Initialization.GetChars());
+        }
+        AP4_Playlist_AppendXmlAttribute(buffer, "media", representation.m_Media.GetChars());
+        AP4_FormatString(value, sizeof(value), "%llu", (unsigned long long)representation.m_StartNumber);
+        AP4_Playlist_AppendXmlAttribute(buffer, "startNumber", value);
+        AP4_Playlist_AppendString(buffer, ">\n");
+
+        AP4_Playlist_AppendString(buffer, "          <SegmentTimeline>\n");
+        AP4_UI64 next_time = 0;
+        for (unsigned int j=representation.m_FirstEntry; j<representation.m_Timeline.ItemCount(); j++) {
+            const TimelineEntry& entry = representation.m_Timeline[j];
+            AP4_Playlist_AppendString(buffer, "            <S");
+            if (j == representation.m_FirstEntry || entry.m_Time != next_time) {
+                AP4_FormatString(value, sizeof(value), " t=\"%llu\"", (unsigned long long)entry.m_Time);
+                AP4_Playlist_AppendString(buffer, value);
+            }
+            AP4_FormatString(value, sizeof(value), " d=\"%llu\"", (unsigned long long)entry.m_Duration);
+            AP4_Playlist_AppendString(buffer, value);
+            if (entry.m_RepeatCount) {
+                AP4_FormatString(value, sizeof(value), " r=\"%u\"", entry.m_RepeatCount);
+                AP4_Playlist_AppendString(buffer, value);
+            }
+            AP4_Playlist_AppendString(buffer, "/>\n");
+            next_time = entry.m_Time+(AP4_UI64)(entry.m_RepeatCount+1)*entry.m_Duration;
+        }
+        AP4_Playlist_AppendString(buffer, "          </SegmentTimeline>\n");
+        AP4_Playlist_AppendString(buffer, "        </SegmentTemplate>\n");
+        AP4_Playlist_AppendString(buffer, "      </Representation>\n");
+        AP4_Playlist_AppendString(buffer, "    </AdaptationSet>\n");
+    }
+
+    AP4_Playlist_AppendString(buffer, "  </Period>\n");
+    AP4_Playlist_AppendString(buffer, "</MPD>\n");
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::Write
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DashManifestWriter::Write(AP4_ByteStream& stream)
+{
+    AP4_Result result = Render(m_Output);
+    if (AP4_FAILED(result)) return result;
+    return stream.Write(m_Output.GetData(), m_Output.GetDataSize());
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter::WriteFile
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DashManifestWriter::WriteFile(const char* filename)
+{
+    AP4_Result result = Render(m_Output);
+    if (AP4_FAILED(result)) return result;
+    return AP4_Playlist_WriteFile(filename, m_Output);
+}
@@ -0,0 +1,283 @@
+/*****************************************************************
+|
+|    AP4 - HLS Playlist and DASH Manifest Writers
+|
+|    Copyright 2002-2014 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_PLAYLIST_WRITER_H_
+#define _AP4_PLAYLIST_WRITER_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+#include "Ap4Array.h"
+#include "Ap4List.h"
+#include "Ap4String.h"
+#include "Ap4DataBuffer.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ByteStream;
+
+/*----------------------------------------------------------------------
+|   AP4_HlsPlaylistWriter
++---------------------------------------------------------------------*/
+/**
+ * Incremental writer for HLS media playlists.
+ * Segments (and, for low-latency HLS, partial segments) are appended as
+ * they become available, and the playlist can be re-rendered at any time.
+ * The text for each segment is formatted only once, when it is added, so
+ * rendering the playlist is just a concatenation into a single buffer.
+ * When used with an AP4_SegmentBuilder, the durations are obtained from
+ * GetMediaDuration()/GetTimescale() before each segment is written, and
+ * parts can be added from an AP4_SegmentBuilder::ChunkListener.
+ */
+class AP4_HlsPlaylistWriter
+{
+public:
+    // types
+    typedef enum {
+        PLAYLIST_TYPE_VOD,
+        PLAYLIST_TYPE_EVENT,
+        PLAYLIST_TYPE_LIVE  // no EXT-X-PLAYLIST-TYPE tag, sliding window
+    } PlaylistType;
+
+    // constructor and destructor
+    AP4_HlsPlaylistWriter(PlaylistType type = PLAYLIST_TYPE_VOD, unsigned int version = 3);
+    ~AP4_HlsPlaylistWriter();
+
+    // configuration
+    void SetVersion(unsigned int version)          { m_Version = version;              }
+    void SetIndependentSegments(bool independent)  { m_IndependentSegments = independent; }
+    void SetIFramesOnly(bool iframes_only)         { m_IFramesOnly = iframes_only;     }
+    void SetAllowCache(const char* allow_cache);
+
+    /**
+     * Set the minimum value of EXT-X-TARGETDURATION. The target duration
+     * that is written is the maximum of this value and the rounded duration
+     * of all the segments added so far, until the playlist is rendered for
+     * the first time: after that, it no longer changes, so event and live
+     * playlists should set it to the longest expected segment duration.
+     */
+    void SetTargetDuration(unsigned int target_duration) { m_TargetDuration = target_duration; }
+
+    /**
+     * Set the maximum number of segments listed in the playlist (live
+     * playlists only). A value of 0 means no limit.
+     */
+    void SetWindowSize(unsigned int window_size) { m_WindowSize = window_size; }
+
+    /**
+     * Enable low-latency HLS: EXT-X-PART-INF and EXT-X-SERVER-CONTROL are
+     * written in the header, and parts are listed for the segments that are
+     * within 3 target durations of the end of the playlist.
+     */
+    void SetPartTargetDuration(double part_target_duration) { m_PartTargetDuration = part_target_duration; }
+
+    /**
+     * Add a tag line (without line terminator) written after the
+     * EXT-X-MEDIA-SEQUENCE tag, such as EXT-X-KEY or EXT-X-MAP.
+     */
+    AP4_Result AddHeaderTag(const char* tag);
+
+    // methods
+    /**
+     * Add a partial segment to the segment currently being produced.
+     * A byte_range_size of 0 means that the part has no byte range.
+     */
+    AP4_Result AddPart(const char*  uri,
+                       double       duration,
+                       bool         independent,
+                       AP4_UI32     byte_range_size   = 0,
+                       AP4_Position byte_range_offset = 0);
+
+    /**
+     * Add a complete segment. Parts added since the previous segment become
+     * the parts of this segment. A byte_range_size of 0 means that the
+     * segment has no byte range.
+     */
+    AP4_Result AddSegment(const char*  uri,
+                          double       duration,
+                          AP4_UI32     byte_range_size   = 0,
+                          AP4_Position byte_range_offset = 0,
+                          bool         discontinuity     = false);
+
+    /**
+     * Mark the playlist as complete (EXT-X-ENDLIST).
+     */
+    void SetEndList() { m_EndList = true; }
+
+    AP4_Cardinal GetSegmentCount()   { return m_SegmentCount;   }
+    AP4_UI64     GetMediaSequence()  { return m_MediaSequence;  }
+    unsigned int GetTargetDuration();
+
+    // output
+    AP4_Result Render(AP4_DataBuffer& buffer);
+    AP4_Result Write(AP4_ByteStream& stream);
+
+    /**
+     * Write the playlist to a file, by writing to a temporary file next to
+     * it and renaming it, so that readers never see a partial playlist.
+     */
+    AP4_Result WriteFile(const char* filename);
+
+private:
+    // types
+    struct Segment {
+        double         m_Duration;
+        bool           m_Discontinuity;
+        AP4_DataBuffer m_PartLines;
+        AP4_DataBuffer m_Lines;
+    };
+
+    // methods
+    void FormatDuration(char* buffer, AP4_Size buffer_size, double duration);
+
+    // members
+    PlaylistType         m_Type;
+    unsigned int         m_Version;
+    bool                 m_IndependentSegments;
+    bool                 m_IFramesOnly;
+    AP4_String           m_AllowCache;
+    unsigned int         m_TargetDuration;
+    unsigned int         m_MaxSegmentDuration;
+    unsigned int         m_WindowSize;
+    double               m_PartTargetDuration;
+    AP4_DataBuffer       m_HeaderTags;
+    AP4_List<Segment>    m_Segments;
+    AP4_Cardinal         m_SegmentCount;
+    AP4_UI64             m_MediaSequence;
+    AP4_UI64             m_DiscontinuitySequence;
+    AP4_DataBuffer       m_PendingParts;
+    bool                 m_EndList;
+    bool                 m_Published;
+    unsigned int         m_PublishedTargetDuration;
+    AP4_DataBuffer       m_Output;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_DashManifestWriter
++---------------------------------------------------------------------*/
+/**
+ * Incremental writer for DASH manifests using SegmentTemplate with a
+ * SegmentTimeline. Each representation is placed in its own adaptation
+ * set. Consecutive segments with the same duration are merged into a
+ * single S element, and in dynamic mode the segments that fall outside
+ * of the time shift buffer are removed from the timeline.
+ * The times and durations are expressed in the timescale of the
+ * representation, so the values returned by AP4_SegmentBuilder's
+ * GetMediaStartTime() and GetMediaDuration() can be used directly.
+ */
+class AP4_DashManifestWriter
+{
+public:
+    // constructor and destructor
+    AP4_DashManifestWriter(bool dynamic = false);
+    ~AP4_DashManifestWriter();
+
+    // configuration
+    void SetMinBufferTime(double seconds)        { m_MinBufferTime = seconds;        }
+    void SetTimeShiftBufferDepth(double seconds) { m_TimeShiftBufferDepth = seconds; }
+    void SetMinimumUpdatePeriod(double seconds)  { m_MinimumUpdatePeriod = seconds;  }
+    void SetAvailabilityStartTime(const char* time);
+    void SetPublishTime(const char* time);
+
+    /**
+     * Add a representation. The initialization and media templates are
+     * used as-is for the SegmentTemplate (media would typically contain
+     * $Time$ or $Number$).
+     */
+    AP4_Result AddRepresentation(const char*   id,
+                                 const char*   mime_type,
+                                 const char*   codecs,
+                                 AP4_UI32      bandwidth,
+                                 AP4_UI32      timescale,
+                                 const char*   initialization,
+                                 const char*   media,
+                                 AP4_Ordinal&  index);
+    AP4_Result SetVideoAttributes(AP4_Ordinal index, unsigned int width, unsigned int height);
+    AP4_Result SetAudioAttributes(AP4_Ordinal index, unsigned int sampling_rate);
+
+    /**
+     * Set the number of the first segment (1 by default), before any
+     * segment is added to the representation.
+     */
+    AP4_Result SetStartNumber(AP4_Ordinal index, AP4_UI64 start_number);
+
+    // methods
+    AP4_Result AddSegment(AP4_Ordinal index, AP4_UI64 start_time, AP4_UI64 duration);
+
+    /**
+     * Mark the presentation as complete: the manifest becomes static, with
+     * a duration equal to that of the longest representation.
+     */
+    void SetEndOfStream() { m_Dynamic = false; }
+
+    // output
+    AP4_Result Render(AP4_DataBuffer& buffer);
+    AP4_Result Write(AP4_ByteStream& stream);
+    AP4_Result WriteFile(const char* filename); // see AP4_HlsPlaylistWriter::WriteFile
+
+private:
+    // types
+    struct TimelineEntry {
+        AP4_UI64 m_Time;
+        AP4_UI64 m_Duration;
+        AP4_UI32 m_RepeatCount;
+    };
+    struct Representation {
+        AP4_String               m_Id;
+        AP4_String               m_MimeType;
+        AP4_String               m_Codecs;
+        AP4_UI32                 m_Bandwidth;
+        AP4_UI32                 m_Timescale;
+        AP4_String               m_Initialization;
+        AP4_String               m_Media;
+        unsigned int             m_Width;
+        unsigned int             m_Height;
+        unsigned int             m_SamplingRate;
+        AP4_Array<TimelineEntry> m_Timeline;
+        AP4_Cardinal             m_FirstEntry;   // entries before this one have been removed
+        AP4_UI64                 m_StartNumber;
+        AP4_UI64                 m_EndTime;
+    };
+
+    // methods
+    void TrimTimeline(Representation& representation);
+
+    // members
+    bool                       m_Dynamic;
+    double                     m_MinBufferTime;
+    double                     m_TimeShiftBufferDepth;
+    double                     m_MinimumUpdatePeriod;
+    AP4_String                 m_AvailabilityStartTime;
+    AP4_String                 m_PublishTime;
+    AP4_Array<Representation*> m_Representations;
+    AP4_DataBuffer             m_Output;
+};
+
+#endif // _AP4_PLAYLIST_WRITER_H_
@@ -46,6 +46,7 @@
 #include "Ap4SidxAtom.h"
 #include "Ap4DataBuffer.h"
 #include "Ap4Debug.h"
+#include "Ap4SampleHashIndex.h"
 
 /*----------------------------------------------------------------------
 |   types
@@ -163,7 +164,7 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
     
         // if this is not a moof atom, just write it back and continue
         if (atom->GetType() != AP4_ATOM_TYPE_MOOF) {
-            result = atom->Write(output);
+            result = atom->WriteBuffered(output);
             if (AP4_FAILED(result)) return result;
             continue;
         }
@@ -238,7 +239,7 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
         // write the moof
         AP4_UI64 moof_out_start = 0;
         output.Tell(moof_out_start);
-        moof->Write(output);
+        moof->WriteBuffered(output);
         
         // remember the location of this fragment
         FragmentMapEntry map_entry = {atom_offset, moof_out_start};
@@ -303,6 +304,11 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
                 result = sample_tables[i]->GetSample(j, sample);
                 if (AP4_FAILED(result)) return result;
                 sample.ReadData(sample_data_in);
+                if (m_SampleHashIndex) {
+                    m_SampleHashIndex->AddSample(tfhd->GetTrackId(),
+                                                 sample_data_in.GetData(),
+                                                 sample_data_in.GetDataSize());
+                }
                 
                 // process the sample data
                 if (handler) {
@@ -363,7 +369,7 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
         
         // update the moof if needed
         output.Seek(moof_out_start);
-        moof->Write(output);
+        moof->WriteBuffered(output);
         output.Seek(mdat_out_end);
         
         // update the sidx if we have one
@@ -656,7 +662,12 @@ AP4_Processor::Process(AP4_ByteStream&   input,
         }
 
         // write all atoms
-        top_level.GetChildren().Apply(AP4_AtomListWriter(output));
+        for (AP4_List<AP4_Atom>::Item* item = top_level.GetChildren().FirstItem();
+                                       item;
+                                       item = item->GetNext()) {
+            result = item->GetData()->WriteBuffered(output);
+            if (AP4_FAILED(result)) return result;
+        }
 
         // write mdat header
         if (mdat_payload_size) {
@@ -686,6 +697,12 @@ AP4_Processor::Process(AP4_ByteStream&   input,
             for (unsigned int i=0; i<locators.ItemCount(); i++) {
                 AP4_SampleLocator& locator = locators[i];
                 locator.m_Sample.ReadData(data_in);
+                if (m_SampleHashIndex) {
+                    m_SampleHashIndex->SetSample(m_TrackIds[locator.m_TrakIndex],
+                                                 locator.m_SampleIndex,
+                                                 data_in.GetData(),
+                                                 data_in.GetDataSize());
+                }
                 TrackHandler* handler = m_TrackHandlers[locator.m_TrakIndex];
                 if (handler) {
                     result = handler->ProcessSample(data_in, data_out);
@@ -48,6 +48,7 @@ class AP4_TrakAtom;
 class AP4_TrexAtom;
 class AP4_SidxAtom;
 class AP4_FragmentSampleTable;
+class AP4_SampleHashIndex;
 struct AP4_AtomLocator;
 
 /*----------------------------------------------------------------------
@@ -158,11 +159,23 @@ public:
                                          AP4_DataBuffer& data_out) = 0;
     };
 
+    /**
+     *  Default constructor
+     */
+    AP4_Processor() : m_SampleHashIndex(NULL) {}
+
     /**
      *  Default destructor
      */
     virtual ~AP4_Processor() { m_ExternalTrackData.DeleteReferences(); }
 
+    /**
+     * Record the hash of the input data of each sample (before it is
+     * processed) in a sample hash index, so that the next run can tell
+     * which samples have changed. The index is not owned by the processor.
+     */
+    void SetSampleHashIndex(AP4_SampleHashIndex* index) { m_SampleHashIndex = index; }
+
     /**
      * Process the input stream into an output stream.
      * @param input Input stream from which to read the input file.
@@ -270,6 +283,7 @@ protected:
     AP4_List<ExternalTrackData> m_ExternalTrackData;
     AP4_Array<AP4_UI32>         m_TrackIds;
     AP4_Array<TrackHandler*>    m_TrackHandlers;
+    AP4_SampleHashIndex*        m_SampleHashIndex;
 };
 
 #endif // _AP4_PROCESSOR_H_
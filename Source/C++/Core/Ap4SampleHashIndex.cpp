@@ -0,0 +1,386 @@
+/*****************************************************************
+|
+|    AP4 - Sample Hash Index
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4SampleHashIndex.h"
+#include "Ap4ByteStream.h"
+#include "Ap4Movie.h"
+#include "Ap4Track.h"
+#include "Ap4LinearReader.h"
+#include "Ap4UuidAtom.h"
+#include "Ap4Xxhash.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_UI08 AP4_SAMPLE_HASH_INDEX_UUID[16] = {
+    0x05, 0x45, 0xFD, 0x23, 0xCD, 0xCD, 0x48, 0x05, 0x9F, 0x87, 0xB4, 0x81, 0xAF, 0xD8, 0x4E, 0x95
+};
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::~AP4_SampleHashIndex
++---------------------------------------------------------------------*/
+AP4_SampleHashIndex::~AP4_SampleHashIndex()
+{
+    for (unsigned int i=0; i<m_Tracks.ItemCount(); i++) {
+        delete m_Tracks[i];
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::Create
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::Create(AP4_Movie& movie, AP4_ByteStream& stream, AP4_SampleHashIndex*& index)
+{
+    index = new AP4_SampleHashIndex();
+
+    stream.Seek(0);
+    AP4_LinearReader reader(movie, &stream);
+    for (AP4_List<AP4_Track>::Item* item = movie.GetTracks().FirstItem();
+                                    item;
+                                    item = item->GetNext()) {
+        AP4_UI32 track_id = item->GetData()->GetId();
+        reader.EnableTrack(track_id);
+        index->GetTrack(track_id); // so that tracks without samples are listed
+    }
+    reader.SetSampleHashIndex(index);
+
+    AP4_Sample     sample;
+    AP4_DataBuffer sample_data;
+    AP4_UI32       track_id = 0;
+    AP4_Result     result;
+    do {
+        result = reader.ReadNextSample(sample, sample_data, track_id);
+    } while (AP4_SUCCEEDED(result));
+    if (result != AP4_ERROR_EOS) {
+        delete index;
+        index = NULL;
+        return result;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::Load
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::Load(AP4_ByteStream& stream, AP4_SampleHashIndex*& index)
+{
+    index = NULL;
+    AP4_LargeSize size = 0;
+    AP4_Result result = stream.GetSize(size);
+    if (AP4_FAILED(result)) return result;
+    AP4_Position position = 0;
+    stream.Tell(position);
+    if (position > size || size-position > 0x7FFFFFFF) return AP4_ERROR_INVALID_FORMAT;
+
+    AP4_DataBuffer data;
+    AP4_Size data_size = (AP4_Size)(size-position);
+    result = data.SetDataSize(data_size);
+    if (AP4_FAILED(result)) return result;
+    result = stream.Read(data.UseData(), data_size);
+    if (AP4_FAILED(result)) return result;
+
+    AP4_SampleHashIndex* hash_index = new AP4_SampleHashIndex();
+    result = hash_index->Parse(data.GetData(), data_size);
+    if (AP4_FAILED(result)) {
+        delete hash_index;
+        return result;
+    }
+    index = hash_index;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::Load
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::Load(AP4_AtomParent& parent, AP4_SampleHashIndex*& index)
+{
+    index = NULL;
+    for (AP4_List<AP4_Atom>::Item* item = parent.GetChildren().FirstItem();
+                                   item;
+                                   item = item->GetNext()) {
+        AP4_UuidAtom* uuid = AP4_DYNAMIC_CAST(AP4_UuidAtom, item->GetData());
+        if (uuid == NULL) continue;
+        if (AP4_CompareMemory(uuid->GetUuid(), AP4_SAMPLE_HASH_INDEX_UUID, 16) != 0) continue;
+
+        // the payload of the atom is the serialized index
+        AP4_MemoryByteStream* payload = new AP4_MemoryByteStream();
+        AP4_Result result = uuid->WriteFields(*payload);
+        if (AP4_SUCCEEDED(result)) {
+            payload->Seek(0);
+            result = Load(*payload, index);
+        }
+        payload->Release();
+        return result;
+    }
+
+    return AP4_ERROR_NO_SUCH_ITEM;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::Parse
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::Parse(const AP4_UI08* data, AP4_Size data_size)
+{
+    if (data_size < AP4_SAMPLE_HASH_INDEX_HEADER_SIZE) return AP4_ERROR_INVALID_FORMAT;
+    if (AP4_BytesToUInt32BE(data)   != AP4_SAMPLE_HASH_INDEX_MAGIC)   return AP4_ERROR_INVALID_FORMAT;
+    if (AP4_BytesToUInt32BE(data+4) != AP4_SAMPLE_HASH_INDEX_VERSION) return AP4_ERROR_NOT_SUPPORTED;
+    if (AP4_BytesToUInt32BE(data+8) != AP4_SAMPLE_HASH_INDEX_ALGORITHM_XXH64) {
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+
+    AP4_Cardinal track_count = AP4_BytesToUInt32BE(data+12);
+    AP4_Size     offset      = AP4_SAMPLE_HASH_INDEX_HEADER_SIZE;
+    for (unsigned int i=0; i<track_count; i++) {
+        if (data_size-offset < AP4_SAMPLE_HASH_INDEX_TRACK_HEADER_SIZE) return AP4_ERROR_INVALID_FORMAT;
+        AP4_UI32     track_id     = AP4_BytesToUInt32BE(data+offset);
+        AP4_Cardinal sample_count = AP4_BytesToUInt32BE(data+offset+4);
+        offset += AP4_SAMPLE_HASH_INDEX_TRACK_HEADER_SIZE;
+        if ((AP4_UI64)sample_count*8 > data_size-offset) return AP4_ERROR_INVALID_FORMAT;
+
+        TrackHashes* track = GetTrack(track_id);
+        AP4_Result result = track->m_Hashes.SetItemCount(sample_count);
+        if (AP4_FAILED(result)) return result;
+        for (unsigned int j=0; j<sample_count; j++) {
+            track->m_Hashes[j] = AP4_BytesToUInt64BE(data+offset);
+            offset += 8;
+        }
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::FindTrack
++---------------------------------------------------------------------*/
+AP4_SampleHashIndex::TrackHashes*
+AP4_SampleHashIndex::FindTrack(AP4_UI32 track_id) const
+{
+    for (unsigned int i=0; i<m_Tracks.ItemCount(); i++) {
+        if (m_Tracks[i]->m_TrackId == track_id) return m_Tracks[i];
+    }
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::GetTrack
++---------------------------------------------------------------------*/
+AP4_SampleHashIndex::TrackHashes*
+AP4_SampleHashIndex::GetTrack(AP4_UI32 track_id)
+{
+    TrackHashes* track = FindTrack(track_id);
+    if (track == NULL) {
+        track = new TrackHashes(track_id);
+        m_Tracks.Append(track);
+    }
+
+    return track;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::AddSample
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::AddSample(AP4_UI32 track_id, const AP4_UI08* data, AP4_Size data_size)
+{
+    return GetTrack(track_id)->m_Hashes.Append(AP4_ComputeXxh64(data, data_size));
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::SetSample
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::SetSample(AP4_UI32        track_id,
+                               AP4_Ordinal     sample_index,
+                               const AP4_UI08* data,
+                               AP4_Size        data_size)
+{
+    TrackHashes* track = GetTrack(track_id);
+    if (sample_index >= track->m_Hashes.ItemCount()) {
+        AP4_Result result = track->m_Hashes.SetItemCount(sample_index+1);
+        if (AP4_FAILED(result)) return result;
+    }
+    track->m_Hashes[sample_index] = AP4_ComputeXxh64(data, data_size);
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::GetTrackId
++---------------------------------------------------------------------*/
+AP4_UI32
+AP4_SampleHashIndex::GetTrackId(AP4_Ordinal track_index) const
+{
+    if (track_index >= m_Tracks.ItemCount()) return 0;
+    return m_Tracks[track_index]->m_TrackId;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::GetSampleCount
++---------------------------------------------------------------------*/
+AP4_Cardinal
+AP4_SampleHashIndex::GetSampleCount(AP4_UI32 track_id) const
+{
+    TrackHashes* track = FindTrack(track_id);
+    return track ? track->m_Hashes.ItemCount() : 0;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::GetSampleHash
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::GetSampleHash(AP4_UI32 track_id, AP4_Ordinal sample_index, AP4_UI64& hash) const
+{
+    hash = 0;
+    TrackHashes* track = FindTrack(track_id);
+    if (track == NULL) return AP4_ERROR_NO_SUCH_ITEM;
+    if (sample_index >= track->m_Hashes.ItemCount()) return AP4_ERROR_OUT_OF_RANGE;
+    hash = track->m_Hashes[sample_index];
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::IsSampleUnchanged
++---------------------------------------------------------------------*/
+bool
+AP4_SampleHashIndex::IsSampleUnchanged(AP4_UI32        track_id,
+                                       AP4_Ordinal     sample_index,
+                                       const AP4_UI08* data,
+                                       AP4_Size        data_size) const
+{
+    AP4_UI64 hash = 0;
+    if (AP4_FAILED(GetSampleHash(track_id, sample_index, hash))) return false;
+
+    return hash == AP4_ComputeXxh64(data, data_size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::Compare
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::Compare(const AP4_SampleHashIndex& other,
+                             AP4_UI32                   track_id,
+                             AP4_Array<AP4_Ordinal>&    changed_samples) const
+{
+    changed_samples.Clear();
+    TrackHashes* track       = FindTrack(track_id);
+    TrackHashes* other_track = other.FindTrack(track_id);
+    if (track == NULL && other_track == NULL) return AP4_ERROR_NO_SUCH_ITEM;
+
+    AP4_Cardinal sample_count       = track       ? track->m_Hashes.ItemCount()       : 0;
+    AP4_Cardinal other_sample_count = other_track ? other_track->m_Hashes.ItemCount() : 0;
+    AP4_Cardinal common_count       = sample_count < other_sample_count ? sample_count : other_sample_count;
+    for (unsigned int i=0; i<common_count; i++) {
+        if (track->m_Hashes[i] != other_track->m_Hashes[i]) {
+            changed_samples.Append(i);
+        }
+    }
+    AP4_Cardinal max_count = sample_count > other_sample_count ? sample_count : other_sample_count;
+    for (unsigned int i=common_count; i<max_count; i++) {
+        changed_samples.Append(i);
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::GetSerializedSize
++---------------------------------------------------------------------*/
+AP4_UI64
+AP4_SampleHashIndex::GetSerializedSize() const
+{
+    AP4_UI64 size = AP4_SAMPLE_HASH_INDEX_HEADER_SIZE;
+    for (unsigned int i=0; i<m_Tracks.ItemCount(); i++) {
+        size += AP4_SAMPLE_HASH_INDEX_TRACK_HEADER_SIZE+(AP4_UI64)m_Tracks[i]->m_Hashes.ItemCount()*8;
+    }
+
+    return size;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::Write
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::Write(AP4_ByteStream& stream) const
+{
+    AP4_UI08 header[AP4_SAMPLE_HASH_INDEX_HEADER_SIZE];
+    AP4_BytesFromUInt32BE(header,    AP4_SAMPLE_HASH_INDEX_MAGIC);
+    AP4_BytesFromUInt32BE(header+4,  AP4_SAMPLE_HASH_INDEX_VERSION);
+    AP4_BytesFromUInt32BE(header+8,  AP4_SAMPLE_HASH_INDEX_ALGORITHM_XXH64);
+    AP4_BytesFromUInt32BE(header+12, m_Tracks.ItemCount());
+    AP4_CHECK(stream.Write(header, sizeof(header)));
+
+    AP4_DataBuffer buffer;
+    for (unsigned int i=0; i<m_Tracks.ItemCount(); i++) {
+        const AP4_Array<AP4_UI64>& hashes = m_Tracks[i]->m_Hashes;
+        AP4_UI08 track_header[AP4_SAMPLE_HASH_INDEX_TRACK_HEADER_SIZE];
+        AP4_BytesFromUInt32BE(track_header,   m_Tracks[i]->m_TrackId);
+        AP4_BytesFromUInt32BE(track_header+4, hashes.ItemCount());
+        AP4_CHECK(stream.Write(track_header, sizeof(track_header)));
+        if (hashes.ItemCount() == 0) continue;
+
+        AP4_CHECK(buffer.SetDataSize(hashes.ItemCount()*8));
+        AP4_BytesFromUInt64ArrayBE(buffer.UseData(), &hashes[0], hashes.ItemCount());
+        AP4_CHECK(stream.Write(buffer.GetData(), buffer.GetDataSize()));
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex::CreateAtom
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SampleHashIndex::CreateAtom(AP4_Atom*& atom) const
+{
+    atom = NULL;
+    AP4_UI64 size = AP4_UUID_ATOM_HEADER_SIZE+GetSerializedSize();
+    if (size > 0xFFFFFFFF) return AP4_ERROR_OUT_OF_RANGE;
+
+    AP4_MemoryByteStream* payload = new AP4_MemoryByteStream();
+    AP4_Result result = Write(*payload);
+    if (AP4_SUCCEEDED(result)) {
+        payload->Seek(0);
+        atom = new AP4_UnknownUuidAtom(size, AP4_SAMPLE_HASH_INDEX_UUID, *payload);
+    }
+    payload->Release();
+
+    return result;
+}
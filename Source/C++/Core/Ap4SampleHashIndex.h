@@ -0,0 +1,168 @@
+/*****************************************************************
+|
+|    AP4 - Sample Hash Index
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+
+#ifndef _AP4_SAMPLE_HASH_INDEX_H_
+#define _AP4_SAMPLE_HASH_INDEX_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+#include "Ap4Atom.h"
+#include "Ap4Array.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ByteStream;
+class AP4_Movie;
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_UI32 AP4_SAMPLE_HASH_INDEX_MAGIC             = AP4_ATOM_TYPE('B','4','S','H');
+const AP4_UI32 AP4_SAMPLE_HASH_INDEX_VERSION           = 1;
+const AP4_UI32 AP4_SAMPLE_HASH_INDEX_ALGORITHM_XXH64   = 1;
+const AP4_Size AP4_SAMPLE_HASH_INDEX_HEADER_SIZE       = 16;
+const AP4_Size AP4_SAMPLE_HASH_INDEX_TRACK_HEADER_SIZE = 8;
+
+extern const AP4_UI08 AP4_SAMPLE_HASH_INDEX_UUID[16];
+
+/*----------------------------------------------------------------------
+|   AP4_SampleHashIndex
++---------------------------------------------------------------------*/
+/**
+ * Table of the hashes (XXH64) of the samples of each track of a file,
+ * used to find out which samples have changed since a previous pass
+ * (to skip unchanged content when re-packaging) or to check the
+ * integrity of the sample data.
+ *
+ * The hashes can be recorded by an AP4_LinearReader or an AP4_Processor
+ * (see their SetSampleHashIndex method), or computed for a whole file
+ * with Create(). The index can be saved in a sidecar file, or stored in
+ * a uuid atom (for example in the moov atom). The serialized form is the
+ * same in both cases, all values being big-endian:
+ *   header (16 bytes):
+ *     magic ('B4SH'), version, hash algorithm, track count : 4 x UI32
+ *   for each track:
+ *     track ID, sample count                               : 2 x UI32
+ *     one hash per sample                                  : UI64 each
+ */
+class AP4_SampleHashIndex
+{
+public:
+    // class methods
+    /**
+     * Compute the hashes of all the samples of all the tracks of a movie.
+     */
+    static AP4_Result Create(AP4_Movie& movie, AP4_ByteStream& stream, AP4_SampleHashIndex*& index);
+
+    /**
+     * Load a serialized index from a stream.
+     */
+    static AP4_Result Load(AP4_ByteStream& stream, AP4_SampleHashIndex*& index);
+
+    /**
+     * Load the index stored in a uuid atom, among the children of an atom
+     * (for example a moov atom). Returns AP4_ERROR_NO_SUCH_ITEM if there
+     * is no such atom.
+     */
+    static AP4_Result Load(AP4_AtomParent& parent, AP4_SampleHashIndex*& index);
+
+    // constructor and destructor
+    AP4_SampleHashIndex() {}
+    ~AP4_SampleHashIndex();
+
+    // methods
+    /**
+     * Record the hash of the next sample of a track.
+     */
+    AP4_Result AddSample(AP4_UI32 track_id, const AP4_UI08* data, AP4_Size data_size);
+
+    /**
+     * Record the hash of a sample of a track, when samples are not seen
+     * in order (hashes of samples not set yet are 0).
+     */
+    AP4_Result SetSample(AP4_UI32        track_id,
+                         AP4_Ordinal     sample_index,
+                         const AP4_UI08* data,
+                         AP4_Size        data_size);
+
+    AP4_Cardinal GetTrackCount() const { return m_Tracks.ItemCount(); }
+    AP4_UI32     GetTrackId(AP4_Ordinal track_index) const;
+    AP4_Cardinal GetSampleCount(AP4_UI32 track_id) const;
+    AP4_Result   GetSampleHash(AP4_UI32 track_id, AP4_Ordinal sample_index, AP4_UI64& hash) const;
+
+    /**
+     * Check whether the data of a sample has the hash recorded in the
+     * index, in which case the result of processing it can be reused.
+     */
+    bool IsSampleUnchanged(AP4_UI32        track_id,
+                           AP4_Ordinal     sample_index,
+                           const AP4_UI08* data,
+                           AP4_Size        data_size) const;
+
+    /**
+     * Compare the hashes of a track with those of another index, and list
+     * the samples that differ (samples present in only one of them count
+     * as changed).
+     */
+    AP4_Result Compare(const AP4_SampleHashIndex& other,
+                       AP4_UI32                   track_id,
+                       AP4_Array<AP4_Ordinal>&    changed_samples) const;
+
+    /**
+     * Write the serialized index to a stream.
+     */
+    AP4_Result Write(AP4_ByteStream& stream) const;
+
+    /**
+     * Create a uuid atom containing the serialized index.
+     */
+    AP4_Result CreateAtom(AP4_Atom*& atom) const;
+
+private:
+    // types
+    struct TrackHashes {
+        TrackHashes(AP4_UI32 track_id) : m_TrackId(track_id) {}
+        AP4_UI32            m_TrackId;
+        AP4_Array<AP4_UI64> m_Hashes;
+    };
+
+    // methods
+    TrackHashes* FindTrack(AP4_UI32 track_id) const;
+    TrackHashes* GetTrack(AP4_UI32 track_id);
+    AP4_UI64     GetSerializedSize() const;
+    AP4_Result   Parse(const AP4_UI08* data, AP4_Size data_size);
+
+    // members
+    AP4_Array<TrackHashes*> m_Tracks;
+};
+
+#endif // _AP4_SAMPLE_HASH_INDEX_H_
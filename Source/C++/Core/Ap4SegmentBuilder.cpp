@@ -42,6 +42,7 @@
 #include "Ap4MfhdAtom.h"
 #include "Ap4TrunAtom.h"
 #include "Ap4TfdtAtom.h"
+#include "Ap4Utils.h"
 
 /*----------------------------------------------------------------------
 |   constants
@@ -62,7 +63,14 @@ AP4_SegmentBuilder::AP4_SegmentBuilder(AP4_Track::Type track_type,
     m_SampleStartNumber(0),
     m_MediaTimeOrigin(media_time_origin),
     m_MediaStartTime(0),
-    m_MediaDuration(0)
+    m_MediaDuration(0),
+    m_ChunkListener(NULL),
+    m_ChunkMaxSamples(0),
+    m_ChunkMaxDurationMs(0),
+    m_ChunkSequenceNumber(1),
+    m_ChunkIndex(0),
+    m_ChunkFirstSample(0),
+    m_ChunkMediaStartTime(0)
 {
 }
 
@@ -74,24 +82,132 @@ AP4_SegmentBuilder::~AP4_SegmentBuilder()
     m_Samples.Clear();
 }
 
+/*----------------------------------------------------------------------
+|   AP4_SegmentBuilder::EnableChunks
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentBuilder::EnableChunks(ChunkListener* listener,
+                                 unsigned int   max_chunk_samples,
+                                 unsigned int   max_chunk_duration_ms,
+                                 unsigned int   first_sequence_number)
+{
+    if (listener == NULL) return AP4_ERROR_INVALID_PARAMETERS;
+    if (max_chunk_samples == 0 && max_chunk_duration_ms == 0) return AP4_ERROR_INVALID_PARAMETERS;
+    if (m_Samples.ItemCount()) return AP4_ERROR_INVALID_STATE;
+    
+    m_ChunkListener       = listener;
+    m_ChunkMaxSamples     = max_chunk_samples;
+    m_ChunkMaxDurationMs  = max_chunk_duration_ms;
+    m_ChunkSequenceNumber = first_sequence_number;
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_SegmentBuilder::AddSample
 +---------------------------------------------------------------------*/
 AP4_Result
 AP4_SegmentBuilder::AddSample(AP4_Sample& sample)
 {
+    if (m_ChunkListener) {
+        m_SampleTimesUs.Append(AP4_GetMonotonicTimeUs());
+    }
     AP4_Result result = m_Samples.Append(sample);
     if (AP4_FAILED(result)) return result;
     m_MediaDuration += sample.GetDuration();
     
+    // check if we need to emit a chunk
+    if (m_ChunkListener) {
+        unsigned int pending_samples = m_Samples.ItemCount()-m_ChunkFirstSample;
+        AP4_UI64     pending_time    = m_MediaDuration-m_ChunkMediaStartTime;
+        if ((m_ChunkMaxSamples && pending_samples >= m_ChunkMaxSamples) ||
+            (m_ChunkMaxDurationMs && m_Timescale &&
+             pending_time*1000 >= (AP4_UI64)m_ChunkMaxDurationMs*m_Timescale)) {
+            // the limit stays reached until the samples can be emitted
+            return FlushChunk();
+        }
+    }
+    
     return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
-|   AP4_SegmentBuilder::WriteMediaSegment
+|   AP4_SegmentBuilder::FlushChunk
 +---------------------------------------------------------------------*/
 AP4_Result
-AP4_SegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int sequence_number)
+AP4_SegmentBuilder::FlushChunk()
+{
+    if (m_ChunkListener == NULL) return AP4_ERROR_INVALID_STATE;
+    unsigned int complete_count = GetCompleteSampleCount();
+    if (complete_count <= m_ChunkFirstSample) return AP4_SUCCESS;
+    
+    return EmitChunk(complete_count-m_ChunkFirstSample);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentBuilder::EmitChunk
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentBuilder::EmitChunk(unsigned int sample_count)
+{
+    if (sample_count == 0) return AP4_SUCCESS;
+    AP4_UI32 chunk_duration = 0;
+    for (unsigned int i=0; i<sample_count; i++) {
+        chunk_duration += m_Samples[m_ChunkFirstSample+i].GetDuration();
+    }
+    
+    // finalize the timestamps of the chunk's samples
+    AdjustTimestamps(m_ChunkFirstSample, sample_count);
+    
+    // append the chunk to the segment data
+    AP4_UI64 build_start = AP4_GetMonotonicTimeUs();
+    AP4_Size chunk_offset = m_SegmentData.GetDataSize();
+    AP4_MemoryByteStream* chunk_stream = new AP4_MemoryByteStream(m_SegmentData);
+    chunk_stream->Seek(chunk_offset);
+    AP4_UI64 decode_time = m_MediaTimeOrigin+m_MediaStartTime+m_ChunkMediaStartTime;
+    bool independent = m_Samples[m_ChunkFirstSample].IsSync();
+    AP4_Result result = WriteFragment(*chunk_stream,
+                                      m_ChunkSequenceNumber,
+                                      m_ChunkFirstSample,
+                                      sample_count,
+                                      decode_time,
+                                      independent);
+    chunk_stream->Release();
+    if (AP4_FAILED(result)) return result;
+    AP4_UI64 build_end = AP4_GetMonotonicTimeUs();
+    
+    // notify the listener
+    ChunkInfo info;
+    info.m_SequenceNumber = m_ChunkSequenceNumber;
+    info.m_ChunkIndex     = m_ChunkIndex;
+    info.m_SampleCount    = sample_count;
+    info.m_MediaStartTime = decode_time;
+    info.m_MediaDuration  = chunk_duration;
+    info.m_IsIndependent  = independent;
+    info.m_LatencyUs      = build_end-m_SampleTimesUs[m_ChunkFirstSample];
+    info.m_BuildTimeUs    = build_end-build_start;
+    
+    ++m_ChunkSequenceNumber;
+    ++m_ChunkIndex;
+    m_ChunkFirstSample    += sample_count;
+    m_ChunkMediaStartTime += chunk_duration;
+    
+    return m_ChunkListener->OnChunk(*this,
+                                    info,
+                                    m_SegmentData.GetData()+chunk_offset,
+                                    m_SegmentData.GetDataSize()-chunk_offset);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentBuilder::WriteFragment
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentBuilder::WriteFragment(AP4_ByteStream& stream,
+                                  unsigned int    sequence_number,
+                                  unsigned int    first_sample,
+                                  unsigned int    sample_count,
+                                  AP4_UI64        decode_time,
+                                  bool            independent)
 {
     unsigned int tfhd_flags = AP4_TFHD_FLAG_DEFAULT_BASE_IS_MOOF;
     if (m_TrackType == AP4_Track::TYPE_VIDEO) {
@@ -115,13 +231,13 @@ AP4_SegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int seque
     }
     
     traf->AddChild(tfhd);
-    AP4_TfdtAtom* tfdt = new AP4_TfdtAtom(1, m_MediaTimeOrigin+m_MediaStartTime);
+    AP4_TfdtAtom* tfdt = new AP4_TfdtAtom(1, decode_time);
     traf->AddChild(tfdt);
     AP4_UI32 trun_flags = AP4_TRUN_FLAG_DATA_OFFSET_PRESENT     |
                           AP4_TRUN_FLAG_SAMPLE_DURATION_PRESENT |
                           AP4_TRUN_FLAG_SAMPLE_SIZE_PRESENT;
     AP4_UI32 first_sample_flags = 0;
-    if (m_TrackType == AP4_Track::TYPE_VIDEO) {
+    if (m_TrackType == AP4_Track::TYPE_VIDEO && independent) {
         trun_flags |= AP4_TRUN_FLAG_FIRST_SAMPLE_FLAGS_PRESENT;
         first_sample_flags = 0x2000000; // sample_depends_on=2 (I frame)
     }
@@ -131,21 +247,22 @@ AP4_SegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int seque
     moof->AddChild(traf);
     
     // add samples to the fragment
-    AP4_Array<AP4_UI32>            sample_indexes;
     AP4_Array<AP4_TrunAtom::Entry> trun_entries;
     AP4_UI32                       mdat_size = AP4_ATOM_HEADER_SIZE;
-    trun_entries.SetItemCount(m_Samples.ItemCount());
-    for (unsigned int i=0; i<m_Samples.ItemCount(); i++) {
+    trun_entries.SetItemCount(sample_count);
+    for (unsigned int i=0; i<sample_count; i++) {
+        AP4_Sample& sample = m_Samples[first_sample+i];
+        
         // if we have one non-zero CTS delta, we'll need to express it
-        if (m_Samples[i].GetCtsDelta()) {
+        if (sample.GetCtsDelta()) {
             trun->SetFlags(trun->GetFlags() | AP4_TRUN_FLAG_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT);
         }
         
         // add one sample
         AP4_TrunAtom::Entry& trun_entry = trun_entries[i];
-        trun_entry.sample_duration                = m_Samples[i].GetDuration();
-        trun_entry.sample_size                    = m_Samples[i].GetSize();
-        trun_entry.sample_composition_time_offset = m_Samples[i].GetCtsDelta();
+        trun_entry.sample_duration                = sample.GetDuration();
+        trun_entry.sample_size                    = sample.GetSize();
+        trun_entry.sample_composition_time_offset = sample.GetCtsDelta();
         
         mdat_size += trun_entry.sample_size;
     }
@@ -155,20 +272,22 @@ AP4_SegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int seque
     trun->SetDataOffset((AP4_UI32)moof->GetSize()+AP4_ATOM_HEADER_SIZE);
     
     // write moof
-    moof->Write(stream);
+    AP4_Result result = moof->WriteBuffered(stream);
+    delete moof;
+    if (AP4_FAILED(result)) return result;
     
     // write mdat
     stream.WriteUI32(mdat_size);
     stream.WriteUI32(AP4_ATOM_TYPE_MDAT);
-    for (unsigned int i=0; i<m_Samples.ItemCount(); i++) {
-        AP4_Result result;
-        AP4_ByteStream* data_stream = m_Samples[i].GetDataStream();
-        result = data_stream->Seek(m_Samples[i].GetOffset());
+    for (unsigned int i=0; i<sample_count; i++) {
+        AP4_Sample& sample = m_Samples[first_sample+i];
+        AP4_ByteStream* data_stream = sample.GetDataStream();
+        result = data_stream->Seek(sample.GetOffset());
         if (AP4_FAILED(result)) {
             data_stream->Release();
             return result;
         }
-        result = data_stream->CopyTo(stream, m_Samples[i].GetSize());
+        result = data_stream->CopyTo(stream, sample.GetSize());
         if (AP4_FAILED(result)) {
             data_stream->Release();
             return result;
@@ -177,13 +296,48 @@ AP4_SegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int seque
         data_stream->Release();
     }
     
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentBuilder::WriteMediaSegment
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int sequence_number)
+{
+    AP4_Result result;
+    if (m_ChunkListener) {
+        // moof sequence numbers must increase
+        if (sequence_number < m_ChunkSequenceNumber) return AP4_ERROR_INVALID_PARAMETERS;
+        m_ChunkSequenceNumber = sequence_number;
+        
+        // emit what's left as the last chunk, and output the whole segment
+        result = EmitChunk(m_Samples.ItemCount()-m_ChunkFirstSample);
+        if (AP4_FAILED(result)) return result;
+        result = stream.Write(m_SegmentData.GetData(), m_SegmentData.GetDataSize());
+        if (AP4_FAILED(result)) return result;
+        m_SegmentData.SetDataSize(0);
+        m_SampleTimesUs.Clear();
+        m_ChunkIndex          = 0;
+        m_ChunkFirstSample    = 0;
+        m_ChunkMediaStartTime = 0;
+    } else {
+        AdjustTimestamps(0, m_Samples.ItemCount());
+        result = WriteFragment(stream,
+                               sequence_number,
+                               0,
+                               m_Samples.ItemCount(),
+                               m_MediaTimeOrigin+m_MediaStartTime,
+                               true);
+        if (AP4_FAILED(result)) return result;
+    }
+    
     // update counters
     m_SampleStartNumber += m_Samples.ItemCount();
     m_MediaStartTime    += m_MediaDuration;
     m_MediaDuration      = 0;
     
     // cleanup
-    delete moof;
     m_Samples.Clear();
 
     return AP4_SUCCESS;
@@ -206,11 +360,30 @@ AP4_VideoSegmentBuilder::AP4_VideoSegmentBuilder(AP4_UI32 track_id,
                                                  double   frames_per_second,
                                                  AP4_UI64 media_time_origin) :
     AP4_FeedSegmentBuilder(AP4_Track::TYPE_VIDEO, track_id, media_time_origin),
-    m_FramesPerSecond(frames_per_second)
+    m_FramesPerSecond(frames_per_second),
+    m_CompleteSampleCount(0),
+    m_MaxDisplayOrder(0),
+    m_ReorderDelay(0)
 {
     m_Timescale = (unsigned int)(frames_per_second*1000.0);
 }
 
+/*----------------------------------------------------------------------
+|   AP4_VideoSegmentBuilder::AddSampleOrder
++---------------------------------------------------------------------*/
+void
+AP4_VideoSegmentBuilder::AddSampleOrder(AP4_UI32 decode_order, AP4_UI32 display_order)
+{
+    // a frame that starts a GOP, or that is displayed after all the frames
+    // of the GOP so far, closes the reorder group of the frames before it:
+    // the frames that follow can only be displayed after those
+    if (display_order == 0 || display_order > m_MaxDisplayOrder) {
+        m_CompleteSampleCount = m_SampleOrders.ItemCount();
+        m_MaxDisplayOrder     = display_order;
+    }
+    m_SampleOrders.Append(SampleOrder(decode_order, display_order));
+}
+
 /*----------------------------------------------------------------------
 |   AP4_VideoSegmentBuilder::SortSamples
 +---------------------------------------------------------------------*/
@@ -301,7 +474,7 @@ AP4_VideoSegmentBuilder::WriteVideoInitSegment(AP4_ByteStream&        stream,
     delete ftyp;
 
     // write the moov atom
-    AP4_Result result = output_movie->GetMoovAtom()->Write(stream);
+    AP4_Result result = output_movie->GetMoovAtom()->WriteBuffered(stream);
     if (AP4_FAILED(result)) {
         return result;
     }
@@ -313,56 +486,70 @@ AP4_VideoSegmentBuilder::WriteVideoInitSegment(AP4_ByteStream&        stream,
 }
 
 /*----------------------------------------------------------------------
-|   AP4_VideoSegmentBuilder::WriteMediaSegment
+|   AP4_VideoSegmentBuilder::AdjustTimestamps
 +---------------------------------------------------------------------*/
-AP4_Result
-AP4_VideoSegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int sequence_number)
+void
+AP4_VideoSegmentBuilder::AdjustTimestamps(unsigned int first_sample, unsigned int sample_count)
 {
-    if (m_SampleOrders.ItemCount() > 1) {
-        // rebase the decode order
-        AP4_UI32 decode_order_base = m_SampleOrders[0].m_DecodeOrder;
-        for (unsigned int i=0; i<m_SampleOrders.ItemCount(); i++) {
-            if (m_SampleOrders[i].m_DecodeOrder >= decode_order_base) {
-                m_SampleOrders[i].m_DecodeOrder -= decode_order_base;
-            }
-        }
+    if (sample_count == 0 || first_sample+sample_count > m_SampleOrders.ItemCount()) {
+        return;
+    }
+    SampleOrder* orders = &m_SampleOrders[first_sample];
     
-        // adjust the sample CTS/DTS offsets based on the sample orders
-        unsigned int start = 0;
-        for (unsigned int i=1; i<=m_SampleOrders.ItemCount(); i++) {
-            if (i == m_SampleOrders.ItemCount() || m_SampleOrders[i].m_DisplayOrder == 0) {
-                // we got to the end of the GOP, sort it by display order
-                SortSamples(&m_SampleOrders[start], i-start);
-                start = i;
-            }
+    // rebase the decode order
+    AP4_UI32 decode_order_base = orders[0].m_DecodeOrder;
+    for (unsigned int i=0; i<sample_count; i++) {
+        if (orders[i].m_DecodeOrder >= decode_order_base) {
+            orders[i].m_DecodeOrder -= decode_order_base;
         }
+    }
 
-        // compute the max CTS delta
-        unsigned int max_delta = 0;
-        for (unsigned int i=0; i<m_SampleOrders.ItemCount(); i++) {
-            if (m_SampleOrders[i].m_DecodeOrder > i) {
-                unsigned int delta =m_SampleOrders[i].m_DecodeOrder-i;
-                if (delta > max_delta) {
-                    max_delta = delta;
-                }
-            }
+    // adjust the sample CTS/DTS offsets based on the sample orders
+    unsigned int start = 0;
+    for (unsigned int i=1; i<=sample_count; i++) {
+        if (i == sample_count || orders[i].m_DisplayOrder == 0) {
+            // we got to the end of the GOP, sort it by display order
+            SortSamples(&orders[start], i-start);
+            start = i;
         }
+    }
 
-        // set the CTS for all samples
-        for (unsigned int i=0; i<m_SampleOrders.ItemCount(); i++) {
-            AP4_UI64 dts = m_Samples[i].GetDts();
-            if (m_Timescale) {
-                dts = (AP4_UI64)((double)m_Timescale/m_FramesPerSecond*(double)(i+max_delta));
-            }
-            if (m_SampleOrders[i].m_DecodeOrder < m_Samples.ItemCount()) {
-                m_Samples[m_SampleOrders[i].m_DecodeOrder].SetCts(dts);
+    // compute the max CTS delta (in chunked mode, it is kept for the whole
+    // stream so that chunks with less reordering do not get overlapping CTS)
+    unsigned int max_delta = m_ChunkListener ? m_ReorderDelay : 0;
+    for (unsigned int i=0; i<sample_count; i++) {
+        if (orders[i].m_DecodeOrder > i) {
+            unsigned int delta = orders[i].m_DecodeOrder-i;
+            if (delta > max_delta) {
+                max_delta = delta;
             }
         }
-    
-        m_SampleOrders.Clear();
     }
+    if (m_ChunkListener) m_ReorderDelay = max_delta;
+
+    // set the CTS for all samples
+    for (unsigned int i=0; i<sample_count; i++) {
+        AP4_UI64 dts = m_Samples[first_sample+i].GetDts();
+        if (m_Timescale) {
+            dts = (AP4_UI64)((double)m_Timescale/m_FramesPerSecond*(double)(first_sample+i+max_delta));
+        }
+        if (orders[i].m_DecodeOrder < sample_count) {
+            m_Samples[first_sample+orders[i].m_DecodeOrder].SetCts(dts);
+        }
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_VideoSegmentBuilder::WriteMediaSegment
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_VideoSegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int sequence_number)
+{
+    AP4_Result result = AP4_SegmentBuilder::WriteMediaSegment(stream, sequence_number);
+    m_SampleOrders.Clear();
+    m_CompleteSampleCount = 0;
     
-    return AP4_SegmentBuilder::WriteMediaSegment(stream, sequence_number);
+    return result;
 }
 
 /*----------------------------------------------------------------------
@@ -414,14 +601,14 @@ AP4_AvcSegmentBuilder::Feed(const void* data,
             dts      = (AP4_UI64)((double)m_Timescale/m_FramesPerSecond*(double)m_Samples.ItemCount());
         }
 
+        // remember the sample order (before adding the sample, which may emit a chunk)
+        AddSampleOrder(access_unit_info.decode_order, access_unit_info.display_order);
+        
         // create a new sample and add it to the list
         AP4_Sample sample(*sample_data, 0, sample_data_size, duration, 0, dts, 0, access_unit_info.is_idr);
         AddSample(sample);
         sample_data->Release();
         
-        // remember the sample order
-        m_SampleOrders.Append(SampleOrder(access_unit_info.decode_order, access_unit_info.display_order));
-        
         // free the memory buffers
         for (unsigned int i=0; i<access_unit_info.nal_units.ItemCount(); i++) {
             delete access_unit_info.nal_units[i];
@@ -548,14 +735,14 @@ AP4_HevcSegmentBuilder::Feed(const void* data,
             dts      = (AP4_UI64)((double)m_Timescale/m_FramesPerSecond*(double)m_Samples.ItemCount());
         }
 
+        // remember the sample order (before adding the sample, which may emit a chunk)
+        AddSampleOrder(access_unit_info.decode_order, access_unit_info.display_order);
+        
         // create a new sample and add it to the list
         AP4_Sample sample(*sample_data, 0, sample_data_size, duration, 0, dts, 0, access_unit_info.is_random_access);
         AddSample(sample);
         sample_data->Release();
         
-        // remember the sample order
-        m_SampleOrders.Append(SampleOrder(access_unit_info.decode_order, access_unit_info.display_order));
-        
         // free the memory buffers
         for (unsigned int i=0; i<access_unit_info.nal_units.ItemCount(); i++) {
             delete access_unit_info.nal_units[i];
@@ -812,7 +999,7 @@ AP4_AacSegmentBuilder::WriteInitSegment(AP4_ByteStream& stream)
     delete ftyp;
     
     // write the moov atom
-    result = output_movie->GetMoovAtom()->Write(stream);
+    result = output_movie->GetMoovAtom()->WriteBuffered(stream);
     
     // cleanup
     delete output_movie;
@@ -54,6 +54,36 @@ class AP4_MpegAudioSampleDescription;
 class AP4_SegmentBuilder
 {
 public:
+    // types
+    /**
+     * Information about a chunk (a moof+mdat pair holding part of a
+     * segment) emitted in chunked mode.
+     */
+    struct ChunkInfo {
+        unsigned int m_SequenceNumber; // moof sequence number of the chunk
+        unsigned int m_ChunkIndex;     // index of the chunk within its segment
+        unsigned int m_SampleCount;
+        AP4_UI64     m_MediaStartTime; // decode time of the first sample, in the media timescale
+        AP4_UI64     m_MediaDuration;  // in the media timescale
+        bool         m_IsIndependent;  // true if the first sample is a sync sample
+        AP4_UI64     m_LatencyUs;      // time between the first sample being added and the chunk being ready
+        AP4_UI64     m_BuildTimeUs;    // time spent serializing the chunk
+    };
+    
+    // classes
+    /**
+     * Interface implemented by objects that want to receive chunks as
+     * soon as they are ready, for low-latency (CMAF chunked) delivery.
+     */
+    class ChunkListener {
+    public:
+        virtual ~ChunkListener() {}
+        virtual AP4_Result OnChunk(AP4_SegmentBuilder& builder,
+                                   const ChunkInfo&    info,
+                                   const AP4_UI08*     chunk_data,
+                                   AP4_Size            chunk_data_size) = 0;
+    };
+    
     // constructor and destructor
     AP4_SegmentBuilder(AP4_Track::Type track_type,
                        AP4_UI32        track_id,
@@ -73,8 +103,49 @@ public:
     virtual AP4_Result WriteMediaSegment(AP4_ByteStream& stream, unsigned int sequence_number);
     virtual AP4_Result WriteInitSegment(AP4_ByteStream& stream) = 0;
     
+    /**
+     * Enable chunked mode: a chunk is emitted to the listener each time
+     * max_chunk_samples samples have been added, or when the samples added
+     * since the last chunk span at least max_chunk_duration_ms (a value of
+     * 0 disables the corresponding limit).
+     * Chunks are only cut where the timestamps of the samples are final,
+     * so a chunk never splits a group of reordered video frames, and may
+     * therefore be emitted a few samples after a limit has been reached.
+     * In chunked mode, each chunk has its own moof sequence number, starting
+     * at first_sequence_number, and WriteMediaSegment emits the remaining
+     * samples as a final chunk, numbered sequence_number, then writes all
+     * the chunks of the segment to the stream. Since sequence numbers must
+     * increase, WriteMediaSegment fails with AP4_ERROR_INVALID_PARAMETERS
+     * if sequence_number is lower than the next chunk sequence number.
+     */
+    AP4_Result EnableChunks(ChunkListener* listener,
+                            unsigned int   max_chunk_samples,
+                            unsigned int   max_chunk_duration_ms,
+                            unsigned int   first_sequence_number = 1);
+    
+    /**
+     * Emit a chunk with the samples added since the last chunk whose
+     * timestamps are final, if any.
+     */
+    AP4_Result FlushChunk();
+    
 protected:
     // methods
+    virtual void AdjustTimestamps(unsigned int /* first_sample */, unsigned int /* sample_count */) {}
+    /**
+     * Number of samples, from the start of the segment, whose timestamps
+     * no longer depend on samples that have not been added yet.
+     */
+    virtual unsigned int GetCompleteSampleCount() { return m_Samples.ItemCount(); }
+    AP4_Result   EmitChunk(unsigned int sample_count);
+    AP4_Result   WriteFragment(AP4_ByteStream& stream,
+                               unsigned int    sequence_number,
+                               unsigned int    first_sample,
+                               unsigned int    sample_count,
+                               AP4_UI64        decode_time,
+                               bool            independent);
+    
+    // members
     AP4_Track::Type       m_TrackType;
     AP4_UI32              m_TrackId;
     AP4_String            m_TrackLanguage;
@@ -84,6 +155,17 @@ protected:
     AP4_UI64              m_MediaStartTime;
     AP4_UI64              m_MediaDuration;
     AP4_Array<AP4_Sample> m_Samples;
+    
+    // chunked mode
+    ChunkListener*        m_ChunkListener;
+    unsigned int          m_ChunkMaxSamples;
+    unsigned int          m_ChunkMaxDurationMs;
+    unsigned int          m_ChunkSequenceNumber;
+    unsigned int          m_ChunkIndex;
+    unsigned int          m_ChunkFirstSample;     // index of the first sample not yet in a chunk
+    AP4_UI64              m_ChunkMediaStartTime;  // relative to m_MediaStartTime
+    AP4_Array<AP4_UI64>   m_SampleTimesUs;        // when each sample of the segment was added
+    AP4_DataBuffer        m_SegmentData;          // chunks emitted so far for the current segment
 };
 
 /*----------------------------------------------------------------------
@@ -127,7 +209,12 @@ protected:
         AP4_UI32 m_DisplayOrder;
     };
     
+    // AP4_SegmentBuilder methods
+    virtual void         AdjustTimestamps(unsigned int first_sample, unsigned int sample_count);
+    virtual unsigned int GetCompleteSampleCount() { return m_CompleteSampleCount; }
+    
     // methods
+    void AddSampleOrder(AP4_UI32 decode_order, AP4_UI32 display_order);
     void SortSamples(SampleOrder* array, unsigned int n);
     AP4_Result WriteVideoInitSegment(AP4_ByteStream&        stream,
                                      AP4_SampleDescription* sample_description,
@@ -138,6 +225,9 @@ protected:
     // members
     double                 m_FramesPerSecond;
     AP4_Array<SampleOrder> m_SampleOrders;
+    unsigned int           m_CompleteSampleCount; // samples that form complete reorder groups
+    AP4_UI32               m_MaxDisplayOrder;     // since the start of the GOP
+    unsigned int           m_ReorderDelay;        // in frames, kept across chunks in chunked mode
 };
 
 /*----------------------------------------------------------------------
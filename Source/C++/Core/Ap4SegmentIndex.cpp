@@ -0,0 +1,619 @@
+/*****************************************************************
+|
+|    AP4 - Segment Index
+|
+|    Copyright 2002-2014 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4SegmentIndex.h"
+#include "Ap4ByteStream.h"
+#include "Ap4AtomFactory.h"
+#include "Ap4ContainerAtom.h"
+#include "Ap4MoovAtom.h"
+#include "Ap4TrakAtom.h"
+#include "Ap4TrexAtom.h"
+#include "Ap4TfhdAtom.h"
+#include "Ap4TfdtAtom.h"
+#include "Ap4TrunAtom.h"
+#include "Ap4SidxAtom.h"
+#include "Ap4TfraAtom.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_Size AP4_SEGMENT_INDEX_MFRO_SIZE = 16;
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndexBuilder
++---------------------------------------------------------------------*/
+class AP4_SegmentIndexBuilder
+{
+public:
+    AP4_SegmentIndexBuilder(AP4_UI32 track_id);
+
+    // methods
+    AP4_Result Build(AP4_ByteStream& input);
+    AP4_Result ProcessMoov(AP4_MoovAtom& moov);
+    bool       ProcessSidx(AP4_SidxAtom& sidx, AP4_Position sidx_end);
+    bool       ProcessMfra(AP4_ByteStream& input, AP4_LargeSize input_size);
+    bool       GetFragmentTiming(AP4_ContainerAtom& moof,
+                                 bool&              has_decode_time,
+                                 AP4_UI64&          decode_time,
+                                 AP4_SI64&          presentation_offset,
+                                 AP4_UI64&          duration);
+    void       AddEntry(AP4_UI64 start_time, AP4_UI64 offset, AP4_UI64 size, AP4_UI64 duration);
+    void       Serialize(AP4_DataBuffer& data);
+
+    // members
+    AP4_DefaultAtomFactory m_AtomFactory;
+    AP4_UI32               m_TrackId;
+    AP4_UI32               m_TimeScale;
+    AP4_UI32               m_DefaultSampleDuration;
+    AP4_Cardinal           m_TrackCount;
+    AP4_UI64               m_InitOffset;
+    AP4_UI64               m_InitSize;
+    AP4_Cardinal           m_EntryCount;
+    AP4_DataBuffer         m_Entries;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndexBuilder::AP4_SegmentIndexBuilder
++---------------------------------------------------------------------*/
+AP4_SegmentIndexBuilder::AP4_SegmentIndexBuilder(AP4_UI32 track_id) :
+    m_TrackId(track_id),
+    m_TimeScale(0),
+    m_DefaultSampleDuration(0),
+    m_TrackCount(0),
+    m_InitOffset(0),
+    m_InitSize(0),
+    m_EntryCount(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndexBuilder::AddEntry
++---------------------------------------------------------------------*/
+void
+AP4_SegmentIndexBuilder::AddEntry(AP4_UI64 start_time, AP4_UI64 offset, AP4_UI64 size, AP4_UI64 duration)
+{
+    AP4_Size data_size = m_Entries.GetDataSize();
+    m_Entries.Reserve(data_size+AP4_SEGMENT_INDEX_ENTRY_SIZE);
+    m_Entries.SetDataSize(data_size+AP4_SEGMENT_INDEX_ENTRY_SIZE);
+    AP4_UI08* entry = m_Entries.UseData()+data_size;
+    AP4_BytesFromUInt64BE(entry,    start_time);
+    AP4_BytesFromUInt64BE(entry+8,  offset);
+    AP4_BytesFromUInt64BE(entry+16, size);
+    AP4_BytesFromUInt64BE(entry+24, duration);
+    ++m_EntryCount;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndexBuilder::Serialize
++---------------------------------------------------------------------*/
+void
+AP4_SegmentIndexBuilder::Serialize(AP4_DataBuffer& data)
+{
+    data.SetDataSize(AP4_SEGMENT_INDEX_HEADER_SIZE+m_Entries.GetDataSize());
+    AP4_UI08* header = data.UseData();
+    AP4_BytesFromUInt32BE(header,    AP4_SEGMENT_INDEX_MAGIC);
+    AP4_BytesFromUInt32BE(header+4,  AP4_SEGMENT_INDEX_VERSION);
+    AP4_BytesFromUInt32BE(header+8,  m_TrackId);
+    AP4_BytesFromUInt32BE(header+12, m_TimeScale);
+    AP4_BytesFromUInt64BE(header+16, m_InitOffset);
+    AP4_BytesFromUInt64BE(header+24, m_InitSize);
+    AP4_BytesFromUInt32BE(header+32, m_EntryCount);
+    AP4_BytesFromUInt32BE(header+36, AP4_SEGMENT_INDEX_ENTRY_SIZE);
+    if (m_Entries.GetDataSize()) {
+        AP4_CopyMemory(header+AP4_SEGMENT_INDEX_HEADER_SIZE, m_Entries.GetData(), m_Entries.GetDataSize());
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndexBuilder::ProcessMoov
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentIndexBuilder::ProcessMoov(AP4_MoovAtom& moov)
+{
+    // find the track
+    AP4_TrakAtom* trak = NULL;
+    for (AP4_List<AP4_TrakAtom>::Item* item = moov.GetTrakAtoms().FirstItem(); item; item = item->GetNext()) {
+        if (m_TrackId == 0 || item->GetData()->GetId() == m_TrackId) {
+            trak = item->GetData();
+            break;
+        }
+    }
+    if (trak == NULL) return AP4_ERROR_NO_SUCH_ITEM;
+    m_TrackId    = trak->GetId();
+    m_TimeScale  = trak->GetMediaTimeScale();
+    m_TrackCount = moov.GetTrakAtoms().ItemCount();
+
+    // find the fragment defaults for the track
+    AP4_ContainerAtom* mvex = AP4_DYNAMIC_CAST(AP4_ContainerAtom, moov.GetChild(AP4_ATOM_TYPE_MVEX));
+    if (mvex == NULL) return AP4_ERROR_INVALID_FORMAT; // not a fragmented file
+    for (AP4_List<AP4_Atom>::Item* item = mvex->GetChildren().FirstItem(); item; item = item->GetNext()) {
+        AP4_TrexAtom* trex = AP4_DYNAMIC_CAST(AP4_TrexAtom, item->GetData());
+        if (trex && trex->GetTrackId() == m_TrackId) {
+            m_DefaultSampleDuration = trex->GetDefaultSampleDuration();
+        }
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndexBuilder::ProcessSidx
++---------------------------------------------------------------------*/
+bool
+AP4_SegmentIndexBuilder::ProcessSidx(AP4_SidxAtom& sidx, AP4_Position sidx_end)
+{
+    // only single-level indexes for our track can be used as-is
+    if (sidx.GetReferenceId() != m_TrackId || sidx.GetTimeScale() == 0) return false;
+    const AP4_Array<AP4_SidxAtom::Reference>& references = sidx.GetReferences();
+    for (unsigned int i=0; i<references.ItemCount(); i++) {
+        if (references[i].m_ReferenceType != 0) return false;
+    }
+
+    m_TimeScale = sidx.GetTimeScale();
+    AP4_UI64 offset = sidx_end+sidx.GetFirstOffset();
+    AP4_UI64 time   = sidx.GetEarliestPresentationTime();
+    for (unsigned int i=0; i<references.ItemCount(); i++) {
+        AddEntry(time, offset, references[i].m_ReferencedSize, references[i].m_SubsegmentDuration);
+        offset += references[i].m_ReferencedSize;
+        time   += references[i].m_SubsegmentDuration;
+    }
+
+    return true;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndexBuilder::GetFragmentTiming
++---------------------------------------------------------------------*/
+bool
+AP4_SegmentIndexBuilder::GetFragmentTiming(AP4_ContainerAtom& moof,
+                                           bool&              has_decode_time,
+                                           AP4_UI64&          decode_time,
+                                           AP4_SI64&          presentation_offset,
+                                           AP4_UI64&          duration)
+{
+    has_decode_time     = false;
+    decode_time         = 0;
+    presentation_offset = 0;
+    duration            = 0;
+    for (unsigned int i=0; ; i++) {
+        AP4_ContainerAtom* traf = AP4_DYNAMIC_CAST(AP4_ContainerAtom, moof.GetChild(AP4_ATOM_TYPE_TRAF, i));
+        if (traf == NULL) return false;
+        AP4_TfhdAtom* tfhd = AP4_DYNAMIC_CAST(AP4_TfhdAtom, traf->GetChild(AP4_ATOM_TYPE_TFHD));
+        if (tfhd == NULL || tfhd->GetTrackId() != m_TrackId) continue;
+
+        AP4_TfdtAtom* tfdt = AP4_DYNAMIC_CAST(AP4_TfdtAtom, traf->GetChild(AP4_ATOM_TYPE_TFDT));
+        if (tfdt) {
+            has_decode_time = true;
+            decode_time     = tfdt->GetBaseMediaDecodeTime();
+        }
+        AP4_UI32 default_sample_duration = m_DefaultSampleDuration;
+        if (tfhd->GetFlags() & AP4_TFHD_FLAG_DEFAULT_SAMPLE_DURATION_PRESENT) {
+            default_sample_duration = tfhd->GetDefaultSampleDuration();
+        }
+        // the earliest presentation time is relative to the decode time
+        bool have_presentation_offset = false;
+        for (AP4_List<AP4_Atom>::Item* item = traf->GetChildren().FirstItem(); item; item = item->GetNext()) {
+            AP4_TrunAtom* trun = AP4_DYNAMIC_CAST(AP4_TrunAtom, item->GetData());
+            if (trun == NULL) continue;
+            const AP4_Array<AP4_TrunAtom::Entry>& entries = trun->GetEntries();
+            bool has_durations = (trun->GetFlags() & AP4_TRUN_FLAG_SAMPLE_DURATION_PRESENT) != 0;
+            bool has_offsets   = (trun->GetFlags() & AP4_TRUN_FLAG_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) != 0;
+            for (unsigned int j=0; j<entries.ItemCount(); j++) {
+                AP4_SI64 offset = 0;
+                if (has_offsets) {
+                    // offsets are signed in version 1
+                    offset = trun->GetVersion() ?
+                             (AP4_SI64)(AP4_SI32)entries[j].sample_composition_time_offset :
+                             (AP4_SI64)entries[j].sample_composition_time_offset;
+                }
+                AP4_SI64 presentation = (AP4_SI64)duration+offset;
+                if (!have_presentation_offset || presentation < presentation_offset) {
+                    presentation_offset      = presentation;
+                    have_presentation_offset = true;
+                }
+                duration += has_durations ? entries[j].sample_duration : default_sample_duration;
+            }
+        }
+        return true;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndexBuilder::ProcessMfra
++---------------------------------------------------------------------*/
+bool
+AP4_SegmentIndexBuilder::ProcessMfra(AP4_ByteStream& input, AP4_LargeSize input_size)
+{
+    // with more than one track, the fragments of the other tracks may be
+    // interleaved between the random access points
+    if (m_TrackCount != 1) return false;
+
+    // look for an mfro atom at the end of the stream
+    if (input_size < AP4_SEGMENT_INDEX_MFRO_SIZE) return false;
+    AP4_UI08 mfro[AP4_SEGMENT_INDEX_MFRO_SIZE];
+    if (AP4_FAILED(input.Seek(input_size-AP4_SEGMENT_INDEX_MFRO_SIZE))) return false;
+    if (AP4_FAILED(input.Read(mfro, AP4_SEGMENT_INDEX_MFRO_SIZE)))      return false;
+    if (AP4_BytesToUInt32BE(mfro)   != AP4_SEGMENT_INDEX_MFRO_SIZE ||
+        AP4_BytesToUInt32BE(mfro+4) != AP4_ATOM_TYPE_MFRO) {
+        return false;
+    }
+    AP4_UI32 mfra_size = AP4_BytesToUInt32BE(mfro+12);
+    if (mfra_size > input_size) return false;
+    AP4_Position mfra_position = input_size-mfra_size;
+
+    // parse the mfra atom and find the tfra atom for our track
+    AP4_Atom* atom = NULL;
+    if (AP4_FAILED(input.Seek(mfra_position))) return false;
+    if (AP4_FAILED(m_AtomFactory.CreateAtomFromStream(input, atom))) return false;
+    AP4_ContainerAtom* mfra = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+    AP4_TfraAtom* tfra = NULL;
+    if (mfra && mfra->GetType() == AP4_ATOM_TYPE_MFRA) {
+        for (AP4_List<AP4_Atom>::Item* item = mfra->GetChildren().FirstItem(); item; item = item->GetNext()) {
+            AP4_TfraAtom* candidate = AP4_DYNAMIC_CAST(AP4_TfraAtom, item->GetData());
+            if (candidate && candidate->GetTrackId() == m_TrackId) {
+                tfra = candidate;
+                break;
+            }
+        }
+    }
+    bool done = false;
+    if (tfra && tfra->GetEntries().ItemCount()) {
+        // keep one random access point per moof (tfra times are
+        // presentation times, like the ones we compute for moof atoms)
+        AP4_Array<AP4_TfraAtom::Entry>& entries = tfra->GetEntries();
+        AP4_Array<AP4_TfraAtom::Entry>  points;
+        for (unsigned int i=0; i<entries.ItemCount(); i++) {
+            if (points.ItemCount() && points[points.ItemCount()-1].m_MoofOffset >= entries[i].m_MoofOffset) {
+                continue;
+            }
+            points.Append(entries[i]);
+        }
+
+        // the duration of the last fragment is obtained from its moof
+        AP4_TfraAtom::Entry& last = points[points.ItemCount()-1];
+        AP4_Atom* last_moof = NULL;
+        if (last.m_MoofOffset < mfra_position &&
+            AP4_SUCCEEDED(input.Seek(last.m_MoofOffset)) &&
+            AP4_SUCCEEDED(m_AtomFactory.CreateAtomFromStream(input, last_moof))) {
+            AP4_ContainerAtom* moof = AP4_DYNAMIC_CAST(AP4_ContainerAtom, last_moof);
+            bool     has_decode_time = false;
+            AP4_UI64 decode_time = 0;
+            AP4_SI64 presentation_offset = 0;
+            AP4_UI64 last_duration = 0;
+            if (moof && moof->GetType() == AP4_ATOM_TYPE_MOOF &&
+                GetFragmentTiming(*moof, has_decode_time, decode_time, presentation_offset, last_duration)) {
+                for (unsigned int i=0; i<points.ItemCount(); i++) {
+                    AP4_UI64 end_offset = i+1 < points.ItemCount() ? points[i+1].m_MoofOffset : mfra_position;
+                    AP4_UI64 end_time   = i+1 < points.ItemCount() ? points[i+1].m_Time : points[i].m_Time+last_duration;
+                    AddEntry(points[i].m_Time,
+                             points[i].m_MoofOffset,
+                             end_offset-points[i].m_MoofOffset,
+                             end_time > points[i].m_Time ? end_time-points[i].m_Time : 0);
+                }
+                done = true;
+            }
+            delete last_moof;
+        }
+    }
+    delete atom;
+
+    return done;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndexBuilder::Build
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentIndexBuilder::Build(AP4_ByteStream& input)
+{
+    AP4_LargeSize input_size = 0;
+    AP4_Result result = input.GetSize(input_size);
+    if (AP4_FAILED(result)) return result;
+
+    bool         have_moov       = false;
+    bool         mfra_checked    = false;
+    bool         entry_open      = false;
+    AP4_UI64     entry_time      = 0;
+    AP4_UI64     entry_duration  = 0;
+    AP4_Position entry_offset    = 0;
+    AP4_Position entry_end       = 0;
+    AP4_UI64     next_decode_time = 0;
+    AP4_Position position        = 0;
+    while (position+8 <= input_size) {
+        // read the atom header
+        AP4_UI32 size32 = 0;
+        AP4_UI32 type   = 0;
+        AP4_UI64 size   = 0;
+        result = input.Seek(position);
+        if (AP4_SUCCEEDED(result)) result = input.ReadUI32(size32);
+        if (AP4_SUCCEEDED(result)) result = input.ReadUI32(type);
+        if (AP4_FAILED(result)) return result;
+        if (size32 == 1) {
+            result = input.ReadUI64(size);
+            if (AP4_FAILED(result)) return result;
+        } else if (size32 == 0) {
+            size = input_size-position;
+        } else {
+            size = size32;
+        }
+        if (size < 8) return AP4_ERROR_INVALID_FORMAT;
+
+        if (type == AP4_ATOM_TYPE_MOOV || type == AP4_ATOM_TYPE_SIDX || type == AP4_ATOM_TYPE_MOOF) {
+            // close the current entry
+            if (entry_open && type == AP4_ATOM_TYPE_MOOF) {
+                AddEntry(entry_time, entry_offset, entry_end-entry_offset, entry_duration);
+                entry_open = false;
+            }
+
+            // parse the atom
+            AP4_Atom* atom = NULL;
+            result = input.Seek(position);
+            if (AP4_FAILED(result)) return result;
+            result = m_AtomFactory.CreateAtomFromStream(input, atom);
+            if (AP4_FAILED(result)) return result;
+            if (type == AP4_ATOM_TYPE_MOOV) {
+                AP4_MoovAtom* moov = AP4_DYNAMIC_CAST(AP4_MoovAtom, atom);
+                result = moov ? ProcessMoov(*moov) : AP4_ERROR_INVALID_FORMAT;
+                have_moov    = true;
+                m_InitOffset = 0;
+                m_InitSize   = position+size;
+            } else if (!have_moov) {
+                result = AP4_ERROR_INVALID_FORMAT;
+            } else if (type == AP4_ATOM_TYPE_SIDX) {
+                AP4_SidxAtom* sidx = AP4_DYNAMIC_CAST(AP4_SidxAtom, atom);
+                if (sidx && m_EntryCount == 0 && !entry_open && ProcessSidx(*sidx, position+size)) {
+                    delete atom;
+                    return AP4_SUCCESS;
+                }
+            } else {
+                // use the mfra atom if there is one, or index each fragment
+                if (!mfra_checked) {
+                    mfra_checked = true;
+                    if (ProcessMfra(input, input_size)) {
+                        delete atom;
+                        return AP4_SUCCESS;
+                    }
+                }
+                AP4_ContainerAtom* moof = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+                bool     has_decode_time = false;
+                AP4_UI64 decode_time = 0;
+                AP4_SI64 presentation_offset = 0;
+                if (moof && GetFragmentTiming(*moof, has_decode_time, decode_time, presentation_offset, entry_duration)) {
+                    if (!has_decode_time) decode_time = next_decode_time;
+                    next_decode_time = decode_time+entry_duration;
+                    if (presentation_offset < 0 && (AP4_UI64)(-presentation_offset) > decode_time) {
+                        entry_time = 0;
+                    } else {
+                        entry_time = (AP4_UI64)((AP4_SI64)decode_time+presentation_offset);
+                    }
+                    entry_offset = position;
+                    entry_end    = position+size;
+                    entry_open   = true;
+                }
+            }
+            delete atom;
+            if (AP4_FAILED(result)) return result;
+        } else if (type == AP4_ATOM_TYPE_MDAT && entry_open) {
+            entry_end = position+size;
+        }
+
+        position += size;
+    }
+    if (entry_open) {
+        AddEntry(entry_time, entry_offset, entry_end-entry_offset, entry_duration);
+    }
+    if (!have_moov) return AP4_ERROR_INVALID_FORMAT;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex::AP4_SegmentIndex
++---------------------------------------------------------------------*/
+AP4_SegmentIndex::AP4_SegmentIndex() :
+    m_Data(NULL),
+    m_DataSize(0),
+    m_TrackId(0),
+    m_TimeScale(0),
+    m_InitOffset(0),
+    m_InitSize(0),
+    m_EntryCount(0),
+    m_EntrySize(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex::Create
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentIndex::Create(AP4_ByteStream& input, AP4_UI32 track_id, AP4_SegmentIndex*& index)
+{
+    index = NULL;
+    AP4_SegmentIndexBuilder builder(track_id);
+    AP4_Result result = builder.Build(input);
+    if (AP4_FAILED(result)) return result;
+
+    AP4_SegmentIndex* segment_index = new AP4_SegmentIndex();
+    builder.Serialize(segment_index->m_Storage);
+    result = segment_index->Parse(segment_index->m_Storage.GetData(), segment_index->m_Storage.GetDataSize());
+    if (AP4_FAILED(result)) {
+        delete segment_index;
+        return result;
+    }
+    index = segment_index;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex::Load
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentIndex::Load(AP4_ByteStream& stream, AP4_SegmentIndex*& index)
+{
+    index = NULL;
+    AP4_LargeSize size = 0;
+    AP4_Result result = stream.GetSize(size);
+    if (AP4_FAILED(result)) return result;
+    AP4_Position position = 0;
+    stream.Tell(position);
+    if (position > size || size-position > 0x7FFFFFFF) return AP4_ERROR_INVALID_FORMAT;
+
+    AP4_SegmentIndex* segment_index = new AP4_SegmentIndex();
+    AP4_Size data_size = (AP4_Size)(size-position);
+    segment_index->m_Storage.SetDataSize(data_size);
+    result = stream.Read(segment_index->m_Storage.UseData(), data_size);
+    if (AP4_SUCCEEDED(result)) {
+        result = segment_index->Parse(segment_index->m_Storage.GetData(), data_size);
+    }
+    if (AP4_FAILED(result)) {
+        delete segment_index;
+        return result;
+    }
+    index = segment_index;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex::Attach
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentIndex::Attach(const AP4_UI08* data, AP4_Size data_size, AP4_SegmentIndex*& index)
+{
+    index = NULL;
+    AP4_SegmentIndex* segment_index = new AP4_SegmentIndex();
+    AP4_Result result = segment_index->Parse(data, data_size);
+    if (AP4_FAILED(result)) {
+        delete segment_index;
+        return result;
+    }
+    index = segment_index;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex::Parse
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentIndex::Parse(const AP4_UI08* data, AP4_Size data_size)
+{
+    if (data == NULL || data_size < AP4_SEGMENT_INDEX_HEADER_SIZE) return AP4_ERROR_INVALID_FORMAT;
+    if (AP4_BytesToUInt32BE(data)   != AP4_SEGMENT_INDEX_MAGIC)   return AP4_ERROR_INVALID_FORMAT;
+    if (AP4_BytesToUInt32BE(data+4) != AP4_SEGMENT_INDEX_VERSION) return AP4_ERROR_NOT_SUPPORTED;
+
+    AP4_Cardinal entry_count = AP4_BytesToUInt32BE(data+32);
+    AP4_Size     entry_size  = AP4_BytesToUInt32BE(data+36);
+    if (entry_size < AP4_SEGMENT_INDEX_ENTRY_SIZE) return AP4_ERROR_INVALID_FORMAT;
+    if ((AP4_UI64)entry_count*entry_size > data_size-AP4_SEGMENT_INDEX_HEADER_SIZE) {
+        return AP4_ERROR_INVALID_FORMAT;
+    }
+
+    m_Data       = data;
+    m_DataSize   = data_size;
+    m_TrackId    = AP4_BytesToUInt32BE(data+8);
+    m_TimeScale  = AP4_BytesToUInt32BE(data+12);
+    m_InitOffset = AP4_BytesToUInt64BE(data+16);
+    m_InitSize   = AP4_BytesToUInt64BE(data+24);
+    m_EntryCount = entry_count;
+    m_EntrySize  = entry_size;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex::GetEntryStartTime
++---------------------------------------------------------------------*/
+AP4_UI64
+AP4_SegmentIndex::GetEntryStartTime(AP4_Ordinal index) const
+{
+    return AP4_BytesToUInt64BE(m_Data+AP4_SEGMENT_INDEX_HEADER_SIZE+index*m_EntrySize);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex::GetEntry
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentIndex::GetEntry(AP4_Ordinal index, Entry& entry) const
+{
+    if (index >= m_EntryCount) return AP4_ERROR_OUT_OF_RANGE;
+    const AP4_UI08* data = m_Data+AP4_SEGMENT_INDEX_HEADER_SIZE+index*m_EntrySize;
+    entry.m_StartTime = AP4_BytesToUInt64BE(data);
+    entry.m_Offset    = AP4_BytesToUInt64BE(data+8);
+    entry.m_Size      = AP4_BytesToUInt64BE(data+16);
+    entry.m_Duration  = AP4_BytesToUInt64BE(data+24);
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex::FindEntry
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentIndex::FindEntry(AP4_UI64 time, AP4_Ordinal& index) const
+{
+    index = 0;
+    if (m_EntryCount == 0) return AP4_ERROR_OUT_OF_RANGE;
+
+    // find the last entry that starts at or before the time
+    AP4_Ordinal low  = 0;
+    AP4_Ordinal high = m_EntryCount;
+    while (high-low > 1) {
+        AP4_Ordinal middle = low+(high-low)/2;
+        if (GetEntryStartTime(middle) <= time) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    // check that the time is not past the end of the last entry
+    if (low == m_EntryCount-1) {
+        Entry last;
+        if (AP4_FAILED(GetEntry(low, last)) || time >= last.m_StartTime+last.m_Duration) {
+            return AP4_ERROR_OUT_OF_RANGE;
+        }
+    }
+    index = low;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex::Write
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentIndex::Write(AP4_ByteStream& stream) const
+{
+    return stream.Write(m_Data, AP4_SEGMENT_INDEX_HEADER_SIZE+m_EntryCount*m_EntrySize);
+}
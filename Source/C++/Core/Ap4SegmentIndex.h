@@ -0,0 +1,148 @@
+/*****************************************************************
+|
+|    AP4 - Segment Index
+|
+|    Copyright 2002-2014 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_SEGMENT_INDEX_H_
+#define _AP4_SEGMENT_INDEX_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+#include "Ap4Atom.h"
+#include "Ap4DataBuffer.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ByteStream;
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_UI32 AP4_SEGMENT_INDEX_MAGIC       = AP4_ATOM_TYPE('B','4','S','I');
+const AP4_UI32 AP4_SEGMENT_INDEX_VERSION     = 1;
+const AP4_Size AP4_SEGMENT_INDEX_HEADER_SIZE = 40;
+const AP4_Size AP4_SEGMENT_INDEX_ENTRY_SIZE  = 32;
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentIndex
++---------------------------------------------------------------------*/
+/**
+ * Compact index of the fragments (moof+mdat) of a fragmented MP4 file,
+ * for serving segments by byte range without reading the MP4 file.
+ *
+ * The serialized form is designed to be used in place (for example from
+ * a memory-mapped file), all values being big-endian:
+ *   header (40 bytes):
+ *     magic ('B4SI'), version, track ID, timescale      : 4 x UI32
+ *     init segment offset, init segment size            : 2 x UI64
+ *     entry count, entry size                           : 2 x UI32
+ *   entries (entry size bytes each, sorted by time):
+ *     start time (in the index timescale), byte offset  : 2 x UI64
+ *     byte size, duration (in the index timescale)      : 2 x UI64
+ * Readers must use the entry size from the header, so that fields can be
+ * appended to the entries in later versions.
+ *
+ * The start time of an entry is the earliest presentation time of its
+ * samples (decode time plus composition offset, on the media timeline,
+ * without applying edit lists), which is the time used by sidx atoms
+ * and tfra atoms. When the index is built by scanning the moof atoms, it
+ * is computed from the tfdt and trun atoms of the fragments.
+ */
+class AP4_SegmentIndex
+{
+public:
+    // types
+    struct Entry {
+        AP4_UI64 m_StartTime;
+        AP4_UI64 m_Offset;
+        AP4_UI64 m_Size;
+        AP4_UI64 m_Duration;
+    };
+
+    // class methods
+    /**
+     * Build an index for a fragmented MP4 file. The index is built from
+     * the file's sidx atom if it has one, or from the tfra atom of its mfra
+     * atom for single-track files, and by scanning the moof atoms otherwise.
+     * A track_id of 0 means the first track.
+     */
+    static AP4_Result Create(AP4_ByteStream& input, AP4_UI32 track_id, AP4_SegmentIndex*& index);
+
+    /**
+     * Load a serialized index from a stream.
+     */
+    static AP4_Result Load(AP4_ByteStream& stream, AP4_SegmentIndex*& index);
+
+    /**
+     * Use a serialized index in place. The data is not copied, so it must
+     * remain valid for the lifetime of the index object.
+     */
+    static AP4_Result Attach(const AP4_UI08* data, AP4_Size data_size, AP4_SegmentIndex*& index);
+
+    // methods
+    AP4_UI32     GetTrackId()    const { return m_TrackId;    }
+    AP4_UI32     GetTimeScale()  const { return m_TimeScale;  }
+    AP4_UI64     GetInitOffset() const { return m_InitOffset; }
+    AP4_UI64     GetInitSize()   const { return m_InitSize;   }
+    AP4_Cardinal GetEntryCount() const { return m_EntryCount; }
+    AP4_Result   GetEntry(AP4_Ordinal index, Entry& entry) const;
+
+    /**
+     * Find the entry that contains a given time (in the index timescale),
+     * with a binary search. Times before the first entry map to the first
+     * entry, and AP4_ERROR_OUT_OF_RANGE is returned for times past the end.
+     */
+    AP4_Result FindEntry(AP4_UI64 time, AP4_Ordinal& index) const;
+
+    /**
+     * Write the serialized index to a stream.
+     */
+    AP4_Result Write(AP4_ByteStream& stream) const;
+
+private:
+    // constructor
+    AP4_SegmentIndex();
+
+    // methods
+    AP4_Result Parse(const AP4_UI08* data, AP4_Size data_size);
+    AP4_UI64   GetEntryStartTime(AP4_Ordinal index) const;
+
+    // members
+    AP4_DataBuffer  m_Storage; // used when the index owns its data
+    const AP4_UI08* m_Data;
+    AP4_Size        m_DataSize;
+    AP4_UI32        m_TrackId;
+    AP4_UI32        m_TimeScale;
+    AP4_UI64        m_InitOffset;
+    AP4_UI64        m_InitSize;
+    AP4_Cardinal    m_EntryCount;
+    AP4_Size        m_EntrySize;
+};
+
+#endif // _AP4_SEGMENT_INDEX_H_
@@ -164,12 +164,7 @@ AP4_StcoAtom::WriteFields(AP4_ByteStream& stream)
     if (AP4_FAILED(result)) return result;
 
     // entries
-    for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
-        result = stream.WriteUI32(m_Entries[i]);
-        if (AP4_FAILED(result)) return result;
-    }
-
-    return result;
+    return stream.WriteUI32Array(m_Entries, m_EntryCount);
 }
 
 /*----------------------------------------------------------------------
@@ -114,14 +114,18 @@ AP4_StscAtom::WriteFields(AP4_ByteStream& stream)
     // entry count
     AP4_Cardinal entry_count = m_Entries.ItemCount();
     result = stream.WriteUI32(entry_count);
+    if (AP4_FAILED(result)) return result;
 
-    // entries
-    for (AP4_Ordinal i=0; i<entry_count; i++) {
-        stream.WriteUI32(m_Entries[i].m_FirstChunk);
-        if (AP4_FAILED(result)) return result;
-        stream.WriteUI32(m_Entries[i].m_SamplesPerChunk);
-        if (AP4_FAILED(result)) return result;
-        stream.WriteUI32(m_Entries[i].m_SampleDescriptionIndex);
+    // entries, a block at a time
+    AP4_UI08 block[AP4_ATOM_TABLE_WRITE_BLOCK_SIZE];
+    for (AP4_Ordinal i=0; i<entry_count;) {
+        AP4_UI08* entry = block;
+        for (; i<entry_count && entry+12 <= block+sizeof(block); i++, entry += 12) {
+            AP4_BytesFromUInt32BE(entry,   m_Entries[i].m_FirstChunk);
+            AP4_BytesFromUInt32BE(entry+4, m_Entries[i].m_SamplesPerChunk);
+            AP4_BytesFromUInt32BE(entry+8, m_Entries[i].m_SampleDescriptionIndex);
+        }
+        result = stream.Write(block, (AP4_Size)(entry-block));
         if (AP4_FAILED(result)) return result;
     }
 
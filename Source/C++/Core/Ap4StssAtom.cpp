@@ -105,12 +105,8 @@ AP4_StssAtom::WriteFields(AP4_ByteStream& stream)
     if (AP4_FAILED(result)) return result;
 
     // entries
-    for (AP4_Ordinal i=0; i<entry_count; i++) {
-        result = stream.WriteUI32(m_Entries[i]);
-        if (AP4_FAILED(result)) return result;
-    }
-
-    return result;
+    if (entry_count == 0) return AP4_SUCCESS;
+    return stream.WriteUI32Array(&m_Entries[0], entry_count);
 }
 
 /*----------------------------------------------------------------------
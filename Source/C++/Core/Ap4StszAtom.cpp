@@ -119,11 +119,8 @@ AP4_StszAtom::WriteFields(AP4_ByteStream& stream)
     if (AP4_FAILED(result)) return result;
 
     // entries if needed (the samples have different sizes)
-    if (m_SampleSize == 0) {
-        for (AP4_UI32 i=0; i<m_SampleCount; i++) {
-            result = stream.WriteUI32(m_Entries[i]);
-            if (AP4_FAILED(result)) return result;
-        }
+    if (m_SampleSize == 0 && m_SampleCount) {
+        result = stream.WriteUI32Array(&m_Entries[0], m_SampleCount);
     }
 
     return result;
@@ -166,14 +166,15 @@ AP4_SttsAtom::WriteFields(AP4_ByteStream& stream)
     result = stream.WriteUI32(entry_count);
     if (AP4_FAILED(result)) return result;
 
-    // write the entries
-    for (AP4_Ordinal i=0; i<entry_count; i++) {
-        // sample count
-        result = stream.WriteUI32(m_Entries[i].m_SampleCount);
-        if (AP4_FAILED(result)) return result;
-
-        // time offset
-        result = stream.WriteUI32(m_Entries[i].m_SampleDuration);
+    // write the entries, a block at a time
+    AP4_UI08 block[AP4_ATOM_TABLE_WRITE_BLOCK_SIZE];
+    for (AP4_Ordinal i=0; i<entry_count;) {
+        AP4_UI08* entry = block;
+        for (; i<entry_count && entry+8 <= block+sizeof(block); i++, entry += 8) {
+            AP4_BytesFromUInt32BE(entry,   m_Entries[i].m_SampleCount);
+            AP4_BytesFromUInt32BE(entry+4, m_Entries[i].m_SampleDuration);
+        }
+        result = stream.Write(block, (AP4_Size)(entry-block));
         if (AP4_FAILED(result)) return result;
     }
 
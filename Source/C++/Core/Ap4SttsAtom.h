@@ -71,6 +71,7 @@ public:
     virtual AP4_Result GetSampleIndexForTimeStamp(AP4_UI64      ts, 
                                                   AP4_Ordinal&  sample_index);
     virtual AP4_Result WriteFields(AP4_ByteStream& stream);
+    const AP4_Array<AP4_SttsTableEntry>& GetEntries() { return m_Entries; }
 
 private:
     // methods
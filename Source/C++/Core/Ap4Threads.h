@@ -0,0 +1,124 @@
+/*****************************************************************
+|
+|    AP4 - Threads
+|
+|    Copyright 2002-2020 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_THREADS_H_
+#define _AP4_THREADS_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+#include "Ap4Results.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ThreadImpl;
+class AP4_MutexImpl;
+
+/*----------------------------------------------------------------------
+|   AP4_Runnable
++---------------------------------------------------------------------*/
+class AP4_Runnable
+{
+public:
+    virtual ~AP4_Runnable() {}
+    virtual void Run() = 0;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Thread
++---------------------------------------------------------------------*/
+/**
+ * Thread that runs the Run() method of a target object.
+ * The implementation is provided by the platform (System/Posix or
+ * System/Win32). The destructor waits for the thread to terminate.
+ */
+class AP4_Thread
+{
+public:
+    // class methods
+    /**
+     * Number of processors available to the process (at least 1).
+     */
+    static AP4_Cardinal GetProcessorCount();
+
+    // constructor and destructor
+    AP4_Thread(AP4_Runnable& target);
+    ~AP4_Thread();
+
+    // methods
+    AP4_Result Start();
+    AP4_Result Wait();
+
+private:
+    // members
+    AP4_ThreadImpl* m_Impl;
+
+    // not copyable
+    AP4_Thread(const AP4_Thread&);
+    AP4_Thread& operator=(const AP4_Thread&);
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex
++---------------------------------------------------------------------*/
+class AP4_Mutex
+{
+public:
+    // constructor and destructor
+    AP4_Mutex();
+    ~AP4_Mutex();
+
+    // methods
+    AP4_Result Lock();
+    AP4_Result Unlock();
+
+private:
+    // members
+    AP4_MutexImpl* m_Impl;
+
+    // not copyable
+    AP4_Mutex(const AP4_Mutex&);
+    AP4_Mutex& operator=(const AP4_Mutex&);
+};
+
+/*----------------------------------------------------------------------
+|   AP4_AutoLock
++---------------------------------------------------------------------*/
+class AP4_AutoLock
+{
+public:
+    AP4_AutoLock(AP4_Mutex& mutex) : m_Mutex(mutex) { m_Mutex.Lock(); }
+    ~AP4_AutoLock() { m_Mutex.Unlock(); }
+
+private:
+    AP4_Mutex& m_Mutex;
+};
+
+#endif // _AP4_THREADS_H_
@@ -258,23 +258,31 @@ AP4_TrunAtom::WriteFields(AP4_ByteStream& stream)
         if (AP4_FAILED(result)) return result;
     }
     AP4_UI32 sample_count = m_Entries.ItemCount();
-    for (unsigned int i=0; i<sample_count; i++) {
-        if (m_Flags & AP4_TRUN_FLAG_SAMPLE_DURATION_PRESENT) {
-            result = stream.WriteUI32(m_Entries[i].sample_duration);
-            if (AP4_FAILED(result)) return result;
-        }
-        if (m_Flags & AP4_TRUN_FLAG_SAMPLE_SIZE_PRESENT) {
-            result = stream.WriteUI32(m_Entries[i].sample_size);
-            if (AP4_FAILED(result)) return result;
-        }
-        if (m_Flags & AP4_TRUN_FLAG_SAMPLE_FLAGS_PRESENT) {
-            result = stream.WriteUI32(m_Entries[i].sample_flags);
-            if (AP4_FAILED(result)) return result;
-        }
-        if (m_Flags & AP4_TRUN_FLAG_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) {
-            stream.WriteUI32(m_Entries[i].sample_composition_time_offset);
-            if (AP4_FAILED(result)) return result;
+    AP4_UI08 block[AP4_ATOM_TABLE_WRITE_BLOCK_SIZE];
+    for (unsigned int i=0; i<sample_count;) {
+        // fill a block with as many entries as it can hold, then write it
+        AP4_UI08* entry = block;
+        for (; i<sample_count && entry+16 <= block+sizeof(block); i++) {
+            if (m_Flags & AP4_TRUN_FLAG_SAMPLE_DURATION_PRESENT) {
+                AP4_BytesFromUInt32BE(entry, m_Entries[i].sample_duration);
+                entry += 4;
+            }
+            if (m_Flags & AP4_TRUN_FLAG_SAMPLE_SIZE_PRESENT) {
+                AP4_BytesFromUInt32BE(entry, m_Entries[i].sample_size);
+                entry += 4;
+            }
+            if (m_Flags & AP4_TRUN_FLAG_SAMPLE_FLAGS_PRESENT) {
+                AP4_BytesFromUInt32BE(entry, m_Entries[i].sample_flags);
+                entry += 4;
+            }
+            if (m_Flags & AP4_TRUN_FLAG_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) {
+                AP4_BytesFromUInt32BE(entry, m_Entries[i].sample_composition_time_offset);
+                entry += 4;
+            }
         }
+        if (entry == block) break; // no fields per entry
+        result = stream.Write(block, (AP4_Size)(entry-block));
+        if (AP4_FAILED(result)) return result;
     }
     
     return AP4_SUCCESS;
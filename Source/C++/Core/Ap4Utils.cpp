@@ -29,9 +29,26 @@
 /*----------------------------------------------------------------------
 |   includes
 +---------------------------------------------------------------------*/
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
 #include "Ap4Utils.h"
 #include "Ap4Debug.h"
 
+/*----------------------------------------------------------------------
+|   SIMD support
++---------------------------------------------------------------------*/
+#if !defined(AP4_CONFIG_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define AP4_UTILS_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AP4_UTILS_USE_SSE2
+#endif
+#endif
+
 /*----------------------------------------------------------------------
 |   AP4_GlobalOptions::g_Entry
 +---------------------------------------------------------------------*/
@@ -183,6 +200,208 @@ AP4_ByteSwap16(unsigned char* bytes, unsigned int count) {
     }
 }
 
+/*----------------------------------------------------------------------
+|   AP4_BytesFromUInt32ArrayBE
++---------------------------------------------------------------------*/
+void
+AP4_BytesFromUInt32ArrayBE(unsigned char* bytes, const AP4_UI32* values, AP4_Cardinal count)
+{
+    AP4_Cardinal i = 0;
+
+    // the vector paths are only enabled on x86, which is little-endian
+#if defined(AP4_UTILS_USE_AVX2)
+    // swap 8 values at a time
+    const __m256i swap = _mm256_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12,
+                                          3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+    for (; i+8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(values+i));
+        _mm256_storeu_si256((__m256i*)(bytes+4*i), _mm256_shuffle_epi8(v, swap));
+    }
+#elif defined(AP4_UTILS_USE_SSE2)
+    // swap 4 values at a time: swap the bytes of each 16-bit word, then the words
+    for (; i+4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(values+i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+        _mm_storeu_si128((__m128i*)(bytes+4*i), v);
+    }
+#endif
+
+    // scalar conversion (and tail of the vector conversion)
+    for (; i<count; i++) {
+        AP4_BytesFromUInt32BE(bytes+4*i, values[i]);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_BytesFromUInt64ArrayBE
++---------------------------------------------------------------------*/
+void
+AP4_BytesFromUInt64ArrayBE(unsigned char* bytes, const AP4_UI64* values, AP4_Cardinal count)
+{
+    AP4_Cardinal i = 0;
+
+#if defined(AP4_UTILS_USE_AVX2)
+    // swap 4 values at a time
+    const __m256i swap = _mm256_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8,
+                                          7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8);
+    for (; i+4 <= count; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(values+i));
+        _mm256_storeu_si256((__m256i*)(bytes+8*i), _mm256_shuffle_epi8(v, swap));
+    }
+#elif defined(AP4_UTILS_USE_SSE2)
+    // swap 2 values at a time: swap the bytes of each 16-bit word, then reverse the words
+    for (; i+2 <= count; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(values+i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0,1,2,3));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0,1,2,3));
+        _mm_storeu_si128((__m128i*)(bytes+8*i), v);
+    }
+#endif
+
+    // scalar conversion (and tail of the vector conversion)
+    for (; i<count; i++) {
+        AP4_BytesFromUInt64BE(bytes+8*i, values[i]);
+    }
+}
+
+#if defined(AP4_UTILS_USE_AVX2) || defined(AP4_UTILS_USE_SSE2)
+/*----------------------------------------------------------------------
+|   AP4_Utils_LowestBitSet
++---------------------------------------------------------------------*/
+static inline unsigned int
+AP4_Utils_LowestBitSet(unsigned int mask)
+{
+    unsigned int bit = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+}
+#endif
+
+/*----------------------------------------------------------------------
+|   AP4_Utils_FindBytePattern
++---------------------------------------------------------------------*/
+static inline AP4_Size
+AP4_Utils_FindBytePattern(const AP4_UI08*    data,
+                          AP4_Size           data_size,
+                          const AP4_UI08*    pattern,
+                          const AP4_UI08*    masks,
+                          const unsigned int pattern_size, // a constant once inlined
+                          const bool         masked_head)  // false: only the last byte is masked
+{
+    AP4_Size i = 0;
+
+#if defined(AP4_UTILS_USE_AVX2)
+    // test 32 positions at a time
+    __m256i patterns[4];
+    __m256i mask_vectors[4];
+    for (unsigned int k=0; k<pattern_size; k++) {
+        patterns[k]     = _mm256_set1_epi8((char)(pattern[k]&masks[k]));
+        mask_vectors[k] = _mm256_set1_epi8((char)masks[k]);
+    }
+    for (; i+32+pattern_size-1 <= data_size; i += 32) {
+        __m256i match = _mm256_set1_epi8((char)0xFF);
+        for (unsigned int k=0; k<pattern_size; k++) {
+            __m256i b = _mm256_loadu_si256((const __m256i*)(data+i+k));
+            if (masked_head || k == pattern_size-1) b = _mm256_and_si256(b, mask_vectors[k]);
+            match = _mm256_and_si256(match, _mm256_cmpeq_epi8(b, patterns[k]));
+        }
+        unsigned int match_mask = (unsigned int)_mm256_movemask_epi8(match);
+        if (match_mask) return i+AP4_Utils_LowestBitSet(match_mask);
+    }
+#elif defined(AP4_UTILS_USE_SSE2)
+    // test 16 positions at a time
+    __m128i patterns[4];
+    __m128i mask_vectors[4];
+    for (unsigned int k=0; k<pattern_size; k++) {
+        patterns[k]     = _mm_set1_epi8((char)(pattern[k]&masks[k]));
+        mask_vectors[k] = _mm_set1_epi8((char)masks[k]);
+    }
+    for (; i+16+pattern_size-1 <= data_size; i += 16) {
+        __m128i match = _mm_set1_epi8((char)0xFF);
+        for (unsigned int k=0; k<pattern_size; k++) {
+            __m128i b = _mm_loadu_si128((const __m128i*)(data+i+k));
+            if (masked_head || k == pattern_size-1) b = _mm_and_si128(b, mask_vectors[k]);
+            match = _mm_and_si128(match, _mm_cmpeq_epi8(b, patterns[k]));
+        }
+        unsigned int match_mask = (unsigned int)_mm_movemask_epi8(match);
+        if (match_mask) return i+AP4_Utils_LowestBitSet(match_mask);
+    }
+#endif
+
+    // scalar scan (and tail of the vector scan): compare from the last
+    // byte, and on a mismatch skip the positions at which the mismatched
+    // byte cannot match the pattern either
+    while (i+pattern_size <= data_size) {
+        unsigned int k = pattern_size;
+        while (k && (data[i+k-1]&masks[k-1]) == (pattern[k-1]&masks[k-1])) --k;
+        if (k == 0) return i;
+        AP4_UI08     b     = data[i+k-1];
+        unsigned int shift = k;
+        for (unsigned int j=k-1; j; j--) {
+            if ((b&masks[j-1]) == (pattern[j-1]&masks[j-1])) {
+                shift = k-j;
+                break;
+            }
+        }
+        i += shift;
+    }
+    return data_size;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FindBytePattern
++---------------------------------------------------------------------*/
+AP4_Size
+AP4_FindBytePattern(const AP4_UI08* data,
+                    AP4_Size        data_size,
+                    const AP4_UI08* pattern,
+                    const AP4_UI08* masks,
+                    unsigned int    pattern_size)
+{
+    if (pattern_size == 0 || pattern_size > 4) return data_size;
+
+    // one specialized copy of the scan per pattern size, with a faster one
+    // for the common case where only the last byte of the pattern is masked
+    bool masked_head = false;
+    for (unsigned int k=0; k+1<pattern_size; k++) {
+        if (masks[k] != 0xFF) masked_head = true;
+    }
+    if (masked_head) {
+        switch (pattern_size) {
+            case 2:  return AP4_Utils_FindBytePattern(data, data_size, pattern, masks, 2, true);
+            case 3:  return AP4_Utils_FindBytePattern(data, data_size, pattern, masks, 3, true);
+            default: return AP4_Utils_FindBytePattern(data, data_size, pattern, masks, 4, true);
+        }
+    } else {
+        switch (pattern_size) {
+            case 1:  return AP4_Utils_FindBytePattern(data, data_size, pattern, masks, 1, false);
+            case 2:  return AP4_Utils_FindBytePattern(data, data_size, pattern, masks, 2, false);
+            case 3:  return AP4_Utils_FindBytePattern(data, data_size, pattern, masks, 3, false);
+            default: return AP4_Utils_FindBytePattern(data, data_size, pattern, masks, 4, false);
+        }
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FindSyncWord
++---------------------------------------------------------------------*/
+AP4_Size
+AP4_FindSyncWord(const AP4_UI08* data,
+                 AP4_Size        data_size,
+                 AP4_UI16        sync_word,
+                 AP4_UI08        low_byte_mask)
+{
+    const AP4_UI08 pattern[2] = { (AP4_UI08)(sync_word>>8), (AP4_UI08)sync_word };
+    const AP4_UI08 masks[2]   = { 0xFF, low_byte_mask };
+    return AP4_FindBytePattern(data, data_size, pattern, masks, 2);
+}
+
 /*----------------------------------------------------------------------
 |   AP4_DurationMsFromUnits
 +---------------------------------------------------------------------*/
@@ -381,31 +600,23 @@ AP4_ParseIntegerU(const char* str)
 }
 
 /*----------------------------------------------------------------------
-|   types and macros
+|   constants
 +---------------------------------------------------------------------*/
-#define AP4_WORD_BITS  32
-#define AP4_WORD_BYTES 4
-
-#define AP4_BIT_MASK(_n) ((1<<(_n))-1)
-
-#if AP4_WORD_BITS != 32
-#error unsupported word size /* 64 and other word size not yet implemented */
-#endif
+// zero bytes after the data, so that whole words can always be loaded
+const unsigned int AP4_BIT_READER_PADDING = 8;
 
 /*----------------------------------------------------------------------
 |   AP4_BitReader::AP4_BitReader
 +---------------------------------------------------------------------*/
 AP4_BitReader::AP4_BitReader(const AP4_UI08* data, unsigned int data_size) :
+    m_DataSize(data_size),
     m_Position(0),
     m_Cache(0),
     m_BitsCached(0)
 {
-    // make the buffer an integral mulitple of the word size
-    m_Buffer.SetBufferSize(AP4_WORD_BYTES*((data_size+AP4_WORD_BYTES-1)/AP4_WORD_BYTES));
+    m_Buffer.SetBufferSize(data_size+AP4_BIT_READER_PADDING);
     m_Buffer.SetData(data, data_size);
-    if (m_Buffer.GetDataSize() != m_Buffer.GetBufferSize()) {
-        AP4_SetMemory(m_Buffer.UseData()+m_Buffer.GetDataSize(), 0, m_Buffer.GetBufferSize()-m_Buffer.GetDataSize());
-    }
+    AP4_SetMemory(m_Buffer.UseData()+data_size, 0, AP4_BIT_READER_PADDING);
 }
 
 /*----------------------------------------------------------------------
@@ -429,121 +640,88 @@ AP4_BitReader::Reset()
 }
 
 /*----------------------------------------------------------------------
-|   AP4_BitReader::GetBitsRead
+|   AP4_BitReader::Refill
 +---------------------------------------------------------------------*/
-unsigned int
-AP4_BitReader::GetBitsRead()
-{
-    return 8*m_Position - m_BitsCached;
-}
-
-/*----------------------------------------------------------------------
-|   AP4_BitReader::ReadCache
-+---------------------------------------------------------------------*/
-AP4_BitReader::BitsWord
-AP4_BitReader::ReadCache() const
+void
+AP4_BitReader::Refill()
 {
-    // stop reading past the end of the buffer when more bits are requested
-    // than the input contains; the missing bytes read as zero
-    if (m_Position+AP4_WORD_BYTES > m_Buffer.GetBufferSize()) {
-        return 0;
+    // load as many whole bytes as the cache can take, which leaves
+    // at least 57 bits in the cache
+    unsigned int byte_count = (64-m_BitsCached)/8;
+    if (m_Position < m_DataSize) {
+        // the padding makes it safe to load a whole word
+        AP4_UI64 word = AP4_BytesToUInt64BE(m_Buffer.GetData()+m_Position);
+        word &= ~(AP4_UI64)0 << (64-8*byte_count);
+        m_Cache |= word >> m_BitsCached;
     }
-    const AP4_UI08* out_ptr = m_Buffer.GetData()+m_Position;
-    return (((AP4_BitReader::BitsWord) out_ptr[0]) << 24) |
-           (((AP4_BitReader::BitsWord) out_ptr[1]) << 16) |
-           (((AP4_BitReader::BitsWord) out_ptr[2]) <<  8) |
-           (((AP4_BitReader::BitsWord) out_ptr[3])      );
+    m_Position   += byte_count;
+    m_BitsCached += 8*byte_count;
 }
 
 /*----------------------------------------------------------------------
-|   AP4_BitReader::ReadBits
+|   AP4_BitReader::ReadBitsSlow
 +---------------------------------------------------------------------*/
 AP4_UI32
-AP4_BitReader::ReadBits(unsigned int n)
+AP4_BitReader::ReadBitsSlow(unsigned int n)
 {
     if (n == 0) return 0;
-    AP4_BitReader::BitsWord result;
-    if (m_BitsCached >= n) {
-        /* we have enough bits in the cache to satisfy the request */
-        m_BitsCached -= n;
-        result = (m_Cache >> m_BitsCached) & AP4_BIT_MASK(n);
-    } else {
-        /* not enough bits in the cache */
-        AP4_BitReader::BitsWord word = ReadCache();
-        m_Position += AP4_WORD_BYTES;
 
-        /* combine the new word and the cache, and update the state */
-        AP4_BitReader::BitsWord cache = m_Cache & AP4_BIT_MASK(m_BitsCached);
-        n -= m_BitsCached;
-        m_BitsCached = AP4_WORD_BITS - n;
-        result = m_BitsCached ? (word >> m_BitsCached) | (cache << n) : word;
-        m_Cache = word;
-    }
-
-    return result;
+    // only the last 32 bits can be returned
+    SkipBits(n-32);
+    return ReadBits(32);
 }
 
 /*----------------------------------------------------------------------
-|   AP4_BitReader::ReadBit
+|   AP4_BitReader_CountLeadingZeros
 +---------------------------------------------------------------------*/
-int
-AP4_BitReader::ReadBit()
+static inline unsigned int
+AP4_BitReader_CountLeadingZeros(AP4_UI64 x)
 {
-    AP4_BitReader::BitsWord result;
-    if (m_BitsCached == 0) {
-        /* the cache is empty */
-
-        /* read the next word into the cache */
-        m_Cache = ReadCache();
-        m_Position += AP4_WORD_BYTES;
-        m_BitsCached = AP4_WORD_BITS - 1;
-
-        /* return the first bit */
-        result = m_Cache >> (AP4_WORD_BITS - 1);
-    } else {
-        /* get the bit from the cache */
-        result = (m_Cache >> (--m_BitsCached)) & 1;
+    if (x == 0) return 64;
+#if defined(__GNUC__)
+    return (unsigned int)__builtin_clzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63-(unsigned int)index;
+#else
+    unsigned int count = 0;
+    while ((x & ((AP4_UI64)1 << 63)) == 0) {
+        x <<= 1;
+        ++count;
     }
-    return result;
+    return count;
+#endif
 }
 
 /*----------------------------------------------------------------------
-|   AP4_BitReader::PeekBits
+|   AP4_BitReader::ReadUE
 +---------------------------------------------------------------------*/
 AP4_UI32
-AP4_BitReader::PeekBits(unsigned int n)
-{
-   /* we have enough bits in the cache to satisfy the request */
-   if (m_BitsCached >= n) {
-      return (m_Cache >> (m_BitsCached - n)) & AP4_BIT_MASK(n);
-   } else {
-      /* not enough bits in the cache, read the next word */
-      AP4_BitReader::BitsWord word = ReadCache();
-
-      /* combine the new word and the cache, and update the state */
-      AP4_BitReader::BitsWord   cache = m_Cache & AP4_BIT_MASK(m_BitsCached);
-      n -= m_BitsCached;
-      return (word >> (AP4_WORD_BITS - n)) | (cache << n);
-   }
-}
-
-/*----------------------------------------------------------------------
-|   AP4_BitReader::PeekBit
-+---------------------------------------------------------------------*/
-int
-AP4_BitReader::PeekBit()
+AP4_BitReader::ReadUE()
 {
-   /* the cache is empty */
-   if (m_BitsCached == 0) {
-      /* read the next word into the cache */
-      AP4_BitReader::BitsWord cache = ReadCache();
+    // a code with N leading zeros is 2N+1 bits long
+    unsigned int leading_zeros = AP4_BitReader_CountLeadingZeros(m_Cache);
+    if (2*leading_zeros+1 > m_BitsCached && m_BitsCached <= 56) {
+        Refill();
+        leading_zeros = AP4_BitReader_CountLeadingZeros(m_Cache);
+    }
+    if (leading_zeros < 32 && 2*leading_zeros+1 <= m_BitsCached) {
+        // the whole code is in the cache
+        unsigned int code_size = 2*leading_zeros+1;
+        AP4_UI32 code = (AP4_UI32)(m_Cache >> (64-code_size));
+        m_Cache = code_size < 64 ? m_Cache << code_size : 0;
+        m_BitsCached -= code_size;
+        return code-1;
+    }
 
-      /* return the first bit */
-      return cache >> (AP4_WORD_BITS - 1);
-   } else {
-      /* get the bit from the cache */
-      return (m_Cache >> (m_BitsCached-1)) & 1;
-   }
+    // long (or invalid) codes
+    leading_zeros = 0;
+    while (ReadBits(1) == 0) {
+        if (++leading_zeros > 32) return 0; // safeguard
+    }
+    if (leading_zeros >= 32) return 0;
+    return ((1U<<leading_zeros)-1)+ReadBits(leading_zeros);
 }
 
 /*----------------------------------------------------------------------
@@ -552,47 +730,30 @@ AP4_BitReader::PeekBit()
 void
 AP4_BitReader::SkipBits(unsigned int n)
 {
-   if (n <= m_BitsCached) {
-      m_BitsCached -= n;
-   } else {
-      n -= m_BitsCached;
-      while (n >= AP4_WORD_BITS) {
-         m_Position += AP4_WORD_BYTES;
-         n -= AP4_WORD_BITS;
-      }
-      if (n) {
-         m_Cache = ReadCache();
-         m_BitsCached = AP4_WORD_BITS-n;
-         m_Position += AP4_WORD_BYTES;
-      } else {
-         m_BitsCached = 0;
-         m_Cache = 0;
-      }
-   }
-}
-
-/*----------------------------------------------------------------------
-|   AP4_BitReader::SkipBit
-+---------------------------------------------------------------------*/
-void
-AP4_BitReader::SkipBit()
-{
-   if (m_BitsCached == 0) {
-      m_Cache = ReadCache();
-      m_Position += AP4_WORD_BYTES;
-      m_BitsCached = AP4_WORD_BITS - 1;
-   } else {
-      --m_BitsCached;
-   }
+    if (n <= m_BitsCached) {
+        m_Cache = n < 64 ? m_Cache << n : 0;
+        m_BitsCached -= n;
+    } else {
+        // skip whole bytes without loading them
+        n -= m_BitsCached;
+        m_Cache      = 0;
+        m_BitsCached = 0;
+        m_Position  += n/8;
+        n %= 8;
+        if (n) {
+            Refill();
+            m_Cache <<= n;
+            m_BitsCached -= n;
+        }
+    }
 }
 
 /*----------------------------------------------------------------------
-|   AP4_BitReader::GetPosition
+|   AP4_BitReader::SkipBytes
 +---------------------------------------------------------------------*/
-unsigned int
-AP4_BitReader::GetBitsPosition()
+AP4_Result
+AP4_BitReader::SkipBytes(AP4_Size byte_count)
 {
-    return m_Position * 8 - m_BitsCached;
+    SkipBits(8*byte_count);
+    return AP4_SUCCESS;
 }
-
-
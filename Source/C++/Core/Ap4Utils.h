@@ -69,6 +69,37 @@ void AP4_BytesFromDoubleBE(unsigned char* bytes, double value);
 void AP4_BytesFromUInt64BE(unsigned char* bytes, AP4_UI64 value);
 void AP4_ByteSwap16(unsigned char* bytes, unsigned int count);
 
+/**
+ * Convert arrays of values to big-endian bytes, for writing tables in bulk.
+ */
+void AP4_BytesFromUInt32ArrayBE(unsigned char* bytes, const AP4_UI32* values, AP4_Cardinal count);
+void AP4_BytesFromUInt64ArrayBE(unsigned char* bytes, const AP4_UI64* values, AP4_Cardinal count);
+
+/**
+ * Find the first offset at which a 16-bit big-endian sync word starts in a
+ * buffer. The second byte is compared after applying low_byte_mask, so that
+ * sync word variants (like 0xAC40/0xAC41) can be found in a single pass.
+ * Returns data_size if the sync word is not found.
+ */
+AP4_Size AP4_FindSyncWord(const AP4_UI08* data,
+                          AP4_Size        data_size,
+                          AP4_UI16        sync_word,
+                          AP4_UI08        low_byte_mask = 0xFF);
+
+/**
+ * Find the first offset at which a short pattern (at most 4 bytes) starts
+ * in a buffer, each byte of the buffer being compared after applying the
+ * corresponding mask: (data[i+k]&masks[k]) == (pattern[k]&masks[k]).
+ * This is the scanning kernel shared by the sync word and the NAL unit
+ * start code searches, vectorized with SSE2 or AVX2 when available.
+ * Returns data_size if the pattern is not found.
+ */
+AP4_Size AP4_FindBytePattern(const AP4_UI08* data,
+                             AP4_Size        data_size,
+                             const AP4_UI08* pattern,
+                             const AP4_UI08* masks,
+                             unsigned int    pattern_size);
+
 /*----------------------------------------------------------------------
 |   AP4_BytesToUInt32BE
 +---------------------------------------------------------------------*/
@@ -164,6 +195,7 @@ AP4_UI32 AP4_DurationMsFromUnits(AP4_UI64 units,
 AP4_UI64 AP4_ConvertTime(AP4_UI64 time_value,
                          AP4_UI32 from_time_scale,
                          AP4_UI32 to_time_scale);
+AP4_UI64 AP4_GetMonotonicTimeUs(); // for measuring elapsed time only
 
 /*----------------------------------------------------------------------
 |   random numbers
@@ -193,6 +225,7 @@ extern int AP4_FormatStringVN(char *buffer, size_t count, const char *format, va
 #include <string.h>
 #define AP4_StringLength(x) strlen(x)
 #define AP4_CopyMemory(x,y,z) memcpy(x,y,z)
+#define AP4_MoveMemory(x,y,z) memmove(x,y,z)
 #define AP4_CompareMemory(x, y, z) memcmp(x, y, z)
 #define AP4_SetMemory(x,y,z) memset(x,y,z)
 #define AP4_CompareStrings(x,y) strcmp(x,y)
@@ -243,11 +276,16 @@ private:
 /*----------------------------------------------------------------------
 |   AP4_BitReader
 +---------------------------------------------------------------------*/
+/**
+ * Reads bits, MSB first, from a copy of a memory buffer. Bits are read
+ * through a 64-bit cache that is refilled a whole word at a time, and
+ * reading past the end of the data returns zero bits.
+ */
 class AP4_BitReader
 {
 public:
     // types
-    typedef unsigned int BitsWord;
+    typedef AP4_UI64 BitsWord;
 
     // constructor and destructor
     AP4_BitReader(const AP4_UI08* data, unsigned int data_size);
@@ -255,26 +293,52 @@ public:
 
     // methods
     AP4_Result   Reset();
-    int          ReadBit();
-    AP4_UI32     ReadBits(unsigned int bit_count);
-    int          PeekBit();
-    AP4_UI32     PeekBits(unsigned int bit_count);
+    int          ReadBit() { return (int)ReadBits(1); }
+    AP4_UI32     ReadBits(unsigned int bit_count) {
+        if (bit_count == 0 || bit_count > 32) return ReadBitsSlow(bit_count);
+        if (m_BitsCached < bit_count) Refill();
+        AP4_UI32 result = (AP4_UI32)(m_Cache >> (64-bit_count));
+        m_Cache <<= bit_count;
+        m_BitsCached -= bit_count;
+        return result;
+    }
+    int          PeekBit() { return (int)PeekBits(1); }
+    AP4_UI32     PeekBits(unsigned int bit_count) {
+        if (bit_count == 0 || bit_count > 32) return 0;
+        if (m_BitsCached < bit_count) Refill();
+        return (AP4_UI32)(m_Cache >> (64-bit_count));
+    }
     AP4_Result   SkipBytes(AP4_Size byte_count);
-    void         SkipBit();
+    void         SkipBit() { SkipBits(1); }
     void         SkipBits(unsigned int bit_count);
 
-    unsigned int GetBitsPosition();
+    /**
+     * Read an unsigned Exp-Golomb code, ue(v).
+     * Invalid codes, with more than 31 leading zero bits, read as 0.
+     */
+    AP4_UI32     ReadUE();
+
+    /**
+     * Read a signed Exp-Golomb code, se(v).
+     */
+    AP4_SI32     ReadSE() {
+        AP4_UI32 code_num = ReadUE();
+        return (code_num & 1) ? (AP4_SI32)((code_num+1)/2) : -(AP4_SI32)(code_num/2);
+    }
 
-    unsigned int GetBitsRead();
+    unsigned int GetBitsPosition() { return 8*m_Position - m_BitsCached; }
+    unsigned int GetBitsRead()     { return 8*m_Position - m_BitsCached; }
 
 private:
     // methods
-    BitsWord ReadCache() const;
+    void     Refill();
+    AP4_UI32 ReadBitsSlow(unsigned int bit_count);
 
     // members
     AP4_DataBuffer m_Buffer;
-    unsigned int   m_Position;
-    BitsWord       m_Cache;
+    unsigned int   m_DataSize;
+    unsigned int   m_Position;   // position of the next byte to load in the cache
+    BitsWord       m_Cache;      // cached bits, left aligned, unused bits are 0
     unsigned int   m_BitsCached;
 };
 
@@ -0,0 +1,164 @@
+/*****************************************************************
+|
+|    AP4 - XXH64 Hash Function
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Xxhash.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_UI64 AP4_XXH64_PRIME_1 = 0x9E3779B185EBCA87ULL;
+const AP4_UI64 AP4_XXH64_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+const AP4_UI64 AP4_XXH64_PRIME_3 = 0x165667B19E3779F9ULL;
+const AP4_UI64 AP4_XXH64_PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+const AP4_UI64 AP4_XXH64_PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+/*----------------------------------------------------------------------
+|   AP4_Xxh64_Rotate
++---------------------------------------------------------------------*/
+static inline AP4_UI64
+AP4_Xxh64_Rotate(AP4_UI64 value, unsigned int bits)
+{
+    return (value << bits) | (value >> (64-bits));
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Xxh64_Read32
++---------------------------------------------------------------------*/
+static inline AP4_UI32
+AP4_Xxh64_Read32(const AP4_UI08* p)
+{
+    return (AP4_UI32)p[0]        |
+           ((AP4_UI32)p[1] <<  8) |
+           ((AP4_UI32)p[2] << 16) |
+           ((AP4_UI32)p[3] << 24);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Xxh64_Read64
++---------------------------------------------------------------------*/
+static inline AP4_UI64
+AP4_Xxh64_Read64(const AP4_UI08* p)
+{
+#if AP4_PLATFORM_BYTE_ORDER == AP4_PLATFORM_BYTE_ORDER_LITTLE_ENDIAN
+    AP4_UI64 value;
+    AP4_CopyMemory(&value, p, 8);
+    return value;
+#else
+    return (AP4_UI64)AP4_Xxh64_Read32(p) | ((AP4_UI64)AP4_Xxh64_Read32(p+4) << 32);
+#endif
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Xxh64_Round
++---------------------------------------------------------------------*/
+static inline AP4_UI64
+AP4_Xxh64_Round(AP4_UI64 accumulator, AP4_UI64 input)
+{
+    accumulator += input*AP4_XXH64_PRIME_2;
+    accumulator  = AP4_Xxh64_Rotate(accumulator, 31);
+    return accumulator*AP4_XXH64_PRIME_1;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Xxh64_MergeRound
++---------------------------------------------------------------------*/
+static inline AP4_UI64
+AP4_Xxh64_MergeRound(AP4_UI64 accumulator, AP4_UI64 value)
+{
+    accumulator ^= AP4_Xxh64_Round(0, value);
+    return accumulator*AP4_XXH64_PRIME_1+AP4_XXH64_PRIME_4;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ComputeXxh64
++---------------------------------------------------------------------*/
+AP4_UI64
+AP4_ComputeXxh64(const AP4_UI08* data, AP4_Size data_size, AP4_UI64 seed)
+{
+    const AP4_UI08* p   = data;
+    const AP4_UI08* end = data+data_size;
+    AP4_UI64        hash;
+
+    if (data_size >= 32) {
+        // four parallel lanes over 32-byte stripes
+        AP4_UI64 v1 = seed+AP4_XXH64_PRIME_1+AP4_XXH64_PRIME_2;
+        AP4_UI64 v2 = seed+AP4_XXH64_PRIME_2;
+        AP4_UI64 v3 = seed;
+        AP4_UI64 v4 = seed-AP4_XXH64_PRIME_1;
+        const AP4_UI08* limit = end-32;
+        do {
+            v1 = AP4_Xxh64_Round(v1, AP4_Xxh64_Read64(p));
+            v2 = AP4_Xxh64_Round(v2, AP4_Xxh64_Read64(p+8));
+            v3 = AP4_Xxh64_Round(v3, AP4_Xxh64_Read64(p+16));
+            v4 = AP4_Xxh64_Round(v4, AP4_Xxh64_Read64(p+24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = AP4_Xxh64_Rotate(v1, 1)  +
+               AP4_Xxh64_Rotate(v2, 7)  +
+               AP4_Xxh64_Rotate(v3, 12) +
+               AP4_Xxh64_Rotate(v4, 18);
+        hash = AP4_Xxh64_MergeRound(hash, v1);
+        hash = AP4_Xxh64_MergeRound(hash, v2);
+        hash = AP4_Xxh64_MergeRound(hash, v3);
+        hash = AP4_Xxh64_MergeRound(hash, v4);
+    } else {
+        hash = seed+AP4_XXH64_PRIME_5;
+    }
+    hash += data_size;
+
+    // remaining bytes
+    while (p+8 <= end) {
+        hash ^= AP4_Xxh64_Round(0, AP4_Xxh64_Read64(p));
+        hash  = AP4_Xxh64_Rotate(hash, 27)*AP4_XXH64_PRIME_1+AP4_XXH64_PRIME_4;
+        p += 8;
+    }
+    if (p+4 <= end) {
+        hash ^= (AP4_UI64)AP4_Xxh64_Read32(p)*AP4_XXH64_PRIME_1;
+        hash  = AP4_Xxh64_Rotate(hash, 23)*AP4_XXH64_PRIME_2+AP4_XXH64_PRIME_3;
+        p += 4;
+    }
+    while (p < end) {
+        hash ^= (*p++)*AP4_XXH64_PRIME_5;
+        hash  = AP4_Xxh64_Rotate(hash, 11)*AP4_XXH64_PRIME_1;
+    }
+
+    // final mix
+    hash ^= hash >> 33;
+    hash *= AP4_XXH64_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= AP4_XXH64_PRIME_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
@@ -0,0 +1,48 @@
+/*****************************************************************
+|
+|    AP4 - XXH64 Hash Function
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+
+#ifndef _AP4_XXHASH_H_
+#define _AP4_XXHASH_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+
+/*----------------------------------------------------------------------
+|   functions
++---------------------------------------------------------------------*/
+/**
+ * Compute the XXH64 hash of a buffer. XXH64 is a fast non-cryptographic
+ * 64-bit hash, suitable for detecting changes in sample data (not for
+ * protecting against deliberate collisions).
+ */
+AP4_UI64 AP4_ComputeXxh64(const AP4_UI08* data, AP4_Size data_size, AP4_UI64 seed = 0);
+
+#endif // _AP4_XXHASH_H_
@@ -301,6 +301,19 @@ AP4_FileByteStream::Create(const char*              name,
     return AP4_AndroidFileByteStream::Create(NULL, name, mode, stream);
 }
 
+/*----------------------------------------------------------------------
+|   AP4_FileByteStream::Rename
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_FileByteStream::Rename(const char* from, const char* to)
+{
+    if (rename(from, to) != 0) {
+        return AP4_ERROR_WRITE_FAILED;
+    }
+    
+    return AP4_SUCCESS;
+}
+
 #if !defined(AP4_CONFIG_NO_EXCEPTIONS)
 /*----------------------------------------------------------------------
 |   AP4_FileByteStream::AP4_FileByteStream
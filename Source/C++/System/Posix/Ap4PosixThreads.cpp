@@ -0,0 +1,155 @@
+/*****************************************************************
+|
+|    AP4 - Posix Threads implementation
+|
+|    Copyright 2002-2020 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <pthread.h>
+#include <unistd.h>
+
+#include "Ap4Threads.h"
+
+/*----------------------------------------------------------------------
+|   AP4_ThreadImpl
++---------------------------------------------------------------------*/
+class AP4_ThreadImpl
+{
+public:
+    AP4_ThreadImpl(AP4_Runnable& target) : m_Target(target), m_Started(false) {}
+
+    static void* EntryPoint(void* argument) {
+        AP4_ThreadImpl* self = reinterpret_cast<AP4_ThreadImpl*>(argument);
+        self->m_Target.Run();
+        return NULL;
+    }
+
+    AP4_Runnable& m_Target;
+    pthread_t     m_Thread;
+    bool          m_Started;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_MutexImpl
++---------------------------------------------------------------------*/
+class AP4_MutexImpl
+{
+public:
+    AP4_MutexImpl()  { pthread_mutex_init(&m_Mutex, NULL); }
+    ~AP4_MutexImpl() { pthread_mutex_destroy(&m_Mutex);    }
+
+    pthread_mutex_t m_Mutex;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::GetProcessorCount
++---------------------------------------------------------------------*/
+AP4_Cardinal
+AP4_Thread::GetProcessorCount()
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > 0) return (AP4_Cardinal)count;
+#endif
+    return 1;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::AP4_Thread
++---------------------------------------------------------------------*/
+AP4_Thread::AP4_Thread(AP4_Runnable& target) :
+    m_Impl(new AP4_ThreadImpl(target))
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::~AP4_Thread
++---------------------------------------------------------------------*/
+AP4_Thread::~AP4_Thread()
+{
+    Wait();
+    delete m_Impl;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::Start
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Thread::Start()
+{
+    if (m_Impl->m_Started) return AP4_ERROR_INVALID_STATE;
+    if (pthread_create(&m_Impl->m_Thread, NULL, AP4_ThreadImpl::EntryPoint, m_Impl)) {
+        return AP4_FAILURE;
+    }
+    m_Impl->m_Started = true;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::Wait
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Thread::Wait()
+{
+    if (!m_Impl->m_Started) return AP4_SUCCESS;
+    m_Impl->m_Started = false;
+    return pthread_join(m_Impl->m_Thread, NULL) == 0 ? AP4_SUCCESS : AP4_FAILURE;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::AP4_Mutex
++---------------------------------------------------------------------*/
+AP4_Mutex::AP4_Mutex() :
+    m_Impl(new AP4_MutexImpl())
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::~AP4_Mutex
++---------------------------------------------------------------------*/
+AP4_Mutex::~AP4_Mutex()
+{
+    delete m_Impl;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::Lock
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mutex::Lock()
+{
+    return pthread_mutex_lock(&m_Impl->m_Mutex) == 0 ? AP4_SUCCESS : AP4_FAILURE;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::Unlock
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mutex::Unlock()
+{
+    return pthread_mutex_unlock(&m_Impl->m_Mutex) == 0 ? AP4_SUCCESS : AP4_FAILURE;
+}
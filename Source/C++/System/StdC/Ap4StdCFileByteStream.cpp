@@ -39,12 +39,32 @@
 #include <errno.h>
 #include <sys/stat.h>
 #endif
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
 #if defined(_WIN32)
 #include <io.h>
 #include <fcntl.h>
 #endif
 #include "Ap4FileByteStream.h"
 
+/*----------------------------------------------------------------------
+|   kernel-assisted copies
++---------------------------------------------------------------------*/
+#if defined(__linux__) && !defined(AP4_CONFIG_NO_KERNEL_COPY)
+#define AP4_STDC_FILE_BYTE_STREAM_USE_KERNEL_COPY
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const unsigned int AP4_STDC_FILE_BYTE_STREAM_COPY_BUFFER_SIZE   = 1024*1024;
+const unsigned int AP4_STDC_FILE_BYTE_STREAM_MIN_KERNEL_COPY    = 64*1024;
+const unsigned int AP4_STDC_FILE_BYTE_STREAM_MAX_KERNEL_CHUNK   = 1024*1024*1024;
+
 /*----------------------------------------------------------------------
 |   compatibility wrappers
 +---------------------------------------------------------------------*/
@@ -191,18 +211,28 @@ public:
     AP4_Result Tell(AP4_Position& position);
     AP4_Result GetSize(AP4_LargeSize& size);
     AP4_Result Flush();
+    AP4_Result CopyTo(AP4_ByteStream& stream, AP4_LargeSize size);
+    AP4_Result GetFileDescriptor(int& fd);
+    AP4_Result Truncate(AP4_LargeSize size);
 
     // AP4_Referenceable methods
     void AddReference();
     void Release();
 
 private:
+    // methods
+#if defined(AP4_STDC_FILE_BYTE_STREAM_USE_KERNEL_COPY)
+    AP4_Result KernelCopyTo(AP4_ByteStream& stream, AP4_LargeSize size, AP4_LargeSize& copied);
+#endif
+
     // members
     AP4_ByteStream* m_Delegator;
     AP4_Cardinal    m_ReferenceCount;
     FILE*           m_File;
     AP4_Position    m_Position;
     AP4_LargeSize   m_Size;
+    bool            m_SizeStale; // the file may have grown through its descriptor
+    AP4_UI08*       m_CopyBuffer;
 };
 
 /*----------------------------------------------------------------------
@@ -290,7 +320,9 @@ AP4_StdcFileByteStream::AP4_StdcFileByteStream(AP4_FileByteStream* delegator,
     m_ReferenceCount(1),
     m_File(file),
     m_Position(0),
-    m_Size(size)
+    m_Size(size),
+    m_SizeStale(false),
+    m_CopyBuffer(NULL)
 {
 }
 
@@ -302,6 +334,7 @@ AP4_StdcFileByteStream::~AP4_StdcFileByteStream()
     if (m_File && m_File != stdin && m_File != stdout && m_File != stderr) {
         fclose(m_File);
     }
+    delete[] m_CopyBuffer;
 }
 
 /*----------------------------------------------------------------------
@@ -392,6 +425,10 @@ AP4_StdcFileByteStream::Seek(AP4_Position position)
     result = AP4_fseek(m_File, position, SEEK_SET);
     if (result == 0) {
         m_Position = position;
+
+        // past the known size, the file may have grown if it was written
+        // through its descriptor: check its size the next time it is needed
+        if (m_Position > m_Size) m_SizeStale = true;
         return AP4_SUCCESS;
     } else {
         return AP4_FAILURE;
@@ -414,6 +451,15 @@ AP4_StdcFileByteStream::Tell(AP4_Position& position)
 AP4_Result
 AP4_StdcFileByteStream::GetSize(AP4_LargeSize& size)
 {
+#if defined(AP4_STDC_FILE_BYTE_STREAM_USE_KERNEL_COPY)
+    if (m_SizeStale) {
+        struct stat info;
+        if (fstat(fileno(m_File), &info) == 0 && (AP4_LargeSize)info.st_size > m_Size) {
+            m_Size = info.st_size;
+        }
+        m_SizeStale = false;
+    }
+#endif
     size = m_Size;
     return AP4_SUCCESS;
 }
@@ -428,6 +474,149 @@ AP4_StdcFileByteStream::Flush()
     return (ret_val > 0) ? AP4_FAILURE: AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_StdcFileByteStream::GetFileDescriptor
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StdcFileByteStream::GetFileDescriptor(int& fd)
+{
+#if defined(_WIN32_WCE)
+    fd = -1;
+    return AP4_ERROR_NOT_SUPPORTED;
+#else
+    fd = fileno(m_File);
+    return fd < 0 ? AP4_FAILURE : AP4_SUCCESS;
+#endif
+}
+
+/*----------------------------------------------------------------------
+|   AP4_StdcFileByteStream::Truncate
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StdcFileByteStream::Truncate(AP4_LargeSize size)
+{
+#if defined(_WIN32_WCE)
+    return AP4_ERROR_NOT_SUPPORTED;
+#else
+    AP4_LargeSize current_size = 0;
+    GetSize(current_size);
+    if (size > current_size) return AP4_ERROR_INVALID_PARAMETERS;
+
+    // write out any pending output before resizing the file
+    if (AP4_fseek(m_File, m_Position, SEEK_SET) != 0) return AP4_ERROR_WRITE_FAILED;
+#if defined(_WIN32)
+    if (_chsize_s(_fileno(m_File), size) != 0) return AP4_ERROR_WRITE_FAILED;
+#else
+    if (ftruncate(fileno(m_File), (off_t)size) != 0) return AP4_ERROR_WRITE_FAILED;
+#endif
+    m_Size      = size;
+    m_SizeStale = false;
+
+    return m_Position > size ? Seek(size) : AP4_SUCCESS;
+#endif
+}
+
+#if defined(AP4_STDC_FILE_BYTE_STREAM_USE_KERNEL_COPY)
+/*----------------------------------------------------------------------
+|   AP4_StdcFileByteStream::KernelCopyTo
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StdcFileByteStream::KernelCopyTo(AP4_ByteStream& stream,
+                                     AP4_LargeSize   size,
+                                     AP4_LargeSize&  copied)
+{
+    copied = 0;
+
+    // only copy between regular files
+    int in_fd  = fileno(m_File);
+    int out_fd = -1;
+    if (AP4_FAILED(stream.GetFileDescriptor(out_fd))) return AP4_SUCCESS;
+    struct stat info;
+    if (fstat(in_fd,  &info) != 0 || !S_ISREG(info.st_mode)) return AP4_SUCCESS;
+    if (fstat(out_fd, &info) != 0 || !S_ISREG(info.st_mode)) return AP4_SUCCESS;
+
+    // flush the buffered data, the copy uses explicit offsets (fseek, unlike
+    // fflush, is defined for input streams, and writes any pending output)
+    AP4_Position out_position = 0;
+    AP4_CHECK(stream.Tell(out_position));
+    AP4_CHECK(stream.Flush());
+    if (AP4_fseek(m_File, m_Position, SEEK_SET) != 0) return AP4_ERROR_READ_FAILED;
+
+    // use copy_file_range when supported between the two files, or sendfile
+    off_t in_offset  = (off_t)m_Position;
+    off_t out_offset = (off_t)out_position;
+#if defined(SYS_copy_file_range)
+    bool use_copy_file_range = true;
+#else
+    bool use_copy_file_range = false;
+#endif
+    while (copied < size) {
+        size_t chunk = (size-copied) < AP4_STDC_FILE_BYTE_STREAM_MAX_KERNEL_CHUNK ?
+                       (size_t)(size-copied) : AP4_STDC_FILE_BYTE_STREAM_MAX_KERNEL_CHUNK;
+        ssize_t result;
+#if defined(SYS_copy_file_range)
+        if (use_copy_file_range) {
+            result = syscall(SYS_copy_file_range, in_fd, &in_offset, out_fd, &out_offset, chunk, 0);
+            if (result < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+                use_copy_file_range = false;
+                continue;
+            }
+        } else
+#endif
+        {
+            if (lseek(out_fd, out_offset, SEEK_SET) < 0) break;
+            result = sendfile(out_fd, in_fd, &in_offset, chunk);
+            if (result > 0) out_offset += result;
+        }
+
+        // stop on errors and at the end of the input, the caller
+        // falls back to a buffered copy for what remains
+        if (result <= 0) break;
+        copied += result;
+    }
+
+    // re-synchronize the streams with the files
+    m_Position += copied;
+    if (AP4_fseek(m_File, m_Position, SEEK_SET) != 0) return AP4_ERROR_READ_FAILED;
+    return stream.Seek(out_position+copied);
+}
+#endif
+
+/*----------------------------------------------------------------------
+|   AP4_StdcFileByteStream::CopyTo
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StdcFileByteStream::CopyTo(AP4_ByteStream& stream, AP4_LargeSize size)
+{
+#if defined(AP4_STDC_FILE_BYTE_STREAM_USE_KERNEL_COPY)
+    if (size >= AP4_STDC_FILE_BYTE_STREAM_MIN_KERNEL_COPY) {
+        AP4_LargeSize copied = 0;
+        AP4_Result result = KernelCopyTo(stream, size, copied);
+        if (AP4_FAILED(result)) return result;
+        size -= copied;
+    }
+#endif
+
+    // copy through a buffer, allocated once for the lifetime of the stream
+    if (size && m_CopyBuffer == NULL) {
+        m_CopyBuffer = new AP4_UI08[AP4_STDC_FILE_BYTE_STREAM_COPY_BUFFER_SIZE];
+    }
+    while (size) {
+        AP4_Size bytes_to_read = size < AP4_STDC_FILE_BYTE_STREAM_COPY_BUFFER_SIZE ?
+                                 (AP4_Size)size : AP4_STDC_FILE_BYTE_STREAM_COPY_BUFFER_SIZE;
+        AP4_Size bytes_read = 0;
+        AP4_Result result = ReadPartial(m_CopyBuffer, bytes_to_read, bytes_read);
+        if (AP4_FAILED(result)) return result;
+        if (bytes_read) {
+            result = stream.Write(m_CopyBuffer, bytes_read);
+            if (AP4_FAILED(result)) return result;
+        }
+        size -= bytes_read;
+    }
+
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_FileByteStream::Create
 +---------------------------------------------------------------------*/
@@ -439,6 +628,29 @@ AP4_FileByteStream::Create(const char*              name,
     return AP4_StdcFileByteStream::Create(NULL, name, mode, stream);
 }
 
+/*----------------------------------------------------------------------
+|   AP4_FileByteStream::Rename
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_FileByteStream::Rename(const char* from, const char* to)
+{
+#if defined(_WIN32) && !defined(_WIN32_WCE)
+    AP4_WIN32_USE_CHAR_CONVERSION;
+    LPCWSTR from_w = AP4_WIN32_A2W(from);
+    LPCWSTR to_w   = AP4_WIN32_A2W(to);
+    if (from_w == NULL || to_w == NULL) return AP4_ERROR_INVALID_PARAMETERS;
+    if (!MoveFileExW(from_w, to_w, MOVEFILE_REPLACE_EXISTING)) {
+        return AP4_ERROR_WRITE_FAILED;
+    }
+#else
+    if (rename(from, to) != 0) {
+        return AP4_ERROR_WRITE_FAILED;
+    }
+#endif
+    
+    return AP4_SUCCESS;
+}
+
 #if !defined(AP4_CONFIG_NO_EXCEPTIONS)
 /*----------------------------------------------------------------------
 |   AP4_FileByteStream::AP4_FileByteStream
@@ -0,0 +1,158 @@
+/*****************************************************************
+|
+|    AP4 - Win32 Threads implementation
+|
+|    Copyright 2002-2020 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#if !defined(WIN32_LEAN_AND_MEAN)
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <process.h>
+
+#include "Ap4Threads.h"
+
+/*----------------------------------------------------------------------
+|   AP4_ThreadImpl
++---------------------------------------------------------------------*/
+class AP4_ThreadImpl
+{
+public:
+    AP4_ThreadImpl(AP4_Runnable& target) : m_Target(target), m_Thread(NULL) {}
+
+    static unsigned int __stdcall EntryPoint(void* argument) {
+        AP4_ThreadImpl* self = reinterpret_cast<AP4_ThreadImpl*>(argument);
+        self->m_Target.Run();
+        return 0;
+    }
+
+    AP4_Runnable& m_Target;
+    HANDLE        m_Thread;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_MutexImpl
++---------------------------------------------------------------------*/
+class AP4_MutexImpl
+{
+public:
+    AP4_MutexImpl()  { InitializeCriticalSection(&m_Mutex); }
+    ~AP4_MutexImpl() { DeleteCriticalSection(&m_Mutex);     }
+
+    CRITICAL_SECTION m_Mutex;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::GetProcessorCount
++---------------------------------------------------------------------*/
+AP4_Cardinal
+AP4_Thread::GetProcessorCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (AP4_Cardinal)info.dwNumberOfProcessors : 1;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::AP4_Thread
++---------------------------------------------------------------------*/
+AP4_Thread::AP4_Thread(AP4_Runnable& target) :
+    m_Impl(new AP4_ThreadImpl(target))
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::~AP4_Thread
++---------------------------------------------------------------------*/
+AP4_Thread::~AP4_Thread()
+{
+    Wait();
+    delete m_Impl;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::Start
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Thread::Start()
+{
+    if (m_Impl->m_Thread) return AP4_ERROR_INVALID_STATE;
+    uintptr_t thread = _beginthreadex(NULL, 0, AP4_ThreadImpl::EntryPoint, m_Impl, 0, NULL);
+    if (thread == 0) return AP4_FAILURE;
+    m_Impl->m_Thread = (HANDLE)thread;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::Wait
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Thread::Wait()
+{
+    if (m_Impl->m_Thread == NULL) return AP4_SUCCESS;
+    DWORD result = WaitForSingleObject(m_Impl->m_Thread, INFINITE);
+    CloseHandle(m_Impl->m_Thread);
+    m_Impl->m_Thread = NULL;
+    return result == WAIT_OBJECT_0 ? AP4_SUCCESS : AP4_FAILURE;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::AP4_Mutex
++---------------------------------------------------------------------*/
+AP4_Mutex::AP4_Mutex() :
+    m_Impl(new AP4_MutexImpl())
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::~AP4_Mutex
++---------------------------------------------------------------------*/
+AP4_Mutex::~AP4_Mutex()
+{
+    delete m_Impl;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::Lock
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mutex::Lock()
+{
+    EnterCriticalSection(&m_Impl->m_Mutex);
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::Unlock
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mutex::Unlock()
+{
+    LeaveCriticalSection(&m_Impl->m_Mutex);
+    return AP4_SUCCESS;
+}
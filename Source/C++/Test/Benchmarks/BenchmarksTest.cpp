@@ -50,6 +50,13 @@
 #define ENC_IN_BUFFER_SIZE (1024*128)
 #define ENC_OUT_BUFFER_SIZE (ENC_IN_BUFFER_SIZE+32)
 #define SCALE_MB (1024.0f*1024.0f)
+#define SCALE_MBIT (1000.0f*1000.0f/8.0f)
+#define TS_PES_PAYLOAD_SIZE (1024*64)
+#define NAL_STREAM_SIZE (1024*1024)
+#define NAL_FEED_SIZE (1024*64)
+#define SYNC_FRAME_STREAM_SIZE (1024*1024)
+#define SYNC_FRAME_FEED_SIZE (1024*8)
+#define TABLE_SAMPLE_COUNT (1024*256)
 
 /*----------------------------------------------------------------------
 |   macros
@@ -144,7 +151,16 @@ PrintUsage()
            "read-samples-dcf-cbc\n"
            "read-samples-dcf-ctr\n"
            "read-samples-pdcf-cbc\n"
-           "read-samples-pdcf-ctr\n");
+           "read-samples-pdcf-ctr\n"
+           "ts-packetize\n"
+           "nal-parse\n"
+           "nal-unescape\n"
+           "ac3-parse\n"
+           "ac3-index\n"
+           "eac3-index\n"
+           "ac4-index\n"
+           "table-write\n"
+           "table-write-buffered\n");
 }
 
 /*----------------------------------------------------------------------
@@ -423,6 +439,113 @@ ReadFile(const char* filename, unsigned int block_size, bool sequential)
     return total_read;
 }
 
+/*----------------------------------------------------------------------
+|   PacketizeTs
++---------------------------------------------------------------------*/
+static unsigned int
+PacketizeTs(AP4_Mpeg2TsWriter::SampleStream* stream,
+            AP4_MemoryByteStream*            output,
+            const unsigned char*             payload,
+            unsigned int                     repeats)
+{
+    unsigned int total_size = 0;
+    for (unsigned int i=0; i<repeats; i++) {
+        output->Seek(0);
+        stream->WritePES(payload, TS_PES_PAYLOAD_SIZE, i*3000, true, i*3000+6000, (i%8) == 0, *output);
+        total_size += TS_PES_PAYLOAD_SIZE;
+    }
+    return total_size;
+}
+
+/*----------------------------------------------------------------------
+|   ParseNalUnits
++---------------------------------------------------------------------*/
+static unsigned int
+ParseNalUnits(AP4_NalParser& parser, const unsigned char* stream)
+{
+    parser.Reset();
+    unsigned int offset = 0;
+    while (offset < NAL_STREAM_SIZE) {
+        AP4_Size to_feed = NAL_STREAM_SIZE-offset;
+        if (to_feed > NAL_FEED_SIZE) to_feed = NAL_FEED_SIZE;
+        AP4_Size bytes_consumed = 0;
+        const AP4_UI08* nalu_data = NULL;
+        AP4_Size        nalu_size = 0;
+        parser.Feed(stream+offset, to_feed, bytes_consumed, nalu_data, nalu_size, offset+to_feed == NAL_STREAM_SIZE);
+        if (bytes_consumed == 0 && nalu_data == NULL) break;
+        offset += bytes_consumed;
+    }
+    return NAL_STREAM_SIZE;
+}
+
+/*----------------------------------------------------------------------
+|   ParseAc3Frames
++---------------------------------------------------------------------*/
+static unsigned int
+ParseAc3Frames(const unsigned char* stream)
+{
+    AP4_Ac3Parser parser;
+    unsigned int offset = 0;
+    bool eos = false;
+    for (;;) {
+        AP4_Ac3Frame frame;
+        if (AP4_SUCCEEDED(parser.FindFrame(frame))) {
+            frame.m_Source->SkipBytes(frame.m_Info.m_FrameSize);
+        } else if (eos) {
+            break;
+        }
+        AP4_Size to_feed = parser.GetBytesFree();
+        if (to_feed > SYNC_FRAME_FEED_SIZE) to_feed = SYNC_FRAME_FEED_SIZE;
+        if (to_feed > SYNC_FRAME_STREAM_SIZE-offset) to_feed = SYNC_FRAME_STREAM_SIZE-offset;
+        if (to_feed) {
+            parser.Feed(stream+offset, &to_feed);
+            offset += to_feed;
+        } else if (offset == SYNC_FRAME_STREAM_SIZE) {
+            eos = true;
+            parser.Feed(NULL, NULL, AP4_BITSTREAM_FLAG_EOS);
+        }
+    }
+    return SYNC_FRAME_STREAM_SIZE;
+}
+
+/*----------------------------------------------------------------------
+|   IndexSyncFrames
++---------------------------------------------------------------------*/
+template <typename S>
+static unsigned int
+IndexSyncFrames(const unsigned char* stream,
+                AP4_Result (*find_frame_span)(const AP4_UI08*, AP4_Size, AP4_Size&, S&, bool))
+{
+    unsigned int offset = 0;
+    for (;;) {
+        AP4_Size bytes_consumed = 0;
+        S frame;
+        AP4_Result result = find_frame_span(stream+offset,
+                                            SYNC_FRAME_STREAM_SIZE-offset,
+                                            bytes_consumed,
+                                            frame,
+                                            true);
+        offset += bytes_consumed;
+        if (AP4_FAILED(result)) break;
+    }
+    return SYNC_FRAME_STREAM_SIZE;
+}
+
+/*----------------------------------------------------------------------
+|   WriteAtom
++---------------------------------------------------------------------*/
+static unsigned int
+WriteAtom(AP4_Atom& atom, AP4_MemoryByteStream& output, bool buffered)
+{
+    output.Seek(0);
+    if (buffered) {
+        atom.WriteBuffered(output);
+    } else {
+        atom.Write(output);
+    }
+    return (unsigned int)atom.GetSize();
+}
+
 /*----------------------------------------------------------------------
 |   main
 +---------------------------------------------------------------------*/
@@ -456,6 +579,15 @@ main(int argc, char** argv)
     bool do_read_samples_dcf_ctr   = false;
     bool do_read_samples_pdcf_cbc  = false;
     bool do_read_samples_pdcf_ctr  = false;
+    bool do_ts_packetize           = false;
+    bool do_nal_parse              = false;
+    bool do_nal_unescape           = false;
+    bool do_ac3_parse              = false;
+    bool do_ac3_index              = false;
+    bool do_eac3_index             = false;
+    bool do_ac4_index              = false;
+    bool do_table_write            = false;
+    bool do_table_write_buffered   = false;
     const char* test_file_read     = "test-bench.mp4";
     const char* test_file_mp4      = "test-bench.mp4";
     const char* test_file_dcf_cbc  = "test-bench.mp4.cbc.odf";
@@ -510,6 +642,24 @@ main(int argc, char** argv)
             do_read_samples_pdcf_cbc = true;
         } else if (!strcmp(arg, "read-samples-pdcf-ctr")) {
             do_read_samples_pdcf_ctr = true;
+        } else if (!strcmp(arg, "ts-packetize")) {
+            do_ts_packetize = true;
+        } else if (!strcmp(arg, "nal-parse")) {
+            do_nal_parse = true;
+        } else if (!strcmp(arg, "nal-unescape")) {
+            do_nal_unescape = true;
+        } else if (!strcmp(arg, "ac3-parse")) {
+            do_ac3_parse = true;
+        } else if (!strcmp(arg, "ac3-index")) {
+            do_ac3_index = true;
+        } else if (!strcmp(arg, "eac3-index")) {
+            do_eac3_index = true;
+        } else if (!strcmp(arg, "ac4-index")) {
+            do_ac4_index = true;
+        } else if (!strcmp(arg, "table-write")) {
+            do_table_write = true;
+        } else if (!strcmp(arg, "table-write-buffered")) {
+            do_table_write_buffered = true;
         } else if (!strncmp(arg, "--test-file-read=", 17)) {
             test_file_read = arg+17;
         } else if (!strncmp(arg, "--test-file-mp4=", 16)) {
@@ -547,6 +697,15 @@ main(int argc, char** argv)
             do_read_samples_dcf_ctr   = true;
             do_read_samples_pdcf_cbc  = true;
             do_read_samples_pdcf_ctr  = true;
+            do_ts_packetize           = true;
+            do_nal_parse              = true;
+            do_nal_unescape           = true;
+            do_ac3_parse              = true;
+            do_ac3_index              = true;
+            do_eac3_index             = true;
+            do_ac4_index              = true;
+            do_table_write            = true;
+            do_table_write_buffered   = true;
         } else {
             fprintf(stderr, "ERROR: unknown test name (%s)\n", arg);
             return 1;
@@ -681,5 +840,133 @@ main(int argc, char** argv)
     total += LoadAllSamples(test_file_pdcf_ctr, 16);
     BENCH_END("MB", SCALE_MB)
 
+    AP4_Mpeg2TsWriter ts_writer;
+    AP4_Mpeg2TsWriter::SampleStream* ts_stream = NULL;
+    ts_writer.SetVideoStream(90000, AP4_MPEG2_STREAM_TYPE_AVC, AP4_MPEG2_TS_DEFAULT_STREAM_ID_VIDEO, ts_stream);
+    AP4_MemoryByteStream* ts_output = new AP4_MemoryByteStream();
+    unsigned char* ts_payload = new unsigned char[TS_PES_PAYLOAD_SIZE];
+    AP4_SetMemory(ts_payload, 0x5A, TS_PES_PAYLOAD_SIZE);
+
+    BENCH_START("TS Packetize", do_ts_packetize)
+    total += PacketizeTs(ts_stream, ts_output, ts_payload, 64);
+    BENCH_END("Mbit", SCALE_MBIT)
+
+    delete[] ts_payload;
+    ts_output->Release();
+
+    // synthetic Annex-B stream, with a start code every 4096 bytes
+    AP4_NalParser nal_parser;
+    unsigned char* nal_stream = new unsigned char[NAL_STREAM_SIZE];
+    for (unsigned int x=0; x<NAL_STREAM_SIZE; x++) {
+        nal_stream[x] = (unsigned char)(x*7+(x>>8)) | 0x04;
+    }
+    for (unsigned int x=0; x+4<NAL_STREAM_SIZE; x += 4096) {
+        nal_stream[x  ] = 0;
+        nal_stream[x+1] = 0;
+        nal_stream[x+2] = 0;
+        nal_stream[x+3] = 1;
+    }
+
+    BENCH_START("NAL Parse", do_nal_parse)
+    total += ParseNalUnits(nal_parser, nal_stream);
+    BENCH_END("MB", SCALE_MB)
+
+    // add an emulation prevention byte every 1000 bytes
+    for (unsigned int x=1000; x+4<NAL_STREAM_SIZE; x += 1000) {
+        nal_stream[x  ] = 0;
+        nal_stream[x+1] = 0;
+        nal_stream[x+2] = 3;
+        nal_stream[x+3] = 1;
+    }
+    AP4_DataBuffer unescaped;
+
+    BENCH_START("NAL Unescape", do_nal_unescape)
+    AP4_NalParser::Unescape(nal_stream, NAL_STREAM_SIZE, unescaped, NAL_STREAM_SIZE);
+    total += NAL_STREAM_SIZE;
+    BENCH_END("MB", SCALE_MB)
+
+    delete[] nal_stream;
+
+    // synthetic AC-3 stream, 48kHz 384kbps frames (1536 bytes)
+    unsigned char* sync_frame_stream = new unsigned char[SYNC_FRAME_STREAM_SIZE];
+    for (unsigned int x=0; x<SYNC_FRAME_STREAM_SIZE; x++) {
+        sync_frame_stream[x] = (unsigned char)(x*7+(x>>8));
+    }
+    for (unsigned int x=0; x+1536<=SYNC_FRAME_STREAM_SIZE; x += 1536) {
+        sync_frame_stream[x  ] = 0x0B;
+        sync_frame_stream[x+1] = 0x77;
+        sync_frame_stream[x+4] = 28;     // fscod=0, frmsizecod=28
+        sync_frame_stream[x+5] = 8<<3;   // bsid=8, bsmod=0
+        sync_frame_stream[x+6] = 2<<5;   // acmod=2
+    }
+
+    BENCH_START("AC-3 Parse", do_ac3_parse)
+    total += ParseAc3Frames(sync_frame_stream);
+    BENCH_END("MB", SCALE_MB)
+
+    BENCH_START("AC-3 Index", do_ac3_index)
+    total += IndexSyncFrames(sync_frame_stream, AP4_Ac3Parser::FindFrameSpan);
+    BENCH_END("MB", SCALE_MB)
+
+    // synthetic E-AC-3 stream, 48kHz 6 block frames (1536 bytes)
+    for (unsigned int x=0; x+1536<=SYNC_FRAME_STREAM_SIZE; x += 1536) {
+        sync_frame_stream[x  ] = 0x0B;
+        sync_frame_stream[x+1] = 0x77;
+        sync_frame_stream[x+2] = (767>>8);     // strmtyp=0, substreamid=0
+        sync_frame_stream[x+3] = (767&0xFF);   // frmsiz=767
+        sync_frame_stream[x+4] = (3<<4)|(2<<1); // fscod=0, numblkscod=3, acmod=2
+        sync_frame_stream[x+5] = 16<<3;        // bsid=16
+    }
+
+    BENCH_START("E-AC-3 Index", do_eac3_index)
+    total += IndexSyncFrames(sync_frame_stream, AP4_Eac3Parser::FindFrameSpan);
+    BENCH_END("MB", SCALE_MB)
+
+    // synthetic AC-4 stream, 48kHz 25fps frames (4096 bytes)
+    for (unsigned int x=0; x+4096<=SYNC_FRAME_STREAM_SIZE; x += 4096) {
+        sync_frame_stream[x  ] = 0xAC;
+        sync_frame_stream[x+1] = 0x40;
+        sync_frame_stream[x+2] = (4092>>8);
+        sync_frame_stream[x+3] = (4092&0xFF);
+        sync_frame_stream[x+4] = 0x80; // bitstream_version=2, sequence_counter=0
+        sync_frame_stream[x+5] = 0x05; // b_wait_frames=0, fs_index=1, frame_rate_index=5 (25fps)...
+        sync_frame_stream[x+6] = 0x40; // ...b_iframe_global=0
+    }
+
+    BENCH_START("AC-4 Index", do_ac4_index)
+    total += IndexSyncFrames(sync_frame_stream, AP4_Ac4Parser::FindFrameSpan);
+    BENCH_END("MB", SCALE_MB)
+
+    delete[] sync_frame_stream;
+
+    // synthetic stbl atom, with the sample tables of a track with one sample per chunk
+    AP4_ContainerAtom stbl(AP4_ATOM_TYPE_STBL);
+    AP4_SttsAtom* stts = new AP4_SttsAtom();
+    AP4_CttsAtom* ctts = new AP4_CttsAtom();
+    AP4_StszAtom* stsz = new AP4_StszAtom();
+    AP4_UI32* chunk_offsets = new AP4_UI32[TABLE_SAMPLE_COUNT];
+    for (unsigned int x=0; x<TABLE_SAMPLE_COUNT; x++) {
+        stts->AddEntry(1, 1000+(x&1));
+        ctts->AddEntry(1, (x%3)*1000);
+        stsz->AddEntry(4000+(x&0xFFF));
+        chunk_offsets[x] = x*4096;
+    }
+    stbl.AddChild(stts);
+    stbl.AddChild(ctts);
+    stbl.AddChild(stsz);
+    stbl.AddChild(new AP4_StcoAtom(chunk_offsets, TABLE_SAMPLE_COUNT));
+    delete[] chunk_offsets;
+    AP4_MemoryByteStream* table_output = new AP4_MemoryByteStream();
+
+    BENCH_START("Table Write", do_table_write)
+    total += WriteAtom(stbl, *table_output, false);
+    BENCH_END("MB", SCALE_MB)
+
+    BENCH_START("Table Write Buffered", do_table_write_buffered)
+    total += WriteAtom(stbl, *table_output, true);
+    BENCH_END("MB", SCALE_MB)
+
+    table_output->Release();
+
     return 1;
 }
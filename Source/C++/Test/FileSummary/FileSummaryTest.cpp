@@ -0,0 +1,179 @@
+/*****************************************************************
+|
+|    AP4 - File Summary Test
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+#include "Ap4FileSummary.h"
+
+/*----------------------------------------------------------------------
+|   macros
++---------------------------------------------------------------------*/
+#define CHECK(x) do { \
+    if (!(x)) { fprintf(stderr, "ERROR line %d\n", __LINE__); return -1; }\
+} while (0)
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "File Summary Test - Version 1.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2017 Axiomatic Systems, LLC"
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr,
+            BANNER
+            "\n\nusage: filesummarytest <mp4-file> [<mp4-file> ...]\n"
+            "(for example Test/Data/audio-aac-001.mp4 and Test/Data/video-h264-001.mp4)\n");
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   CheckSummary
++---------------------------------------------------------------------*/
+static int
+CheckSummary(AP4_ByteStream& stream, AP4_File& file, bool check_layout)
+{
+    AP4_FileSummary* summary = NULL;
+    CHECK(AP4_SUCCEEDED(AP4_FileSummary::Create(stream, summary)));
+
+    // file info
+    AP4_Movie* movie = file.GetMovie();
+    AP4_FtypAtom* ftyp = file.GetFileType();
+    if (ftyp) {
+        CHECK(summary->GetMajorBrand()   == ftyp->GetMajorBrand());
+        CHECK(summary->GetMinorVersion() == ftyp->GetMinorVersion());
+    }
+    if (check_layout) {
+        CHECK(summary->IsFastStart() == file.IsMoovBeforeMdat());
+    }
+    CHECK(summary->IsFragmented() == movie->HasFragments());
+    CHECK(summary->GetTimeScale()  == movie->GetTimeScale());
+    CHECK(summary->GetDuration()   == movie->GetDuration());
+    CHECK(summary->GetDurationMs() == movie->GetDurationMs());
+
+    // tracks, with the sample counts that the full sample tables have
+    CHECK(summary->GetTracks().ItemCount() == movie->GetTracks().ItemCount());
+    unsigned int index = 0;
+    for (AP4_List<AP4_Track>::Item* item = movie->GetTracks().FirstItem();
+                                    item;
+                                    item = item->GetNext(), index++) {
+        AP4_Track* track = item->GetData();
+        const AP4_FileSummary::Track& info = summary->GetTracks()[index];
+        CHECK(info.m_Id                     == track->GetId());
+        CHECK(info.m_Type                   == track->GetType());
+        CHECK(info.m_HandlerType            == track->GetHandlerType());
+        CHECK(info.m_SampleDescriptionCount == track->GetSampleDescriptionCount());
+        CHECK(info.m_SampleCount            == track->GetSampleCount());
+        CHECK(info.m_MediaTimeScale         == track->GetMediaTimeScale());
+        CHECK(info.m_MediaDuration          == track->GetMediaDuration());
+        CHECK(info.m_DurationMs             == track->GetDurationMs());
+
+        AP4_SampleDescription* desc = track->GetSampleDescription(0);
+        CHECK(desc != NULL);
+        AP4_String codec;
+        desc->GetCodecString(codec);
+        CHECK(info.m_Format == desc->GetFormat());
+        CHECK(info.m_Codec  == codec);
+    }
+
+    delete summary;
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   TestFile
++---------------------------------------------------------------------*/
+static int
+TestFile(const char* filename)
+{
+    AP4_ByteStream* input = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open input file (%s)\n", filename);
+        return -1;
+    }
+
+    // the summary matches a full parse of the file
+    AP4_File* file = new AP4_File(*input, true);
+    CHECK(file->GetMovie() != NULL);
+    input->Seek(0);
+    CHECK(CheckSummary(*input, *file, true) == 0);
+
+    // the same, with 64-bit headers for the stsz/stz2 atoms: write the
+    // ftyp and moov atoms only, the summary does not read any further
+    for (AP4_List<AP4_Track>::Item* item = file->GetMovie()->GetTracks().FirstItem();
+                                    item;
+                                    item = item->GetNext()) {
+        AP4_Atom* stsz = item->GetData()->UseTrakAtom()->FindChild("mdia/minf/stbl/stsz");
+        if (stsz == NULL) stsz = item->GetData()->UseTrakAtom()->FindChild("mdia/minf/stbl/stz2");
+        CHECK(stsz != NULL);
+        stsz->SetSize(stsz->GetSize()+8, true);
+        stsz->GetParent()->OnChildChanged(stsz);
+    }
+    AP4_MemoryByteStream* large = new AP4_MemoryByteStream();
+    if (file->GetFileType()) CHECK(AP4_SUCCEEDED(file->GetFileType()->Write(*large)));
+    CHECK(AP4_SUCCEEDED(file->GetMovie()->GetMoovAtom()->Write(*large)));
+    large->Seek(0);
+    CHECK(CheckSummary(*large, *file, false) == 0);
+
+    large->Release();
+    delete file;
+    input->Release();
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        PrintUsageAndExit();
+    }
+    for (int i=1; i<argc; i++) {
+        if (TestFile(argv[i])) {
+            fprintf(stderr, "ERROR: test failed for %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    printf("file summary test passed\n");
+    return 0;
+}
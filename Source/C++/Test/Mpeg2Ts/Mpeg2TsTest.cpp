@@ -0,0 +1,235 @@
+/*****************************************************************
+|
+|    AP4 - MPEG2 Transport Stream Test
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   macros
++---------------------------------------------------------------------*/
+#define CHECK(x) do { \
+    if (!(x)) { fprintf(stderr, "ERROR line %d\n", __LINE__); return -1; }\
+} while (0)
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const unsigned int TEST_SAMPLE_COUNT    = 20;
+const unsigned int TEST_AUDIO_DURATION  = 1920; // 1024 samples at 48kHz
+const unsigned int TEST_VIDEO_DURATION  = 3000; // 30 fps
+const unsigned int TEST_VIDEO_CTS_DELAY = 6000;
+
+/*----------------------------------------------------------------------
+|   MakePayload
++---------------------------------------------------------------------*/
+static void
+MakePayload(AP4_DataBuffer& payload, bool video, unsigned int index)
+{
+    // vary the sizes so that PES packets span a variable number of packets
+    unsigned int size = video ? 100+index*397 : 7+index*13;
+    payload.SetDataSize(size);
+    AP4_UI08* data = payload.UseData();
+    for (unsigned int i=0; i<size; i++) {
+        data[i] = (AP4_UI08)(i*7+index);
+    }
+    if (video) {
+        // an Annex-B AUD, followed by an IDR slice every 10 frames, with
+        // the SPS and PPS of a 160x120 stream in front of the first one
+        static const AP4_UI08 aud[6] = {0, 0, 0, 1, 0x09, 0xF0};
+        static const AP4_UI08 parameter_sets[32] = {
+            0, 0, 0, 1, 0x27, 0x4D, 0x40, 0x0A, 0xA9, 0x18, 0x50, 0x8B, 0xCB, 0x80,
+            0x35, 0x06, 0x01, 0x06, 0xB6, 0xC2, 0xB5, 0xEF, 0x7C, 0x04,
+            0, 0, 0, 1, 0x28, 0xDE, 0x09, 0x88
+        };
+        unsigned int offset = 0;
+        AP4_CopyMemory(data, aud, sizeof(aud));
+        offset += sizeof(aud);
+        if (index == 0) {
+            AP4_CopyMemory(data+offset, parameter_sets, sizeof(parameter_sets));
+            offset += sizeof(parameter_sets);
+        }
+        data[offset]   = 0;
+        data[offset+1] = 0;
+        data[offset+2] = 1;
+        data[offset+3] = (index%10) == 0 ? 0x65 : 0x41;
+        // avoid accidental start codes in the filler
+        for (unsigned int i=offset+4; i<size; i++) {
+            if (data[i] < 2) data[i] = 2;
+        }
+    } else {
+        // an ADTS header for AAC LC, 48kHz, stereo
+        data[0] = 0xFF;
+        data[1] = 0xF1;
+        data[2] = 0x4C;
+        data[3] = (AP4_UI08)(0x80 | (size>>11));
+        data[4] = (AP4_UI08)(size>>3);
+        data[5] = (AP4_UI08)(((size&7)<<5) | 0x1F);
+        data[6] = 0xFC;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   WriteMalformedPes
++---------------------------------------------------------------------*/
+static AP4_Result
+WriteMalformedPes(AP4_ByteStream& output)
+{
+    // a PES header that claims to be larger than the PES packet
+    AP4_UI08 packet[188];
+    AP4_SetMemory(packet, 0xFF, sizeof(packet));
+    packet[0] = 0x47;
+    packet[1] = 0x40 | (AP4_MPEG2_TS_DEFAULT_PID_AUDIO>>8);
+    packet[2] = AP4_MPEG2_TS_DEFAULT_PID_AUDIO&0xFF;
+    packet[3] = 0x1F; // payload only, continuity counter 15
+    packet[4] = 0;
+    packet[5] = 0;
+    packet[6] = 1;
+    packet[7] = AP4_MPEG2_TS_DEFAULT_STREAM_ID_AUDIO;
+    packet[8] = 0;
+    packet[9] = 3; // PES_packet_length
+    packet[10] = 0x80;
+    packet[11] = 0;
+    packet[12] = 10; // PES_header_data_length
+    return output.Write(packet, sizeof(packet));
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int /*argc*/, char** /*argv*/)
+{
+    AP4_Result result;
+
+    // write a transport stream with one audio and one video stream
+    AP4_MemoryByteStream* ts = new AP4_MemoryByteStream();
+    AP4_Mpeg2TsWriter writer;
+    AP4_Mpeg2TsWriter::SampleStream* audio = NULL;
+    AP4_Mpeg2TsWriter::SampleStream* video = NULL;
+    result = writer.SetAudioStream(AP4_MPEG2_TS_TIMESCALE,
+                                   AP4_MPEG2_STREAM_TYPE_ISO_IEC_13818_7,
+                                   AP4_MPEG2_TS_DEFAULT_STREAM_ID_AUDIO,
+                                   audio);
+    CHECK(AP4_SUCCEEDED(result));
+    result = writer.SetVideoStream(AP4_MPEG2_TS_TIMESCALE,
+                                   AP4_MPEG2_STREAM_TYPE_AVC,
+                                   AP4_MPEG2_TS_DEFAULT_STREAM_ID_VIDEO,
+                                   video);
+    CHECK(AP4_SUCCEEDED(result));
+    CHECK(AP4_SUCCEEDED(writer.WritePAT(*ts)));
+    CHECK(AP4_SUCCEEDED(writer.WritePMT(*ts)));
+
+    AP4_DataBuffer payload;
+    for (unsigned int i=0; i<TEST_SAMPLE_COUNT; i++) {
+        AP4_UI64 dts = i*TEST_VIDEO_DURATION;
+        MakePayload(payload, true, i);
+        result = video->WritePES(payload.GetData(), payload.GetDataSize(),
+                                 dts, true, dts+TEST_VIDEO_CTS_DELAY, true, *ts);
+        CHECK(AP4_SUCCEEDED(result));
+
+        if (i == TEST_SAMPLE_COUNT/2) {
+            CHECK(AP4_SUCCEEDED(WriteMalformedPes(*ts)));
+        }
+
+        MakePayload(payload, false, i);
+        AP4_UI64 pts = i*TEST_AUDIO_DURATION;
+        result = audio->WritePES(payload.GetData(), payload.GetDataSize(),
+                                 pts, false, pts, false, *ts);
+        CHECK(AP4_SUCCEEDED(result));
+    }
+
+    // read it back
+    ts->Seek(0);
+    AP4_Mpeg2TsReader reader(*ts);
+    CHECK(AP4_SUCCEEDED(reader.ParseProgram()));
+    CHECK(reader.GetStreamCount() == 2);
+    CHECK(reader.FindStream(AP4_MPEG2_TS_DEFAULT_PID_AUDIO) != NULL);
+    CHECK(reader.FindStream(AP4_MPEG2_TS_DEFAULT_PID_VIDEO) != NULL);
+    
+    // the decoder configurations are built from the stream
+    AP4_SampleDescription* description = reader.FindStream(AP4_MPEG2_TS_DEFAULT_PID_VIDEO)->GetSampleDescription();
+    CHECK(description->GetType() == AP4_SampleDescription::TYPE_AVC);
+    AP4_AvcSampleDescription* avc_description = AP4_DYNAMIC_CAST(AP4_AvcSampleDescription, description);
+    CHECK(avc_description != NULL);
+    CHECK(avc_description->GetWidth() == 160 && avc_description->GetHeight() == 120);
+    CHECK(avc_description->GetSequenceParameters().ItemCount() == 1);
+    CHECK(avc_description->GetPictureParameters().ItemCount() == 1);
+    description = reader.FindStream(AP4_MPEG2_TS_DEFAULT_PID_AUDIO)->GetSampleDescription();
+    CHECK(description->GetType() == AP4_SampleDescription::TYPE_MPEG);
+    AP4_MpegAudioSampleDescription* aac_description = AP4_DYNAMIC_CAST(AP4_MpegAudioSampleDescription, description);
+    CHECK(aac_description != NULL);
+    CHECK(aac_description->GetSampleRate() == 48000);
+    CHECK(aac_description->GetChannelCount() == 2);
+    CHECK(aac_description->GetMpeg4AudioObjectType() == AP4_MPEG4_AUDIO_OBJECT_TYPE_AAC_LC);
+
+    unsigned int   audio_count = 0;
+    unsigned int   video_count = 0;
+    AP4_Sample     sample;
+    AP4_DataBuffer data;
+    AP4_UI32       track_id = 0;
+    for (;;) {
+        result = reader.ReadNextSample(sample, data, track_id);
+        if (result == AP4_ERROR_EOS) break;
+        CHECK(AP4_SUCCEEDED(result));
+        CHECK(sample.GetSize() == data.GetDataSize());
+        if (track_id == AP4_MPEG2_TS_DEFAULT_PID_VIDEO) {
+            unsigned int i = video_count++;
+            MakePayload(payload, true, i);
+            CHECK(data.GetDataSize() == payload.GetDataSize());
+            CHECK(AP4_CompareMemory(data.GetData(), payload.GetData(), payload.GetDataSize()) == 0);
+            AP4_UI64 dts = AP4_MPEG2_TS_DEFAULT_PCR_OFFSET+i*TEST_VIDEO_DURATION;
+            CHECK(sample.GetDts() == dts);
+            CHECK(sample.GetCts() == dts+TEST_VIDEO_CTS_DELAY);
+            CHECK(sample.GetDuration() == TEST_VIDEO_DURATION);
+            CHECK(sample.IsSync() == ((i%10) == 0));
+        } else if (track_id == AP4_MPEG2_TS_DEFAULT_PID_AUDIO) {
+            unsigned int i = audio_count++;
+            MakePayload(payload, false, i);
+            CHECK(data.GetDataSize() == payload.GetDataSize());
+            CHECK(AP4_CompareMemory(data.GetData(), payload.GetData(), payload.GetDataSize()) == 0);
+            AP4_UI64 pts = AP4_MPEG2_TS_DEFAULT_PCR_OFFSET+i*TEST_AUDIO_DURATION;
+            CHECK(sample.GetDts() == pts);
+            CHECK(sample.GetCts() == pts);
+            CHECK(sample.GetDuration() == TEST_AUDIO_DURATION);
+        } else {
+            CHECK(false);
+        }
+    }
+    CHECK(video_count == TEST_SAMPLE_COUNT);
+    CHECK(audio_count == TEST_SAMPLE_COUNT);
+
+    ts->Release();
+
+    printf("mpeg2ts test passed\n");
+    return 0;
+}
@@ -0,0 +1,286 @@
+/*****************************************************************
+|
+|    AP4 - Playlist Writer Test
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   macros
++---------------------------------------------------------------------*/
+#define CHECK(x) do { \
+    if (!(x)) { fprintf(stderr, "ERROR line %d\n", __LINE__); return -1; }\
+} while (0)
+
+/*----------------------------------------------------------------------
+|   Contains
++---------------------------------------------------------------------*/
+static bool
+Contains(AP4_DataBuffer& text, const char* pattern)
+{
+    // the rendered text is not null-terminated
+    AP4_Size size = text.GetDataSize();
+    text.Reserve(size+1);
+    text.UseData()[size] = '\0';
+    return strstr((const char*)text.GetData(), pattern) != NULL;
+}
+
+/*----------------------------------------------------------------------
+|   Count
++---------------------------------------------------------------------*/
+static unsigned int
+Count(AP4_DataBuffer& text, const char* pattern)
+{
+    AP4_Size size = text.GetDataSize();
+    text.Reserve(size+1);
+    text.UseData()[size] = '\0';
+    unsigned int count = 0;
+    for (const char* c = (const char*)text.GetData(); (c = strstr(c, pattern)) != NULL; c++) {
+        ++count;
+    }
+    return count;
+}
+
+/*----------------------------------------------------------------------
+|   TestHlsTargetDuration
++---------------------------------------------------------------------*/
+static int
+TestHlsTargetDuration()
+{
+    AP4_HlsPlaylistWriter playlist(AP4_HlsPlaylistWriter::PLAYLIST_TYPE_EVENT);
+    AP4_DataBuffer text;
+    playlist.SetTargetDuration(4);
+
+    // the target duration follows the segments until it is published
+    CHECK(AP4_SUCCEEDED(playlist.AddSegment("seg-0.ts", 6.2)));
+    CHECK(playlist.GetTargetDuration() == 6);
+    CHECK(AP4_SUCCEEDED(playlist.Render(text)));
+    CHECK(Contains(text, "#EXT-X-TARGETDURATION:6\r\n"));
+
+    // and then never changes
+    CHECK(AP4_SUCCEEDED(playlist.AddSegment("seg-1.ts", 9.0)));
+    CHECK(playlist.GetTargetDuration() == 6);
+    CHECK(AP4_SUCCEEDED(playlist.Render(text)));
+    CHECK(Contains(text, "#EXT-X-TARGETDURATION:6\r\n"));
+    CHECK(Contains(text, "#EXTINF:9.000000,\r\nseg-1.ts\r\n"));
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   TestHlsByteRanges
++---------------------------------------------------------------------*/
+static int
+TestHlsByteRanges()
+{
+    AP4_HlsPlaylistWriter playlist(AP4_HlsPlaylistWriter::PLAYLIST_TYPE_VOD, 4);
+    AP4_DataBuffer text;
+
+    // offsets past 4GB must not be truncated
+    AP4_Position offset = AP4_Position(0x100000000ULL)+1000;
+    CHECK(AP4_SUCCEEDED(playlist.AddSegment("media.ts", 4.0, 1000, 0)));
+    CHECK(AP4_SUCCEEDED(playlist.AddSegment("media.ts", 4.0, 2000, offset)));
+    playlist.SetEndList();
+    CHECK(AP4_SUCCEEDED(playlist.Render(text)));
+    CHECK(Contains(text, "#EXT-X-PLAYLIST-TYPE:VOD\r\n"));
+    CHECK(Contains(text, "#EXT-X-BYTERANGE:1000@0\r\n"));
+    CHECK(Contains(text, "#EXT-X-BYTERANGE:2000@4294968296\r\n"));
+    CHECK(Contains(text, "#EXT-X-ENDLIST\r\n"));
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   TestHlsWindow
++---------------------------------------------------------------------*/
+static int
+TestHlsWindow()
+{
+    AP4_HlsPlaylistWriter playlist(AP4_HlsPlaylistWriter::PLAYLIST_TYPE_LIVE);
+    AP4_DataBuffer text;
+    playlist.SetWindowSize(3);
+    for (unsigned int i=0; i<10; i++) {
+        char uri[32];
+        AP4_FormatString(uri, sizeof(uri), "seg-%u.ts", i);
+        CHECK(AP4_SUCCEEDED(playlist.AddSegment(uri, 2.0, 0, 0, i == 8)));
+    }
+    CHECK(playlist.GetSegmentCount() == 10);
+    CHECK(playlist.GetMediaSequence() == 7);
+    CHECK(AP4_SUCCEEDED(playlist.Render(text)));
+    CHECK(!Contains(text, "#EXT-X-PLAYLIST-TYPE"));
+    CHECK(Contains(text, "#EXT-X-MEDIA-SEQUENCE:7\r\n"));
+    CHECK(!Contains(text, "seg-6.ts"));
+    CHECK(Contains(text, "#EXTINF:2.000000,\r\nseg-7.ts\r\n"));
+    CHECK(Contains(text, "#EXT-X-DISCONTINUITY\r\n#EXTINF:2.000000,\r\nseg-8.ts\r\n"));
+    CHECK(Count(text, "#EXTINF") == 3);
+
+    // the discontinuity sequence counts the discontinuities that slid out
+    CHECK(AP4_SUCCEEDED(playlist.AddSegment("seg-10.ts", 2.0)));
+    CHECK(AP4_SUCCEEDED(playlist.AddSegment("seg-11.ts", 2.0)));
+    CHECK(AP4_SUCCEEDED(playlist.Render(text)));
+    CHECK(Contains(text, "#EXT-X-DISCONTINUITY-SEQUENCE:1\r\n"));
+    CHECK(!Contains(text, "#EXT-X-DISCONTINUITY\r\n"));
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   TestHlsParts
++---------------------------------------------------------------------*/
+static int
+TestHlsParts()
+{
+    AP4_HlsPlaylistWriter playlist(AP4_HlsPlaylistWriter::PLAYLIST_TYPE_EVENT, 9);
+    AP4_DataBuffer text;
+    playlist.SetTargetDuration(1);
+    playlist.SetPartTargetDuration(0.5);
+    for (unsigned int i=0; i<6; i++) {
+        char uri[32];
+        AP4_FormatString(uri, sizeof(uri), "seg-%u.mp4", i);
+        CHECK(AP4_SUCCEEDED(playlist.AddPart(uri, 0.5, true, 100, 0)));
+        CHECK(AP4_SUCCEEDED(playlist.AddPart(uri, 0.5, false, 100, 100)));
+        CHECK(AP4_SUCCEEDED(playlist.AddSegment(uri, 1.0)));
+    }
+    CHECK(AP4_SUCCEEDED(playlist.AddPart("seg-6.mp4", 0.5, true, 100, 0)));
+    CHECK(AP4_SUCCEEDED(playlist.Render(text)));
+    CHECK(Contains(text, "#EXT-X-PART-INF:PART-TARGET=0.500000\r\n"));
+    CHECK(Contains(text, "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=1.500000\r\n"));
+
+    // only the parts of the last 3 target durations are kept, plus the pending ones
+    CHECK(Count(text, "#EXT-X-PART:") == 7);
+    CHECK(!Contains(text, "URI=\"seg-2.mp4\""));
+    CHECK(Contains(text, "#EXT-X-PART:DURATION=0.500000,URI=\"seg-3.mp4\",INDEPENDENT=YES,BYTERANGE=\"100@0\"\r\n"));
+    CHECK(Contains(text, "#EXT-X-PART:DURATION=0.500000,URI=\"seg-3.mp4\",BYTERANGE=\"100@100\"\r\n#EXTINF:1.000000,\r\nseg-3.mp4\r\n"));
+    CHECK(Contains(text, "seg-5.mp4\r\n#EXT-X-PART:DURATION=0.500000,URI=\"seg-6.mp4\""));
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   TestDashTimeline
++---------------------------------------------------------------------*/
+static int
+TestDashTimeline()
+{
+    AP4_DashManifestWriter manifest;
+    AP4_DataBuffer text;
+    AP4_Ordinal video = 0;
+    AP4_Ordinal audio = 0;
+    CHECK(AP4_SUCCEEDED(manifest.AddRepresentation("v", "video/mp4", "avc1.64001F", 1000000, 90000,
+                                                   "v-init.mp4", "v-$Number$.m4s", video)));
+    CHECK(AP4_SUCCEEDED(manifest.AddRepresentation("a&b", "audio/mp4", NULL, 64000, 48000,
+                                                   NULL, "a-$Time$.m4s", audio)));
+    CHECK(AP4_SUCCEEDED(manifest.SetVideoAttributes(video, 1280, 720)));
+    CHECK(AP4_SUCCEEDED(manifest.SetAudioAttributes(audio, 48000)));
+    CHECK(manifest.SetAudioAttributes(2, 48000) == AP4_ERROR_OUT_OF_RANGE);
+
+    // equal consecutive durations are merged, gaps restart the timeline
+    for (unsigned int i=0; i<4; i++) {
+        CHECK(AP4_SUCCEEDED(manifest.AddSegment(video, i*180000, 180000)));
+    }
+    CHECK(AP4_SUCCEEDED(manifest.AddSegment(video, 720000, 90000)));
+    CHECK(AP4_SUCCEEDED(manifest.AddSegment(video, 900000, 90000)));
+    CHECK(AP4_SUCCEEDED(manifest.AddSegment(audio, 0, 96000)));
+    CHECK(manifest.SetStartNumber(video, 5) == AP4_ERROR_INVALID_STATE);
+    CHECK(AP4_SUCCEEDED(manifest.Render(text)));
+    CHECK(Contains(text, "type=\"static\""));
+    CHECK(Contains(text, "mediaPresentationDuration=\"PT11.000S\""));
+    CHECK(Contains(text, "<Representation id=\"v\" codecs=\"avc1.64001F\" bandwidth=\"1000000\" width=\"1280\" height=\"720\">"));
+    CHECK(Contains(text, "<Representation id=\"a&amp;b\" bandwidth=\"64000\" audioSamplingRate=\"48000\">"));
+    CHECK(Contains(text, "<SegmentTemplate timescale=\"90000\" initialization=\"v-init.mp4\" media=\"v-$Number$.m4s\" startNumber=\"1\">"));
+    CHECK(Contains(text, "<SegmentTemplate timescale=\"48000\" media=\"a-$Time$.m4s\" startNumber=\"1\">"));
+    CHECK(Contains(text,
+                   "            <S t=\"0\" d=\"180000\" r=\"3\"/>\n"
+                   "            <S d=\"90000\"/>\n"
+                   "            <S t=\"900000\" d=\"90000\"/>\n"));
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   TestDashDynamic
++---------------------------------------------------------------------*/
+static int
+TestDashDynamic()
+{
+    AP4_DashManifestWriter manifest(true);
+    AP4_DataBuffer text;
+    AP4_Ordinal index = 0;
+    manifest.SetTimeShiftBufferDepth(10.0);
+    manifest.SetMinimumUpdatePeriod(2.0);
+    CHECK(AP4_SUCCEEDED(manifest.AddRepresentation("1", "video/mp4", NULL, 0, 1000,
+                                                   "init.mp4", "seg-$Number$.m4s", index)));
+    CHECK(manifest.SetStartNumber(1, 0) == AP4_ERROR_OUT_OF_RANGE);
+    CHECK(AP4_SUCCEEDED(manifest.SetStartNumber(index, 0)));
+
+    // segments that leave the time shift buffer are removed and counted
+    for (unsigned int i=0; i<100; i++) {
+        CHECK(AP4_SUCCEEDED(manifest.AddSegment(index, i*2000, i == 50 ? 1000 : 2000)));
+        if (i == 50) {
+            CHECK(AP4_SUCCEEDED(manifest.AddSegment(index, i*2000+1000, 1000)));
+        }
+    }
+    CHECK(AP4_SUCCEEDED(manifest.Render(text)));
+    CHECK(Contains(text, "type=\"dynamic\""));
+    CHECK(Contains(text, "availabilityStartTime=\"1970-01-01T00:00:00Z\""));
+    CHECK(Contains(text, "minimumUpdatePeriod=\"PT2.000S\""));
+    CHECK(Contains(text, "timeShiftBufferDepth=\"PT10.000S\""));
+    CHECK(!Contains(text, "mediaPresentationDuration"));
+    CHECK(Contains(text, "startNumber=\"96\""));
+    CHECK(Contains(text, "<S t=\"190000\" d=\"2000\" r=\"4\"/>\n          </SegmentTimeline>"));
+
+    // at the end of the stream, the manifest becomes static
+    manifest.SetEndOfStream();
+    CHECK(AP4_SUCCEEDED(manifest.Render(text)));
+    CHECK(Contains(text, "type=\"static\""));
+    CHECK(Contains(text, "mediaPresentationDuration=\"PT10.000S\""));
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int /*argc*/, char** /*argv*/)
+{
+    CHECK(TestHlsTargetDuration() == 0);
+    CHECK(TestHlsByteRanges() == 0);
+    CHECK(TestHlsWindow() == 0);
+    CHECK(TestHlsParts() == 0);
+    CHECK(TestDashTimeline() == 0);
+    CHECK(TestDashDynamic() == 0);
+
+    printf("playlist writer test passed\n");
+    return 0;
+}
@@ -0,0 +1,299 @@
+/*****************************************************************
+|
+|    AP4 - Segment Builder Test
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   macros
++---------------------------------------------------------------------*/
+#define CHECK(x) do { \
+    if (!(x)) { fprintf(stderr, "ERROR line %d\n", __LINE__); return -1; }\
+} while (0)
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "Segment Builder Test - Version 1.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2017 Axiomatic Systems, LLC"
+
+const double TEST_FRAME_RATE = 24.0;
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr,
+            BANNER
+            "\n\nusage: segmentbuildertest <path-to-video-h264-001.mp4>\n");
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   ChunkCounter
++---------------------------------------------------------------------*/
+class ChunkCounter : public AP4_SegmentBuilder::ChunkListener
+{
+public:
+    ChunkCounter() : m_ChunkCount(0), m_SampleCount(0), m_LastSequenceNumber(0) {}
+    virtual AP4_Result OnChunk(AP4_SegmentBuilder&                  /* builder */,
+                               const AP4_SegmentBuilder::ChunkInfo& info,
+                               const AP4_UI08*                      /* chunk_data */,
+                               AP4_Size                             /* chunk_data_size */) {
+        ++m_ChunkCount;
+        m_SampleCount        += info.m_SampleCount;
+        m_LastSequenceNumber  = info.m_SequenceNumber;
+        return AP4_SUCCESS;
+    }
+
+    unsigned int m_ChunkCount;
+    unsigned int m_SampleCount;
+    unsigned int m_LastSequenceNumber;
+};
+
+/*----------------------------------------------------------------------
+|   AppendNalUnit
++---------------------------------------------------------------------*/
+static void
+AppendNalUnit(AP4_DataBuffer& output, const AP4_UI08* nalu, AP4_Size nalu_size)
+{
+    static const AP4_UI08 start_code[4] = {0, 0, 0, 1};
+    output.AppendData(start_code, 4);
+    output.AppendData(nalu, nalu_size);
+}
+
+/*----------------------------------------------------------------------
+|   ReadElementaryStream
++---------------------------------------------------------------------*/
+static AP4_Result
+ReadElementaryStream(const char* filename, AP4_DataBuffer& output)
+{
+    AP4_ByteStream* input = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+    if (AP4_FAILED(result)) return result;
+    AP4_File* file = new AP4_File(*input);
+    input->Release();
+
+    // convert the samples of the video track to Annex-B
+    result = AP4_ERROR_INVALID_FORMAT;
+    AP4_Track* track = file->GetMovie() ? file->GetMovie()->GetTrack(AP4_Track::TYPE_VIDEO) : NULL;
+    AP4_AvcSampleDescription* avc_desc = track ?
+        AP4_DYNAMIC_CAST(AP4_AvcSampleDescription, track->GetSampleDescription(0)) : NULL;
+    if (avc_desc) {
+        for (unsigned int i=0; i<avc_desc->GetSequenceParameters().ItemCount(); i++) {
+            const AP4_DataBuffer& sps = avc_desc->GetSequenceParameters()[i];
+            AppendNalUnit(output, sps.GetData(), sps.GetDataSize());
+        }
+        for (unsigned int i=0; i<avc_desc->GetPictureParameters().ItemCount(); i++) {
+            const AP4_DataBuffer& pps = avc_desc->GetPictureParameters()[i];
+            AppendNalUnit(output, pps.GetData(), pps.GetDataSize());
+        }
+        unsigned int   nalu_length_size = avc_desc->GetNaluLengthSize();
+        AP4_Sample     sample;
+        AP4_DataBuffer sample_data;
+        result = AP4_SUCCESS;
+        for (unsigned int i=0; i<track->GetSampleCount() && AP4_SUCCEEDED(result); i++) {
+            result = track->ReadSample(i, sample, sample_data);
+            const AP4_UI08* data = sample_data.GetData();
+            AP4_Size        size = sample_data.GetDataSize();
+            while (AP4_SUCCEEDED(result) && size > nalu_length_size) {
+                AP4_Size nalu_size = 0;
+                for (unsigned int j=0; j<nalu_length_size; j++) {
+                    nalu_size = (nalu_size<<8) | data[j];
+                }
+                data += nalu_length_size;
+                size -= nalu_length_size;
+                if (nalu_size > size) {
+                    result = AP4_ERROR_INVALID_FORMAT;
+                    break;
+                }
+                AppendNalUnit(output, data, nalu_size);
+                data += nalu_size;
+                size -= nalu_size;
+            }
+        }
+    }
+    delete file;
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   BuildSegment
++---------------------------------------------------------------------*/
+static AP4_Result
+BuildSegment(const AP4_DataBuffer& input,
+             unsigned int          max_chunk_samples,
+             unsigned int          sequence_number,
+             ChunkCounter&         counter,
+             AP4_MemoryByteStream& output)
+{
+    AP4_AvcSegmentBuilder builder(1, TEST_FRAME_RATE);
+    if (max_chunk_samples) {
+        AP4_Result result = builder.EnableChunks(&counter, max_chunk_samples, 0);
+        if (AP4_FAILED(result)) return result;
+    }
+
+    AP4_Size offset = 0;
+    while (offset < input.GetDataSize()) {
+        AP4_Size bytes_consumed = 0;
+        AP4_Result result = builder.Feed(input.GetData()+offset,
+                                         input.GetDataSize()-offset,
+                                         bytes_consumed);
+        if (result < 0) return result;
+        offset += bytes_consumed;
+    }
+    for (;;) {
+        AP4_Size bytes_consumed = 0;
+        AP4_Result result = builder.Feed(NULL, 0, bytes_consumed);
+        if (result < 0) return result;
+        if (result == AP4_SUCCESS) break; // no more access units
+    }
+
+    return builder.WriteMediaSegment(output, sequence_number);
+}
+
+/*----------------------------------------------------------------------
+|   GetCompositionTimes
++---------------------------------------------------------------------*/
+static AP4_Result
+GetCompositionTimes(AP4_MemoryByteStream& segment, AP4_Array<AP4_UI64>& cts)
+{
+    segment.Seek(0);
+    AP4_DefaultAtomFactory atom_factory;
+    AP4_Atom* atom = NULL;
+    while (AP4_SUCCEEDED(atom_factory.CreateAtomFromStream(segment, atom))) {
+        AP4_ContainerAtom* moof = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+        if (moof && moof->GetType() == AP4_ATOM_TYPE_MOOF) {
+            AP4_TfdtAtom* tfdt = AP4_DYNAMIC_CAST(AP4_TfdtAtom, moof->FindChild("traf/tfdt"));
+            AP4_TrunAtom* trun = AP4_DYNAMIC_CAST(AP4_TrunAtom, moof->FindChild("traf/trun"));
+            if (tfdt == NULL || trun == NULL) {
+                delete atom;
+                return AP4_ERROR_INVALID_FORMAT;
+            }
+            AP4_UI64 dts = tfdt->GetBaseMediaDecodeTime();
+            for (unsigned int i=0; i<trun->GetEntries().ItemCount(); i++) {
+                const AP4_TrunAtom::Entry& entry = trun->GetEntries()[i];
+                cts.Append(dts+entry.sample_composition_time_offset);
+                dts += entry.sample_duration;
+            }
+        }
+        delete atom;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   CheckDisplayOrder
++---------------------------------------------------------------------*/
+static bool
+CheckDisplayOrder(const AP4_Array<AP4_UI64>& reference, const AP4_Array<AP4_UI64>& cts)
+{
+    // the chunked output may use a different composition offset, but
+    // must display the samples in the same order, each at a distinct time
+    if (reference.ItemCount() != cts.ItemCount()) return false;
+    for (unsigned int i=0; i<cts.ItemCount(); i++) {
+        for (unsigned int j=0; j<cts.ItemCount(); j++) {
+            if (i == j) continue;
+            if (cts[i] == cts[j]) return false;
+            if ((reference[i] < reference[j]) != (cts[i] < cts[j])) return false;
+        }
+    }
+
+    return true;
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int argc, char** argv)
+{
+    if (argc != 2) {
+        PrintUsageAndExit();
+    }
+    const char* input_filename = argv[1];
+
+    // extract the H.264 elementary stream, which has B-frames
+    AP4_DataBuffer input_data;
+    AP4_Result result = ReadElementaryStream(input_filename, input_data);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot read input file (%s)\n", input_filename);
+        return 1;
+    }
+
+    // build the segment as a single fragment, as a reference
+    ChunkCounter          reference_counter;
+    AP4_MemoryByteStream* reference = new AP4_MemoryByteStream();
+    CHECK(AP4_SUCCEEDED(BuildSegment(input_data, 0, 1, reference_counter, *reference)));
+    AP4_Array<AP4_UI64> reference_cts;
+    CHECK(AP4_SUCCEEDED(GetCompositionTimes(*reference, reference_cts)));
+    reference->Release();
+    CHECK(reference_cts.ItemCount() > 1);
+
+    // the input must have reordered frames for the test to be meaningful
+    bool reordered = false;
+    for (unsigned int i=1; i<reference_cts.ItemCount(); i++) {
+        if (reference_cts[i] < reference_cts[i-1]) reordered = true;
+    }
+    CHECK(reordered);
+
+    // build it again with chunks that would split the reorder groups
+    for (unsigned int max_chunk_samples=1; max_chunk_samples<=4; max_chunk_samples++) {
+        // the last chunk gets the sequence number passed to WriteMediaSegment
+        unsigned int          sequence_number = 1000;
+        ChunkCounter          counter;
+        AP4_MemoryByteStream* chunked = new AP4_MemoryByteStream();
+        CHECK(AP4_SUCCEEDED(BuildSegment(input_data, max_chunk_samples, sequence_number, counter, *chunked)));
+        AP4_Array<AP4_UI64> cts;
+        CHECK(AP4_SUCCEEDED(GetCompositionTimes(*chunked, cts)));
+        chunked->Release();
+        CHECK(counter.m_ChunkCount > 1);
+        CHECK(counter.m_SampleCount == reference_cts.ItemCount());
+        CHECK(counter.m_LastSequenceNumber == sequence_number);
+        CHECK(CheckDisplayOrder(reference_cts, cts));
+    }
+
+    // sequence numbers cannot go backwards
+    ChunkCounter          counter;
+    AP4_MemoryByteStream* chunked = new AP4_MemoryByteStream();
+    CHECK(BuildSegment(input_data, 1, 1, counter, *chunked) == AP4_ERROR_INVALID_PARAMETERS);
+    chunked->Release();
+
+    printf("segment builder test passed\n");
+    return 0;
+}
@@ -0,0 +1,233 @@
+/*****************************************************************
+|
+|    AP4 - Segment Index Test
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+#include "Ap4SegmentIndex.h"
+
+/*----------------------------------------------------------------------
+|   macros
++---------------------------------------------------------------------*/
+#define CHECK(x) do { \
+    if (!(x)) { fprintf(stderr, "ERROR line %d\n", __LINE__); return -1; }\
+} while (0)
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "Segment Index Test - Version 1.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2017 Axiomatic Systems, LLC"
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr,
+            BANNER
+            "\n\nusage: segmentindextest <fragmented-mp4-file> [<fragmented-mp4-file> ...]\n"
+            "(for example Test/Data/audio-aac-002.mp4 and Test/Data/video-h264-002.mp4)\n");
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   ComputeExpectedEntries
++---------------------------------------------------------------------*/
+static AP4_Result
+ComputeExpectedEntries(AP4_ByteStream&                         input,
+                       AP4_Movie&                              movie,
+                       AP4_UI32                                track_id,
+                       AP4_Array<AP4_SegmentIndex::Entry>&     entries)
+{
+    // walk the top-level atoms, and get the timing of each fragment of
+    // the track from its sample table
+    AP4_DefaultAtomFactory atom_factory;
+    AP4_LargeSize          input_size = 0;
+    AP4_Position           position   = 0;
+    AP4_UI64               next_dts   = 0;
+    bool                   in_entry   = false;
+    AP4_Result result = input.GetSize(input_size);
+    if (AP4_FAILED(result)) return result;
+    while (position < input_size) {
+        result = input.Seek(position);
+        if (AP4_FAILED(result)) return result;
+        AP4_Atom* atom = NULL;
+        result = atom_factory.CreateAtomFromStream(input, atom);
+        if (AP4_FAILED(result)) return result;
+        AP4_LargeSize atom_size = atom->GetSize();
+        AP4_ContainerAtom* moof = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+        if (moof && moof->GetType() == AP4_ATOM_TYPE_MOOF) {
+            in_entry = false;
+            AP4_MovieFragment fragment(moof); // takes ownership of the atom
+            AP4_FragmentSampleTable* sample_table = NULL;
+            result = fragment.CreateSampleTable(&movie,
+                                                track_id,
+                                                &input,
+                                                position,
+                                                position+atom_size+AP4_ATOM_HEADER_SIZE,
+                                                next_dts,
+                                                sample_table);
+            if (AP4_SUCCEEDED(result) && sample_table->GetSampleCount()) {
+                AP4_SegmentIndex::Entry entry;
+                entry.m_StartTime = (AP4_UI64)-1;
+                entry.m_Offset    = position;
+                entry.m_Size      = atom_size;
+                entry.m_Duration  = 0;
+                for (unsigned int i=0; i<sample_table->GetSampleCount(); i++) {
+                    AP4_Sample sample;
+                    sample_table->GetSample(i, sample);
+                    if (sample.GetCts() < entry.m_StartTime) entry.m_StartTime = sample.GetCts();
+                    entry.m_Duration += sample.GetDuration();
+                    next_dts = sample.GetDts()+sample.GetDuration();
+                }
+                entries.Append(entry);
+                in_entry = true;
+            }
+            delete sample_table;
+        } else {
+            // the mdat atoms that follow a moof are part of its segment
+            if (atom->GetType() == AP4_ATOM_TYPE_MDAT && in_entry) {
+                entries[entries.ItemCount()-1].m_Size += atom_size;
+            } else {
+                in_entry = false;
+            }
+            delete atom;
+        }
+        position += atom_size;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   CheckEntries
++---------------------------------------------------------------------*/
+static int
+CheckEntries(const AP4_SegmentIndex& index, const AP4_Array<AP4_SegmentIndex::Entry>& expected)
+{
+    CHECK(index.GetEntryCount() == expected.ItemCount());
+    for (unsigned int i=0; i<expected.ItemCount(); i++) {
+        AP4_SegmentIndex::Entry entry;
+        CHECK(AP4_SUCCEEDED(index.GetEntry(i, entry)));
+        CHECK(entry.m_StartTime == expected[i].m_StartTime);
+        CHECK(entry.m_Offset    == expected[i].m_Offset);
+        CHECK(entry.m_Size      == expected[i].m_Size);
+        CHECK(entry.m_Duration  == expected[i].m_Duration);
+        
+        // lookups map any time within an entry to that entry
+        AP4_Ordinal found = 0;
+        CHECK(AP4_SUCCEEDED(index.FindEntry(entry.m_StartTime, found)) && found == i);
+        CHECK(AP4_SUCCEEDED(index.FindEntry(entry.m_StartTime+entry.m_Duration-1, found)) && found == i);
+    }
+    const AP4_SegmentIndex::Entry& last = expected[expected.ItemCount()-1];
+    AP4_Ordinal found = 0;
+    CHECK(index.FindEntry(last.m_StartTime+last.m_Duration, found) == AP4_ERROR_OUT_OF_RANGE);
+    
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   TestFile
++---------------------------------------------------------------------*/
+static int
+TestFile(const char* filename)
+{
+    AP4_ByteStream* input = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open input file (%s)\n", filename);
+        return -1;
+    }
+    
+    // the index is built for the first track by default
+    AP4_File*  file  = new AP4_File(*input, true);
+    AP4_Movie* movie = file->GetMovie();
+    CHECK(movie != NULL && movie->HasFragments());
+    AP4_Track* track = movie->GetTracks().FirstItem()->GetData();
+    AP4_SegmentIndex* index = NULL;
+    CHECK(AP4_SUCCEEDED(AP4_SegmentIndex::Create(*input, 0, index)));
+    CHECK(index->GetTrackId() == track->GetId());
+    CHECK(index->GetTimeScale() == track->GetMediaTimeScale());
+    CHECK(index->GetInitOffset() == 0);
+    CHECK(index->GetInitSize() > 0);
+    
+    AP4_Array<AP4_SegmentIndex::Entry> expected;
+    CHECK(AP4_SUCCEEDED(ComputeExpectedEntries(*input, *movie, track->GetId(), expected)));
+    CHECK(expected.ItemCount() > 0);
+    CHECK(expected[0].m_Offset == index->GetInitSize());
+    CHECK(CheckEntries(*index, expected) == 0);
+    
+    // the serialized index has the same entries, loaded or used in place
+    AP4_MemoryByteStream* serialized = new AP4_MemoryByteStream();
+    CHECK(AP4_SUCCEEDED(index->Write(*serialized)));
+    CHECK(serialized->GetDataSize() == AP4_SEGMENT_INDEX_HEADER_SIZE+expected.ItemCount()*AP4_SEGMENT_INDEX_ENTRY_SIZE);
+    AP4_SegmentIndex* loaded = NULL;
+    serialized->Seek(0);
+    CHECK(AP4_SUCCEEDED(AP4_SegmentIndex::Load(*serialized, loaded)));
+    CHECK(CheckEntries(*loaded, expected) == 0);
+    AP4_SegmentIndex* attached = NULL;
+    CHECK(AP4_SUCCEEDED(AP4_SegmentIndex::Attach(serialized->GetData(), serialized->GetDataSize(), attached)));
+    CHECK(attached->GetTrackId() == track->GetId());
+    CHECK(CheckEntries(*attached, expected) == 0);
+    
+    delete attached;
+    delete loaded;
+    serialized->Release();
+    delete index;
+    delete file;
+    input->Release();
+    
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        PrintUsageAndExit();
+    }
+    for (int i=1; i<argc; i++) {
+        if (TestFile(argv[i])) {
+            fprintf(stderr, "ERROR: test failed for %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    printf("segment index test passed\n");
+    return 0;
+}
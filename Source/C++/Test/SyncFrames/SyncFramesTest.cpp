@@ -0,0 +1,347 @@
+/*****************************************************************
+|
+|    AP4 - Sync Frames Test
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   macros
++---------------------------------------------------------------------*/
+#define CHECK(x) do { \
+    if (!(x)) { fprintf(stderr, "ERROR line %d\n", __LINE__); return -1; }\
+} while (0)
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const unsigned int TEST_FRAME_COUNT = 300;
+const unsigned int TEST_JUNK_SIZE   = 101;  // before the first frame
+const unsigned int TEST_FEED_SIZE   = 1000; // not a multiple of the frame sizes, for the spans
+
+/*----------------------------------------------------------------------
+|   FrameBoundary
++---------------------------------------------------------------------*/
+struct FrameBoundary {
+    AP4_Position m_Offset;   // offset of the sample data in the stream
+    AP4_Size     m_Size;     // size of the sample data
+    AP4_UI32     m_Duration;
+    AP4_UI32     m_Timescale;
+    bool         m_Sync;
+};
+
+/*----------------------------------------------------------------------
+|   MakeAc3Stream
++---------------------------------------------------------------------*/
+static void
+MakeAc3Stream(AP4_DataBuffer& stream)
+{
+    // alternate 384kbps (1536 bytes) and 160kbps (640 bytes) frames at 48kHz
+    stream.SetDataSize(TEST_JUNK_SIZE+TEST_FRAME_COUNT*1536);
+    AP4_SetMemory(stream.UseData(), 0, stream.GetDataSize());
+    AP4_Size offset = TEST_JUNK_SIZE;
+    for (unsigned int i=0; i<TEST_FRAME_COUNT; i++) {
+        AP4_UI08* frame = stream.UseData()+offset;
+        unsigned int frmsizecod = (i%3 == 1) ? 18 : 28;
+        frame[0] = 0x0B;
+        frame[1] = 0x77;
+        frame[4] = (AP4_UI08)frmsizecod; // fscod=0
+        frame[5] = 8<<3;                 // bsid=8, bsmod=0
+        frame[6] = 2<<5;                 // acmod=2
+        offset += (frmsizecod == 28) ? 1536 : 640;
+    }
+    stream.SetDataSize(offset);
+}
+
+/*----------------------------------------------------------------------
+|   MakeEac3Stream
++---------------------------------------------------------------------*/
+static void
+MakeEac3Stream(AP4_DataBuffer& stream)
+{
+    // independent frames of 6 blocks at 48kHz, some of them followed by
+    // a dependent substream frame that belongs to the same access unit
+    stream.SetDataSize(TEST_JUNK_SIZE+TEST_FRAME_COUNT*(1536+512));
+    AP4_SetMemory(stream.UseData(), 0, stream.GetDataSize());
+    AP4_Size offset = TEST_JUNK_SIZE;
+    for (unsigned int i=0; i<TEST_FRAME_COUNT; i++) {
+        unsigned int frame_count = (i%4 == 2) ? 2 : 1;
+        for (unsigned int j=0; j<frame_count; j++) {
+            AP4_UI08* frame = stream.UseData()+offset;
+            unsigned int frmsiz = j ? 255 : ((i%2) ? 511 : 767); // in 16-bit words, minus 1
+            frame[0] = 0x0B;
+            frame[1] = 0x77;
+            frame[2] = (AP4_UI08)((j<<6) | (frmsiz>>8)); // strmtyp=0 or 1, substreamid=0
+            frame[3] = (AP4_UI08)(frmsiz&0xFF);
+            frame[4] = (3<<4) | (2<<1);                  // fscod=0, numblkscod=3, acmod=2
+            frame[5] = 16<<3;                            // bsid=16, dialnorm=0
+            if (j) {
+                frame[6] = 0x10;                         // compre=0, chanmape=1
+                frame[7] = 0x20;                         // chanmap=0x200 (Lrs/Rrs, for 7.1)
+            }
+            offset += (frmsiz+1)*2;
+        }
+    }
+    stream.SetDataSize(offset);
+}
+
+/*----------------------------------------------------------------------
+|   MakeAc4Stream
++---------------------------------------------------------------------*/
+static void
+MakeAc4Stream(AP4_DataBuffer& stream)
+{
+    // 25fps frames at 48kHz, with a CRC word every 5 frames and an I-frame every 10
+    stream.SetDataSize(TEST_JUNK_SIZE+TEST_FRAME_COUNT*(4+4092+2));
+    AP4_SetMemory(stream.UseData(), 0, stream.GetDataSize());
+    AP4_Size offset = TEST_JUNK_SIZE;
+    for (unsigned int i=0; i<TEST_FRAME_COUNT; i++) {
+        AP4_UI08* frame = stream.UseData()+offset;
+        unsigned int frame_size = (i%2) ? 3000 : 4092;
+        unsigned int crc_size   = (i%5 == 0) ? 2 : 0;
+        frame[0] = 0xAC;
+        frame[1] = crc_size ? 0x41 : 0x40;
+        frame[2] = (AP4_UI08)(frame_size>>8);
+        frame[3] = (AP4_UI08)(frame_size&0xFF);
+        frame[4] = 0x80;                      // bitstream_version=2, sequence_counter=0
+        frame[5] = 0x05;                      // b_wait_frames=0, fs_index=1, frame_rate_index=5...
+        frame[6] = (i%10 == 0) ? 0x60 : 0x40; // ...b_iframe_global
+        offset += 4+frame_size+crc_size;
+    }
+    stream.SetDataSize(offset);
+}
+
+/*----------------------------------------------------------------------
+|   FindFrameBoundaries
++---------------------------------------------------------------------*/
+template <typename PARSER, typename FRAME>
+static AP4_Result
+FindFrameBoundaries(const AP4_DataBuffer&     stream,
+                    AP4_Array<FrameBoundary>& boundaries,
+                    void                      (*get_frame_info)(const FRAME&, FrameBoundary&))
+{
+    // keep the parser's buffer full, like the applications do: the parser
+    // may return an access unit as soon as the header of the next sync
+    // frame is in the buffer
+    PARSER   parser;
+    AP4_Size fed = 0;
+    for (;;) {
+        AP4_Size to_feed = parser.GetBytesFree();
+        if (to_feed > stream.GetDataSize()-fed) to_feed = stream.GetDataSize()-fed;
+        if (to_feed) {
+            parser.Feed(stream.GetData()+fed, &to_feed);
+            fed += to_feed;
+        } else if (fed == stream.GetDataSize()) {
+            parser.Feed(NULL, NULL, AP4_BITSTREAM_FLAG_EOS);
+        }
+
+        FRAME frame;
+        AP4_Result result = parser.FindFrame(frame);
+        if (AP4_SUCCEEDED(result)) {
+            FrameBoundary boundary;
+            boundary.m_Offset = fed-parser.GetBytesAvailable();
+            get_frame_info(frame, boundary);
+            boundaries.Append(boundary);
+            frame.m_Source->SkipBytes(boundary.m_Size);
+        } else if (result != AP4_ERROR_NOT_ENOUGH_DATA) {
+            return result;
+        } else if (fed == stream.GetDataSize()) {
+            break;
+        }
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   FindFrameSpanBoundaries
++---------------------------------------------------------------------*/
+template <typename SPAN>
+static AP4_Result
+FindFrameSpanBoundaries(const AP4_DataBuffer&     stream,
+                        AP4_Array<FrameBoundary>& boundaries,
+                        AP4_Result                (*find_frame_span)(const AP4_UI08*, AP4_Size, AP4_Size&, SPAN&, bool),
+                        void                      (*get_span_info)(const SPAN&, FrameBoundary&))
+{
+    // make the data available in small blocks, like the applications do
+    AP4_Size offset    = 0;
+    AP4_Size available = 0;
+    for (;;) {
+        bool     eos = (available == stream.GetDataSize());
+        AP4_Size bytes_consumed = 0;
+        SPAN     frame;
+        AP4_Result result = find_frame_span(stream.GetData()+offset, available-offset, bytes_consumed, frame, eos);
+        if (bytes_consumed > available-offset) return AP4_ERROR_INTERNAL;
+        offset += bytes_consumed;
+        if (AP4_SUCCEEDED(result)) {
+            FrameBoundary boundary;
+            boundary.m_Offset = (AP4_Position)(frame.m_Data-stream.GetData());
+            boundary.m_Size   = frame.m_Size;
+            get_span_info(frame, boundary);
+            boundaries.Append(boundary);
+        } else if (result != AP4_ERROR_NOT_ENOUGH_DATA) {
+            return result;
+        } else if (eos) {
+            break;
+        } else {
+            available += TEST_FEED_SIZE;
+            if (available > stream.GetDataSize()) available = stream.GetDataSize();
+        }
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   CompareBoundaries
++---------------------------------------------------------------------*/
+static bool
+CompareBoundaries(const AP4_Array<FrameBoundary>& frames, const AP4_Array<FrameBoundary>& spans)
+{
+    if (frames.ItemCount() != TEST_FRAME_COUNT) return false;
+    if (spans.ItemCount() != frames.ItemCount()) return false;
+    for (unsigned int i=0; i<frames.ItemCount(); i++) {
+        if (spans[i].m_Offset    != frames[i].m_Offset    ||
+            spans[i].m_Size      != frames[i].m_Size      ||
+            spans[i].m_Duration  != frames[i].m_Duration  ||
+            spans[i].m_Timescale != frames[i].m_Timescale ||
+            spans[i].m_Sync      != frames[i].m_Sync) {
+            fprintf(stderr, "frame %d: offset=%lld/%lld, size=%d/%d, duration=%d/%d, timescale=%d/%d, sync=%d/%d\n",
+                    i,
+                    (long long)frames[i].m_Offset, (long long)spans[i].m_Offset,
+                    frames[i].m_Size,              spans[i].m_Size,
+                    frames[i].m_Duration,          spans[i].m_Duration,
+                    frames[i].m_Timescale,         spans[i].m_Timescale,
+                    frames[i].m_Sync,              spans[i].m_Sync);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*----------------------------------------------------------------------
+|   frame and span info
++---------------------------------------------------------------------*/
+static void
+GetAc3FrameInfo(const AP4_Ac3Frame& frame, FrameBoundary& boundary)
+{
+    boundary.m_Size      = frame.m_Info.m_FrameSize;
+    boundary.m_Duration  = 1536;
+    boundary.m_Timescale = frame.m_Info.m_SampleRate;
+    boundary.m_Sync      = true;
+}
+static void
+GetAc3SpanInfo(const AP4_Ac3FrameSpan& frame, FrameBoundary& boundary)
+{
+    boundary.m_Duration  = frame.m_SampleCount;
+    boundary.m_Timescale = frame.m_SampleRate;
+    boundary.m_Sync      = true;
+}
+static void
+GetEac3FrameInfo(const AP4_Eac3Frame& frame, FrameBoundary& boundary)
+{
+    boundary.m_Size      = frame.m_Info.m_FrameSize;
+    boundary.m_Duration  = 1536; // the test stream only has 6 block frames
+    boundary.m_Timescale = frame.m_Info.m_SampleRate;
+    boundary.m_Sync      = true;
+}
+static void
+GetEac3SpanInfo(const AP4_Eac3FrameSpan& frame, FrameBoundary& boundary)
+{
+    boundary.m_Duration  = frame.m_SampleCount;
+    boundary.m_Timescale = frame.m_SampleRate;
+    boundary.m_Sync      = true;
+}
+static void
+GetAc4FrameInfo(const AP4_Ac4Frame& frame, FrameBoundary& boundary)
+{
+    // the sample data follows the header, and is followed by the CRC
+    boundary.m_Size      = frame.m_Info.m_FrameSize+frame.m_Info.m_CRCSize;
+    boundary.m_Duration  = frame.m_Info.m_SampleDuration;
+    boundary.m_Timescale = frame.m_Info.m_MediaTimeScale;
+    boundary.m_Sync      = frame.m_Info.m_Iframe == 1;
+}
+static void
+GetAc4SpanInfo(const AP4_Ac4FrameSpan& frame, FrameBoundary& boundary)
+{
+    boundary.m_Duration  = frame.m_SampleDuration;
+    boundary.m_Timescale = frame.m_MediaTimeScale;
+    boundary.m_Sync      = frame.m_Iframe == 1;
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int /*argc*/, char** /*argv*/)
+{
+    AP4_DataBuffer stream;
+
+    // AC-3
+    MakeAc3Stream(stream);
+    {
+        AP4_Array<FrameBoundary> frames;
+        AP4_Array<FrameBoundary> spans;
+        CHECK(AP4_SUCCEEDED(FindFrameBoundaries<AP4_Ac3Parser>(stream, frames, GetAc3FrameInfo)));
+        CHECK(AP4_SUCCEEDED(FindFrameSpanBoundaries(stream, spans, AP4_Ac3Parser::FindFrameSpan, GetAc3SpanInfo)));
+        CHECK(CompareBoundaries(frames, spans));
+    }
+
+    // E-AC-3
+    MakeEac3Stream(stream);
+    {
+        AP4_Array<FrameBoundary> frames;
+        AP4_Array<FrameBoundary> spans;
+        CHECK(AP4_SUCCEEDED(FindFrameBoundaries<AP4_Eac3Parser>(stream, frames, GetEac3FrameInfo)));
+        CHECK(AP4_SUCCEEDED(FindFrameSpanBoundaries(stream, spans, AP4_Eac3Parser::FindFrameSpan, GetEac3SpanInfo)));
+        CHECK(CompareBoundaries(frames, spans));
+    }
+
+    // AC-4
+    MakeAc4Stream(stream);
+    {
+        AP4_Array<FrameBoundary> frames;
+        AP4_Array<FrameBoundary> spans;
+        CHECK(AP4_SUCCEEDED(FindFrameBoundaries<AP4_Ac4Parser>(stream, frames, GetAc4FrameInfo)));
+        CHECK(AP4_SUCCEEDED(FindFrameSpanBoundaries(stream, spans, AP4_Ac4Parser::FindFrameSpan, GetAc4SpanInfo)));
+
+        // the spans do not include the CRC
+        for (unsigned int i=0; i<spans.ItemCount(); i++) {
+            if ((i%5) == 0) spans[i].m_Size += 2;
+        }
+        CHECK(CompareBoundaries(frames, spans));
+    }
+
+    printf("sync frames test passed\n");
+    return 0;
+}